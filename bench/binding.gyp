@@ -0,0 +1,62 @@
+{
+  "targets": [
+    {
+      "target_name": "pjsip_bench_uas",
+      "type": "executable",
+      "sources": [
+        "uas.cpp"
+      ],
+      "include_dirs": [
+        "../pjproject-2.15.1/pjlib/include",
+        "../pjproject-2.15.1/pjlib-util/include",
+        "../pjproject-2.15.1/pjmedia/include",
+        "../pjproject-2.15.1/pjnath/include",
+        "../pjproject-2.15.1/pjsip/include",
+        "../pjproject-2.15.1/pjsip-apps/src/pjsua"
+      ],
+      "conditions": [
+        ["OS=='win'", {
+          "libraries": [
+            "ws2_32.lib",
+            "advapi32.lib",
+            "crypt32.lib",
+            "iphlpapi.lib",
+            "winmm.lib",
+            "msvcrt.lib",
+            "kernel32.lib",
+            "user32.lib",
+            "<!(node -e \"const fs=require('fs'); const path=require('path'); const rootDir='../pjproject-2.15.1'; const searchPaths=['lib','pjlib/lib','pjlib-util/lib','pjmedia/lib','pjnath/lib','pjsip/lib','third_party/lib']; const foundLibs=[]; searchPaths.forEach(sp=>{const fullPath=path.join(rootDir,sp); if(fs.existsSync(fullPath)){fs.readdirSync(fullPath).filter(f=>f.endsWith('.lib')).forEach(lib=>foundLibs.push(path.resolve(fullPath,lib)))}}); if(foundLibs.length===0){process.stderr.write('No PJSIP libraries found'); process.exit(1)}; const ordered=['pjsua2-lib','pjsua-lib','pjsip-ua','pjsip-simple','pjsip-core','pjmedia-codec','pjmedia-audiodev','pjmedia-videodev','pjmedia','pjnath','pjlib-util','pjlib','libspeex','libilbccodec','libg7221codec','libgsmcodec','libsrtp','libresample','libwebrtc','libyuv','libbaseclasses','libmilenage']; const orderedLibs=[]; ordered.forEach(name=>{const lib=foundLibs.find(l=>l.includes(name)); if(lib)orderedLibs.push(lib)}); foundLibs.forEach(lib=>{if(!orderedLibs.includes(lib))orderedLibs.push(lib)}); console.log(orderedLibs.join(';'));\")"
+          ],
+          "msvs_settings": {
+            "VCCLCompilerTool": {
+              "ExceptionHandling": 1,
+              "AdditionalOptions": ["/std:c++17"]
+            },
+            "VCLinkerTool": {
+              "AdditionalOptions": ["/NODEFAULTLIB:MSVCRT"]
+            }
+          }
+        }],
+        ["OS=='mac'", {
+          "libraries": [
+            "<!(node -e \"const fs=require('fs'); const path=require('path'); const libDir = '../pjproject-2.15.1/lib'; const foundLibs = []; if(fs.existsSync(libDir)) { const libFiles = fs.readdirSync(libDir).filter(f => f.endsWith('.a') || f.endsWith('.dylib')); libFiles.forEach(lib => { foundLibs.push(path.resolve(libDir, lib)); }); } else { console.log('lib directory not found: ' + libDir); } if(foundLibs.length === 0) { console.log('No PJSIP libraries found in ' + libDir); process.exit(1); } foundLibs.forEach(lib => console.log(lib));\")"
+          ],
+          "xcode_settings": {
+            "MACOSX_DEPLOYMENT_TARGET": "15.0",
+            "GCC_ENABLE_CPP_EXCEPTIONS": "YES",
+            "CLANG_CXX_LANGUAGE_STANDARD": "c++17"
+          }
+        }]
+      ],
+      "defines": [
+        "PJ_IS_LITTLE_ENDIAN=1",
+        "PJ_IS_BIG_ENDIAN=0",
+        "PJ_WIN64=1",
+        "PJ_M_X86_64=1",
+        "WIN64=1",
+        "WIN32=1",
+        "_WIN32_WINNT=0x0601"
+      ]
+    }
+  ]
+}
@@ -0,0 +1,484 @@
+#!/usr/bin/env node
+// Benchmark harness: drives the addon against the loopback stand-in UAS
+// (bench/uas.cpp, built by `npm run build:bench`) and writes the results as
+// JSON so runs can be compared between releases.
+//
+//   node bench/run.js [--scenario all|register|cps|soak] [--out bench-results.json]
+//                     [--baseline old.json --tolerance 0.2] [--<option> value ...]
+//
+// Scenarios:
+//   register  registration storm, `accounts` REGISTERs paced at `regRate`/s
+//   cps       call rate ramp from `cpsStart` to `cpsEnd` in `cpsStep` steps of
+//             `stepSeconds`, each call held for `holdMs`
+//   soak      `soakCalls` concurrent calls held for `soakSeconds`
+//
+// Latencies are taken from the native event timestamps, so JS scheduling
+// only shows up in the event delivery numbers. CPU and RSS are for this
+// process (addon + harness), the UAS runs in its own process.
+
+const { spawn } = require('child_process');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const addon = require('../build/Release/node_pjsip.node');
+
+const EVENT_RECORD_INTS = 8;
+const EVENT_REG_STATE = 1;
+const EVENT_CALL_STATE = 3;
+const INV_STATE_CONFIRMED = 5;
+const INV_STATE_DISCONNECTED = 6;
+
+const RESULTS_SCHEMA = 1;
+
+const DEFAULTS = {
+    scenario: 'all',
+    out: 'bench-results.json',
+    baseline: '',
+    tolerance: 0.2,         // allowed p99 growth against the baseline
+    uas: path.join(__dirname, 'build', 'Release',
+                   process.platform === 'win32' ? 'pjsip_bench_uas.exe' : 'pjsip_bench_uas'),
+    uasPort: 5070,
+    uasThreads: 2,
+    threads: 4,             // SIP worker threads in the addon
+    maxCalls: 2048,         // capped at PJSUA_MAX_CALLS, see PJSIP_SETUP.md
+    accounts: 1000,         // capped at PJSUA_MAX_ACC
+    regRate: 200,
+    cpsStart: 10,
+    cpsEnd: 100,
+    cpsStep: 10,
+    stepSeconds: 10,
+    holdMs: 2000,
+    soakCalls: 500,
+    soakRate: 50,
+    soakSeconds: 60,
+    settleMs: 5000          // grace period for in-flight transactions
+};
+
+function parseArgs(argv) {
+    const options = Object.assign({}, DEFAULTS);
+    for (let i = 0; i < argv.length; i += 2) {
+        const key = argv[i].replace(/^--/, '').replace(/-([a-z])/g, (m, c) => c.toUpperCase());
+        if (!(key in DEFAULTS) || i + 1 >= argv.length) {
+            throw new Error(`Unknown or incomplete option ${argv[i]}`);
+        }
+        options[key] = typeof DEFAULTS[key] === 'number' ? Number(argv[i + 1]) : argv[i + 1];
+    }
+    return options;
+}
+
+const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+function percentiles(samples) {
+    if (samples.length === 0) {
+        return { count: 0, p50: null, p99: null, p999: null, max: null };
+    }
+    const sorted = Float64Array.from(samples).sort();
+    const at = (q) => sorted[Math.min(sorted.length - 1, Math.floor(q * sorted.length))];
+    return {
+        count: sorted.length,
+        p50: at(0.5) / 1000,        // milliseconds
+        p99: at(0.99) / 1000,
+        p999: at(0.999) / 1000,
+        max: sorted[sorted.length - 1] / 1000
+    };
+}
+
+function cpuMicros() {
+    const usage = process.cpuUsage();
+    return usage.user + usage.system;
+}
+
+// Issues `perSecond` actions for `seconds`, in small bursts off a 5 ms tick
+async function paced(perSecond, seconds, action) {
+    const start = Date.now();
+    let issued = 0;
+    while (Date.now() - start < seconds * 1000) {
+        const due = Math.floor(((Date.now() - start) / 1000) * perSecond);
+        while (issued < due) {
+            issued++;
+            if (action() === false) {
+                return issued;
+            }
+        }
+        await sleep(5);
+    }
+    return issued;
+}
+
+async function waitFor(predicate, timeoutMs) {
+    const deadline = Date.now() + timeoutMs;
+    while (!predicate() && Date.now() < deadline) {
+        await sleep(20);
+    }
+    return predicate();
+}
+
+class LoopbackUas {
+    constructor(options) {
+        this.options = options;
+        this.summary = null;
+    }
+
+    start() {
+        if (!fs.existsSync(this.options.uas)) {
+            return Promise.reject(new Error(`UAS binary not found at ${this.options.uas}, run npm run build:bench`));
+        }
+        this.process = spawn(this.options.uas, [
+            '--port', String(this.options.uasPort),
+            '--threads', String(this.options.uasThreads),
+            '--max-calls', String(this.options.maxCalls)
+        ], { stdio: ['pipe', 'pipe', 'inherit'] });
+
+        return new Promise((resolve, reject) => {
+            let output = '';
+            this.process.stdout.on('data', (chunk) => {
+                output += chunk.toString();
+                const ready = output.match(/READY (\d+)/);
+                if (ready && !this.port) {
+                    this.port = Number(ready[1]);
+                    resolve(this.port);
+                }
+                const done = output.match(/DONE (.*)/);
+                if (done) {
+                    this.summary = done[1];
+                }
+            });
+            this.process.on('exit', (code) => {
+                if (!this.port) {
+                    reject(new Error(`UAS exited with code ${code}`));
+                }
+            });
+        });
+    }
+
+    async stop() {
+        if (!this.process) {
+            return;
+        }
+        const exited = new Promise((resolve) => this.process.on('exit', resolve));
+        this.process.stdin.end();
+        await Promise.race([exited, sleep(5000)]);
+        this.process.kill();
+    }
+}
+
+class Harness {
+    constructor(options) {
+        this.options = options;
+        this.deliveryLatency = [];
+        this.regPending = new Map();    // acc id -> send time
+        this.regLatency = [];
+        this.regOk = 0;
+        this.regFailed = 0;
+        this.calls = new Map();         // call id -> { start, confirmed, sample }
+        this.onConfirmed = null;
+    }
+
+    init() {
+        const result = addon.Init({
+            maxCalls: this.options.maxCalls,
+            threadCount: this.options.threads,
+            audioDevice: 'null',
+            autoConnectAudio: false,
+            logLevel: 1,
+            transports: [{ type: 'udp', port: 0, bindAddress: '127.0.0.1' }]
+        });
+        if (!result) {
+            throw new Error('PJSIP init failed');
+        }
+        const buffer = addon.setEventCallback((count) => this.dispatch(count));
+        this.eventInts = new Int32Array(buffer);
+        this.eventTimes = new Float64Array(buffer);
+    }
+
+    dispatch(count) {
+        const now = addon.getMonotonicTime();
+        for (let i = 0; i < count; i++) {
+            const base = i * EVENT_RECORD_INTS;
+            const timestamp = this.eventTimes[(base >> 1) + 3];
+            this.deliveryLatency.push(now - timestamp);
+
+            if (this.eventInts[base] === EVENT_REG_STATE) {
+                this.onRegState(this.eventInts[base + 1], this.eventInts[base + 4], timestamp);
+            } else if (this.eventInts[base] === EVENT_CALL_STATE) {
+                this.onCallState(this.eventInts[base + 2], this.eventInts[base + 3], timestamp);
+            }
+        }
+    }
+
+    onRegState(accId, statusCode, timestamp) {
+        const sent = this.regPending.get(accId);
+        if (sent === undefined) {
+            return;
+        }
+        this.regPending.delete(accId);
+        if (statusCode === 200) {
+            this.regOk++;
+            this.regLatency.push(timestamp - sent);
+        } else {
+            this.regFailed++;
+        }
+    }
+
+    onCallState(callId, state, timestamp) {
+        const call = this.calls.get(callId);
+        if (!call) {
+            return;
+        }
+        if (state === INV_STATE_CONFIRMED && !call.confirmed) {
+            call.confirmed = true;
+            call.sample.confirmed++;
+            call.sample.setup.push(timestamp - call.start);
+            if (this.onConfirmed) {
+                this.onConfirmed(callId);
+            }
+        } else if (state === INV_STATE_DISCONNECTED) {
+            if (!call.confirmed) {
+                call.sample.failed++;
+            }
+            this.calls.delete(callId);
+        }
+    }
+
+    // Returns false when the stack refuses the call
+    startCall(accId, uri, sample) {
+        const start = addon.getMonotonicTime();
+        const callId = addon.makeCall(accId, uri);
+        sample.offered++;
+        if (callId < 0) {
+            sample.failed++;
+            return false;
+        }
+        this.calls.set(callId, { start, confirmed: false, sample });
+        return true;
+    }
+
+    async registrationStorm(uasPort) {
+        const registrar = `sip:127.0.0.1:${uasPort}`;
+        const accountIds = [];
+        let limited = false;
+        const cpuStart = cpuMicros();
+        const started = Date.now();
+
+        const issued = await paced(this.options.regRate, Infinity, () => {
+            if (accountIds.length >= this.options.accounts) {
+                return false;
+            }
+            const n = accountIds.length;
+            const sent = addon.getMonotonicTime();
+            const accId = addon.addAccount({
+                aor: `sip:bench${n}@127.0.0.1`,
+                registrar,
+                username: `bench${n}`,
+                password: 'bench'
+            });
+            if (accId < 0) {
+                limited = true;     // PJSUA_MAX_ACC reached
+                return false;
+            }
+            this.regPending.set(accId, sent);
+            accountIds.push(accId);
+            return accountIds.length < this.options.accounts;
+        });
+
+        await waitFor(() => this.regPending.size === 0, this.options.settleMs);
+        const elapsed = (Date.now() - started) / 1000;
+        const cpu = cpuMicros() - cpuStart;
+
+        for (const accId of accountIds) {
+            addon.removeAccount(accId);
+        }
+        this.regPending.clear();
+
+        return {
+            requested: this.options.accounts,
+            issued,
+            registered: this.regOk,
+            failed: this.regFailed,
+            timedOut: accountIds.length - this.regOk - this.regFailed,
+            limitedByMaxAccounts: limited,
+            targetRate: this.options.regRate,
+            achievedRate: this.regOk / elapsed,
+            cpuMicrosPerRegister: this.regOk > 0 ? cpu / this.regOk : null,
+            roundTrip: percentiles(this.regLatency)
+        };
+    }
+
+    addCallAccount(uasPort) {
+        const accId = addon.addAccount({
+            aor: 'sip:bench@127.0.0.1',
+            registrar: `sip:127.0.0.1:${uasPort}`,
+            username: 'bench',
+            password: 'bench'
+        });
+        if (accId < 0) {
+            throw new Error('Adding the calling account failed');
+        }
+        return accId;
+    }
+
+    async cpsRamp(accId, uri) {
+        const steps = [];
+        this.onConfirmed = (callId) => {
+            setTimeout(() => addon.hangupCall(callId), this.options.holdMs);
+        };
+
+        for (let cps = this.options.cpsStart; cps <= this.options.cpsEnd; cps += this.options.cpsStep) {
+            const sample = { offered: 0, confirmed: 0, failed: 0, setup: [] };
+            const cpuStart = cpuMicros();
+
+            await paced(cps, this.options.stepSeconds, () => {
+                this.startCall(accId, uri, sample);
+            });
+            await waitFor(() => this.calls.size === 0, this.options.holdMs + this.options.settleMs);
+            const cpu = cpuMicros() - cpuStart;
+
+            steps.push({
+                targetCps: cps,
+                achievedCps: sample.confirmed / this.options.stepSeconds,
+                offered: sample.offered,
+                confirmed: sample.confirmed,
+                failed: sample.failed,
+                cpuMicrosPerCall: sample.confirmed > 0 ? cpu / sample.confirmed : null,
+                setup: percentiles(sample.setup)
+            });
+            console.log(`  ${cps} cps: ${sample.confirmed}/${sample.offered} confirmed, ` +
+                        `p99 setup ${steps[steps.length - 1].setup.p99} ms`);
+        }
+
+        this.onConfirmed = null;
+        return steps;
+    }
+
+    async soak(accId, uri) {
+        const sample = { offered: 0, confirmed: 0, failed: 0, setup: [] };
+        const rssBase = process.memoryUsage().rss;
+
+        await paced(this.options.soakRate, this.options.soakCalls / this.options.soakRate + 1, () => {
+            return this.startCall(accId, uri, sample) && sample.offered < this.options.soakCalls;
+        });
+        await waitFor(() => sample.confirmed + sample.failed >= sample.offered, this.options.settleMs);
+
+        const established = sample.confirmed;
+        const cpuStart = cpuMicros();
+        const rssSamples = [];
+        const holdStart = Date.now();
+        while (Date.now() - holdStart < this.options.soakSeconds * 1000) {
+            await sleep(1000);
+            rssSamples.push(process.memoryUsage().rss);
+        }
+        const cpu = cpuMicros() - cpuStart;
+        const rssPeak = Math.max(rssBase, ...rssSamples);
+        const dropped = established - this.calls.size;
+
+        for (const callId of Array.from(this.calls.keys())) {
+            addon.hangupCall(callId);
+        }
+        await waitFor(() => this.calls.size === 0, this.options.settleMs);
+
+        return {
+            requested: this.options.soakCalls,
+            established,
+            failed: sample.failed,
+            droppedDuringHold: dropped,
+            holdSeconds: this.options.soakSeconds,
+            rssBaseBytes: rssBase,
+            rssPeakBytes: rssPeak,
+            rssBytesPerCall: established > 0 ? (rssPeak - rssBase) / established : null,
+            cpuMicrosPerCallSecond: established > 0 ? cpu / (established * this.options.soakSeconds) : null,
+            setup: percentiles(sample.setup)
+        };
+    }
+}
+
+// p99 metrics compared against a baseline results file
+function compareWithBaseline(results, baseline, tolerance) {
+    const metrics = [
+        ['register.roundTrip.p99', (r) => r.register && r.register.roundTrip.p99],
+        ['soak.setup.p99', (r) => r.soak && r.soak.setup.p99],
+        ['soak.rssBytesPerCall', (r) => r.soak && r.soak.rssBytesPerCall],
+        ['soak.cpuMicrosPerCallSecond', (r) => r.soak && r.soak.cpuMicrosPerCallSecond],
+        ['eventDelivery.p99', (r) => r.eventDelivery && r.eventDelivery.p99]
+    ];
+    const regressions = [];
+    for (const [name, get] of metrics) {
+        const before = get(baseline);
+        const after = get(results);
+        if (before > 0 && after !== null && after !== undefined && after > before * (1 + tolerance)) {
+            regressions.push({ metric: name, baseline: before, current: after });
+        }
+    }
+    return regressions;
+}
+
+async function main() {
+    const options = parseArgs(process.argv.slice(2));
+    const scenarios = options.scenario === 'all' ? ['register', 'cps', 'soak'] : options.scenario.split(',');
+
+    const uas = new LoopbackUas(options);
+    const uasPort = await uas.start();
+    const uri = `sip:uas@127.0.0.1:${uasPort}`;
+
+    const harness = new Harness(options);
+    harness.init();
+
+    const results = {
+        schema: RESULTS_SCHEMA,
+        startedAt: new Date().toISOString(),
+        host: {
+            platform: process.platform,
+            arch: process.arch,
+            cpus: os.cpus().length,
+            cpuModel: os.cpus()[0] ? os.cpus()[0].model : '',
+            node: process.version
+        },
+        pjsip: addon.getVersion(),
+        options
+    };
+
+    try {
+        if (scenarios.includes('register')) {
+            console.log(`Registration storm: ${options.accounts} accounts at ${options.regRate}/s`);
+            results.register = await harness.registrationStorm(uasPort);
+        }
+        if (scenarios.includes('cps') || scenarios.includes('soak')) {
+            const accId = harness.addCallAccount(uasPort);
+            if (scenarios.includes('cps')) {
+                console.log(`CPS ramp: ${options.cpsStart}..${options.cpsEnd} step ${options.cpsStep}`);
+                results.cps = await harness.cpsRamp(accId, uri);
+            }
+            if (scenarios.includes('soak')) {
+                console.log(`Soak: ${options.soakCalls} calls for ${options.soakSeconds}s`);
+                results.soak = await harness.soak(accId, uri);
+            }
+            addon.removeAccount(accId);
+        }
+        results.eventDelivery = percentiles(harness.deliveryLatency);
+        results.eventQueue = addon.getEventQueueStats();
+        results.transports = addon.getTransports();
+    } finally {
+        addon.shutdown();
+        await uas.stop();
+    }
+    results.uas = uas.summary;
+    results.finishedAt = new Date().toISOString();
+
+    fs.writeFileSync(options.out, JSON.stringify(results, null, 2) + '\n');
+    console.log(`Results written to ${options.out}`);
+
+    if (options.baseline) {
+        const baseline = JSON.parse(fs.readFileSync(options.baseline, 'utf8'));
+        const regressions = compareWithBaseline(results, baseline, options.tolerance);
+        for (const r of regressions) {
+            console.error(`Regression: ${r.metric} ${r.baseline} -> ${r.current}`);
+        }
+        if (regressions.length > 0) {
+            process.exitCode = 1;
+        }
+    }
+}
+
+main().catch((error) => {
+    console.error(error);
+    process.exit(1);
+});
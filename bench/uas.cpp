@@ -0,0 +1,254 @@
+// Loopback stand-in UAS for the benchmark harness (bench/run.js).
+//
+// A second pjsua endpoint in its own process, since pjsua is a process
+// singleton. It answers every REGISTER with a stateless 200 that echoes the
+// Contact and Expires, auto-answers every INVITE (optionally after a 180 and
+// a delay) and can hang up after a fixed hold. Prints "READY <port>" once
+// listening, exits when stdin closes and prints its counters on the way out.
+//
+//   pjsip_bench_uas [--port 5070] [--threads 2] [--max-calls 512]
+//                   [--answer-delay ms] [--hold ms] [--log level]
+
+#include <pjsua-lib/pjsua.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+struct UasOptions {
+    int port;
+    unsigned threads;
+    unsigned max_calls;
+    unsigned answer_delay_ms;   // 0 = answer 200 straight away
+    unsigned hold_ms;           // 0 = wait for the caller's BYE
+    unsigned log_level;
+
+    UasOptions() : port(5070), threads(2), max_calls(512), answer_delay_ms(0), hold_ms(0), log_level(1) {}
+};
+
+static UasOptions options;
+static std::atomic<bool> running(true);
+static std::atomic<uint64_t> registers(0);
+static std::atomic<uint64_t> calls_offered(0);
+static std::atomic<uint64_t> calls_answered(0);
+static std::atomic<uint64_t> calls_ended(0);
+
+// Call ids are reused, timers carry a per-slot sequence to skip stale ones
+static std::atomic<uint32_t> call_sequence[PJSUA_MAX_CALLS];
+
+static void* packTimerData(pjsua_call_id call_id) {
+    uint32_t sequence = call_sequence[call_id].load() & 0xffff;
+    return (void*)(intptr_t)((sequence << 16) | (uint32_t)call_id);
+}
+
+static bool unpackTimerData(void* user_data, pjsua_call_id& call_id) {
+    uint32_t packed = (uint32_t)(intptr_t)user_data;
+    call_id = (pjsua_call_id)(packed & 0xffff);
+    return call_id < (pjsua_call_id)PJSUA_MAX_CALLS && (call_sequence[call_id].load() & 0xffff) == (packed >> 16);
+}
+
+static void onAnswerTimer(void* user_data) {
+    pjsua_call_id call_id;
+    if (unpackTimerData(user_data, call_id)) {
+        pjsua_call_answer(call_id, PJSIP_SC_OK, nullptr, nullptr);
+    }
+}
+
+static void onHangupTimer(void* user_data) {
+    pjsua_call_id call_id;
+    if (unpackTimerData(user_data, call_id)) {
+        pjsua_call_hangup(call_id, 0, nullptr, nullptr);
+    }
+}
+
+static void onIncomingCall(pjsua_acc_id acc_id, pjsua_call_id call_id, pjsip_rx_data* rdata) {
+    PJ_UNUSED_ARG(acc_id);
+    PJ_UNUSED_ARG(rdata);
+    call_sequence[call_id].fetch_add(1);
+    calls_offered.fetch_add(1, std::memory_order_relaxed);
+
+    if (options.answer_delay_ms == 0) {
+        pjsua_call_answer(call_id, PJSIP_SC_OK, nullptr, nullptr);
+        return;
+    }
+    pjsua_call_answer(call_id, PJSIP_SC_RINGING, nullptr, nullptr);
+    pjsua_schedule_timer2(&onAnswerTimer, packTimerData(call_id), options.answer_delay_ms);
+}
+
+static void onCallState(pjsua_call_id call_id, pjsip_event* e) {
+    PJ_UNUSED_ARG(e);
+    pjsua_call_info info;
+    if (pjsua_call_get_info(call_id, &info) != PJ_SUCCESS) {
+        return;
+    }
+
+    if (info.state == PJSIP_INV_STATE_CONFIRMED) {
+        calls_answered.fetch_add(1, std::memory_order_relaxed);
+        if (options.hold_ms > 0) {
+            pjsua_schedule_timer2(&onHangupTimer, packTimerData(call_id), options.hold_ms);
+        }
+    } else if (info.state == PJSIP_INV_STATE_DISCONNECTED) {
+        calls_ended.fetch_add(1, std::memory_order_relaxed);
+        call_sequence[call_id].fetch_add(1);
+    }
+}
+
+// Stateless registrar: 200 OK with the request's Contact and Expires
+static pj_bool_t onRxRequest(pjsip_rx_data* rdata) {
+    pjsip_msg* msg = rdata->msg_info.msg;
+    if (msg->line.req.method.id != PJSIP_REGISTER_METHOD) {
+        return PJ_FALSE;
+    }
+
+    pjsip_hdr headers;
+    pj_list_init(&headers);
+    pj_pool_t* pool = rdata->tp_info.pool;
+
+    const pjsip_hdr* contact = (const pjsip_hdr*)pjsip_msg_find_hdr(msg, PJSIP_H_CONTACT, nullptr);
+    if (contact) {
+        pj_list_push_back(&headers, pjsip_hdr_clone(pool, contact));
+    }
+    const pjsip_expires_hdr* expires = (const pjsip_expires_hdr*)pjsip_msg_find_hdr(msg, PJSIP_H_EXPIRES, nullptr);
+    pj_list_push_back(&headers, pjsip_expires_hdr_create(pool, expires ? expires->ivalue : 300));
+
+    pjsip_endpt_respond_stateless(pjsua_get_pjsip_endpt(), rdata, PJSIP_SC_OK, nullptr, &headers, nullptr);
+    registers.fetch_add(1, std::memory_order_relaxed);
+    return PJ_TRUE;
+}
+
+static pjsip_module registrar_module;
+
+static bool parseArgs(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n", arg.c_str());
+            return false;
+        }
+        long value = strtol(argv[++i], nullptr, 10);
+        if (value < 0) {
+            fprintf(stderr, "Invalid value for %s\n", arg.c_str());
+            return false;
+        }
+        if (arg == "--port") {
+            options.port = (int)value;
+        } else if (arg == "--threads") {
+            options.threads = (unsigned)value;
+        } else if (arg == "--max-calls") {
+            options.max_calls = (unsigned)value;
+        } else if (arg == "--answer-delay") {
+            options.answer_delay_ms = (unsigned)value;
+        } else if (arg == "--hold") {
+            options.hold_ms = (unsigned)value;
+        } else if (arg == "--log") {
+            options.log_level = (unsigned)value;
+        } else {
+            fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (!parseArgs(argc, argv)) {
+        return 2;
+    }
+
+    pj_status_t status = pjsua_create();
+    if (status != PJ_SUCCESS) {
+        fprintf(stderr, "pjsua_create() failed: %d\n", status);
+        return 1;
+    }
+
+    pjsua_config ua_cfg;
+    pjsua_logging_config log_cfg;
+    pjsua_media_config media_cfg;
+    pjsua_config_default(&ua_cfg);
+    pjsua_logging_config_default(&log_cfg);
+    pjsua_media_config_default(&media_cfg);
+
+    ua_cfg.cb.on_incoming_call = &onIncomingCall;
+    ua_cfg.cb.on_call_state = &onCallState;
+    ua_cfg.max_calls = options.max_calls < PJSUA_MAX_CALLS ? options.max_calls : PJSUA_MAX_CALLS;
+    ua_cfg.thread_cnt = options.threads;
+    log_cfg.level = options.log_level;
+    log_cfg.console_level = options.log_level;
+    media_cfg.max_media_ports = ua_cfg.max_calls + 2;
+    media_cfg.clock_rate = 8000;
+    media_cfg.no_vad = PJ_TRUE;
+
+    status = pjsua_init(&ua_cfg, &log_cfg, &media_cfg);
+    if (status != PJ_SUCCESS) {
+        fprintf(stderr, "pjsua_init() failed: %d\n", status);
+        pjsua_destroy();
+        return 1;
+    }
+    pjsua_set_null_snd_dev();
+
+    pj_bzero(&registrar_module, sizeof(registrar_module));
+    registrar_module.name = pj_str((char*)"mod-bench-registrar");
+    registrar_module.id = -1;
+    registrar_module.priority = PJSIP_MOD_PRIORITY_APPLICATION;
+    registrar_module.on_rx_request = &onRxRequest;
+    status = pjsip_endpt_register_module(pjsua_get_pjsip_endpt(), &registrar_module);
+    if (status != PJ_SUCCESS) {
+        fprintf(stderr, "Registering the registrar module failed: %d\n", status);
+        pjsua_destroy();
+        return 1;
+    }
+
+    pjsua_transport_config transport_cfg;
+    pjsua_transport_config_default(&transport_cfg);
+    transport_cfg.port = (unsigned)options.port;
+    transport_cfg.bound_addr = pj_str((char*)"127.0.0.1");
+    transport_cfg.public_addr = pj_str((char*)"127.0.0.1");
+
+    pjsua_transport_id transport_id;
+    status = pjsua_transport_create(PJSIP_TRANSPORT_UDP, &transport_cfg, &transport_id);
+    if (status != PJ_SUCCESS) {
+        fprintf(stderr, "Creating the UDP transport on port %d failed: %d\n", options.port, status);
+        pjsua_destroy();
+        return 1;
+    }
+
+    // Catch-all account so every INVITE reaches on_incoming_call
+    pjsua_acc_id acc_id;
+    pjsua_acc_add_local(transport_id, PJ_TRUE, &acc_id);
+
+    status = pjsua_start();
+    if (status != PJ_SUCCESS) {
+        fprintf(stderr, "pjsua_start() failed: %d\n", status);
+        pjsua_destroy();
+        return 1;
+    }
+
+    pjsua_transport_info transport_info;
+    pjsua_transport_get_info(transport_id, &transport_info);
+    printf("READY %d\n", transport_info.local_name.port);
+    fflush(stdout);
+
+    // The harness owns our lifetime through the stdin pipe
+    std::thread watcher([] {
+        while (fgetc(stdin) != EOF) {
+        }
+        running.store(false);
+    });
+    watcher.detach();
+
+    while (running.load()) {
+        pj_thread_sleep(100);
+    }
+
+    printf("DONE registers=%llu offered=%llu answered=%llu ended=%llu\n",
+           (unsigned long long)registers.load(), (unsigned long long)calls_offered.load(),
+           (unsigned long long)calls_answered.load(), (unsigned long long)calls_ended.load());
+    fflush(stdout);
+
+    pjsua_destroy();
+    return 0;
+}
@@ -4,6 +4,24 @@
       "target_name": "node_pjsip",
       "sources": [
         "src/addon.cpp",
+        "src/account_table.cpp",
+        "src/admission.cpp",
+        "src/call_bridge.cpp",
+        "src/call_recorder.cpp",
+        "src/call_table.cpp",
+        "src/codec_control.cpp",
+        "src/command_worker.cpp",
+        "src/dns_cache.cpp",
+        "src/env_context.cpp",
+        "src/event_queue.cpp",
+        "src/flow_table.cpp",
+        "src/log_sink.cpp",
+        "src/packet_capture.cpp",
+        "src/registration_scheduler.cpp",
+        "src/transport_set.cpp",
+        "src/metrics.cpp",
+        "src/media_stats.cpp",
+        "src/media_tap.cpp",
         "src/pjsip_wrapper.cpp"
       ],
       "include_dirs": [
@@ -2,6 +2,29 @@
 const addon = require('../build/Release/node_pjsip.node');
 const EventEmitter = require('events');
 
+// Event kinds produced by the native event pipeline
+const EVENT_REG_STATE = 1;
+const EVENT_INCOMING_CALL = 2;
+const EVENT_CALL_STATE = 3;
+const EVENT_CALL_MEDIA_STATE = 4;
+
+// Native event record layout: 32 bytes, 8 int32 slots with the
+// timestamp stored as a float64 in the last 8 bytes
+const EVENT_RECORD_INTS = 8;
+
+// Native call table record layout: 64 bytes, 8 int32 slots followed by
+// 4 float64 timestamps
+const CALL_RECORD_INTS = 16;
+const CALL_RECORD_DOUBLES = 8;
+
+// Native media stats record layout: 128 bytes, 8 int32 slots (call id,
+// account, media index, rx packets, rx lost, rx discarded, tx packets,
+// tx lost) followed by 12 float64 values from slot 4 on (rx/tx bytes,
+// rx jitter, rx jitter max, tx jitter, rtt, rtt mean, rx/tx loss %,
+// R factor, MOS, sample time)
+const MEDIA_STATS_RECORD_INTS = 32;
+const MEDIA_STATS_RECORD_DOUBLES = 16;
+
 class PJSIP extends EventEmitter {
     constructor() {
         super();
@@ -9,14 +32,18 @@ class PJSIP extends EventEmitter {
         this.isInitialized = false;
     }
 
-    // Initialize PJSIP stack
-    init() {
+    // Initialize PJSIP stack, options size the call engine (maxCalls, threadCount,
+    // mediaThreadCount, mediaIoqueue, clockRate, ptime, confPorts)
+    init(options = {}) {
         if (this.isInitialized) {
             return Promise.resolve("PJSIP already initialized");
         }
 
         try {
-            const result = addon.Init();
+            const result = addon.Init(options);
+            const buffer = addon.setEventCallback((count) => this._dispatchEvents(count));
+            this._eventInts = new Int32Array(buffer);
+            this._eventTimes = new Float64Array(buffer);
             this.isInitialized = true;
             this.emit('initialized', result);
             return Promise.resolve(result);
@@ -61,6 +88,163 @@ class PJSIP extends EventEmitter {
         }
     }
 
+    // Add many accounts and register them at a paced rate. accounts is an
+    // array of account objects or a Buffer of NUL-terminated
+    // aor, registrar, username, password, proxy records. options: rate,
+    // burst, jitter, window, regTimeout, refreshSpread, onProgress
+    addAccounts(accounts, options = {}) {
+        if (!this.isInitialized) {
+            return Promise.reject(new Error("PJSIP not initialized. Call init() first."));
+        }
+
+        return addon.addAccounts(accounts, options).then((result) => {
+            result.accountIds.forEach((accountId) => {
+                if (accountId < 0) {
+                    return;
+                }
+                const info = addon.getAccountInfo(accountId);
+                if (!info) {
+                    return;
+                }
+                this.accounts.set(accountId, {
+                    id: accountId,
+                    aor: info.aor,
+                    registrar: info.registrar,
+                    username: info.username,
+                    proxy: info.proxy || '',
+                    isRegistered: info.is_registered
+                });
+            });
+            this.emit('accountsAdded', result);
+            return result;
+        });
+    }
+
+    // Promise-returning variants, executed on the native command thread
+    addAccountAsync(config) {
+        if (!this.isInitialized) {
+            return Promise.reject(new Error("PJSIP not initialized. Call init() first."));
+        }
+
+        return addon.addAccountAsync(config).then((accountId) => {
+            this.accounts.set(accountId, {
+                id: accountId,
+                aor: config.aor,
+                registrar: config.registrar,
+                username: config.username,
+                proxy: config.proxy || '',
+                isRegistered: false
+            });
+            this.emit('accountAdded', { accountId, config });
+            return accountId;
+        });
+    }
+
+    removeAccountAsync(accountId) {
+        return addon.removeAccountAsync(accountId).then((result) => {
+            this.accounts.delete(accountId);
+            this.emit('accountRemoved', { accountId });
+            return result;
+        });
+    }
+
+    registerAccountAsync(accountId) {
+        this.emit('registrationStarted', { accountId });
+        return addon.registerAccountAsync(accountId);
+    }
+
+    unregisterAccountAsync(accountId) {
+        this.emit('unregistrationStarted', { accountId });
+        return addon.unregisterAccountAsync(accountId);
+    }
+
+    // Resolves with the call id
+    makeCallAsync(accountId, uri, sdp) {
+        return addon.makeCallAsync(accountId, uri, sdp);
+    }
+
+    // Make a call, returns the call id or -1. The SDP offer is only accepted
+    // with init({ media: 'signalling' })
+    makeCall(accountId, uri, sdp) {
+        return addon.makeCall(accountId, uri, sdp);
+    }
+
+    // Snapshot of every active call, copied out of the native call table in one pass
+    getCalls() {
+        const buffer = addon.getCalls();
+        const ints = new Int32Array(buffer);
+        const times = new Float64Array(buffer);
+        const calls = [];
+        for (let i = 0; i < buffer.byteLength / (CALL_RECORD_INTS * 4); i++) {
+            const base = i * CALL_RECORD_INTS;
+            const timeBase = i * CALL_RECORD_DOUBLES;
+            calls.push({
+                callId: ints[base],
+                accId: ints[base + 1],
+                state: ints[base + 2],
+                statusCode: ints[base + 3],
+                mediaStatus: ints[base + 4],
+                direction: ints[base + 5],
+                stateChanges: ints[base + 6],
+                createdAt: times[timeBase + 4],
+                connectedAt: times[timeBase + 5],
+                updatedAt: times[timeBase + 7]
+            });
+        }
+        return calls;
+    }
+
+    // One call including its remote URI, or null
+    getCall(callId) {
+        return addon.getCall(callId);
+    }
+
+    getCallStats() {
+        return addon.getCallStats();
+    }
+
+    // Signalling mode: SDP sent in the next answer or offer of this call
+    setCallSdp(callId, sdp) {
+        return addon.setCallSdp(callId, sdp);
+    }
+
+    // Signalling mode: { local, remote } SDP text of a call, null where unknown
+    getCallSdp(callId) {
+        return addon.getCallSdp(callId);
+    }
+
+    // Incoming call admission policy: maxCalls, maxCallsPerAccount, cps, cpsBurst,
+    // maxCpu, maxQueueDepth, retryAfter, acceptCode (200, 180 or 183)
+    setAdmissionPolicy(policy) {
+        return addon.setAdmissionPolicy(policy);
+    }
+
+    getAdmissionStats() {
+        return addon.getAdmissionStats();
+    }
+
+    // Logging: level, pjsipLevel, target ('stdout', 'stderr', 'file', 'callback',
+    // 'none'), path, callback(entries), filter, sources (['wrapper', 'pjsip'])
+    setLogOptions(options) {
+        return addon.setLogOptions(options);
+    }
+
+    getLogStats() {
+        return addon.getLogStats();
+    }
+
+    flushLog() {
+        addon.flushLog();
+    }
+
+    answerCallAsync(callId) {
+        return addon.answerCallAsync(callId);
+    }
+
+    hangupCallAsync(callId) {
+        return addon.hangupCallAsync(callId);
+    }
+
     // Register an account
     registerAccount(accountId) {
         if (!this.accounts.has(accountId)) {
@@ -134,22 +318,305 @@ class PJSIP extends EventEmitter {
         }
     }
 
-    // Shutdown PJSIP stack
-    shutdown() {
+    // Unregister the given accounts, or every registered one, at a paced
+    // rate (rate, burst, jitter, window, onProgress). Accounts stay in place.
+    unregisterAccounts(accountIds = null, options = {}) {
+        if (!this.isInitialized) {
+            return Promise.reject(new Error("PJSIP not initialized. Call init() first."));
+        }
+        return addon.unregisterAccounts(accountIds, options);
+    }
+
+    // Every account as addAccounts() Buffer records, passwords included -
+    // treat it as a secret
+    snapshotAccounts() {
+        return addon.snapshotAccounts();
+    }
+
+    restoreAccounts(snapshot, options = {}) {
+        return this.addAccounts(snapshot, options);
+    }
+
+    // 503 to new incoming calls and no new outgoing ones, calls up continue
+    setDraining(enabled) {
+        return addon.setDraining(enabled);
+    }
+
+    // Returns how many calls were up
+    hangupAllCalls() {
+        return addon.hangupAllCalls();
+    }
+
+    // Refuse new calls, unregister in paced batches, let calls end for up to
+    // timeout ms and hang up the rest. Options: timeout, hangupGrace,
+    // unregister, pollInterval plus unregisterAccounts() pacing.
+    // Follow with shutdown({ network: false }).
+    async drain(options = {}) {
+        const timeout = options.timeout !== undefined ? options.timeout : 30000;
+        const hangupGrace = options.hangupGrace !== undefined ? options.hangupGrace : 2000;
+        const pollInterval = options.pollInterval !== undefined ? options.pollInterval : 250;
+        const activeCalls = () => addon.getCallStats().active;
+        const waitForCalls = async (until) => {
+            while (activeCalls() > 0 && Date.now() < until) {
+                await new Promise((resolve) => setTimeout(resolve, pollInterval));
+            }
+        };
+
+        addon.setDraining(true);
+        this.emit('draining');
+        const callsAtStart = activeCalls();
+        const unregistration = options.unregister === false ? Promise.resolve(null)
+                                                             : this.unregisterAccounts(null, options);
+
+        await waitForCalls(Date.now() + timeout);
+        let callsHungUp = 0;
+        if (activeCalls() > 0) {
+            callsHungUp = addon.hangupAllCalls();
+            await waitForCalls(Date.now() + hangupGrace);
+        }
+
+        return { callsAtStart, callsHungUp, unregistration: await unregistration };
+    }
+
+    // Shutdown PJSIP stack. options.network = false skips the un-REGISTER and
+    // BYE round trips, for a node that has been drained
+    shutdown(options) {
         if (!this.isInitialized) {
             return Promise.resolve("PJSIP not initialized");
         }
 
-        try {
-            const result = addon.shutdown();
+        // pjsua_destroy waits for pending transactions, so it runs on the
+        // native command thread instead of blocking the event loop
+        return addon.shutdownAsync(options).then((result) => {
             this.accounts.clear();
             this.isInitialized = false;
             this.emit('shutdown', result);
-            return Promise.resolve(result);
-        } catch (error) {
+            return result;
+        }, (error) => {
             this.emit('error', error);
-            return Promise.reject(error);
+            throw error;
+        });
+    }
+
+    // Get native event pipeline counters
+    getEventQueueStats() {
+        return addon.getEventQueueStats();
+    }
+
+    // Get native counters, gauges and latency percentiles
+    getMetrics() {
+        return addon.getMetrics();
+    }
+
+    // Same metrics in Prometheus text exposition format
+    getPrometheusMetrics() {
+        return addon.getPrometheusMetrics();
+    }
+
+    resetMetrics() {
+        addon.resetMetrics();
+    }
+
+    // Emit 'mediaStats' every interval with { count, ints, values } views
+    // over one shared buffer, valid until the listener returns
+    startMediaStats(intervalMs = 1000) {
+        const buffer = addon.startMediaStats(intervalMs, (count) => {
+            if (this._mediaStats) {
+                this._mediaStats.count = count;
+                this.emit('mediaStats', this._mediaStats);
+            }
+        });
+        this._mediaStats = { count: 0, ints: new Int32Array(buffer), values: new Float64Array(buffer) };
+    }
+
+    stopMediaStats() {
+        this._mediaStats = null;
+        return addon.stopMediaStats();
+    }
+
+    getMediaStatsCounters() {
+        return addon.getMediaStatsCounters();
+    }
+
+    // Stream PCM from the bridge into onAudio(pcm, frames). pcm is a Buffer
+    // view into the native ring, only valid until onAudio returns.
+    createMediaTap(options, onAudio) {
+        let frameBytes = 0;
+        let ring = null;
+        const tap = addon.createMediaTap(options, (firstFrame, frames) => {
+            if (ring) {
+                onAudio(Buffer.from(ring, firstFrame * frameBytes, frames * frameBytes), frames);
+            }
+        });
+        if (!tap) {
+            return null;
+        }
+        frameBytes = tap.frameBytes;
+        ring = tap.buffer;
+        const { buffer, ...info } = tap;
+        return info;
+    }
+
+    destroyMediaTap(tapId) {
+        return addon.destroyMediaTap(tapId);
+    }
+
+    // Returns the bytes accepted, whole frames only
+    injectTapAudio(tapId, pcm) {
+        return addon.injectTapAudio(tapId, pcm);
+    }
+
+    getMediaTapStats(tapId) {
+        return addon.getMediaTapStats(tapId);
+    }
+
+    // Returns the recording id, -1 on failure
+    startRecording(callId, path, options) {
+        return addon.startRecording(callId, path, options);
+    }
+
+    // Resolves with the final stats once the file is closed
+    stopRecording(recordingId) {
+        return addon.stopRecording(recordingId);
+    }
+
+    getRecordingStats(recordingId) {
+        return addon.getRecordingStats(recordingId);
+    }
+
+    bridgeCalls(callA, callB, options) {
+        return addon.bridgeCalls(callA, callB, options);
+    }
+
+    unbridgeCalls(callId) {
+        return addon.unbridgeCalls(callId);
+    }
+
+    getCallBridge(callId) {
+        return addon.getCallBridge(callId);
+    }
+
+    getBridgeStats() {
+        return addon.getBridgeStats();
+    }
+
+    // Resolve SIP URIs or host[:port] targets into the DNS cache, resolves
+    // with one { target, status, addresses, ttl, cached } per target
+    prewarmDns(targets) {
+        return addon.prewarmDns(targets);
+    }
+
+    flushDnsCache() {
+        return addon.flushDnsCache();
+    }
+
+    getDnsStats() {
+        return addon.getDnsStats();
+    }
+
+    // TCP/TLS connections with the number of accounts registered over each
+    getFlows() {
+        return addon.getFlows();
+    }
+
+    getFlowStats() {
+        return addon.getFlowStats();
+    }
+
+    // SIP capture: { format: 'pcap', path, rotateBytes, maxFiles } or
+    // { format: 'hep', collector, agentId }, plus methods/callIds/accounts/sample
+    startCapture(options) {
+        return addon.startCapture(options);
+    }
+
+    stopCapture() {
+        return addon.stopCapture();
+    }
+
+    getCaptureStats() {
+        return addon.getCaptureStats();
+    }
+
+    getCodecs() {
+        return addon.getCodecs();
+    }
+
+    // codecId may be a prefix like 'speex', or '*' for all; 0 disables
+    setCodecPriority(codecId, priority) {
+        return addon.setCodecPriority(codecId, priority);
+    }
+
+    // Offer only the given codecs, in that order
+    pinCodecs(codecIds) {
+        if (!addon.setCodecPriority('*', 0)) {
+            return false;
         }
+        return codecIds.every((codecId, i) => addon.setCodecPriority(codecId, Math.max(255 - i, 1)));
+    }
+
+    // params: ptime, vad, plc, cng, penh - applies to streams created afterwards
+    setCodecParams(codecId, params) {
+        return addon.setCodecParams(codecId, params);
+    }
+
+    getCallCodec(callId) {
+        return addon.getCallCodec(callId);
+    }
+
+    getCodecUsage() {
+        return addon.getCodecUsage();
+    }
+
+    // Re-emit a batch of native events read in place from the shared buffer
+    _dispatchEvents(count) {
+        const ints = this._eventInts;
+        for (let i = 0; i < count; i++) {
+            const base = i * EVENT_RECORD_INTS;
+            const accId = ints[base + 1];
+            switch (ints[base]) {
+                case EVENT_REG_STATE: {
+                    const account = this.accounts.get(accId);
+                    const aor = account ? account.aor : accId;
+                    const expires = ints[base + 3];
+                    const statusCode = ints[base + 4];
+                    if (account) {
+                        account.isRegistered = statusCode === 200 && expires > 0;
+                    }
+                    if (statusCode === 200) {
+                        this.emit(expires > 0 ? 'registered' : 'unregistered', aor);
+                    } else {
+                        this.emit('registerFailed', aor, statusCode);
+                    }
+                    break;
+                }
+                case EVENT_INCOMING_CALL:
+                    this.emit('incomingCall', { accountId: accId, callId: ints[base + 2] });
+                    break;
+                case EVENT_CALL_STATE:
+                    if (this.listenerCount('callState') > 0) {
+                        this.emit('callState', this._readCallEvent(i));
+                    }
+                    break;
+                case EVENT_CALL_MEDIA_STATE:
+                    if (this.listenerCount('callMediaState') > 0) {
+                        this.emit('callMediaState', this._readCallEvent(i));
+                    }
+                    break;
+            }
+        }
+    }
+
+    _readCallEvent(index) {
+        const base = index * EVENT_RECORD_INTS;
+        const ints = this._eventInts;
+        return {
+            callId: ints[base + 2],
+            accountId: ints[base + 1],
+            state: ints[base + 3],
+            statusCode: ints[base + 4],
+            mediaStatus: ints[base + 5],
+            timestamp: this._eventTimes[index * 4 + 3]
+        };
     }
 
     // Get all accounts
@@ -172,18 +639,76 @@ module.exports = {
     PJSIP,
     default: pjsip,
     // Legacy exports for backward compatibility
-    Init: () => pjsip.init(),
+    Init: (options) => pjsip.init(options),
     RegisterAccount: (config) => {
         const accountId = pjsip.addAccount(config);
         return pjsip.registerAccount(accountId);
     },
-    Shutdown: () => pjsip.shutdown(),
+    Shutdown: (options) => pjsip.shutdown(options),
     // New PJSIP-like API
     addAccount: (config) => pjsip.addAccount(config),
+    addAccounts: (accounts, options) => pjsip.addAccounts(accounts, options),
+    unregisterAccounts: (accountIds, options) => pjsip.unregisterAccounts(accountIds, options),
+    snapshotAccounts: () => pjsip.snapshotAccounts(),
+    restoreAccounts: (snapshot, options) => pjsip.restoreAccounts(snapshot, options),
+    setDraining: (enabled) => pjsip.setDraining(enabled),
+    hangupAllCalls: () => pjsip.hangupAllCalls(),
+    drain: (options) => pjsip.drain(options),
+    addAccountAsync: (config) => pjsip.addAccountAsync(config),
+    removeAccountAsync: (accountId) => pjsip.removeAccountAsync(accountId),
+    registerAccountAsync: (accountId) => pjsip.registerAccountAsync(accountId),
+    unregisterAccountAsync: (accountId) => pjsip.unregisterAccountAsync(accountId),
+    makeCallAsync: (accountId, uri, sdp) => pjsip.makeCallAsync(accountId, uri, sdp),
+    makeCall: (accountId, uri, sdp) => pjsip.makeCall(accountId, uri, sdp),
+    getCalls: () => pjsip.getCalls(),
+    getCall: (callId) => pjsip.getCall(callId),
+    getCallStats: () => pjsip.getCallStats(),
+    setCallSdp: (callId, sdp) => pjsip.setCallSdp(callId, sdp),
+    getCallSdp: (callId) => pjsip.getCallSdp(callId),
+    setAdmissionPolicy: (policy) => pjsip.setAdmissionPolicy(policy),
+    getAdmissionStats: () => pjsip.getAdmissionStats(),
+    setLogOptions: (options) => pjsip.setLogOptions(options),
+    getLogStats: () => pjsip.getLogStats(),
+    flushLog: () => pjsip.flushLog(),
+    answerCallAsync: (callId) => pjsip.answerCallAsync(callId),
+    hangupCallAsync: (callId) => pjsip.hangupCallAsync(callId),
     registerAccount: (accountId) => pjsip.registerAccount(accountId),
     unregisterAccount: (accountId) => pjsip.unregisterAccount(accountId),
     getAccountInfo: (accountId) => pjsip.getAccountInfo(accountId),
     removeAccount: (accountId) => pjsip.removeAccount(accountId),
     getAccounts: () => pjsip.getAccounts(),
+    getAccountPoolStats: () => addon.getAccountPoolStats(),
+    getEventQueueStats: () => pjsip.getEventQueueStats(),
+    getMetrics: () => pjsip.getMetrics(),
+    getPrometheusMetrics: () => pjsip.getPrometheusMetrics(),
+    resetMetrics: () => pjsip.resetMetrics(),
+    startMediaStats: (intervalMs) => pjsip.startMediaStats(intervalMs),
+    stopMediaStats: () => pjsip.stopMediaStats(),
+    getMediaStatsCounters: () => pjsip.getMediaStatsCounters(),
+    createMediaTap: (options, onAudio) => pjsip.createMediaTap(options, onAudio),
+    destroyMediaTap: (tapId) => pjsip.destroyMediaTap(tapId),
+    injectTapAudio: (tapId, pcm) => pjsip.injectTapAudio(tapId, pcm),
+    getMediaTapStats: (tapId) => pjsip.getMediaTapStats(tapId),
+    startRecording: (callId, path, options) => pjsip.startRecording(callId, path, options),
+    stopRecording: (recordingId) => pjsip.stopRecording(recordingId),
+    getRecordingStats: (recordingId) => pjsip.getRecordingStats(recordingId),
+    bridgeCalls: (callA, callB, options) => pjsip.bridgeCalls(callA, callB, options),
+    unbridgeCalls: (callId) => pjsip.unbridgeCalls(callId),
+    getCallBridge: (callId) => pjsip.getCallBridge(callId),
+    getBridgeStats: () => pjsip.getBridgeStats(),
+    prewarmDns: (targets) => pjsip.prewarmDns(targets),
+    flushDnsCache: () => pjsip.flushDnsCache(),
+    getDnsStats: () => pjsip.getDnsStats(),
+    getFlows: () => pjsip.getFlows(),
+    getFlowStats: () => pjsip.getFlowStats(),
+    startCapture: (options) => pjsip.startCapture(options),
+    stopCapture: () => pjsip.stopCapture(),
+    getCaptureStats: () => pjsip.getCaptureStats(),
+    getCodecs: () => pjsip.getCodecs(),
+    setCodecPriority: (codecId, priority) => pjsip.setCodecPriority(codecId, priority),
+    pinCodecs: (codecIds) => pjsip.pinCodecs(codecIds),
+    setCodecParams: (codecId, params) => pjsip.setCodecParams(codecId, params),
+    getCallCodec: (callId) => pjsip.getCallCodec(callId),
+    getCodecUsage: () => pjsip.getCodecUsage(),
     isAccountRegistered: (accountId) => pjsip.isAccountRegistered(accountId)
 };
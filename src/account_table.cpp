@@ -0,0 +1,208 @@
+#include "account_table.h"
+
+#include <cstring>
+#include <new>
+
+// PJSIPAccountPool implementation
+PJSIPAccountPool& PJSIPAccountPool::instance() {
+    static PJSIPAccountPool pool;
+    return pool;
+}
+
+PJSIPAccountPool::PJSIPAccountPool() : allocations(0), reuses(0) {
+    for (size_t i = 0; i < CLASSES; i++) {
+        free_lists[i] = nullptr;
+        free_counts[i] = 0;
+        in_use[i] = 0;
+    }
+}
+
+size_t PJSIPAccountPool::sizeClass(size_t size) {
+    size_t index = 0;
+    for (size_t block = MIN_BLOCK; block < size; block <<= 1) {
+        index++;
+    }
+    return index;
+}
+
+void* PJSIPAccountPool::allocate(size_t size) {
+    if (size > MAX_BLOCK) {
+        return ::operator new(size);
+    }
+
+    size_t index = sizeClass(size);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        in_use[index]++;
+        FreeBlock* block = free_lists[index];
+        if (block) {
+            free_lists[index] = block->next;
+            free_counts[index]--;
+            reuses++;
+            return block;
+        }
+        allocations++;
+    }
+    return ::operator new(MIN_BLOCK << index);
+}
+
+void PJSIPAccountPool::deallocate(void* block, size_t size) {
+    if (size > MAX_BLOCK) {
+        ::operator delete(block);
+        return;
+    }
+
+    size_t index = sizeClass(size);
+    std::lock_guard<std::mutex> lock(mutex);
+    FreeBlock* free_block = static_cast<FreeBlock*>(block);
+    free_block->next = free_lists[index];
+    free_lists[index] = free_block;
+    free_counts[index]++;
+    in_use[index]--;
+}
+
+PJSIPAccountPoolStats PJSIPAccountPool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    PJSIPAccountPoolStats result = PJSIPAccountPoolStats();
+    for (size_t i = 0; i < CLASSES; i++) {
+        result.in_use += in_use[i];
+        result.free += free_counts[i];
+        result.bytes_reserved += (uint64_t)(in_use[i] + free_counts[i]) * (MIN_BLOCK << i);
+    }
+    result.allocations = allocations;
+    result.reuses = reuses;
+    return result;
+}
+
+// PJSIPAccount implementation
+PJSIPAccount::PJSIPAccount() : acc_id(PJSUA_INVALID_ID), block_size(0) {
+    aor.ptr = registrar.ptr = username.ptr = proxy.ptr = nullptr;
+    aor.slen = registrar.slen = username.slen = proxy.slen = 0;
+}
+
+static pj_str_t internString(char*& cursor, const std::string& value) {
+    pj_str_t result;
+    result.ptr = cursor;
+    result.slen = (pj_ssize_t)value.size();
+    memcpy(cursor, value.c_str(), value.size() + 1);
+    cursor += value.size() + 1;
+    return result;
+}
+
+std::shared_ptr<PJSIPAccount> PJSIPAccount::create(const PJSIPAccountConfig& config) {
+    size_t strings = config.aor.size() + config.registrar.size() + config.username.size() +
+                     config.proxy.size() + 4;
+    size_t size = sizeof(PJSIPAccount) + strings;
+
+    PJSIPAccount* account = new (PJSIPAccountPool::instance().allocate(size)) PJSIPAccount();
+    account->block_size = size;
+
+    char* cursor = reinterpret_cast<char*>(account + 1);
+    account->aor = internString(cursor, config.aor);
+    account->registrar = internString(cursor, config.registrar);
+    account->username = internString(cursor, config.username);
+    account->proxy = internString(cursor, config.proxy);
+
+    return std::shared_ptr<PJSIPAccount>(account, Deleter(), PJSIPAccountPoolAllocator<PJSIPAccount>());
+}
+
+void PJSIPAccount::Deleter::operator()(PJSIPAccount* account) const {
+    size_t size = account->block_size;
+    account->~PJSIPAccount();
+    PJSIPAccountPool::instance().deallocate(account, size);
+}
+
+// PJSIPAccountTable implementation
+PJSIPAccountTable::PJSIPAccountTable() : slots(new Slot[PJSUA_MAX_ACC]), active_count(0) {
+}
+
+bool PJSIPAccountTable::insert(std::shared_ptr<const PJSIPAccount> account) {
+    if (!account || !isValidId(account->acc_id)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(writer_mutex);
+    Slot& slot = slots[account->acc_id];
+
+    bool was_empty = !std::atomic_load(&slot.account);
+    slot.reg_state.store(PJSIPRegState());
+    std::atomic_store(&slot.account, std::move(account));
+    slot.generation.fetch_add(1, std::memory_order_release);
+
+    if (was_empty) {
+        active_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+std::shared_ptr<const PJSIPAccount> PJSIPAccountTable::remove(pjsua_acc_id acc_id) {
+    if (!isValidId(acc_id)) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(writer_mutex);
+    Slot& slot = slots[acc_id];
+
+    std::shared_ptr<const PJSIPAccount> previous =
+        std::atomic_exchange(&slot.account, std::shared_ptr<const PJSIPAccount>());
+    if (previous) {
+        slot.generation.fetch_add(1, std::memory_order_release);
+        active_count.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return previous;
+}
+
+void PJSIPAccountTable::clear() {
+    for (pjsua_acc_id acc_id = 0; acc_id < (pjsua_acc_id)PJSUA_MAX_ACC; acc_id++) {
+        remove(acc_id);
+    }
+}
+
+std::shared_ptr<const PJSIPAccount> PJSIPAccountTable::get(pjsua_acc_id acc_id) const {
+    if (!isValidId(acc_id)) {
+        return nullptr;
+    }
+    return std::atomic_load(&slots[acc_id].account);
+}
+
+bool PJSIPAccountTable::getRegState(pjsua_acc_id acc_id, PJSIPRegState& state) const {
+    if (!isValidId(acc_id)) {
+        return false;
+    }
+    state = slots[acc_id].reg_state.load();
+    return true;
+}
+
+uint32_t PJSIPAccountTable::generation(pjsua_acc_id acc_id) const {
+    if (!isValidId(acc_id)) {
+        return 0;
+    }
+    return slots[acc_id].generation.load(std::memory_order_acquire);
+}
+
+std::vector<std::shared_ptr<const PJSIPAccount>> PJSIPAccountTable::snapshot() const {
+    std::vector<std::shared_ptr<const PJSIPAccount>> result;
+    result.reserve(count());
+
+    for (pjsua_acc_id acc_id = 0; acc_id < (pjsua_acc_id)PJSUA_MAX_ACC; acc_id++) {
+        std::shared_ptr<const PJSIPAccount> account = std::atomic_load(&slots[acc_id].account);
+        if (account) {
+            result.push_back(std::move(account));
+        }
+    }
+    return result;
+}
+
+void PJSIPAccountTable::updateRegState(pjsua_acc_id acc_id, int status_code, int expires) {
+    if (!isValidId(acc_id)) {
+        return;
+    }
+
+    // Callbacks for one account can overlap on different PJSIP threads
+    slots[acc_id].reg_state.update([status_code, expires](PJSIPRegState& state) {
+        state.is_registered = (status_code == PJSIP_SC_OK && expires > 0) ? 1 : 0;
+        state.status_code = status_code;
+        state.expires = expires;
+        state.reg_count++;
+    });
+}
@@ -0,0 +1,178 @@
+#ifndef NODE_PJSIP_ACCOUNT_TABLE_H
+#define NODE_PJSIP_ACCOUNT_TABLE_H
+
+#include <pjsua-lib/pjsua.h>
+
+#include "seqlock.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Everything needed to create one account
+struct PJSIPAccountConfig {
+    std::string aor;
+    std::string registrar;
+    std::string username;
+    std::string password;
+    std::string proxy;
+    unsigned reg_timeout;       // seconds, 0 = pjsua default
+    bool register_on_add;
+    unsigned env_id;            // owning env, see PJSIPEnvContext
+
+    // Flow settings, negative = the init "flows" option (see PJSIPFlowTable)
+    int outbound;               // RFC 5626 outbound
+    std::string instance_id;    // +sip.instance, "<urn:uuid:...>", empty = pjsua makes one up
+    int keep_alive;             // seconds between UDP keepalives, 0 = off
+
+    PJSIPAccountConfig() : reg_timeout(0), register_on_add(true), env_id(0), outbound(-1), keep_alive(-1) {}
+};
+
+struct PJSIPAccountPoolStats {
+    uint64_t in_use;            // blocks handed out
+    uint64_t free;              // blocks parked on the free lists
+    uint64_t bytes_reserved;    // in use + free
+    uint64_t allocations;       // blocks taken from the heap, never reused
+    uint64_t reuses;            // blocks served from a free list
+};
+
+// Size-classed free lists behind account records. Removing an account parks
+// its blocks for the next add instead of returning them to the heap, so
+// account churn settles at the peak account count instead of fragmenting
+// the allocator. Blocks above MAX_BLOCK go straight to the heap.
+class PJSIPAccountPool {
+public:
+    static const size_t MIN_BLOCK = 64;
+    static const size_t MAX_BLOCK = 4096;
+    static const size_t CLASSES = 7;            // 64 .. 4096
+
+    static PJSIPAccountPool& instance();
+
+    void* allocate(size_t size);
+    void deallocate(void* block, size_t size);
+    PJSIPAccountPoolStats stats() const;
+
+private:
+    PJSIPAccountPool();
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    static size_t sizeClass(size_t size);
+
+    mutable std::mutex mutex;
+    FreeBlock* free_lists[CLASSES];
+    size_t free_counts[CLASSES];
+    size_t in_use[CLASSES];
+    uint64_t allocations;
+    uint64_t reuses;
+};
+
+// std::allocator adaptor so shared_ptr control blocks come from the pool too
+template <typename T>
+struct PJSIPAccountPoolAllocator {
+    typedef T value_type;
+
+    PJSIPAccountPoolAllocator() {}
+    template <typename U>
+    PJSIPAccountPoolAllocator(const PJSIPAccountPoolAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(PJSIPAccountPool::instance().allocate(n * sizeof(T)));
+    }
+    void deallocate(T* p, size_t n) {
+        PJSIPAccountPool::instance().deallocate(p, n * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const PJSIPAccountPoolAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const PJSIPAccountPoolAllocator<U>&) const { return false; }
+};
+
+// PJSIP Account record - immutable once published in the account table.
+//
+// One pool block holds the record followed by its strings, each interned
+// once and NUL-terminated so it can be handed to pjsua as is. The password
+// is not kept: pjsua copies the credentials into the account's own pool.
+class PJSIPAccount {
+public:
+    pjsua_acc_id acc_id;
+    pj_str_t aor;
+    pj_str_t registrar;
+    pj_str_t username;
+    pj_str_t proxy;             // slen 0 when there is none
+
+    static std::shared_ptr<PJSIPAccount> create(const PJSIPAccountConfig& config);
+
+    PJSIPAccount(const PJSIPAccount&) = delete;
+    PJSIPAccount& operator=(const PJSIPAccount&) = delete;
+
+private:
+    PJSIPAccount();
+
+    struct Deleter {
+        void operator()(PJSIPAccount* account) const;
+    };
+
+    size_t block_size;
+};
+
+// Registration state, updated in place from pjsip_on_reg_state
+struct PJSIPRegState {
+    int32_t is_registered;
+    int32_t status_code;    // last REGISTER final status
+    int32_t expires;        // seconds, <= 0 when unregistered
+    int32_t reg_count;      // completed REGISTER transactions
+};
+
+// Dense account table indexed directly by pjsua_acc_id.
+//
+// Account records are published RCU-style: a slot holds a shared_ptr that is
+// swapped atomically, so readers get a reference that stays valid after the
+// account is removed. Registration state lives in the slot behind a seqlock,
+// so reg-state callbacks on PJSIP threads never wait on JS lookups and vice
+// versa. Only insert/remove take the writer mutex.
+class PJSIPAccountTable {
+public:
+    PJSIPAccountTable();
+
+    PJSIPAccountTable(const PJSIPAccountTable&) = delete;
+    PJSIPAccountTable& operator=(const PJSIPAccountTable&) = delete;
+
+    bool insert(std::shared_ptr<const PJSIPAccount> account);
+    std::shared_ptr<const PJSIPAccount> remove(pjsua_acc_id acc_id);
+    void clear();
+
+    // Lock-free readers
+    std::shared_ptr<const PJSIPAccount> get(pjsua_acc_id acc_id) const;
+    bool getRegState(pjsua_acc_id acc_id, PJSIPRegState& state) const;
+    uint32_t generation(pjsua_acc_id acc_id) const;
+    std::vector<std::shared_ptr<const PJSIPAccount>> snapshot() const;
+    size_t count() const { return active_count.load(std::memory_order_relaxed); }
+
+    // Called from PJSIP threads
+    void updateRegState(pjsua_acc_id acc_id, int status_code, int expires);
+
+    static bool isValidId(pjsua_acc_id acc_id) {
+        return acc_id >= 0 && acc_id < (pjsua_acc_id)PJSUA_MAX_ACC;
+    }
+
+private:
+    struct Slot {
+        std::shared_ptr<const PJSIPAccount> account;   // atomic_load/atomic_store only
+        std::atomic<uint32_t> generation;              // bumped on insert and remove
+        PJSIPSeqLock<PJSIPRegState> reg_state;
+
+        Slot() : generation(0) {}
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    std::mutex writer_mutex;
+    std::atomic<size_t> active_count;
+};
+
+#endif
@@ -0,0 +1,233 @@
+#include "admission.h"
+#include "event_queue.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// CPU is resampled at most this often, from whichever thread admits a call
+static const int64_t CPU_SAMPLE_INTERVAL_US = 250000;
+
+// Process user + system CPU time in microseconds
+static int64_t processCpuMicros() {
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) {
+        return 0;
+    }
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (int64_t)((k.QuadPart + u.QuadPart) / 10);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return (int64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 +
+           usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#endif
+}
+
+// PJSIPAdmissionConfig implementation
+PJSIPAdmissionConfig::PJSIPAdmissionConfig() : max_calls(0), max_calls_per_account(0), cps(0), cps_burst(0),
+    max_cpu(0), max_queue_depth(0), retry_after(5), accept_code(PJSIP_SC_OK) {
+}
+
+// PJSIPAdmissionController implementation
+PJSIPAdmissionController::PJSIPAdmissionController(size_t (*queue_depth)(pjsua_acc_id acc_id))
+    : queue_depth(queue_depth), call_marks(new std::atomic<int32_t>[PJSUA_MAX_CALLS]),
+      account_calls(new std::atomic<int32_t>[PJSUA_MAX_ACC]), active_calls(0), draining(false), tokens(0),
+      last_refill_us(0),
+      cpu_sampled_us(0), cpu_last_usage_us(0), cpu_percent(0), offered(0), accepted(0), rejected_overload(0),
+      rejected_global(0), rejected_rate(0), rejected_account(0), rejected_draining(0) {
+    policy.store(PJSIPAdmissionConfig());
+    reset();
+}
+
+void PJSIPAdmissionController::configure(const PJSIPAdmissionConfig& config) {
+    policy.store(config);
+
+    std::lock_guard<std::mutex> lock(bucket_mutex);
+    tokens = config.cps_burst > 0 ? config.cps_burst : config.cps;
+    last_refill_us = (int64_t)pjsipMonotonicMicros();
+}
+
+void PJSIPAdmissionController::reset() {
+    for (unsigned i = 0; i < PJSUA_MAX_CALLS; i++) {
+        call_marks[i].store(NONE, std::memory_order_relaxed);
+    }
+    for (unsigned i = 0; i < PJSUA_MAX_ACC; i++) {
+        account_calls[i].store(0, std::memory_order_relaxed);
+    }
+    active_calls.store(0, std::memory_order_relaxed);
+}
+
+PJSIPAdmissionResult PJSIPAdmissionController::admit(pjsua_acc_id acc_id, pjsua_call_id call_id,
+                                                     unsigned& accept_code) {
+    PJSIPAdmissionConfig config = policy.load();
+    accept_code = config.accept_code > 0 ? (unsigned)config.accept_code : (unsigned)PJSIP_SC_OK;
+    offered.fetch_add(1, std::memory_order_relaxed);
+
+    // Cheapest checks first, the token is only spent on a call we would take
+    PJSIPAdmissionResult result = PJSIPAdmissionResult::Accepted;
+    if (draining.load(std::memory_order_acquire)) {
+        result = PJSIPAdmissionResult::RejectedDraining;
+    } else if ((config.max_queue_depth > 0 && queue_depth && queue_depth(acc_id) >= (size_t)config.max_queue_depth) ||
+        (config.max_cpu > 0 && sampleCpu() >= config.max_cpu)) {
+        result = PJSIPAdmissionResult::RejectedOverload;
+    } else if (config.max_calls > 0 && active_calls.load(std::memory_order_relaxed) >= config.max_calls) {
+        result = PJSIPAdmissionResult::RejectedGlobalLimit;
+    } else if (config.max_calls_per_account > 0 && acc_id >= 0 && acc_id < (pjsua_acc_id)PJSUA_MAX_ACC &&
+               account_calls[acc_id].load(std::memory_order_relaxed) >= config.max_calls_per_account) {
+        result = PJSIPAdmissionResult::RejectedAccountLimit;
+    } else if (config.cps > 0 && !takeToken(config)) {
+        result = PJSIPAdmissionResult::RejectedRate;
+    }
+
+    switch (result) {
+    case PJSIPAdmissionResult::Accepted:
+        accepted.fetch_add(1, std::memory_order_relaxed);
+        track(acc_id, call_id);
+        break;
+    case PJSIPAdmissionResult::RejectedOverload:
+        rejected_overload.fetch_add(1, std::memory_order_relaxed);
+        reject(call_id, PJSIP_SC_SERVICE_UNAVAILABLE, config.retry_after);
+        break;
+    case PJSIPAdmissionResult::RejectedGlobalLimit:
+        rejected_global.fetch_add(1, std::memory_order_relaxed);
+        reject(call_id, PJSIP_SC_SERVICE_UNAVAILABLE, config.retry_after);
+        break;
+    case PJSIPAdmissionResult::RejectedRate:
+        rejected_rate.fetch_add(1, std::memory_order_relaxed);
+        reject(call_id, PJSIP_SC_SERVICE_UNAVAILABLE, config.retry_after);
+        break;
+    case PJSIPAdmissionResult::RejectedAccountLimit:
+        rejected_account.fetch_add(1, std::memory_order_relaxed);
+        reject(call_id, PJSIP_SC_BUSY_HERE, 0);
+        break;
+    case PJSIPAdmissionResult::RejectedDraining:
+        rejected_draining.fetch_add(1, std::memory_order_relaxed);
+        reject(call_id, PJSIP_SC_SERVICE_UNAVAILABLE, config.retry_after);
+        break;
+    }
+    return result;
+}
+
+void PJSIPAdmissionController::onOutgoingCall(pjsua_acc_id acc_id, pjsua_call_id call_id) {
+    track(acc_id, call_id);
+}
+
+void PJSIPAdmissionController::onCallEnded(pjsua_call_id call_id) {
+    if (call_id < 0 || call_id >= (pjsua_call_id)PJSUA_MAX_CALLS) {
+        return;
+    }
+
+    int32_t mark = call_marks[call_id].exchange(NONE);
+    if (mark > 0) {
+        active_calls.fetch_sub(1, std::memory_order_relaxed);
+        account_calls[mark - 1].fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+bool PJSIPAdmissionController::isRejected(pjsua_call_id call_id) const {
+    if (call_id < 0 || call_id >= (pjsua_call_id)PJSUA_MAX_CALLS) {
+        return false;
+    }
+    return call_marks[call_id].load(std::memory_order_relaxed) == REJECTED;
+}
+
+PJSIPAdmissionStats PJSIPAdmissionController::stats() {
+    PJSIPAdmissionStats result;
+    result.offered = offered.load(std::memory_order_relaxed);
+    result.accepted = accepted.load(std::memory_order_relaxed);
+    result.rejected_overload = rejected_overload.load(std::memory_order_relaxed);
+    result.rejected_global = rejected_global.load(std::memory_order_relaxed);
+    result.rejected_rate = rejected_rate.load(std::memory_order_relaxed);
+    result.rejected_account = rejected_account.load(std::memory_order_relaxed);
+    result.rejected_draining = rejected_draining.load(std::memory_order_relaxed);
+    result.active = active_calls.load(std::memory_order_relaxed);
+    result.cpu = sampleCpu();
+    return result;
+}
+
+bool PJSIPAdmissionController::takeToken(const PJSIPAdmissionConfig& config) {
+    double burst = config.cps_burst > 0 ? config.cps_burst : std::max(1.0, config.cps);
+    int64_t now = (int64_t)pjsipMonotonicMicros();
+
+    std::lock_guard<std::mutex> lock(bucket_mutex);
+    tokens = std::min(burst, tokens + (now - last_refill_us) * config.cps / 1e6);
+    last_refill_us = now;
+    if (tokens < 1.0) {
+        return false;
+    }
+    tokens -= 1.0;
+    return true;
+}
+
+int32_t PJSIPAdmissionController::sampleCpu() {
+    int64_t now = (int64_t)pjsipMonotonicMicros();
+    int64_t sampled = cpu_sampled_us.load(std::memory_order_relaxed);
+    if (now - sampled < CPU_SAMPLE_INTERVAL_US ||
+        !cpu_sampled_us.compare_exchange_strong(sampled, now, std::memory_order_relaxed)) {
+        return cpu_percent.load(std::memory_order_relaxed);
+    }
+
+    int64_t usage = processCpuMicros();
+    int64_t previous = cpu_last_usage_us.exchange(usage, std::memory_order_relaxed);
+    if (sampled > 0 && previous > 0) {
+        unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        double percent = 100.0 * (usage - previous) / ((double)(now - sampled) * cores);
+        cpu_percent.store((int32_t)std::min(100.0, std::max(0.0, percent)), std::memory_order_relaxed);
+    }
+    return cpu_percent.load(std::memory_order_relaxed);
+}
+
+void PJSIPAdmissionController::track(pjsua_acc_id acc_id, pjsua_call_id call_id) {
+    if (call_id < 0 || call_id >= (pjsua_call_id)PJSUA_MAX_CALLS ||
+        acc_id < 0 || acc_id >= (pjsua_acc_id)PJSUA_MAX_ACC) {
+        return;
+    }
+
+    int32_t previous = call_marks[call_id].exchange(acc_id + 1);
+    if (previous > 0) {
+        return; // already counted
+    }
+    active_calls.fetch_add(1, std::memory_order_relaxed);
+    account_calls[acc_id].fetch_add(1, std::memory_order_relaxed);
+}
+
+void PJSIPAdmissionController::reject(pjsua_call_id call_id, unsigned code, int32_t retry_after) {
+    if (call_id >= 0 && call_id < (pjsua_call_id)PJSUA_MAX_CALLS) {
+        call_marks[call_id].store(REJECTED, std::memory_order_relaxed);
+    }
+
+    if (retry_after <= 0) {
+        pjsua_call_answer(call_id, code, NULL, NULL);
+        return;
+    }
+
+    // The header only has to live until the response is built
+    char value_buf[16];
+    int len = snprintf(value_buf, sizeof(value_buf), "%d", retry_after);
+    pj_str_t name = pj_str((char*)"Retry-After");
+    pj_str_t value;
+    value.ptr = value_buf;
+    value.slen = len;
+
+    pjsua_msg_data msg_data;
+    pjsua_msg_data_init(&msg_data);
+    pjsip_generic_string_hdr retry_hdr;
+    pjsip_generic_string_hdr_init2(&retry_hdr, &name, &value);
+    pj_list_push_back(&msg_data.hdr_list, &retry_hdr);
+
+    pjsua_call_answer(call_id, code, NULL, &msg_data);
+}
@@ -0,0 +1,118 @@
+#ifndef NODE_PJSIP_ADMISSION_H
+#define NODE_PJSIP_ADMISSION_H
+
+#include <pjsua-lib/pjsua.h>
+
+#include "seqlock.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+// Admission policy, zero disables a limit
+struct PJSIPAdmissionConfig {
+    int32_t max_calls;              // concurrent calls, all accounts
+    int32_t max_calls_per_account;  // concurrent calls per account, over it -> 486
+    double cps;                     // new incoming calls per second
+    int32_t cps_burst;              // token bucket size, defaults to cps
+    int32_t max_cpu;                // process CPU % of all cores
+    int32_t max_queue_depth;        // undelivered JS events
+    int32_t retry_after;            // seconds, Retry-After on 503
+    int32_t accept_code;            // 200 answers inline, 180/183 leave it to JS
+
+    PJSIPAdmissionConfig();
+};
+
+enum class PJSIPAdmissionResult {
+    Accepted,
+    RejectedOverload,       // CPU or event queue watermark - 503
+    RejectedGlobalLimit,    // max_calls - 503
+    RejectedRate,           // cps - 503
+    RejectedAccountLimit,   // max_calls_per_account - 486
+    RejectedDraining        // setDraining() - 503, new calls go to another node
+};
+
+struct PJSIPAdmissionStats {
+    uint64_t offered;
+    uint64_t accepted;
+    uint64_t rejected_overload;
+    uint64_t rejected_global;
+    uint64_t rejected_rate;
+    uint64_t rejected_account;
+    uint64_t rejected_draining;
+    int32_t active;
+    int32_t cpu;                    // last sampled process CPU %
+};
+
+// Incoming call admission, decided inline in on_incoming_call so overload
+// is shed before a single byte reaches JS.
+//
+// Concurrent calls are tracked per call id (incoming admitted calls and
+// outgoing calls once CALLING) and released on DISCONNECTED, all from
+// pjsua callbacks. Rejected calls
+// are remembered too, so their later state callbacks can be dropped.
+class PJSIPAdmissionController {
+public:
+    // queue_depth: undelivered events of the env that would be told about the call
+    explicit PJSIPAdmissionController(size_t (*queue_depth)(pjsua_acc_id acc_id));
+
+    PJSIPAdmissionController(const PJSIPAdmissionController&) = delete;
+    PJSIPAdmissionController& operator=(const PJSIPAdmissionController&) = delete;
+
+    void configure(const PJSIPAdmissionConfig& config);
+    PJSIPAdmissionConfig config() const { return policy.load(); }
+
+    // PJSIP threads - rejections are answered here, accepted calls are left
+    // to the caller to answer with accept_code once JS has been told
+    PJSIPAdmissionResult admit(pjsua_acc_id acc_id, pjsua_call_id call_id, unsigned& accept_code);
+
+    // on_call_state
+    void onOutgoingCall(pjsua_acc_id acc_id, pjsua_call_id call_id);
+    void onCallEnded(pjsua_call_id call_id);
+
+    // Any thread
+    bool isRejected(pjsua_call_id call_id) const;
+    void reset();
+
+    // Draining turns every new incoming call away, outgoing calls are refused by the wrapper
+    void setDraining(bool enabled) { draining.store(enabled, std::memory_order_release); }
+    bool isDraining() const { return draining.load(std::memory_order_acquire); }
+    int32_t activeCalls() const { return active_calls.load(std::memory_order_relaxed); }
+
+    PJSIPAdmissionStats stats();
+
+private:
+    enum CallMark : int32_t { NONE = 0, REJECTED = -1 };  // otherwise acc_id + 1
+
+    bool takeToken(const PJSIPAdmissionConfig& config);
+    int32_t sampleCpu();
+    void track(pjsua_acc_id acc_id, pjsua_call_id call_id);
+    void reject(pjsua_call_id call_id, unsigned code, int32_t retry_after);
+
+    size_t (*queue_depth)(pjsua_acc_id acc_id);
+    PJSIPSeqLock<PJSIPAdmissionConfig> policy;
+
+    std::unique_ptr<std::atomic<int32_t>[]> call_marks;       // per call id
+    std::unique_ptr<std::atomic<int32_t>[]> account_calls;    // per acc id
+    std::atomic<int32_t> active_calls;
+    std::atomic<bool> draining;
+
+    std::mutex bucket_mutex;
+    double tokens;
+    int64_t last_refill_us;
+
+    std::atomic<int64_t> cpu_sampled_us;
+    std::atomic<int64_t> cpu_last_usage_us;
+    std::atomic<int32_t> cpu_percent;
+
+    std::atomic<uint64_t> offered;
+    std::atomic<uint64_t> accepted;
+    std::atomic<uint64_t> rejected_overload;
+    std::atomic<uint64_t> rejected_global;
+    std::atomic<uint64_t> rejected_rate;
+    std::atomic<uint64_t> rejected_account;
+    std::atomic<uint64_t> rejected_draining;
+};
+
+#endif
@@ -0,0 +1,559 @@
+#include "call_bridge.h"
+#include "call_table.h"
+#include "log_sink.h"
+
+#include <pjsua-lib/pjsua_internal.h>
+
+#include <vector>
+
+static const size_t RTP_HEADER_SIZE = 12;
+
+pjmedia_transport_op PJSIPRtpRelay::ops = {
+    &PJSIPRtpRelay::getInfo,
+    &PJSIPRtpRelay::attach,
+    &PJSIPRtpRelay::detach,
+    &PJSIPRtpRelay::sendRtp,
+    &PJSIPRtpRelay::sendRtcp,
+    &PJSIPRtpRelay::sendRtcp2,
+    &PJSIPRtpRelay::mediaCreate,
+    &PJSIPRtpRelay::encodeSdp,
+    &PJSIPRtpRelay::mediaStart,
+    &PJSIPRtpRelay::mediaStop,
+    &PJSIPRtpRelay::simulateLost,
+    &PJSIPRtpRelay::destroy,
+    &PJSIPRtpRelay::attach2
+};
+
+// PJSIPRtpRelay implementation
+PJSIPRtpRelay::PJSIPRtpRelay(PJSIPCallBridge* bridge, pjsua_call_id call_id, pjmedia_transport* member,
+                             bool close_member)
+    : bridge(bridge), call_id(call_id), member(member), close_member(close_member), stream_user_data(nullptr),
+      stream_rtp_cb(nullptr), stream_rtp_cb2(nullptr), stream_rtcp_cb(nullptr), peer(nullptr),
+      payloads{ -1, -1, -1, -1 }, relayed_rtp(0), relayed_rtcp(0) {
+    pj_bzero(&tp.base, sizeof(tp.base));
+    pj_ansi_snprintf(tp.base.name, sizeof(tp.base.name), "relay%d", call_id);
+    tp.base.type = PJMEDIA_TRANSPORT_TYPE_USER;
+    tp.base.op = &ops;
+    tp.owner = this;
+}
+
+PJSIPRtpRelay* PJSIPRtpRelay::create(PJSIPCallBridge* bridge, pjsua_call_id call_id, pjmedia_transport* member,
+                                     bool close_member) {
+    return new PJSIPRtpRelay(bridge, call_id, member, close_member);
+}
+
+void PJSIPRtpRelay::forwardTo(PJSIPRtpRelay* target, const PJSIPPayloadMap& map) {
+    std::lock_guard<std::mutex> lock(forward_mutex);
+    payloads = map;
+    peer.store(target, std::memory_order_release);
+}
+
+void PJSIPRtpRelay::stopForwarding() {
+    std::lock_guard<std::mutex> lock(forward_mutex);
+    peer.store(nullptr, std::memory_order_release);
+}
+
+bool PJSIPRtpRelay::forwardRtp(void* pkt, pj_ssize_t size) {
+    if (peer.load(std::memory_order_acquire) == nullptr || size < (pj_ssize_t)RTP_HEADER_SIZE) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(forward_mutex);
+    PJSIPRtpRelay* target = peer.load(std::memory_order_relaxed);
+    if (target == nullptr) {
+        return false;
+    }
+
+    // Same codec, but each leg may have negotiated its own dynamic numbers.
+    // Anything else (comfort noise, static types) goes through unchanged.
+    uint8_t* header = static_cast<uint8_t*>(pkt);
+    int pt = header[1] & 0x7f;
+    if (pt == payloads.rx_pt) {
+        pt = payloads.tx_pt;
+    } else if (pt == payloads.rx_event_pt && payloads.tx_event_pt >= 0) {
+        pt = payloads.tx_event_pt;
+    }
+    header[1] = (uint8_t)((header[1] & 0x80) | (pt & 0x7f));
+
+    pjmedia_transport_send_rtp(target->member, pkt, (pj_size_t)size);
+    relayed_rtp.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool PJSIPRtpRelay::forwardRtcp(void* pkt, pj_ssize_t size) {
+    if (peer.load(std::memory_order_acquire) == nullptr || size <= 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(forward_mutex);
+    PJSIPRtpRelay* target = peer.load(std::memory_order_relaxed);
+    if (target == nullptr) {
+        return false;
+    }
+
+    // The RTP goes through untouched, so do its reports
+    pjmedia_transport_send_rtcp(target->member, pkt, (pj_size_t)size);
+    relayed_rtcp.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+// Member transport -> us, on the media ioqueue threads
+void PJSIPRtpRelay::onRtp(void* user_data, void* pkt, pj_ssize_t size) {
+    PJSIPRtpRelay* relay = static_cast<PJSIPRtpRelay*>(user_data);
+    if (relay->forwardRtp(pkt, size)) {
+        return;
+    }
+    if (relay->stream_rtp_cb) {
+        relay->stream_rtp_cb(relay->stream_user_data, pkt, size);
+    }
+}
+
+void PJSIPRtpRelay::onRtp2(pjmedia_tp_cb_param* param) {
+    PJSIPRtpRelay* relay = static_cast<PJSIPRtpRelay*>(param->user_data);
+    if (relay->forwardRtp(param->pkt, param->size)) {
+        return;
+    }
+    if (relay->stream_rtp_cb2) {
+        pjmedia_tp_cb_param stream_param = *param;
+        stream_param.user_data = relay->stream_user_data;
+        relay->stream_rtp_cb2(&stream_param);
+        param->rem_switch = stream_param.rem_switch;
+    }
+}
+
+void PJSIPRtpRelay::onRtcp(void* user_data, void* pkt, pj_ssize_t size) {
+    PJSIPRtpRelay* relay = static_cast<PJSIPRtpRelay*>(user_data);
+    if (relay->forwardRtcp(pkt, size)) {
+        return;
+    }
+    if (relay->stream_rtcp_cb) {
+        relay->stream_rtcp_cb(relay->stream_user_data, pkt, size);
+    }
+}
+
+// Transport operations, mostly straight through to the member
+pj_status_t PJSIPRtpRelay::getInfo(pjmedia_transport* transport, pjmedia_transport_info* info) {
+    return pjmedia_transport_get_info(owner(transport)->member, info);
+}
+
+pj_status_t PJSIPRtpRelay::attach(pjmedia_transport* transport, void* user_data, const pj_sockaddr_t* rem_addr,
+                                  const pj_sockaddr_t* rem_rtcp, unsigned addr_len,
+                                  void (*rtp_cb)(void*, void*, pj_ssize_t),
+                                  void (*rtcp_cb)(void*, void*, pj_ssize_t)) {
+    pjmedia_transport_attach_param param;
+    pj_bzero(&param, sizeof(param));
+    param.media_type = PJMEDIA_TYPE_AUDIO;
+    pj_memcpy(&param.rem_addr, rem_addr, addr_len);
+    if (rem_rtcp && pj_sockaddr_has_addr(rem_rtcp)) {
+        pj_memcpy(&param.rem_rtcp, rem_rtcp, addr_len);
+    }
+    param.addr_len = addr_len;
+    param.user_data = user_data;
+    param.rtp_cb = rtp_cb;
+    param.rtcp_cb = rtcp_cb;
+    return attach2(transport, &param);
+}
+
+pj_status_t PJSIPRtpRelay::attach2(pjmedia_transport* transport, pjmedia_transport_attach_param* param) {
+    PJSIPRtpRelay* relay = owner(transport);
+    relay->stream_user_data = param->user_data;
+    relay->stream_rtp_cb = param->rtp_cb2 ? nullptr : param->rtp_cb;
+    relay->stream_rtp_cb2 = param->rtp_cb2;
+    relay->stream_rtcp_cb = param->rtcp_cb;
+
+    // The member calls us instead, the stream's callbacks are restored on failure
+    void* user_data = param->user_data;
+    void (*rtp_cb)(void*, void*, pj_ssize_t) = param->rtp_cb;
+    void (*rtp_cb2)(pjmedia_tp_cb_param*) = param->rtp_cb2;
+    void (*rtcp_cb)(void*, void*, pj_ssize_t) = param->rtcp_cb;
+
+    param->user_data = relay;
+    param->rtp_cb = rtp_cb2 ? nullptr : &PJSIPRtpRelay::onRtp;
+    param->rtp_cb2 = rtp_cb2 ? &PJSIPRtpRelay::onRtp2 : nullptr;
+    param->rtcp_cb = &PJSIPRtpRelay::onRtcp;
+
+    pj_status_t status = pjmedia_transport_attach2(relay->member, param);
+    if (status != PJ_SUCCESS) {
+        param->user_data = user_data;
+        param->rtp_cb = rtp_cb;
+        param->rtp_cb2 = rtp_cb2;
+        param->rtcp_cb = rtcp_cb;
+        relay->stream_user_data = nullptr;
+        relay->stream_rtp_cb = nullptr;
+        relay->stream_rtp_cb2 = nullptr;
+        relay->stream_rtcp_cb = nullptr;
+    }
+    return status;
+}
+
+void PJSIPRtpRelay::detach(pjmedia_transport* transport, void*) {
+    PJSIPRtpRelay* relay = owner(transport);
+    if (relay->stream_user_data == nullptr) {
+        return;
+    }
+    pjmedia_transport_detach(relay->member, relay);
+    relay->stream_user_data = nullptr;
+    relay->stream_rtp_cb = nullptr;
+    relay->stream_rtp_cb2 = nullptr;
+    relay->stream_rtcp_cb = nullptr;
+}
+
+// While forwarding, the peer's packets take the stream's place on the wire
+pj_status_t PJSIPRtpRelay::sendRtp(pjmedia_transport* transport, const void* pkt, pj_size_t size) {
+    PJSIPRtpRelay* relay = owner(transport);
+    if (relay->peer.load(std::memory_order_acquire)) {
+        return PJ_SUCCESS;
+    }
+    return pjmedia_transport_send_rtp(relay->member, pkt, size);
+}
+
+pj_status_t PJSIPRtpRelay::sendRtcp(pjmedia_transport* transport, const void* pkt, pj_size_t size) {
+    PJSIPRtpRelay* relay = owner(transport);
+    if (relay->peer.load(std::memory_order_acquire)) {
+        return PJ_SUCCESS;
+    }
+    return pjmedia_transport_send_rtcp(relay->member, pkt, size);
+}
+
+pj_status_t PJSIPRtpRelay::sendRtcp2(pjmedia_transport* transport, const pj_sockaddr_t* addr, unsigned addr_len,
+                                     const void* pkt, pj_size_t size) {
+    PJSIPRtpRelay* relay = owner(transport);
+    if (relay->peer.load(std::memory_order_acquire)) {
+        return PJ_SUCCESS;
+    }
+    return pjmedia_transport_send_rtcp2(relay->member, addr, addr_len, pkt, size);
+}
+
+pj_status_t PJSIPRtpRelay::mediaCreate(pjmedia_transport* transport, pj_pool_t* pool, unsigned options,
+                                       const pjmedia_sdp_session* remote, unsigned media_index) {
+    return pjmedia_transport_media_create(owner(transport)->member, pool, options, remote, media_index);
+}
+
+pj_status_t PJSIPRtpRelay::encodeSdp(pjmedia_transport* transport, pj_pool_t* pool, pjmedia_sdp_session* local,
+                                     const pjmedia_sdp_session* remote, unsigned media_index) {
+    return pjmedia_transport_encode_sdp(owner(transport)->member, pool, local, remote, media_index);
+}
+
+pj_status_t PJSIPRtpRelay::mediaStart(pjmedia_transport* transport, pj_pool_t* pool,
+                                      const pjmedia_sdp_session* local, const pjmedia_sdp_session* remote,
+                                      unsigned media_index) {
+    return pjmedia_transport_media_start(owner(transport)->member, pool, local, remote, media_index);
+}
+
+pj_status_t PJSIPRtpRelay::mediaStop(pjmedia_transport* transport) {
+    return pjmedia_transport_media_stop(owner(transport)->member);
+}
+
+pj_status_t PJSIPRtpRelay::simulateLost(pjmedia_transport* transport, pjmedia_dir dir, unsigned pct_lost) {
+    return pjmedia_transport_simulate_lost(owner(transport)->member, dir, pct_lost);
+}
+
+pj_status_t PJSIPRtpRelay::destroy(pjmedia_transport* transport) {
+    PJSIPRtpRelay* relay = owner(transport);
+
+    // Nobody forwards into the member past this point
+    relay->bridge->relayDestroyed(relay);
+    if (relay->close_member) {
+        pjmedia_transport_close(relay->member);
+    }
+    delete relay;
+    return PJ_SUCCESS;
+}
+
+// PJSIPCallBridge implementation
+PJSIPCallBridge::PJSIPCallBridge() {
+    for (unsigned i = 0; i < PJSUA_MAX_CALLS; i++) {
+        pairs[i] = Pair{ PJSUA_INVALID_ID, PJSIPBridgeMode::Pending, true, true, 0 };
+        relays[i] = nullptr;
+    }
+}
+
+pjmedia_transport* PJSIPCallBridge::wrapTransport(pjsua_call_id call_id, unsigned media_index,
+                                                  pjmedia_transport* base, unsigned flags) {
+    if (!PJSIPCallTable::isValidId(call_id) || media_index >= PJSUA_MAX_CALL_MEDIA ||
+        pjsua_var.calls[call_id].media[media_index].type != PJMEDIA_TYPE_AUDIO) {
+        return base;
+    }
+
+    // Relays go with the call's transports, so one still here means a
+    // second audio line; only the first one is bridged
+    std::lock_guard<std::mutex> lock(mutex);
+    if (relays[call_id]) {
+        return base;
+    }
+
+    PJSIPRtpRelay* relay = PJSIPRtpRelay::create(this, call_id, base, (flags & PJSUA_MED_TP_CLOSE_MEMBER) != 0);
+    relays[call_id] = relay;
+    return relay->transport();
+}
+
+bool PJSIPCallBridge::bridge(pjsua_call_id a, pjsua_call_id b, const PJSIPBridgeOptions& options) {
+    if (!PJSIPCallTable::isValidId(a) || !PJSIPCallTable::isValidId(b) || a == b ||
+        !pjsua_call_is_active(a) || !pjsua_call_is_active(b)) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pairs[a].peer != PJSUA_INVALID_ID || pairs[b].peer != PJSUA_INVALID_ID) {
+            PJW_LOG_WARN("⚠️ Call %d or %d is already bridged", a, b);
+            return false;
+        }
+        pairs[a] = Pair{ b, PJSIPBridgeMode::Pending, options.relay, options.hangup_together, 0 };
+        pairs[b] = Pair{ a, PJSIPBridgeMode::Pending, options.relay, options.hangup_together, 0 };
+    }
+
+    PJW_LOG_INFO("🔗 Bridging calls %d and %d", a, b);
+    apply(a);
+    return true;
+}
+
+bool PJSIPCallBridge::unbridge(pjsua_call_id call_id) {
+    pjsua_call_id peer;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!PJSIPCallTable::isValidId(call_id) || pairs[call_id].peer == PJSUA_INVALID_ID) {
+            return false;
+        }
+        peer = pairs[call_id].peer;
+        pairs[call_id].peer = PJSUA_INVALID_ID;
+        pairs[peer].peer = PJSUA_INVALID_ID;
+    }
+
+    release(call_id, peer);
+    PJW_LOG_INFO("🔗 Unbridged calls %d and %d", call_id, peer);
+    return true;
+}
+
+bool PJSIPCallBridge::info(pjsua_call_id call_id, PJSIPBridgeInfo& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!PJSIPCallTable::isValidId(call_id) || pairs[call_id].peer == PJSUA_INVALID_ID) {
+        return false;
+    }
+
+    const Pair& pair = pairs[call_id];
+    out.peer = pair.peer;
+    out.mode = pair.mode;
+    out.hangup_together = pair.hangup_together;
+    out.media_updates = pair.media_updates;
+    out.relayed_rtp = relays[call_id] ? relays[call_id]->relayedRtp() : 0;
+    out.relayed_rtcp = relays[call_id] ? relays[call_id]->relayedRtcp() : 0;
+    return true;
+}
+
+PJSIPBridgeStats PJSIPCallBridge::stats() const {
+    PJSIPBridgeStats result = PJSIPBridgeStats();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (pjsua_call_id i = 0; i < (pjsua_call_id)PJSUA_MAX_CALLS; i++) {
+        if (pairs[i].peer == PJSUA_INVALID_ID || pairs[i].peer < i) {
+            continue;   // each pair once
+        }
+        result.pairs++;
+        switch (pairs[i].mode) {
+            case PJSIPBridgeMode::Relay: result.relayed++; break;
+            case PJSIPBridgeMode::Mixed: result.mixed++; break;
+            default: result.pending++; break;
+        }
+    }
+    return result;
+}
+
+bool PJSIPCallBridge::onMediaState(pjsua_call_id call_id) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!PJSIPCallTable::isValidId(call_id) || pairs[call_id].peer == PJSUA_INVALID_ID) {
+            return false;
+        }
+        pairs[call_id].media_updates++;
+    }
+
+    // A re-INVITE may have changed the codec, the hold state or the stream
+    apply(call_id);
+    return true;
+}
+
+void PJSIPCallBridge::onCallEnded(pjsua_call_id call_id) {
+    pjsua_call_id peer;
+    bool hangup_together;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!PJSIPCallTable::isValidId(call_id) || pairs[call_id].peer == PJSUA_INVALID_ID) {
+            return;
+        }
+        peer = pairs[call_id].peer;
+        hangup_together = pairs[call_id].hangup_together;
+        pairs[call_id].peer = PJSUA_INVALID_ID;
+        pairs[peer].peer = PJSUA_INVALID_ID;
+    }
+
+    release(call_id, peer);
+    if (hangup_together && pjsua_call_is_active(peer)) {
+        PJW_LOG_DEBUG("🔗 Call %d ended, hanging up bridged call %d", call_id, peer);
+        pjsua_call_hangup(peer, 0, NULL, NULL);
+    }
+}
+
+void PJSIPCallBridge::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (unsigned i = 0; i < PJSUA_MAX_CALLS; i++) {
+        pairs[i].peer = PJSUA_INVALID_ID;
+        if (relays[i]) {
+            relays[i]->stopForwarding();
+        }
+    }
+}
+
+const char* PJSIPCallBridge::modeName(PJSIPBridgeMode mode) {
+    switch (mode) {
+        case PJSIPBridgeMode::Relay: return "relay";
+        case PJSIPBridgeMode::Mixed: return "mixed";
+        default: return "pending";
+    }
+}
+
+// Unlocked reads of the call's media, like PJSIPCodecControl::callCodec()
+void PJSIPCallBridge::readLeg(Leg& leg) const {
+    leg.slot = pjsua_call_get_conf_port(leg.call_id);
+    leg.active = false;
+    leg.has_stream = false;
+    leg.transport = nullptr;
+
+    int media_index = pjsua_var.calls[leg.call_id].audio_idx;
+    if (media_index < 0) {
+        return;
+    }
+    const pjsua_call_media& media = pjsua_var.calls[leg.call_id].media[media_index];
+    leg.active = media.state != PJSUA_CALL_MEDIA_NONE && media.state != PJSUA_CALL_MEDIA_ERROR;
+    leg.transport = media.tp;
+
+    pjsua_stream_info stream;
+    if (pjsua_call_get_stream_info(leg.call_id, (unsigned)media_index, &stream) == PJ_SUCCESS &&
+        stream.type == PJMEDIA_TYPE_AUDIO) {
+        leg.stream = stream.info.aud;
+        leg.has_stream = true;
+    }
+}
+
+void PJSIPCallBridge::apply(pjsua_call_id call_id) {
+    Leg legs[2];
+    bool relay_allowed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pairs[call_id].peer == PJSUA_INVALID_ID) {
+            return;
+        }
+        legs[0].call_id = call_id;
+        legs[1].call_id = pairs[call_id].peer;
+        relay_allowed = pairs[call_id].relay;
+    }
+
+    // pjsua takes its own locks, never under ours
+    readLeg(legs[0]);
+    readLeg(legs[1]);
+
+    bool same_codec = legs[0].has_stream && legs[1].has_stream &&
+                      pj_stricmp(&legs[0].stream.fmt.encoding_name, &legs[1].stream.fmt.encoding_name) == 0 &&
+                      legs[0].stream.fmt.clock_rate == legs[1].stream.fmt.clock_rate &&
+                      legs[0].stream.fmt.channel_cnt == legs[1].stream.fmt.channel_cnt;
+
+    PJSIPBridgeMode mode = PJSIPBridgeMode::Pending;
+    PJSIPBridgeMode previous;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Pair& pair = pairs[legs[0].call_id];
+        if (pair.peer != legs[1].call_id) {
+            return;     // unbridged meanwhile
+        }
+
+        PJSIPRtpRelay* relay_a = relays[legs[0].call_id];
+        PJSIPRtpRelay* relay_b = relays[legs[1].call_id];
+
+        // Our relay outermost means no SRTP on top of it
+        bool relayable = relay_allowed && same_codec && relay_a && relay_b &&
+                         legs[0].transport == relay_a->transport() && legs[1].transport == relay_b->transport();
+        if (legs[0].active && legs[1].active) {
+            mode = relayable ? PJSIPBridgeMode::Relay : PJSIPBridgeMode::Mixed;
+        }
+
+        if (mode == PJSIPBridgeMode::Relay) {
+            const pjmedia_stream_info& a = legs[0].stream;
+            const pjmedia_stream_info& b = legs[1].stream;
+            relay_a->forwardTo(relay_b, PJSIPPayloadMap{ (int)a.rx_pt, (int)b.tx_pt, a.rx_event_pt, b.tx_event_pt });
+            relay_b->forwardTo(relay_a, PJSIPPayloadMap{ (int)b.rx_pt, (int)a.tx_pt, b.rx_event_pt, a.tx_event_pt });
+        } else {
+            if (relay_a) {
+                relay_a->stopForwarding();
+            }
+            if (relay_b) {
+                relay_b->stopForwarding();
+            }
+        }
+
+        previous = pair.mode;
+        pair.mode = mode;
+        pairs[legs[1].call_id].mode = mode;
+    }
+
+    // Relayed legs are taken off the bridge clock entirely: nothing to
+    // decode, mix or encode. Mixed legs hear each other through the bridge.
+    pjmedia_port_op op = mode == PJSIPBridgeMode::Relay ? PJMEDIA_PORT_DISABLE : PJMEDIA_PORT_ENABLE;
+    for (const Leg& leg : legs) {
+        if (leg.slot != PJSUA_INVALID_ID) {
+            pjmedia_conf_configure_port(pjsua_var.mconf, (unsigned)leg.slot, op, op);
+        }
+    }
+    if (legs[0].slot != PJSUA_INVALID_ID && legs[1].slot != PJSUA_INVALID_ID) {
+        if (mode == PJSIPBridgeMode::Mixed) {
+            pjsua_conf_connect(legs[0].slot, legs[1].slot);
+            pjsua_conf_connect(legs[1].slot, legs[0].slot);
+        } else if (previous == PJSIPBridgeMode::Mixed) {
+            pjsua_conf_disconnect(legs[0].slot, legs[1].slot);
+            pjsua_conf_disconnect(legs[1].slot, legs[0].slot);
+        }
+    }
+
+    if (mode != previous) {
+        PJW_LOG_DEBUG("🔗 Calls %d and %d: %s", legs[0].call_id, legs[1].call_id, modeName(mode));
+    }
+}
+
+void PJSIPCallBridge::release(pjsua_call_id call_id, pjsua_call_id peer) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (relays[call_id]) {
+            relays[call_id]->stopForwarding();
+        }
+        if (relays[peer]) {
+            relays[peer]->stopForwarding();
+        }
+    }
+
+    // Back to ordinary bridge ports, not connected to anything
+    pjsua_conf_port_id slots[2] = { pjsua_call_get_conf_port(call_id), pjsua_call_get_conf_port(peer) };
+    for (pjsua_conf_port_id slot : slots) {
+        if (slot != PJSUA_INVALID_ID) {
+            pjmedia_conf_configure_port(pjsua_var.mconf, (unsigned)slot, PJMEDIA_PORT_ENABLE, PJMEDIA_PORT_ENABLE);
+        }
+    }
+    if (slots[0] != PJSUA_INVALID_ID && slots[1] != PJSUA_INVALID_ID) {
+        pjsua_conf_disconnect(slots[0], slots[1]);
+        pjsua_conf_disconnect(slots[1], slots[0]);
+    }
+}
+
+void PJSIPCallBridge::relayDestroyed(PJSIPRtpRelay* relay) {
+    std::lock_guard<std::mutex> lock(mutex);
+    pjsua_call_id call_id = relay->callId();
+    if (relays[call_id] == relay) {
+        relays[call_id] = nullptr;
+    }
+
+    // Waits out a packet the peer may be sending through us right now
+    for (PJSIPRtpRelay* other : relays) {
+        if (other && other->forwardsTo(relay)) {
+            other->stopForwarding();
+        }
+    }
+    relay->stopForwarding();
+}
@@ -0,0 +1,205 @@
+#ifndef NODE_PJSIP_CALL_BRIDGE_H
+#define NODE_PJSIP_CALL_BRIDGE_H
+
+#include <pjsua-lib/pjsua.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+class PJSIPCallBridge;
+
+enum class PJSIPBridgeMode {
+    Pending,    // waiting for both legs' audio
+    Relay,      // RTP forwarded packet for packet, the conference bridge is bypassed
+    Mixed       // two-way bridge connection between the legs, transcodes as needed
+};
+
+struct PJSIPBridgeOptions {
+    bool relay;                 // forward RTP when both legs negotiated the same codec
+    bool hangup_together;       // either leg ending hangs up the other
+
+    PJSIPBridgeOptions() : relay(true), hangup_together(true) {}
+};
+
+struct PJSIPBridgeInfo {
+    pjsua_call_id peer;
+    PJSIPBridgeMode mode;
+    bool hangup_together;
+    uint64_t relayed_rtp;       // packets this leg received and forwarded to the peer
+    uint64_t relayed_rtcp;
+    uint32_t media_updates;     // re-INVITEs and hold changes handled natively
+};
+
+struct PJSIPBridgeStats {
+    unsigned pairs;
+    unsigned relayed;
+    unsigned mixed;
+    unsigned pending;
+};
+
+// Payload types rewritten on the way through; event types may be -1
+struct PJSIPPayloadMap {
+    int rx_pt;
+    int tx_pt;
+    int rx_event_pt;
+    int tx_event_pt;
+};
+
+// Media transport adapter in front of a call's audio transport, the
+// transport_adapter_sample pattern. Passes everything through until it is
+// told to forward: then RTP/RTCP received on this leg goes straight out of
+// the peer's transport with the payload type rewritten, the stream never
+// sees it, and what the stream itself sends is dropped.
+class PJSIPRtpRelay {
+public:
+    static PJSIPRtpRelay* create(PJSIPCallBridge* bridge, pjsua_call_id call_id, pjmedia_transport* member,
+                                 bool close_member);
+
+    PJSIPRtpRelay(const PJSIPRtpRelay&) = delete;
+    PJSIPRtpRelay& operator=(const PJSIPRtpRelay&) = delete;
+
+    pjmedia_transport* transport() { return &tp.base; }
+    pjsua_call_id callId() const { return call_id; }
+
+    // Bridge mutex held. stopForwarding() returns once no packet is in
+    // flight towards the old peer.
+    void forwardTo(PJSIPRtpRelay* target, const PJSIPPayloadMap& payloads);
+    void stopForwarding();
+    bool forwardsTo(const PJSIPRtpRelay* target) const { return peer.load(std::memory_order_acquire) == target; }
+
+    uint64_t relayedRtp() const { return relayed_rtp.load(std::memory_order_relaxed); }
+    uint64_t relayedRtcp() const { return relayed_rtcp.load(std::memory_order_relaxed); }
+
+private:
+    // pjmedia casts the transport pointer back to this, so it must come first
+    struct Transport {
+        pjmedia_transport base;
+        PJSIPRtpRelay* owner;
+    };
+
+    PJSIPRtpRelay(PJSIPCallBridge* bridge, pjsua_call_id call_id, pjmedia_transport* member, bool close_member);
+
+    static PJSIPRtpRelay* owner(pjmedia_transport* transport) {
+        return reinterpret_cast<Transport*>(transport)->owner;
+    }
+
+    // Received on this leg, true if it went to the peer
+    bool forwardRtp(void* pkt, pj_ssize_t size);
+    bool forwardRtcp(void* pkt, pj_ssize_t size);
+
+    static void onRtp(void* user_data, void* pkt, pj_ssize_t size);
+    static void onRtp2(pjmedia_tp_cb_param* param);
+    static void onRtcp(void* user_data, void* pkt, pj_ssize_t size);
+
+    static pj_status_t getInfo(pjmedia_transport* transport, pjmedia_transport_info* info);
+    static pj_status_t attach(pjmedia_transport* transport, void* user_data, const pj_sockaddr_t* rem_addr,
+                              const pj_sockaddr_t* rem_rtcp, unsigned addr_len,
+                              void (*rtp_cb)(void*, void*, pj_ssize_t), void (*rtcp_cb)(void*, void*, pj_ssize_t));
+    static pj_status_t attach2(pjmedia_transport* transport, pjmedia_transport_attach_param* param);
+    static void detach(pjmedia_transport* transport, void* user_data);
+    static pj_status_t sendRtp(pjmedia_transport* transport, const void* pkt, pj_size_t size);
+    static pj_status_t sendRtcp(pjmedia_transport* transport, const void* pkt, pj_size_t size);
+    static pj_status_t sendRtcp2(pjmedia_transport* transport, const pj_sockaddr_t* addr, unsigned addr_len,
+                                 const void* pkt, pj_size_t size);
+    static pj_status_t mediaCreate(pjmedia_transport* transport, pj_pool_t* pool, unsigned options,
+                                   const pjmedia_sdp_session* remote, unsigned media_index);
+    static pj_status_t encodeSdp(pjmedia_transport* transport, pj_pool_t* pool, pjmedia_sdp_session* local,
+                                 const pjmedia_sdp_session* remote, unsigned media_index);
+    static pj_status_t mediaStart(pjmedia_transport* transport, pj_pool_t* pool, const pjmedia_sdp_session* local,
+                                  const pjmedia_sdp_session* remote, unsigned media_index);
+    static pj_status_t mediaStop(pjmedia_transport* transport);
+    static pj_status_t simulateLost(pjmedia_transport* transport, pjmedia_dir dir, unsigned pct_lost);
+    static pj_status_t destroy(pjmedia_transport* transport);
+
+    static pjmedia_transport_op ops;
+
+    Transport tp;
+    PJSIPCallBridge* bridge;
+    pjsua_call_id call_id;
+    pjmedia_transport* member;
+    bool close_member;
+
+    // The stream attached to us
+    void* stream_user_data;
+    void (*stream_rtp_cb)(void*, void*, pj_ssize_t);
+    void (*stream_rtp_cb2)(pjmedia_tp_cb_param*);
+    void (*stream_rtcp_cb)(void*, void*, pj_ssize_t);
+
+    // Held while a packet goes out through the peer, so the peer cannot be
+    // destroyed under it
+    std::mutex forward_mutex;
+    std::atomic<PJSIPRtpRelay*> peer;
+    PJSIPPayloadMap payloads;
+
+    std::atomic<uint64_t> relayed_rtp;
+    std::atomic<uint64_t> relayed_rtcp;
+};
+
+// Native back-to-back bridging of call pairs.
+//
+// When both legs negotiated the same codec (and neither is SRTP, whose keys
+// differ per leg), their relays forward RTP to each other and the legs'
+// conference ports are disabled, so no frame is decoded, mixed or encoded.
+// Otherwise the legs are connected to each other on the bridge, which
+// transcodes. Every re-INVITE re-evaluates the pair from on_call_media_state
+// and a leg that ends hangs up the other, all on pjsua's threads.
+class PJSIPCallBridge {
+public:
+    PJSIPCallBridge();
+
+    PJSIPCallBridge(const PJSIPCallBridge&) = delete;
+    PJSIPCallBridge& operator=(const PJSIPCallBridge&) = delete;
+
+    // on_create_media_transport. Wraps the first audio transport of a call.
+    pjmedia_transport* wrapTransport(pjsua_call_id call_id, unsigned media_index, pjmedia_transport* base,
+                                     unsigned flags);
+
+    // JS thread
+    bool bridge(pjsua_call_id a, pjsua_call_id b, const PJSIPBridgeOptions& options);
+    bool unbridge(pjsua_call_id call_id);
+    bool info(pjsua_call_id call_id, PJSIPBridgeInfo& out) const;
+    PJSIPBridgeStats stats() const;
+
+    // pjsua callbacks. onMediaState() returns true for a bridged call, whose
+    // media routing is then taken care of.
+    bool onMediaState(pjsua_call_id call_id);
+    void onCallEnded(pjsua_call_id call_id);
+
+    // Shutdown
+    void clear();
+
+    static const char* modeName(PJSIPBridgeMode mode);
+
+private:
+    friend class PJSIPRtpRelay;
+
+    struct Pair {
+        pjsua_call_id peer;
+        PJSIPBridgeMode mode;
+        bool relay;
+        bool hangup_together;
+        uint32_t media_updates;
+    };
+
+    // What apply() needs from pjsua about one leg, read without the mutex
+    struct Leg {
+        pjsua_call_id call_id;
+        pjsua_conf_port_id slot;
+        bool active;
+        bool has_stream;
+        pjmedia_transport* transport;   // outermost audio transport, an SRTP one if encrypted
+        pjmedia_stream_info stream;
+    };
+
+    void readLeg(Leg& leg) const;
+    void apply(pjsua_call_id call_id);
+    void release(pjsua_call_id call_id, pjsua_call_id peer);   // undoes the bridge routing
+    void relayDestroyed(PJSIPRtpRelay* relay);
+
+    mutable std::mutex mutex;
+    Pair pairs[PJSUA_MAX_CALLS];
+    PJSIPRtpRelay* relays[PJSUA_MAX_CALLS];
+};
+
+#endif
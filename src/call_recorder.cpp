@@ -0,0 +1,683 @@
+#include "call_recorder.h"
+#include "log_sink.h"
+
+#include <pjmedia/alaw_ulaw.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// WAVE_FORMAT_* tags
+static const uint16_t WAV_FORMAT_PCM = 1;
+static const uint16_t WAV_FORMAT_ALAW = 6;
+static const uint16_t WAV_FORMAT_MULAW = 7;
+
+static void putLE16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back((uint8_t)(value & 0xff));
+    out.push_back((uint8_t)(value >> 8));
+}
+
+static void putLE32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        out.push_back((uint8_t)((value >> shift) & 0xff));
+    }
+}
+
+static void putTag(std::vector<uint8_t>& out, const char* tag) {
+    out.insert(out.end(), tag, tag + 4);
+}
+
+static bool syncFile(FILE* file) {
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+static const char* encodingName(PJSIPRecordingEncoding encoding) {
+    switch (encoding) {
+        case PJSIPRecordingEncoding::Pcmu: return "pcmu";
+        case PJSIPRecordingEncoding::Pcma: return "pcma";
+        default: return "pcm";
+    }
+}
+
+// PJSIPRecordingOptions implementation
+PJSIPRecordingOptions::PJSIPRecordingOptions() : stereo(false), encoding(PJSIPRecordingEncoding::Pcm16),
+    buffer_ms(PJSIPCallRecorder::DEFAULT_BUFFER_MS), sync(false) {
+}
+
+// PJSIPCallRecording implementation
+PJSIPCallRecording::PJSIPCallRecording(pjsua_call_id call_id, const PJSIPRecordingOptions& options,
+                                       unsigned clock_rate, unsigned samples_per_frame, unsigned capacity)
+    : call_id(call_id), options(options), clock_rate(clock_rate), samples_per_frame(samples_per_frame),
+      frame_bytes(samples_per_frame * 2), capacity(capacity), channel_count(options.stereo ? 2 : 1), refs(1),
+      closed(false), state(State::Recording), file(nullptr), frames(0), dropped(0), bytes(0), write_errors(0),
+      max_queued(0) {
+    for (Channel& channel : channels) {
+        channel.owner = this;
+        pj_bzero(&channel.port, sizeof(channel.port));
+        channel.pool = nullptr;
+        channel.slot = PJSUA_INVALID_ID;
+        channel.write.store(0, std::memory_order_relaxed);
+        channel.read.store(0, std::memory_order_relaxed);
+    }
+}
+
+PJSIPCallRecording::~PJSIPCallRecording() {
+    if (file) {
+        fclose(file);
+    }
+}
+
+bool PJSIPCallRecording::openFile(const std::string& path) {
+    file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        PJW_LOG_ERROR("❌ Cannot open recording file %s", path.c_str());
+        return false;
+    }
+
+    // Every write is already one large batch, stdio buffering would only add a copy
+    setvbuf(file, nullptr, _IONBF, 0);
+    if (!writeHeader()) {
+        PJW_LOG_ERROR("❌ Cannot write recording file %s", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool PJSIPCallRecording::addChannel(unsigned index) {
+    Channel& channel = channels[index];
+    channel.ring.reset(new uint8_t[(size_t)capacity * frame_bytes]);
+
+    channel.pool = pjsua_pool_create("rec%p", 512, 512);
+    if (channel.pool == nullptr) {
+        return false;
+    }
+
+    pj_str_t name = pj_str((char*)"node-pjsip-recorder");
+    pjmedia_port_info_init(&channel.port.info, &name, PJMEDIA_SIG_CLASS_APP('R', 'C'), clock_rate, 1, 16,
+                           samples_per_frame);
+    channel.port.port_data.pdata = &channel;
+    channel.port.put_frame = &PJSIPCallRecording::onPutFrame;
+    channel.port.get_frame = &PJSIPCallRecording::onGetFrame;
+    channel.port.on_destroy = &PJSIPCallRecording::onDestroy;
+
+    if (pjmedia_port_init_grp_lock(&channel.port, channel.pool, nullptr) != PJ_SUCCESS) {
+        pj_pool_safe_release(&channel.pool);
+        return false;
+    }
+
+    // The port's reference, dropped by onDestroy()
+    refs.fetch_add(1, std::memory_order_relaxed);
+
+    if (pjsua_conf_add_port(channel.pool, &channel.port, &channel.slot) != PJ_SUCCESS) {
+        channel.slot = PJSUA_INVALID_ID;
+        pjmedia_port_destroy(&channel.port);    // last reference, runs onDestroy()
+        return false;
+    }
+    return true;
+}
+
+void PJSIPCallRecording::detach() {
+    closed.store(true, std::memory_order_release);
+    for (unsigned i = 0; i < channel_count; i++) {
+        Channel& channel = channels[i];
+        if (channel.pool == nullptr && channel.slot == PJSUA_INVALID_ID) {
+            continue;   // never created, or already gone
+        }
+        if (channel.slot != PJSUA_INVALID_ID) {
+            pjsua_conf_remove_port(channel.slot);
+            channel.slot = PJSUA_INVALID_ID;
+        }
+        // Drops our reference; the bridge may still hold one until its next tick
+        pjmedia_port_destroy(&channel.port);
+    }
+}
+
+void PJSIPCallRecording::release() {
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete this;
+    }
+}
+
+pj_status_t PJSIPCallRecording::onDestroy(pjmedia_port* port) {
+    Channel* channel = static_cast<Channel*>(port->port_data.pdata);
+    pj_pool_safe_release(&channel->pool);
+    channel->owner->release();
+    return PJ_SUCCESS;
+}
+
+// Bridge -> ring, on the bridge clock thread. No allocation, no locks, no I/O.
+pj_status_t PJSIPCallRecording::onPutFrame(pjmedia_port* port, pjmedia_frame* frame) {
+    Channel* channel = static_cast<Channel*>(port->port_data.pdata);
+    PJSIPCallRecording* recording = channel->owner;
+    if (recording->closed.load(std::memory_order_acquire)) {
+        return PJ_SUCCESS;
+    }
+
+    uint32_t write = channel->write.load(std::memory_order_relaxed);
+    uint32_t read = channel->read.load(std::memory_order_acquire);
+    if (write - read >= recording->capacity) {
+        recording->dropped.fetch_add(1, std::memory_order_relaxed);
+        return PJ_SUCCESS;
+    }
+
+    // Silence keeps the file in step with the call's timeline
+    uint8_t* dst = channel->ring.get() + (size_t)(write % recording->capacity) * recording->frame_bytes;
+    size_t copied = 0;
+    if (frame->type == PJMEDIA_FRAME_TYPE_AUDIO && frame->buf) {
+        copied = std::min((size_t)frame->size, (size_t)recording->frame_bytes);
+        memcpy(dst, frame->buf, copied);
+    }
+    memset(dst + copied, 0, recording->frame_bytes - copied);
+    channel->write.store(write + 1, std::memory_order_release);
+
+    // Both channels are fed from the same clock tick, so this is never concurrent
+    if (write + 1 - read > recording->max_queued.load(std::memory_order_relaxed)) {
+        recording->max_queued.store(write + 1 - read, std::memory_order_relaxed);
+    }
+    return PJ_SUCCESS;
+}
+
+pj_status_t PJSIPCallRecording::onGetFrame(pjmedia_port*, pjmedia_frame* frame) {
+    frame->type = PJMEDIA_FRAME_TYPE_NONE;
+    frame->size = 0;
+    return PJ_SUCCESS;
+}
+
+void PJSIPCallRecording::encode(const int16_t* const* sources, unsigned count, std::vector<uint8_t>& out) const {
+    size_t offset = out.size();
+    unsigned sample_bytes = options.encoding == PJSIPRecordingEncoding::Pcm16 ? 2 : 1;
+    out.resize(offset + (size_t)samples_per_frame * count * sample_bytes);
+
+    // Interleaved, little-endian whatever the host
+    uint8_t* dst = out.data() + offset;
+    for (unsigned s = 0; s < samples_per_frame; s++) {
+        for (unsigned c = 0; c < count; c++) {
+            int16_t sample = sources[c][s];
+            switch (options.encoding) {
+                case PJSIPRecordingEncoding::Pcmu:
+                    *dst++ = (uint8_t)pjmedia_linear2ulaw(sample);
+                    break;
+                case PJSIPRecordingEncoding::Pcma:
+                    *dst++ = (uint8_t)pjmedia_linear2alaw(sample);
+                    break;
+                default:
+                    *dst++ = (uint8_t)(sample & 0xff);
+                    *dst++ = (uint8_t)((sample >> 8) & 0xff);
+                    break;
+            }
+        }
+    }
+}
+
+// Writer thread. Takes whatever both rings hold and writes it with one call.
+void PJSIPCallRecording::writeBatch(std::vector<uint8_t>& staging, bool final) {
+    if (file == nullptr) {
+        return;
+    }
+
+    uint32_t read[2] = { 0, 0 };
+    uint32_t available[2] = { 0, 0 };
+    uint32_t least = UINT32_MAX;
+    uint32_t most = 0;
+    for (unsigned c = 0; c < channel_count; c++) {
+        read[c] = channels[c].read.load(std::memory_order_relaxed);
+        available[c] = channels[c].write.load(std::memory_order_acquire) - read[c];
+        least = std::min(least, available[c]);
+        most = std::max(most, available[c]);
+    }
+
+    // Stereo channels are written in pairs. One the bridge stopped feeding
+    // (nothing connected to the call) is padded with silence rather than
+    // letting the other side's ring overflow.
+    uint32_t count = (final || most - least > capacity / 2) ? most : least;
+    if (count == 0) {
+        return;
+    }
+
+    std::vector<int16_t> silence;
+    if (count > least) {
+        silence.assign(samples_per_frame, 0);
+    }
+
+    staging.clear();
+    for (uint32_t i = 0; i < count; i++) {
+        const int16_t* sources[2];
+        for (unsigned c = 0; c < channel_count; c++) {
+            if (i < available[c]) {
+                const uint8_t* frame = channels[c].ring.get() + (size_t)((read[c] + i) % capacity) * frame_bytes;
+                sources[c] = reinterpret_cast<const int16_t*>(frame);
+            } else {
+                sources[c] = silence.data();
+            }
+        }
+        encode(sources, channel_count, staging);
+    }
+
+    for (unsigned c = 0; c < channel_count; c++) {
+        channels[c].read.store(read[c] + std::min(count, available[c]), std::memory_order_release);
+    }
+
+    if (fwrite(staging.data(), 1, staging.size(), file) != staging.size()) {
+        write_errors.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    frames.fetch_add(count, std::memory_order_relaxed);
+    bytes.fetch_add(staging.size(), std::memory_order_relaxed);
+}
+
+bool PJSIPCallRecording::writeHeader() {
+    bool pcm = options.encoding == PJSIPRecordingEncoding::Pcm16;
+    uint16_t sample_bytes = pcm ? 2 : 1;
+    uint16_t block_align = (uint16_t)(sample_bytes * channel_count);
+    uint32_t fmt_size = pcm ? 16 : 18;
+    uint32_t header_size = 12 + (8 + fmt_size) + (pcm ? 0 : 12) + 8;
+
+    // The RIFF size fields are 32-bit, a longer recording is still playable
+    // by readers that trust the file size
+    uint64_t total_frames = frames.load(std::memory_order_relaxed);
+    uint64_t data_size = total_frames * samples_per_frame * block_align;
+    data_size = std::min<uint64_t>(data_size, UINT32_MAX - header_size);
+
+    std::vector<uint8_t> header;
+    header.reserve(header_size);
+    putTag(header, "RIFF");
+    putLE32(header, (uint32_t)(header_size - 8 + data_size));
+    putTag(header, "WAVE");
+
+    putTag(header, "fmt ");
+    putLE32(header, fmt_size);
+    putLE16(header, pcm ? WAV_FORMAT_PCM :
+                    options.encoding == PJSIPRecordingEncoding::Pcmu ? WAV_FORMAT_MULAW : WAV_FORMAT_ALAW);
+    putLE16(header, (uint16_t)channel_count);
+    putLE32(header, clock_rate);
+    putLE32(header, clock_rate * block_align);
+    putLE16(header, block_align);
+    putLE16(header, (uint16_t)(sample_bytes * 8));
+    if (!pcm) {
+        putLE16(header, 0);     // cbSize
+
+        // Non-PCM formats carry the sample count
+        putTag(header, "fact");
+        putLE32(header, 4);
+        putLE32(header, (uint32_t)std::min<uint64_t>(total_frames * samples_per_frame, UINT32_MAX));
+    }
+
+    putTag(header, "data");
+    putLE32(header, (uint32_t)data_size);
+
+    if (fwrite(header.data(), 1, header.size(), file) != header.size()) {
+        write_errors.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (bytes.load(std::memory_order_relaxed) == 0) {
+        bytes.store(header.size(), std::memory_order_relaxed);
+    }
+    return true;
+}
+
+// Writer thread, once the ports are detached and no more frames can arrive
+void PJSIPCallRecording::finish(std::vector<uint8_t>& staging) {
+    writeBatch(staging, true);
+    if (file == nullptr) {
+        return;
+    }
+
+    // Now that the length is known
+    if (fseek(file, 0, SEEK_SET) != 0) {
+        write_errors.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        writeHeader();
+    }
+    if (fflush(file) != 0 || (options.sync && !syncFile(file))) {
+        write_errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (fclose(file) != 0) {
+        write_errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    file = nullptr;
+}
+
+// PJSIPCallRecorder implementation
+PJSIPCallRecorder::PJSIPCallRecorder() : next_id(1), running(false), stop_pending(false) {
+}
+
+PJSIPCallRecorder::~PJSIPCallRecorder() {
+    clear();
+}
+
+int PJSIPCallRecorder::start(pjsua_call_id call_id, pjsua_conf_port_id call_slot, const std::string& path,
+                             const PJSIPRecordingOptions& options, unsigned clock_rate, unsigned samples_per_frame) {
+    unsigned ptime = std::max(samples_per_frame * 1000 / std::max(clock_rate, 1u), 1u);
+    unsigned buffer_ms = std::min(std::max(options.buffer_ms, WRITE_INTERVAL_MS * 2), MAX_BUFFER_MS);
+    unsigned capacity = std::max(buffer_ms / ptime, 2u);
+
+    PJSIPCallRecording* recording = new PJSIPCallRecording(call_id, options, clock_rate, samples_per_frame,
+                                                           capacity);
+    if (!recording->openFile(path)) {
+        recording->release();
+        return -1;
+    }
+
+    bool ready = true;
+    for (unsigned c = 0; c < recording->channel_count && ready; c++) {
+        ready = recording->addChannel(c);
+    }
+
+    // What the call receives goes to the first channel; whatever is connected
+    // to the call (what it sends) is mixed into the same one, or the second in stereo
+    pjsua_conf_port_id received = recording->channels[0].slot;
+    pjsua_conf_port_id sent = recording->channels[recording->channel_count - 1].slot;
+    if (ready) {
+        ready = pjsua_conf_connect(call_slot, received) == PJ_SUCCESS;
+    }
+    if (ready) {
+        pjsua_conf_port_id ports[PJSUA_MAX_CONF_PORTS];
+        unsigned count = PJ_ARRAY_SIZE(ports);
+        std::unique_ptr<pjsua_conf_port_info> port(new pjsua_conf_port_info);
+        if (pjsua_enum_conf_ports(ports, &count) == PJ_SUCCESS) {
+            for (unsigned i = 0; i < count; i++) {
+                if (ports[i] == call_slot || pjsua_conf_get_port_info(ports[i], port.get()) != PJ_SUCCESS) {
+                    continue;
+                }
+                for (unsigned l = 0; l < port->listener_cnt; l++) {
+                    if (port->listeners[l] == call_slot) {
+                        pjsua_conf_connect(ports[i], sent);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    if (!ready) {
+        PJW_LOG_ERROR("❌ Cannot attach the recorder to call %d", call_id);
+        recording->detach();
+        std::vector<uint8_t> staging;
+        recording->finish(staging);
+        remove(path.c_str());
+        recording->release();
+        return -1;
+    }
+
+    int recording_id;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        recording_id = next_id++;
+        recordings[recording_id] = Entry{ recording, call_slot };
+        if (!running) {
+            running = true;
+            writer = std::thread(&PJSIPCallRecorder::run, this);
+        }
+    }
+
+    PJW_LOG_INFO("⏺️ Recording call %d to %s (%s, %s)", call_id, path.c_str(), encodingName(options.encoding),
+                 options.stereo ? "stereo" : "mono");
+    return recording_id;
+}
+
+Napi::Value PJSIPCallRecorder::stop(Napi::Env env, int recording_id) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    // Already stopped with the call, the file is complete
+    auto done = finished.find(recording_id);
+    if (done != finished.end()) {
+        PJSIPRecordingStats result = done->second;
+        finished.erase(done);
+        lock.unlock();
+
+        Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+        deferred.Resolve(statsObject(env, result));
+        return deferred.Promise();
+    }
+
+    auto it = recordings.find(recording_id);
+    if (it == recordings.end()) {
+        return Napi::Value();
+    }
+    PJSIPCallRecording* recording = it->second.recording;
+
+    auto waiter = std::make_shared<PJSIPCallRecording::Waiter>(env);
+    waiter->settle = PJSIPJsCallback::create(env, "pjsip-recording");
+    recording->waiters.push_back(waiter);
+    bool detach = markStopping(recording);
+    stop_pending = true;
+    lock.unlock();
+
+    // Outside the mutex: removing a bridge port takes pjsua's locks
+    if (detach) {
+        recording->detach();
+    }
+    cv.notify_all();
+    return waiter->deferred.Promise();
+}
+
+bool PJSIPCallRecorder::stats(int recording_id, PJSIPRecordingStats& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto done = finished.find(recording_id);
+    if (done != finished.end()) {
+        out = done->second;
+        return true;
+    }
+    auto it = recordings.find(recording_id);
+    if (it == recordings.end()) {
+        return false;
+    }
+    fillStats(*it->second.recording, out);
+    return true;
+}
+
+// A new source for a recorded call is what the call now sends, so it is
+// recorded as well
+void PJSIPCallRecorder::onConnect(pjsua_conf_port_id source, pjsua_conf_port_id sink) {
+    std::vector<pjsua_conf_port_id> targets;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& entry : recordings) {
+            PJSIPCallRecording* recording = entry.second.recording;
+            if (entry.second.call_slot == sink && recording->state == PJSIPCallRecording::State::Recording) {
+                targets.push_back(recording->channels[recording->channel_count - 1].slot);
+            }
+        }
+    }
+
+    for (pjsua_conf_port_id target : targets) {
+        pjsua_conf_connect(source, target);
+    }
+}
+
+void PJSIPCallRecorder::onDisconnect(pjsua_conf_port_id source, pjsua_conf_port_id sink) {
+    std::vector<pjsua_conf_port_id> targets;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& entry : recordings) {
+            PJSIPCallRecording* recording = entry.second.recording;
+            if (entry.second.call_slot == sink && recording->state == PJSIPCallRecording::State::Recording) {
+                targets.push_back(recording->channels[recording->channel_count - 1].slot);
+            }
+        }
+    }
+
+    for (pjsua_conf_port_id target : targets) {
+        pjsua_conf_disconnect(source, target);
+    }
+}
+
+void PJSIPCallRecorder::onCallEnded(pjsua_call_id call_id) {
+    std::vector<PJSIPCallRecording*> detaching;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& entry : recordings) {
+            PJSIPCallRecording* recording = entry.second.recording;
+            if (recording->call_id == call_id && markStopping(recording)) {
+                detaching.push_back(recording);
+            }
+        }
+        if (detaching.empty()) {
+            return;
+        }
+        stop_pending = true;
+    }
+
+    // The entries hold their references until the writer has finished the files
+    for (PJSIPCallRecording* recording : detaching) {
+        recording->detach();
+    }
+    cv.notify_all();
+}
+
+void PJSIPCallRecorder::clear() {
+    std::vector<PJSIPCallRecording*> detaching;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running && recordings.empty()) {
+            return;
+        }
+        for (const auto& entry : recordings) {
+            if (markStopping(entry.second.recording)) {
+                detaching.push_back(entry.second.recording);
+            }
+        }
+        running = false;
+    }
+
+    for (PJSIPCallRecording* recording : detaching) {
+        recording->detach();
+    }
+
+    // The writer finishes every file on its way out
+    cv.notify_all();
+    if (writer.joinable()) {
+        writer.join();
+    }
+
+    std::map<int, Entry> remaining;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        remaining.swap(recordings);
+        finished.clear();
+    }
+    for (const auto& entry : remaining) {
+        entry.second.recording->release();
+    }
+}
+
+bool PJSIPCallRecorder::markStopping(PJSIPCallRecording* recording) {
+    if (recording->state != PJSIPCallRecording::State::Recording) {
+        return false;
+    }
+    recording->closed.store(true, std::memory_order_release);
+    recording->state = PJSIPCallRecording::State::Stopping;
+    return true;
+}
+
+void PJSIPCallRecorder::fillStats(const PJSIPCallRecording& recording, PJSIPRecordingStats& out) const {
+    out.call_id = recording.call_id;
+    out.stereo = recording.channel_count == 2;
+    out.encoding = recording.options.encoding;
+    out.finished = recording.state == PJSIPCallRecording::State::Finished;
+    out.frames = recording.frames.load(std::memory_order_relaxed);
+    out.dropped = recording.dropped.load(std::memory_order_relaxed);
+    out.bytes = recording.bytes.load(std::memory_order_relaxed);
+    out.write_errors = recording.write_errors.load(std::memory_order_relaxed);
+    out.max_queued = recording.max_queued.load(std::memory_order_relaxed);
+    out.clock_rate = recording.clock_rate;
+    out.ptime = recording.samples_per_frame * 1000 / std::max(recording.clock_rate, 1u);
+}
+
+Napi::Object PJSIPCallRecorder::statsObject(Napi::Env env, const PJSIPRecordingStats& stats) {
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("callId", Napi::Number::New(env, stats.call_id));
+    result.Set("stereo", Napi::Boolean::New(env, stats.stereo));
+    result.Set("encoding", Napi::String::New(env, encodingName(stats.encoding)));
+    result.Set("finished", Napi::Boolean::New(env, stats.finished));
+    result.Set("frames", Napi::Number::New(env, (double)stats.frames));
+    result.Set("durationMs", Napi::Number::New(env, (double)stats.frames * stats.ptime));
+    result.Set("dropped", Napi::Number::New(env, (double)stats.dropped));
+    result.Set("bytes", Napi::Number::New(env, (double)stats.bytes));
+    result.Set("writeErrors", Napi::Number::New(env, stats.write_errors));
+    result.Set("maxQueued", Napi::Number::New(env, stats.max_queued));
+    result.Set("clockRate", Napi::Number::New(env, stats.clock_rate));
+    result.Set("ptime", Napi::Number::New(env, stats.ptime));
+    return result;
+}
+
+// Writer thread. Plain file I/O only, never calls into pjsua, so it does not
+// need to be registered with pjlib.
+void PJSIPCallRecorder::run() {
+    struct Pending {
+        int id;
+        PJSIPCallRecording* recording;
+        bool stopping;
+    };
+    std::vector<Pending> batch;
+    std::vector<uint8_t> staging;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        cv.wait_for(lock, std::chrono::milliseconds(WRITE_INTERVAL_MS), [this] { return !running || stop_pending; });
+        bool last = !running;
+        stop_pending = false;
+
+        batch.clear();
+        for (const auto& entry : recordings) {
+            PJSIPCallRecording* recording = entry.second.recording;
+            if (recording->state != PJSIPCallRecording::State::Finished) {
+                batch.push_back({ entry.first, recording, recording->state == PJSIPCallRecording::State::Stopping });
+            }
+        }
+
+        // Finished entries are only collected under the mutex, so the rest
+        // stay valid while the disk is busy
+        lock.unlock();
+        for (const Pending& pending : batch) {
+            if (pending.stopping) {
+                pending.recording->finish(staging);
+            } else {
+                pending.recording->writeBatch(staging, false);
+            }
+        }
+        lock.lock();
+
+        for (const Pending& pending : batch) {
+            if (!pending.stopping) {
+                continue;
+            }
+            PJSIPCallRecording* recording = pending.recording;
+            recording->state = PJSIPCallRecording::State::Finished;
+
+            PJSIPRecordingStats result;
+            fillStats(*recording, result);
+            if (recording->waiters.empty()) {
+                // Stopped with the call: only the stats wait for stopRecording()
+                finished[pending.id] = result;
+                if (finished.size() > MAX_FINISHED) {
+                    finished.erase(finished.begin());   // ids only grow, this is the oldest
+                }
+            }
+            for (const auto& waiter : recording->waiters) {
+                auto keep = waiter;
+                waiter->settle->call([keep, result](Napi::Env env, Napi::Function) {
+                    keep->deferred.Resolve(statsObject(env, result));
+                });
+                waiter->settle->release();
+            }
+            recording->waiters.clear();
+            recordings.erase(pending.id);
+            recording->release();
+        }
+
+        if (last) {
+            break;
+        }
+    }
+}
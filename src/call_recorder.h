@@ -0,0 +1,190 @@
+#ifndef NODE_PJSIP_CALL_RECORDER_H
+#define NODE_PJSIP_CALL_RECORDER_H
+
+#include <napi.h>
+#include <pjsua-lib/pjsua.h>
+
+#include "js_callback.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class PJSIPRecordingEncoding {
+    Pcm16,      // 16-bit linear
+    Pcmu,       // G.711 mu-law, half the bytes
+    Pcma        // G.711 A-law
+};
+
+struct PJSIPRecordingOptions {
+    bool stereo;                        // left: what the call receives, right: what is sent to it
+    PJSIPRecordingEncoding encoding;
+    unsigned buffer_ms;                 // per channel, the longest disk stall absorbed without loss
+    bool sync;                          // fsync the file before stop resolves
+
+    PJSIPRecordingOptions();
+};
+
+struct PJSIPRecordingStats {
+    pjsua_call_id call_id;
+    bool stereo;
+    PJSIPRecordingEncoding encoding;
+    bool finished;                      // file complete, closed and (with sync) on disk
+    uint64_t frames;                    // frames per channel in the file
+    uint64_t dropped;                   // frames lost because the writer fell behind
+    uint64_t bytes;                     // file size
+    uint32_t write_errors;
+    uint32_t max_queued;                // deepest a channel ring got, frames
+    unsigned clock_rate;
+    unsigned ptime;                     // ms per frame
+};
+
+// One recorded call: a bridge port per channel whose put_frame copies the
+// frame into that channel's single-producer/single-consumer ring, nothing
+// else. The file is only touched by the writer thread. Lifetime is
+// reference counted between the recorder's table and the channel ports,
+// whose group locks keep them alive until the bridge has let go.
+class PJSIPCallRecording {
+public:
+    PJSIPCallRecording(const PJSIPCallRecording&) = delete;
+    PJSIPCallRecording& operator=(const PJSIPCallRecording&) = delete;
+
+private:
+    friend class PJSIPCallRecorder;
+
+    enum class State { Recording, Stopping, Finished };
+
+    struct Waiter {
+        Napi::Promise::Deferred deferred;
+        std::shared_ptr<PJSIPJsCallback> settle;
+
+        explicit Waiter(Napi::Env env) : deferred(Napi::Promise::Deferred::New(env)) {}
+    };
+
+    struct Channel {
+        PJSIPCallRecording* owner;
+        pjmedia_port port;
+        pj_pool_t* pool;
+        pjsua_conf_port_id slot;
+        std::unique_ptr<uint8_t[]> ring;
+        std::atomic<uint32_t> write;    // bridge thread
+        std::atomic<uint32_t> read;     // writer thread
+    };
+
+    PJSIPCallRecording(pjsua_call_id call_id, const PJSIPRecordingOptions& options, unsigned clock_rate,
+                       unsigned samples_per_frame, unsigned capacity);
+    ~PJSIPCallRecording();
+
+    bool openFile(const std::string& path);
+    bool addChannel(unsigned index);
+    void detach();
+    void release();
+
+    static pj_status_t onPutFrame(pjmedia_port* port, pjmedia_frame* frame);
+    static pj_status_t onGetFrame(pjmedia_port* port, pjmedia_frame* frame);
+    static pj_status_t onDestroy(pjmedia_port* port);
+
+    // Writer thread
+    void writeBatch(std::vector<uint8_t>& staging, bool final);
+    void finish(std::vector<uint8_t>& staging);
+    void encode(const int16_t* const* frames, unsigned channel_count, std::vector<uint8_t>& out) const;
+    bool writeHeader();
+
+    pjsua_call_id call_id;
+    PJSIPRecordingOptions options;
+    unsigned clock_rate;
+    unsigned samples_per_frame;
+    unsigned frame_bytes;
+    unsigned capacity;                  // frames per ring
+    Channel channels[2];
+    unsigned channel_count;
+    std::atomic<int> refs;
+    std::atomic<bool> closed;           // put_frame stops writing
+    State state;                        // recorder mutex
+    FILE* file;
+
+    std::atomic<uint64_t> frames;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint32_t> write_errors;
+    std::atomic<uint32_t> max_queued;
+
+    // stopRecording() promises, settled by the writer once the file is done
+    std::vector<std::shared_ptr<Waiter>> waiters;
+};
+
+// Native call recording on one writer thread.
+//
+// The bridge clock thread never blocks on storage: frames go into per-call
+// rings in memory, and every WRITE_INTERVAL_MS the writer drains every
+// recording, encodes it and issues one sequential write per file, so
+// hundreds of recordings cost a few large writes per interval instead of one
+// small write per frame on the media clock. A ring that fills up while the
+// disk stalls drops frames and counts them.
+//
+// Stereo recordings have the call's own audio on the left and on the right
+// whatever is connected to the call, followed through connectMedia() and
+// disconnectMedia(). Recordings stop by themselves when the call ends and
+// their rings and ports go as soon as the file is done; the final stats stay
+// until stopRecording() collects them, for the newest MAX_FINISHED of them.
+class PJSIPCallRecorder {
+public:
+    static const unsigned WRITE_INTERVAL_MS = 200;
+    static const unsigned DEFAULT_BUFFER_MS = 2000;
+    static const unsigned MAX_BUFFER_MS = 60000;
+    static const size_t MAX_FINISHED = 1024;
+
+    PJSIPCallRecorder();
+    ~PJSIPCallRecorder();
+
+    PJSIPCallRecorder(const PJSIPCallRecorder&) = delete;
+    PJSIPCallRecorder& operator=(const PJSIPCallRecorder&) = delete;
+
+    // JS thread - returns the recording id, -1 on failure
+    int start(pjsua_call_id call_id, pjsua_conf_port_id call_slot, const std::string& path,
+              const PJSIPRecordingOptions& options, unsigned clock_rate, unsigned samples_per_frame);
+
+    // JS thread - resolves with the final stats once the file is complete,
+    // an empty value for an unknown id
+    Napi::Value stop(Napi::Env env, int recording_id);
+    bool stats(int recording_id, PJSIPRecordingStats& out);
+
+    // Bridge connections made through the wrapper, JS thread
+    void onConnect(pjsua_conf_port_id source, pjsua_conf_port_id sink);
+    void onDisconnect(pjsua_conf_port_id source, pjsua_conf_port_id sink);
+
+    // Any thread, from on_call_state
+    void onCallEnded(pjsua_call_id call_id);
+
+    // Shutdown - finishes every file and stops the writer
+    void clear();
+
+    static Napi::Object statsObject(Napi::Env env, const PJSIPRecordingStats& stats);
+
+private:
+    struct Entry {
+        PJSIPCallRecording* recording;
+        pjsua_conf_port_id call_slot;
+    };
+
+    void run();
+    bool markStopping(PJSIPCallRecording* recording);     // mutex held, true if it still has to be detached
+    void fillStats(const PJSIPCallRecording& recording, PJSIPRecordingStats& out) const;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::map<int, Entry> recordings;
+    std::map<int, PJSIPRecordingStats> finished;    // stopped with the call, not collected yet
+    int next_id;
+    std::thread writer;
+    bool running;
+    bool stop_pending;
+};
+
+#endif
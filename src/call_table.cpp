@@ -0,0 +1,151 @@
+#include "call_table.h"
+
+// PJSIPCallTable implementation
+PJSIPCallTable::PJSIPCallTable() : slots(new Slot[PJSUA_MAX_CALLS]), active_count(0), peak_count(0),
+    total_count(0) {
+}
+
+void PJSIPCallTable::activate(PJSIPCallRecord& record, pjsua_call_id call_id, double now) {
+    record = PJSIPCallRecord();
+    record.call_id = call_id;
+    record.acc_id = PJSUA_INVALID_ID;
+    record.state = PJSIP_INV_STATE_NULL;
+    record.media_status = PJSUA_CALL_MEDIA_NONE;
+    record.active = 1;
+    record.created_us = now;
+    record.updated_us = now;
+
+    uint32_t active = active_count.fetch_add(1, std::memory_order_relaxed) + 1;
+    uint32_t peak = peak_count.load(std::memory_order_relaxed);
+    while (active > peak && !peak_count.compare_exchange_weak(peak, active, std::memory_order_relaxed)) {
+    }
+    total_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PJSIPCallTable::open(pjsua_call_id call_id, pjsua_acc_id acc_id, PJSIPCallDirection direction,
+                          const std::string& remote_uri) {
+    if (!isValidId(call_id)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(writers[call_id % WRITER_STRIPES]);
+    Slot& slot = slots[call_id];
+
+    PJSIPCallRecord record = slot.record.load();
+    if (!record.active) {
+        return;
+    }
+    record.acc_id = acc_id;
+    record.direction = (int32_t)direction;
+    slot.record.store(record);
+
+    std::atomic_store(&slot.remote_uri, std::make_shared<const std::string>(remote_uri));
+}
+
+bool PJSIPCallTable::update(const PJSIPEvent& event) {
+    if (!isValidId(event.call_id)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(writers[event.call_id % WRITER_STRIPES]);
+    Slot& slot = slots[event.call_id];
+
+    PJSIPCallRecord record = slot.record.load();
+    bool opened = !record.active;
+    if (opened) {
+        if (event.state == PJSIP_INV_STATE_DISCONNECTED) {
+            return false; // late callback for a call we already closed
+        }
+        activate(record, event.call_id, event.timestamp_us);
+        std::atomic_store(&slot.remote_uri, std::shared_ptr<const std::string>());
+        // The remote offer of an incoming call is already here and stays;
+        // a local body left from before belongs to no call
+        std::atomic_store(&slot.sdp[(int)PJSIPSdpSide::Local], std::shared_ptr<const std::string>());
+    }
+
+    record.acc_id = event.acc_id;
+    record.state = event.state;
+    record.status_code = event.status_code;
+    record.media_status = event.media_status;
+    record.state_changes++;
+    record.updated_us = event.timestamp_us;
+
+    if (event.state == PJSIP_INV_STATE_CONFIRMED && record.connected_us == 0) {
+        record.connected_us = event.timestamp_us;
+    } else if (event.state == PJSIP_INV_STATE_DISCONNECTED) {
+        record.disconnected_us = event.timestamp_us;
+        record.active = 0;
+        active_count.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    slot.record.store(record);
+    return opened;
+}
+
+void PJSIPCallTable::clear() {
+    for (pjsua_call_id call_id = 0; call_id < (pjsua_call_id)PJSUA_MAX_CALLS; call_id++) {
+        std::lock_guard<std::mutex> lock(writers[call_id % WRITER_STRIPES]);
+        slots[call_id].record.store(PJSIPCallRecord());
+        std::atomic_store(&slots[call_id].remote_uri, std::shared_ptr<const std::string>());
+    }
+    for (pjsua_call_id call_id = 0; call_id < (pjsua_call_id)PJSUA_MAX_CALLS; call_id++) {
+        releaseSdp(call_id);
+    }
+    active_count.store(0, std::memory_order_relaxed);
+}
+
+void PJSIPCallTable::setSdp(pjsua_call_id call_id, PJSIPSdpSide side, std::shared_ptr<const std::string> sdp) {
+    if (!isValidId(call_id)) {
+        return;
+    }
+    std::atomic_store(&slots[call_id].sdp[(int)side], std::move(sdp));
+}
+
+void PJSIPCallTable::releaseSdp(pjsua_call_id call_id) {
+    setSdp(call_id, PJSIPSdpSide::Local, nullptr);
+    setSdp(call_id, PJSIPSdpSide::Remote, nullptr);
+}
+
+bool PJSIPCallTable::get(pjsua_call_id call_id, PJSIPCallRecord& record) const {
+    if (!isValidId(call_id)) {
+        return false;
+    }
+    record = slots[call_id].record.load();
+    return record.active != 0;
+}
+
+std::shared_ptr<const std::string> PJSIPCallTable::getRemoteUri(pjsua_call_id call_id) const {
+    if (!isValidId(call_id)) {
+        return nullptr;
+    }
+    return std::atomic_load(&slots[call_id].remote_uri);
+}
+
+std::shared_ptr<const std::string> PJSIPCallTable::getSdp(pjsua_call_id call_id, PJSIPSdpSide side) const {
+    if (!isValidId(call_id)) {
+        return nullptr;
+    }
+    return std::atomic_load(&slots[call_id].sdp[(int)side]);
+}
+
+size_t PJSIPCallTable::snapshot(std::vector<PJSIPCallRecord>& out) const {
+    out.clear();
+    out.reserve(active_count.load(std::memory_order_relaxed));
+
+    for (pjsua_call_id call_id = 0; call_id < (pjsua_call_id)PJSUA_MAX_CALLS; call_id++) {
+        PJSIPCallRecord record = slots[call_id].record.load();
+        if (record.active) {
+            out.push_back(record);
+        }
+    }
+    return out.size();
+}
+
+PJSIPCallTableStats PJSIPCallTable::stats() const {
+    PJSIPCallTableStats result;
+    result.active = active_count.load(std::memory_order_relaxed);
+    result.capacity = PJSUA_MAX_CALLS;
+    result.peak = peak_count.load(std::memory_order_relaxed);
+    result.total = total_count.load(std::memory_order_relaxed);
+    return result;
+}
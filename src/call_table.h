@@ -0,0 +1,113 @@
+#ifndef NODE_PJSIP_CALL_TABLE_H
+#define NODE_PJSIP_CALL_TABLE_H
+
+#include <pjsua-lib/pjsua.h>
+
+#include "event_queue.h"
+#include "seqlock.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class PJSIPCallDirection : int32_t {
+    Unknown = 0,
+    Outgoing = 1,
+    Incoming = 2
+};
+
+// Per-call record, copied out verbatim by getCalls(). Layout is shared with
+// src/index.ts and lib/index.js: 8 int32 slots followed by 4 float64 slots.
+struct PJSIPCallRecord {
+    int32_t call_id;
+    int32_t acc_id;
+    int32_t state;              // pjsip_inv_state
+    int32_t status_code;        // last SIP status code
+    int32_t media_status;       // pjsua_call_media_status
+    int32_t direction;          // PJSIPCallDirection
+    int32_t state_changes;      // callbacks seen for this call
+    int32_t active;             // 0 once disconnected
+    double created_us;          // pjsipMonotonicMicros() timestamps, 0 = not yet
+    double connected_us;
+    double disconnected_us;
+    double updated_us;
+};
+
+static_assert(sizeof(PJSIPCallRecord) == 64, "PJSIPCallRecord layout is shared with JS");
+
+// Which side of the offer/answer an SDP body belongs to
+enum class PJSIPSdpSide {
+    Local = 0,      // what we send, set by the application in signalling-only mode
+    Remote = 1      // last body received from the peer
+};
+
+// Table-wide counters
+struct PJSIPCallTableStats {
+    uint32_t active;
+    uint32_t capacity;
+    uint32_t peak;
+    uint64_t total;             // calls opened since init
+};
+
+// Fixed-capacity call registry indexed by pjsua_call_id.
+//
+// Records sit behind a seqlock per slot so getCalls() copies the whole table
+// in one pass without locking out PJSIP threads. The remote URI and SDP
+// bodies are published RCU-style like account records. Writers for the same slot are serialized
+// by a striped mutex, since a callback and makeCall() may race on a new call.
+class PJSIPCallTable {
+public:
+    PJSIPCallTable();
+
+    PJSIPCallTable(const PJSIPCallTable&) = delete;
+    PJSIPCallTable& operator=(const PJSIPCallTable&) = delete;
+
+    // Called from PJSIP callbacks with the event record already filled in.
+    // Returns true when the event opened the record.
+    bool update(const PJSIPEvent& event);
+
+    // Fills in what events do not carry, right after the update() that opened
+    // the record and in the same callback, so the call cannot have ended in
+    // between. Never brings back a closed record.
+    void open(pjsua_call_id call_id, pjsua_acc_id acc_id, PJSIPCallDirection direction,
+              const std::string& remote_uri);
+
+    void clear();
+
+    // SDP bodies outlive activation: the remote offer of an incoming call is
+    // seen before its first state callback. Released when the call ends.
+    void setSdp(pjsua_call_id call_id, PJSIPSdpSide side, std::shared_ptr<const std::string> sdp);
+    void releaseSdp(pjsua_call_id call_id);
+
+    // Lock-free readers
+    bool get(pjsua_call_id call_id, PJSIPCallRecord& record) const;
+    std::shared_ptr<const std::string> getRemoteUri(pjsua_call_id call_id) const;
+    std::shared_ptr<const std::string> getSdp(pjsua_call_id call_id, PJSIPSdpSide side) const;
+    size_t snapshot(std::vector<PJSIPCallRecord>& out) const;
+    PJSIPCallTableStats stats() const;
+
+    static bool isValidId(pjsua_call_id call_id) {
+        return call_id >= 0 && call_id < (pjsua_call_id)PJSUA_MAX_CALLS;
+    }
+
+private:
+    static const size_t WRITER_STRIPES = 64;
+
+    struct Slot {
+        PJSIPSeqLock<PJSIPCallRecord> record;
+        std::shared_ptr<const std::string> remote_uri;  // atomic_load/atomic_store only
+        std::shared_ptr<const std::string> sdp[2];      // by PJSIPSdpSide, same rules
+    };
+
+    void activate(PJSIPCallRecord& record, pjsua_call_id call_id, double now);
+
+    std::unique_ptr<Slot[]> slots;
+    mutable std::mutex writers[WRITER_STRIPES];
+    std::atomic<uint32_t> active_count;
+    std::atomic<uint32_t> peak_count;
+    std::atomic<uint64_t> total_count;
+};
+
+#endif
@@ -0,0 +1,164 @@
+#include "codec_control.h"
+
+#include <pjsua-lib/pjsua_internal.h>
+
+#include <algorithm>
+#include <memory>
+
+// pjsua's own codec id format, so ids read back can be fed to setPriority()
+static std::string codecId(const pjmedia_codec_info& info) {
+    std::string id(info.encoding_name.ptr, info.encoding_name.slen);
+    id += "/" + std::to_string(info.clock_rate) + "/" + std::to_string(info.channel_cnt);
+    return id;
+}
+
+// PJSIPCodecControl implementation
+PJSIPCodecControl::PJSIPCodecControl(const PJSIPCallTable* calls) : calls(calls) {
+}
+
+bool PJSIPCodecControl::list(std::vector<PJSIPCodecInfo>& out) const {
+    pjsua_codec_info codecs[PJMEDIA_CODEC_MGR_MAX_CODECS];
+    unsigned count = PJ_ARRAY_SIZE(codecs);
+    if (pjsua_enum_codecs(codecs, &count) != PJ_SUCCESS) {
+        return false;
+    }
+
+    out.clear();
+    out.reserve(count);
+    for (unsigned i = 0; i < count; i++) {
+        PJSIPCodecInfo info = PJSIPCodecInfo();
+        info.id.assign(codecs[i].codec_id.ptr, codecs[i].codec_id.slen);
+        info.description.assign(codecs[i].desc.ptr, codecs[i].desc.slen);
+        info.priority = codecs[i].priority;
+
+        pjmedia_codec_param param;
+        if (pjsua_codec_get_param(&codecs[i].codec_id, &param) == PJ_SUCCESS) {
+            info.clock_rate = param.info.clock_rate;
+            info.channels = param.info.channel_cnt;
+            info.avg_bps = param.info.avg_bps;
+            info.payload_type = param.info.pt;
+            info.ptime = (unsigned)param.info.frm_ptime * std::max<unsigned>(param.setting.frm_per_pkt, 1);
+            info.vad = param.setting.vad != 0;
+            info.plc = param.setting.plc != 0;
+            info.cng = param.setting.cng != 0;
+            info.penh = param.setting.penh != 0;
+        }
+        out.push_back(std::move(info));
+    }
+    return true;
+}
+
+bool PJSIPCodecControl::setPriority(const std::string& id, unsigned priority) {
+    // The codec manager treats the id as a prefix, so "" matches them all
+    pj_str_t codec_id = pj_str((char*)(id == "*" ? "" : id.c_str()));
+    return pjsua_codec_set_priority(&codec_id, (pj_uint8_t)std::min(priority, 255u)) == PJ_SUCCESS;
+}
+
+bool PJSIPCodecControl::setParams(const std::string& id, const PJSIPCodecParams& params) {
+    pj_str_t codec_id = pj_str((char*)id.c_str());
+    pjmedia_codec_param param;
+    if (pjsua_codec_get_param(&codec_id, &param) != PJ_SUCCESS) {
+        return false;
+    }
+
+    // Packets carry whole codec frames
+    if (params.ptime > 0 && param.info.frm_ptime > 0) {
+        unsigned frames = ((unsigned)params.ptime + param.info.frm_ptime / 2) / param.info.frm_ptime;
+        param.setting.frm_per_pkt = (pj_uint8_t)std::min(std::max(frames, 1u), 255u);
+    }
+    if (params.vad >= 0) {
+        param.setting.vad = params.vad ? 1 : 0;
+    }
+    if (params.plc >= 0) {
+        param.setting.plc = params.plc ? 1 : 0;
+    }
+    if (params.cng >= 0) {
+        param.setting.cng = params.cng ? 1 : 0;
+    }
+    if (params.penh >= 0) {
+        param.setting.penh = params.penh ? 1 : 0;
+    }
+    return pjsua_codec_set_param(&codec_id, &param) == PJ_SUCCESS;
+}
+
+bool PJSIPCodecControl::callCodec(pjsua_call_id call_id, unsigned bridge_clock_rate, PJSIPCallCodec& out) const {
+    if (!PJSIPCallTable::isValidId(call_id)) {
+        return false;
+    }
+
+    // info.param and the encoding name point into the stream's pool, which a
+    // hangup or re-INVITE frees; pjsua_call_get_stream_info() takes PJSUA_LOCK
+    // as media teardown does, so hold it until everything is copied out.
+    // Nothing here takes a dialog lock, which pjsua orders before this one.
+    PJSUA_LOCK();
+    int media_index = pjsua_var.calls[call_id].audio_idx;
+    pjsua_stream_info stream;
+    if (media_index < 0 || pjsua_call_get_stream_info(call_id, (unsigned)media_index, &stream) != PJ_SUCCESS ||
+        stream.type != PJMEDIA_TYPE_AUDIO) {
+        PJSUA_UNLOCK();
+        return false;
+    }
+    const pjmedia_stream_info& info = stream.info.aud;
+
+    out.id = codecId(info.fmt);
+    out.clock_rate = info.fmt.clock_rate;
+    out.channels = info.fmt.channel_cnt;
+    out.payload_type = info.fmt.pt;
+    out.ptime = 0;
+    out.vad = false;
+    if (info.param) {
+        out.ptime = (unsigned)info.param->info.frm_ptime * std::max<unsigned>(info.param->setting.frm_per_pkt, 1);
+        out.vad = info.param->setting.vad != 0;
+    }
+    PJSUA_UNLOCK();
+
+    out.resampled = out.clock_rate != bridge_clock_rate;
+    return true;
+}
+
+void PJSIPCodecControl::usage(unsigned bridge_clock_rate, PJSIPCodecUsage& out) {
+    out.bridge_clock_rate = bridge_clock_rate;
+    out.streams = 0;
+    out.resampled = 0;
+    out.connections = 0;
+    out.transcoded = 0;
+    out.by_codec.clear();
+
+    // Codec of every bridged call, by conference slot
+    std::lock_guard<std::mutex> lock(usage_mutex);
+    std::map<pjsua_conf_port_id, std::string> slot_codecs;
+    calls->snapshot(active_calls);
+    for (const PJSIPCallRecord& call : active_calls) {
+        if (call.media_status != PJSUA_CALL_MEDIA_ACTIVE) {
+            continue;
+        }
+        PJSIPCallCodec codec;
+        if (!callCodec(call.call_id, bridge_clock_rate, codec)) {
+            continue;
+        }
+        out.streams++;
+        out.resampled += codec.resampled ? 1 : 0;
+        out.by_codec[codec.id]++;
+
+        pjsua_conf_port_id slot = pjsua_call_get_conf_port(call.call_id);
+        if (slot != PJSUA_INVALID_ID) {
+            slot_codecs[slot] = codec.id;
+        }
+    }
+
+    // Large enough that one per call would not belong on the stack
+    std::unique_ptr<pjsua_conf_port_info> port(new pjsua_conf_port_info);
+    for (const auto& source : slot_codecs) {
+        if (pjsua_conf_get_port_info(source.first, port.get()) != PJ_SUCCESS) {
+            continue;
+        }
+        for (unsigned i = 0; i < port->listener_cnt; i++) {
+            auto sink = slot_codecs.find(port->listeners[i]);
+            if (sink == slot_codecs.end()) {
+                continue;   // players, recorders, taps, the sound device
+            }
+            out.connections++;
+            out.transcoded += sink->second != source.second ? 1 : 0;
+        }
+    }
+}
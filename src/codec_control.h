@@ -0,0 +1,86 @@
+#ifndef NODE_PJSIP_CODEC_CONTROL_H
+#define NODE_PJSIP_CODEC_CONTROL_H
+
+#include <pjsua-lib/pjsua.h>
+
+#include "call_table.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// One registered codec with its default parameters
+struct PJSIPCodecInfo {
+    std::string id;             // "PCMU/8000/1", as pjsua names it
+    std::string description;
+    unsigned priority;          // 0 = disabled
+    unsigned clock_rate;
+    unsigned channels;
+    unsigned avg_bps;
+    unsigned payload_type;
+    unsigned ptime;             // frame length times frames per packet, ms
+    bool vad;
+    bool plc;
+    bool cng;
+    bool penh;
+};
+
+// Codec defaults to change, negative values keep the current setting
+struct PJSIPCodecParams {
+    int ptime;
+    int vad;
+    int plc;
+    int cng;
+    int penh;
+
+    PJSIPCodecParams() : ptime(-1), vad(-1), plc(-1), cng(-1), penh(-1) {}
+};
+
+// What a call's audio stream ended up with after negotiation
+struct PJSIPCallCodec {
+    std::string id;
+    unsigned clock_rate;
+    unsigned channels;
+    unsigned payload_type;
+    unsigned ptime;
+    bool vad;
+    bool resampled;             // clock differs from the bridge's
+};
+
+// Bridge-wide cost of the codecs in use. The bridge decodes every stream to
+// PCM at its own clock, so a connection between two calls on different
+// codecs pays for a full decode/encode pair (plus resampling when the clocks
+// differ), while same-codec legs at the bridge clock are the cheapest case.
+struct PJSIPCodecUsage {
+    unsigned bridge_clock_rate;
+    unsigned streams;           // calls with active audio
+    unsigned resampled;         // of which not at the bridge clock
+    unsigned connections;       // directed call-to-call bridge connections
+    unsigned transcoded;        // of which between different codecs
+    std::map<std::string, unsigned> by_codec;
+};
+
+// Codec priorities and parameters go straight to pjsua's codec manager;
+// per-call reports read the negotiated stream info and the bridge's
+// connection table. Called from the JS thread of any env.
+class PJSIPCodecControl {
+public:
+    explicit PJSIPCodecControl(const PJSIPCallTable* calls);
+
+    bool list(std::vector<PJSIPCodecInfo>& out) const;
+
+    // "*" or a prefix like "speex" changes every matching codec, 0 disables
+    bool setPriority(const std::string& id, unsigned priority);
+    bool setParams(const std::string& id, const PJSIPCodecParams& params);
+
+    bool callCodec(pjsua_call_id call_id, unsigned bridge_clock_rate, PJSIPCallCodec& out) const;
+    void usage(unsigned bridge_clock_rate, PJSIPCodecUsage& out);
+
+private:
+    const PJSIPCallTable* calls;
+    std::mutex usage_mutex;
+    std::vector<PJSIPCallRecord> active_calls;  // usage() scratch, usage_mutex
+};
+
+#endif
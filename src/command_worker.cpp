@@ -0,0 +1,187 @@
+#include "command_worker.h"
+#include "pj_thread_util.h"
+
+#include <pjsua-lib/pjsua.h>
+#include <pjsua-lib/pjsua_internal.h>
+
+#include <algorithm>
+#include <string>
+
+// PJSIPCommand implementation
+PJSIPCommand::PJSIPCommand(Napi::Env env, const char* name, PJSIPCommandLock lock, bool returns_bool,
+                           std::function<int()> run)
+    : name(name), lock(lock), returns_bool(returns_bool), run(std::move(run)),
+      deferred(Napi::Promise::Deferred::New(env)), result(-1) {
+}
+
+// PJSIPCommandWorker implementation
+PJSIPCommandWorker::PJSIPCommandWorker()
+    : outstanding(0), batch_count(0), generation(0), running(false), tsfn_open(false) {
+}
+
+PJSIPCommandWorker::~PJSIPCommandWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    cv.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+Napi::Promise PJSIPCommandWorker::submit(Napi::Env env, std::shared_ptr<PJSIPCommand> command) {
+    Napi::Promise promise = command->deferred.Promise();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!running) {
+        uint32_t for_generation = ++generation;
+        tsfn = Napi::ThreadSafeFunction::New(env, Napi::Function::New(env, [](const Napi::CallbackInfo&) {}),
+                                             "PJSIPCommandWorker", 0, 1,
+                                             [this, for_generation](Napi::Env) { onFinalize(for_generation); });
+        tsfn_open = true;
+        tsfn.Unref(env);
+        running = true;
+        worker = std::thread(&PJSIPCommandWorker::run, this);
+    }
+
+    // Hold the event loop open only while promises are pending
+    if (outstanding++ == 0) {
+        tsfn.Ref(env);
+    }
+
+    queue.push_back(std::move(command));
+    cv.notify_one();
+    return promise;
+}
+
+void PJSIPCommandWorker::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+        generation++;
+    }
+    cv.notify_all();
+    worker.join();
+
+    // Batches already executed are still settled through the released
+    // function; anything never started is rejected here
+    std::deque<std::shared_ptr<PJSIPCommand>> abandoned;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        abandoned.swap(queue);
+    }
+    for (auto& command : abandoned) {
+        Napi::Env env = command->deferred.Env();
+        command->deferred.Reject(Napi::Error::New(env, std::string(command->name) +
+                                                  " cancelled, PJSIP is shutting down").Value());
+    }
+
+    outstanding = 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (tsfn_open) {
+        tsfn_open = false;
+        tsfn.Release();
+    }
+}
+
+// Node closes the function itself on env teardown, before the worker is
+// stopped; from then on batches are executed but can no longer be settled
+void PJSIPCommandWorker::onFinalize(uint32_t for_generation) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (for_generation == generation) {
+        tsfn_open = false;
+    }
+}
+
+size_t PJSIPCommandWorker::pending() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queue.size();
+}
+
+void PJSIPCommandWorker::run() {
+    for (;;) {
+        auto batch = std::make_shared<std::vector<std::shared_ptr<PJSIPCommand>>>();
+        uint32_t batch_generation;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this] { return !running || !queue.empty(); });
+            if (!running) {
+                break;
+            }
+            // An exclusive command closes the batch before it and gets one of its own
+            while (!queue.empty() && batch->size() < MAX_BATCH) {
+                bool exclusive = queue.front()->lock == PJSIPCommandLock::Exclusive;
+                if (exclusive && !batch->empty()) {
+                    break;
+                }
+                batch->push_back(std::move(queue.front()));
+                queue.pop_front();
+                if (exclusive) {
+                    break;
+                }
+            }
+            batch_generation = generation;
+        }
+
+        execute(*batch);
+        batch_count++;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!tsfn_open) {
+            continue;
+        }
+        tsfn.NonBlockingCall([this, batch, batch_generation](Napi::Env env, Napi::Function) {
+            settle(env, *batch);
+            if (batch_generation != generation) {
+                return; // settled after stop(), the function is gone
+            }
+            outstanding -= std::min(outstanding, batch->size());
+            if (outstanding == 0) {
+                tsfn.Unref(env);
+            }
+        });
+    }
+}
+
+void PJSIPCommandWorker::execute(std::vector<std::shared_ptr<PJSIPCommand>>& batch) {
+    size_t i = 0;
+    while (i < batch.size()) {
+        // pjlib may have been created or destroyed by the previous command
+        pjsua_state state = pjsua_get_state();
+        if (state != PJSUA_STATE_NULL) {
+            pjsipRegisterThread("pjsip-cmd");
+        }
+
+        if (batch[i]->lock == PJSIPCommandLock::Pjsua && state == PJSUA_STATE_RUNNING) {
+            PJSUA_LOCK();
+            while (i < batch.size() && batch[i]->lock == PJSIPCommandLock::Pjsua) {
+                batch[i]->result = batch[i]->run();
+                i++;
+            }
+            PJSUA_UNLOCK();
+        } else {
+            batch[i]->result = batch[i]->run();
+            i++;
+        }
+    }
+}
+
+void PJSIPCommandWorker::settle(Napi::Env env, std::vector<std::shared_ptr<PJSIPCommand>>& batch) {
+    for (auto& command : batch) {
+        if (command->on_complete) {
+            command->on_complete(env);
+        }
+
+        if (command->result < 0) {
+            command->deferred.Reject(Napi::Error::New(env, std::string(command->name) + " failed").Value());
+        } else if (command->returns_bool) {
+            command->deferred.Resolve(Napi::Boolean::New(env, true));
+        } else {
+            command->deferred.Resolve(Napi::Number::New(env, command->result));
+        }
+    }
+}
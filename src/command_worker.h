@@ -0,0 +1,77 @@
+#ifndef NODE_PJSIP_COMMAND_WORKER_H
+#define NODE_PJSIP_COMMAND_WORKER_H
+
+#include <napi.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// How a command may be batched with its neighbours
+enum class PJSIPCommandLock {
+    None,       // runs on its own, e.g. call operations that take the dialog lock first, account removal
+    Pjsua,      // consecutive commands share one PJSUA_LOCK() acquisition
+    Exclusive   // runs alone after everything queued before it, e.g. shutdown
+};
+
+// One promise-returning N-API call. run() executes on the worker thread and
+// returns a value that is negative on failure; the promise is settled on the
+// JS thread once the batch containing it has finished.
+struct PJSIPCommand {
+    const char* name;
+    PJSIPCommandLock lock;
+    bool returns_bool;              // resolve with true instead of the value
+    std::function<int()> run;
+    std::function<void(Napi::Env)> on_complete;  // optional, JS thread, before settling
+    Napi::Promise::Deferred deferred;
+    int result;
+
+    PJSIPCommand(Napi::Env env, const char* name, PJSIPCommandLock lock, bool returns_bool,
+                 std::function<int()> run);
+};
+
+// Dedicated pjlib-registered thread that executes pjsua calls posted from JS,
+// so slow operations (pjsua_acc_del, pjsua_destroy) never block the event loop.
+// Commands queued while a batch runs are picked up together as the next batch,
+// and the whole batch is settled with a single ThreadSafeFunction call.
+class PJSIPCommandWorker {
+public:
+    static const size_t MAX_BATCH = 256;
+
+    PJSIPCommandWorker();
+    ~PJSIPCommandWorker();
+
+    PJSIPCommandWorker(const PJSIPCommandWorker&) = delete;
+    PJSIPCommandWorker& operator=(const PJSIPCommandWorker&) = delete;
+
+    // JS thread
+    Napi::Promise submit(Napi::Env env, std::shared_ptr<PJSIPCommand> command);
+    void stop();
+
+    size_t pending();
+    uint64_t batches() const { return batch_count.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    void execute(std::vector<std::shared_ptr<PJSIPCommand>>& batch);
+    static void settle(Napi::Env env, std::vector<std::shared_ptr<PJSIPCommand>>& batch);
+    void onFinalize(uint32_t for_generation);
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::shared_ptr<PJSIPCommand>> queue;
+    Napi::ThreadSafeFunction tsfn;
+    size_t outstanding;             // JS thread only - keeps the loop alive while > 0
+    std::atomic<uint64_t> batch_count;
+    uint32_t generation;            // bumped per start, stale settles skip the ref count
+    bool running;
+    bool tsfn_open;                 // false once released or closed by Node
+};
+
+#endif
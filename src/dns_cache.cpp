@@ -0,0 +1,990 @@
+#include "dns_cache.h"
+#include "event_queue.h"
+#include "log_sink.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <cctype>
+#include <random>
+
+// Stops the resolver while the endpoint still has its ioqueue and timers,
+// pjsip itself only knows about the external resolver
+static pjsip_module dns_module;
+
+PJSIPDnsCache* PJSIPDnsCache::active = nullptr;
+
+static std::string lowercase(const std::string& text) {
+    std::string out = text;
+    std::transform(out.begin(), out.end(), out.begin(), [](unsigned char c) { return (char)tolower(c); });
+    return out;
+}
+
+static int defaultPort(pjsip_transport_type_e type) {
+    return (type & ~PJSIP_TRANSPORT_IPV6) == PJSIP_TRANSPORT_TLS ? 5061 : 5060;
+}
+
+static bool parsePort(const std::string& text, int& port) {
+    if (text.empty() || text.size() > 5 ||
+        !std::all_of(text.begin(), text.end(), [](unsigned char c) { return isdigit(c) != 0; })) {
+        return false;
+    }
+    port = atoi(text.c_str());
+    return port > 0 && port <= 65535;
+}
+
+static bool sameName(const pj_str_t& name, const std::string& other) {
+    return pj_stricmp2(&name, other.c_str()) == 0;
+}
+
+// NAPTR rdata, which pjlib-util leaves unparsed: order, preference, flags,
+// services, regexp, replacement (never compressed, RFC 3403)
+struct PJSIPNaptrRecord {
+    unsigned order;
+    unsigned preference;
+    std::string flags;
+    std::string services;
+    std::string replacement;
+};
+
+static bool parseNaptr(const pj_dns_parsed_rr& rr, PJSIPNaptrRecord& out) {
+    const uint8_t* p = (const uint8_t*)rr.data;
+    const uint8_t* end = p + rr.rdlength;
+    if (!p || end - p < 4) {
+        return false;
+    }
+    out.order = (unsigned)(p[0] << 8 | p[1]);
+    out.preference = (unsigned)(p[2] << 8 | p[3]);
+    p += 4;
+
+    std::string* strings[] = { &out.flags, &out.services, nullptr };
+    for (std::string* field : strings) {
+        if (p >= end || p + 1 + *p > end) {
+            return false;
+        }
+        if (field) {
+            field->assign((const char*)p + 1, *p);
+        }
+        p += 1 + *p;
+    }
+
+    out.replacement.clear();
+    while (p < end && *p != 0) {
+        if (p + 1 + *p > end || (*p & 0xc0) != 0) {
+            return false;
+        }
+        if (!out.replacement.empty()) {
+            out.replacement += '.';
+        }
+        out.replacement.append((const char*)p + 1, *p);
+        p += 1 + *p;
+    }
+    return !out.replacement.empty();
+}
+
+// PJSIPDnsOptions implementation
+PJSIPDnsOptions::PJSIPDnsOptions() : max_ttl(PJSIPDnsCache::DEFAULT_MAX_TTL),
+    negative_ttl(PJSIPDnsCache::DEFAULT_NEGATIVE_TTL), naptr(true) {
+}
+
+// PJSIPDnsCache implementation
+PJSIPDnsCache::PJSIPDnsCache(const PJSIPFlowTable* flows) : flows(flows), resolver(nullptr), transports(0), stopping(false), next_sweep_us(0), hits(0),
+    negative_hits(0), misses(0), coalesced(0), refreshes(0), expired(0), queries(0), failures(0) {
+    pj_bzero(&ext, sizeof(ext));
+}
+
+PJSIPDnsCache::~PJSIPDnsCache() {
+    clear();
+}
+
+bool PJSIPDnsCache::start(pjsip_endpoint* endpt, const PJSIPDnsOptions& config, unsigned transport_types) {
+    clear();
+    options = config;
+    transports = transport_types;
+
+    std::vector<std::string> hosts;
+    std::vector<pj_uint16_t> ports;
+    for (const std::string& nameserver : options.nameservers) {
+        std::string host;
+        uint16_t port;
+        if (!parseNameserver(nameserver, host, port)) {
+            PJW_LOG_ERROR("❌ Invalid nameserver '%s'", nameserver.c_str());
+            return false;
+        }
+        hosts.push_back(host);
+        ports.push_back(port);
+    }
+    if (hosts.empty() || hosts.size() > PJ_DNS_RESOLVER_MAX_NS) {
+        PJW_LOG_ERROR("❌ Between 1 and %d nameservers can be used", (int)PJ_DNS_RESOLVER_MAX_NS);
+        return false;
+    }
+    std::vector<pj_str_t> servers;
+    for (std::string& host : hosts) {
+        servers.push_back(pj_str((char*)host.c_str()));
+    }
+
+    // Created on the endpoint's timer heap and ioqueue, answers arrive on
+    // the SIP worker threads
+    pj_dns_resolver* created = nullptr;
+    pj_status_t status = pjsip_endpt_create_resolver(endpt, &created);
+    if (status != PJ_SUCCESS) {
+        PJW_LOG_ERROR("❌ Error creating DNS resolver: %d", status);
+        return false;
+    }
+    status = pj_dns_resolver_set_ns(created, (unsigned)servers.size(), servers.data(), ports.data());
+    if (status == PJ_SUCCESS) {
+        pj_dns_settings settings;
+        pj_dns_resolver_get_settings(created, &settings);
+        settings.cache_max_ttl = options.max_ttl;
+        status = pj_dns_resolver_set_settings(created, &settings);
+    }
+    if (status != PJ_SUCCESS) {
+        PJW_LOG_ERROR("❌ Error configuring DNS resolver: %d", status);
+        pj_dns_resolver_destroy(created, PJ_FALSE);
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        resolver = created;
+        stopping = false;
+    }
+    active = this;
+
+    ext.resolve = &PJSIPDnsCache::resolve;
+    if (!registerModule() || (status = pjsip_endpt_set_ext_resolver(endpt, &ext)) != PJ_SUCCESS) {
+        PJW_LOG_ERROR("❌ Error installing DNS resolver: %d", status);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            resolver = nullptr;
+        }
+        pj_dns_resolver_destroy(created, PJ_FALSE);
+        active = nullptr;
+        return false;
+    }
+
+    PJW_LOG_INFO("🌐 DNS resolver on %u nameserver(s) (TTL cap %us, negative TTL %us%s)",
+                 (unsigned)servers.size(), options.max_ttl, options.negative_ttl, options.naptr ? ", NAPTR" : "");
+    return true;
+}
+
+bool PJSIPDnsCache::isActive() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return resolver != nullptr && !stopping;
+}
+
+bool PJSIPDnsCache::registerModule() {
+    // pjsua_destroy unloads it with the endpoint and resets the id to -1
+    if (dns_module.name.slen > 0 && dns_module.id >= 0) {
+        return true;
+    }
+
+    pj_bzero(&dns_module, sizeof(dns_module));
+    dns_module.name = pj_str((char*)"mod-node-pjsip-dns");
+    dns_module.id = -1;
+    dns_module.priority = PJSIP_MOD_PRIORITY_APPLICATION;
+    dns_module.stop = &PJSIPDnsCache::onEndpointStop;
+
+    pj_status_t status = pjsip_endpt_register_module(pjsua_get_pjsip_endpt(), &dns_module);
+    if (status != PJ_SUCCESS) {
+        PJW_LOG_ERROR("❌ Error registering DNS module: %d", status);
+        return false;
+    }
+    return true;
+}
+
+// First phase of pjsip_endpt_destroy(): pjsua has sent its last requests.
+// Lookups in flight end with PJ_ECANCELLED, pjsip is no longer told.
+pj_status_t PJSIPDnsCache::onEndpointStop() {
+    PJSIPDnsCache* cache = active;
+    if (!cache) {
+        return PJ_SUCCESS;
+    }
+
+    pj_dns_resolver* stopped;
+    {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        cache->stopping = true;
+        stopped = cache->resolver;
+        cache->resolver = nullptr;
+    }
+    if (stopped) {
+        pj_dns_resolver_destroy(stopped, PJ_TRUE);
+    }
+    return PJ_SUCCESS;
+}
+
+void PJSIPDnsCache::clear() {
+    std::vector<Lookup*> leftover;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& lookup : pending) {
+            leftover.push_back(lookup.second);
+        }
+        pending.clear();
+        entries.clear();
+        next_sweep_us = 0;
+        resolver = nullptr;
+        stopping = false;
+        hits = negative_hits = misses = coalesced = refreshes = expired = queries = failures = 0;
+    }
+    active = active == this ? nullptr : active;
+
+    // Only if the endpoint went away without stopping the resolver
+    for (Lookup* lookup : leftover) {
+        for (const Waiter& waiter : lookup->waiters) {
+            if (waiter.prewarm) {
+                complete(waiter, PJ_ECANCELLED, nullptr, 0, false);
+            }
+        }
+        delete lookup;
+    }
+}
+
+// pjsip_ext_resolver::resolve, on whichever thread is sending
+void PJSIPDnsCache::resolve(pjsip_resolver_t* resolver, pj_pool_t* pool, const pjsip_host_info* host_info,
+                            void* token, pjsip_resolver_callback* cb) {
+    PJSIPDnsCache* cache = active;
+    if (!cache) {
+        (*cb)(PJ_ECANCELLED, token, nullptr);
+        return;
+    }
+
+    Target target;
+    target.host.assign(host_info->addr.host.ptr, (size_t)host_info->addr.host.slen);
+    target.port = host_info->addr.port;
+    target.type = host_info->type;
+    target.secure = (host_info->flag & PJSIP_TRANSPORT_SECURE) != 0;
+
+    Waiter waiter = { cb, token, nullptr, 0 };
+    cache->request(target, waiter);
+}
+
+void PJSIPDnsCache::request(const Target& target, const Waiter& waiter) {
+    pjsip_server_addresses numeric;
+    if (numericAddress(target, numeric)) {
+        complete(waiter, PJ_SUCCESS, &numeric, 0, true);
+        return;
+    }
+
+    PJSIPMetrics& metrics = PJSIPMetrics::instance();
+    std::string key = keyOf(target);
+    double now = pjsipMonotonicMicros();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!resolver || stopping) {
+        lock.unlock();
+        complete(waiter, PJ_ECANCELLED, nullptr, 0, false);
+        return;
+    }
+
+    auto it = entries.find(key);
+    if (it != entries.end() && it->second.expires_us <= now) {
+        entries.erase(it);
+        it = entries.end();
+        expired++;
+    }
+    bool in_flight = pending.count(key) > 0;
+
+    if (it != entries.end()) {
+        Entry entry = it->second;
+        Lookup* refresh = nullptr;
+        if (entry.status == PJ_SUCCESS) {
+            hits++;
+            if (now >= entry.refresh_us && !in_flight) {
+                refresh = new Lookup();
+                refresh->cache = this;
+                refresh->key = key;
+                refresh->target = target;
+                pending[key] = refresh;
+                refreshes++;
+            }
+        } else {
+            negative_hits++;
+        }
+        lock.unlock();
+        metrics.increment(PJSIPCounter::DnsCacheHits);
+
+        unsigned ttl = (unsigned)((entry.expires_us - now) / 1000000.0);
+        if (entry.status == PJ_SUCCESS) {
+            order(entry.addresses);
+        }
+        complete(waiter, entry.status, &entry.addresses, ttl, true);
+        if (refresh) {
+            begin(refresh);
+        }
+        return;
+    }
+
+    if (in_flight) {
+        pending[key]->waiters.push_back(waiter);
+        coalesced++;
+        return;
+    }
+
+    Lookup* lookup = new Lookup();
+    lookup->cache = this;
+    lookup->key = key;
+    lookup->target = target;
+    lookup->waiters.push_back(waiter);
+    pending[key] = lookup;
+    misses++;
+    lock.unlock();
+
+    metrics.increment(PJSIPCounter::DnsCacheMisses);
+    begin(lookup);
+}
+
+// Lookup stages. They run without the mutex, a query may be answered from
+// pjlib-util's own cache before pj_dns_resolver_start_query() returns.
+void PJSIPDnsCache::begin(Lookup* lookup) {
+    lookup->type = preferredType(lookup->target);
+    lookup->started_us = pjsipMonotonicMicros();
+    lookup->ttl = UINT32_MAX;
+    lookup->error = PJ_SUCCESS;
+    lookup->outstanding = 0;
+
+    if (lookup->target.port != 0) {
+        Server server = { lookup, lookup->target.host, (uint16_t)lookup->target.port, 0, 0, {} };
+        lookup->servers.push_back(server);
+        queryAddresses(lookup);
+    } else if (lookup->target.type == PJSIP_TRANSPORT_UNSPECIFIED && options.naptr) {
+        queryNaptr(lookup);
+    } else {
+        querySrv(lookup);
+    }
+}
+
+pj_status_t PJSIPDnsCache::startQuery(const std::string& name, int type, pj_dns_callback* cb, void* user_data) {
+    pj_dns_resolver* current;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!resolver || stopping) {
+            return PJ_ECANCELLED;
+        }
+        current = resolver;
+        queries++;
+    }
+
+    pj_str_t query_name = pj_str((char*)name.c_str());
+    pj_dns_async_query* query = nullptr;
+    return pj_dns_resolver_start_query(current, &query_name, type, 0, cb, user_data, &query);
+}
+
+void PJSIPDnsCache::queryNaptr(Lookup* lookup) {
+    pj_status_t status = startQuery(lookup->target.host, PJ_DNS_TYPE_NAPTR, &PJSIPDnsCache::onNaptr, lookup);
+    if (status != PJ_SUCCESS) {
+        onNaptr(lookup, status, nullptr);
+    }
+}
+
+// Picks the most preferred NAPTR record for a transport the engine has,
+// its replacement is the SRV name. No usable record: SRV for the default.
+void PJSIPDnsCache::onNaptr(void* user_data, pj_status_t status, pj_dns_parsed_packet* response) {
+    Lookup* lookup = (Lookup*)user_data;
+    PJSIPDnsCache* cache = lookup->cache;
+
+    const PJSIPNaptrRecord* best = nullptr;
+    pjsip_transport_type_e best_type = PJSIP_TRANSPORT_UNSPECIFIED;
+    std::vector<PJSIPNaptrRecord> records;
+    if (status == PJ_SUCCESS && response) {
+        records.resize(response->hdr.anscount);
+        for (unsigned i = 0; i < response->hdr.anscount; i++) {
+            const pj_dns_parsed_rr& rr = response->ans[i];
+            PJSIPNaptrRecord& record = records[i];
+            if (rr.type != PJ_DNS_TYPE_NAPTR || !parseNaptr(rr, record) ||
+                lowercase(record.flags).find('s') == std::string::npos) {
+                continue;
+            }
+
+            std::string service = lowercase(record.services);
+            pjsip_transport_type_e type = PJSIP_TRANSPORT_UNSPECIFIED;
+            if (service == "sips+d2t") {
+                type = PJSIP_TRANSPORT_TLS;
+            } else if (service == "sip+d2t" && !lookup->target.secure) {
+                type = PJSIP_TRANSPORT_TCP;
+            } else if (service == "sip+d2u" && !lookup->target.secure) {
+                type = PJSIP_TRANSPORT_UDP;
+            }
+            if (type == PJSIP_TRANSPORT_UNSPECIFIED || !(cache->transports & (1u << type))) {
+                continue;
+            }
+            if (!best || record.order < best->order ||
+                (record.order == best->order && record.preference < best->preference)) {
+                best = &record;
+                best_type = type;
+                lookup->ttl = std::min(lookup->ttl, rr.ttl);
+            }
+        }
+    }
+
+    if (best) {
+        lookup->type = best_type;
+        lookup->srv_name = best->replacement;
+    }
+    cache->querySrv(lookup);
+}
+
+void PJSIPDnsCache::querySrv(Lookup* lookup) {
+    if (lookup->srv_name.empty()) {
+        switch (lookup->type & ~PJSIP_TRANSPORT_IPV6) {
+        case PJSIP_TRANSPORT_UDP: lookup->srv_name = "_sip._udp." + lookup->target.host; break;
+        case PJSIP_TRANSPORT_TCP: lookup->srv_name = "_sip._tcp." + lookup->target.host; break;
+        case PJSIP_TRANSPORT_TLS: lookup->srv_name = "_sips._tcp." + lookup->target.host; break;
+        default: break;
+        }
+    }
+    if (lookup->srv_name.empty()) {
+        onSrv(lookup, PJ_ENOTFOUND, nullptr);
+        return;
+    }
+
+    pj_status_t status = startQuery(lookup->srv_name, PJ_DNS_TYPE_SRV, &PJSIPDnsCache::onSrv, lookup);
+    if (status != PJ_SUCCESS) {
+        onSrv(lookup, status, nullptr);
+    }
+}
+
+// SRV targets by priority, addresses from the additional section where the
+// server sent them. Without SRV records the host is looked up directly.
+void PJSIPDnsCache::onSrv(void* user_data, pj_status_t status, pj_dns_parsed_packet* response) {
+    Lookup* lookup = (Lookup*)user_data;
+    bool ipv6 = (lookup->type & PJSIP_TRANSPORT_IPV6) != 0;
+
+    std::vector<Server> servers;
+    if (status == PJ_SUCCESS && response) {
+        for (unsigned i = 0; i < response->hdr.anscount; i++) {
+            const pj_dns_parsed_rr& rr = response->ans[i];
+            if (rr.type != PJ_DNS_TYPE_SRV || rr.rdata.srv.target.slen == 0 ||
+                (rr.rdata.srv.target.slen == 1 && rr.rdata.srv.target.ptr[0] == '.')) {
+                continue;
+            }
+            Server server = { lookup, std::string(rr.rdata.srv.target.ptr, (size_t)rr.rdata.srv.target.slen),
+                              rr.rdata.srv.port, rr.rdata.srv.prio, rr.rdata.srv.weight, {} };
+            servers.push_back(server);
+            lookup->ttl = std::min(lookup->ttl, rr.ttl);
+        }
+        std::stable_sort(servers.begin(), servers.end(), [](const Server& a, const Server& b) {
+            return a.priority != b.priority ? a.priority < b.priority : a.weight > b.weight;
+        });
+        if (servers.size() > MAX_SRV_TARGETS) {
+            servers.resize(MAX_SRV_TARGETS);
+        }
+
+        for (unsigned i = 0; i < response->hdr.arcount; i++) {
+            const pj_dns_parsed_rr& rr = response->arr[i];
+            if (rr.type != (ipv6 ? PJ_DNS_TYPE_AAAA : PJ_DNS_TYPE_A)) {
+                continue;
+            }
+            for (Server& server : servers) {
+                if (sameName(rr.name, server.name)) {
+                    pj_sockaddr address;
+                    pj_sockaddr_init(ipv6 ? pj_AF_INET6() : pj_AF_INET(), &address, nullptr, server.port);
+                    if (ipv6) {
+                        address.ipv6.sin6_addr = rr.rdata.aaaa.ip_addr;
+                    } else {
+                        address.ipv4.sin_addr = rr.rdata.a.ip_addr;
+                    }
+                    server.addresses.push_back(address);
+                    lookup->ttl = std::min(lookup->ttl, rr.ttl);
+                }
+            }
+        }
+    } else if (status != PJ_SUCCESS) {
+        lookup->error = status;
+    }
+
+    if (servers.empty()) {
+        Server server = { lookup, lookup->target.host, (uint16_t)defaultPort(lookup->type), 0, 0, {} };
+        servers.push_back(server);
+    }
+    lookup->servers = std::move(servers);
+    lookup->cache->queryAddresses(lookup);
+}
+
+void PJSIPDnsCache::queryAddresses(Lookup* lookup) {
+    std::vector<Server*> missing;
+    for (Server& server : lookup->servers) {
+        if (server.addresses.empty()) {
+            missing.push_back(&server);
+        }
+    }
+    if (missing.empty()) {
+        finish(lookup);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        lookup->outstanding = (unsigned)missing.size();
+    }
+
+    // The last answer finishes the lookup, nothing is touched after it
+    int type = (lookup->type & PJSIP_TRANSPORT_IPV6) ? PJ_DNS_TYPE_AAAA : PJ_DNS_TYPE_A;
+    for (Server* server : missing) {
+        pj_status_t status = startQuery(server->name, type, &PJSIPDnsCache::onAddress, server);
+        if (status != PJ_SUCCESS) {
+            onAddress(server, status, nullptr);
+        }
+    }
+}
+
+// One SRV target's (or the host's) A/AAAA answer, possibly concurrent with
+// the other targets'
+void PJSIPDnsCache::onAddress(void* user_data, pj_status_t status, pj_dns_parsed_packet* response) {
+    Server* server = (Server*)user_data;
+    Lookup* lookup = server->lookup;
+    PJSIPDnsCache* cache = lookup->cache;
+    bool ipv6 = (lookup->type & PJSIP_TRANSPORT_IPV6) != 0;
+
+    bool done;
+    {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        if (status == PJ_SUCCESS && response) {
+            for (unsigned i = 0; i < response->hdr.anscount; i++) {
+                const pj_dns_parsed_rr& rr = response->ans[i];
+                if (rr.type == PJ_DNS_TYPE_CNAME) {
+                    lookup->ttl = std::min(lookup->ttl, rr.ttl);
+                }
+                if (rr.type != (ipv6 ? PJ_DNS_TYPE_AAAA : PJ_DNS_TYPE_A)) {
+                    continue;
+                }
+                pj_sockaddr address;
+                pj_sockaddr_init(ipv6 ? pj_AF_INET6() : pj_AF_INET(), &address, nullptr, server->port);
+                if (ipv6) {
+                    address.ipv6.sin6_addr = rr.rdata.aaaa.ip_addr;
+                } else {
+                    address.ipv4.sin_addr = rr.rdata.a.ip_addr;
+                }
+                server->addresses.push_back(address);
+                lookup->ttl = std::min(lookup->ttl, rr.ttl);
+            }
+        } else if (status != PJ_SUCCESS) {
+            lookup->error = status;
+        }
+        done = --lookup->outstanding == 0;
+    }
+
+    if (done) {
+        cache->finish(lookup);
+    }
+}
+
+// Stores the outcome and tells everyone who waited. A refresh that fails
+// keeps the entry it was refreshing until that one expires.
+void PJSIPDnsCache::finish(Lookup* lookup) {
+    pjsip_server_addresses addresses;
+    addresses.count = 0;
+    for (const Server& server : lookup->servers) {
+        for (const pj_sockaddr& address : server.addresses) {
+            if (addresses.count == PJSIP_MAX_RESOLVED_ADDRESSES) {
+                break;
+            }
+            unsigned n = addresses.count++;
+            addresses.entry[n].type = lookup->type;
+            addresses.entry[n].priority = server.priority;
+            addresses.entry[n].weight = server.weight;
+            addresses.entry[n].addr = address;
+            addresses.entry[n].addr_len = (int)pj_sockaddr_get_len(&address);
+        }
+    }
+
+    pj_status_t status = addresses.count > 0 ? PJ_SUCCESS
+                         : lookup->error != PJ_SUCCESS ? lookup->error : PJ_ENOTFOUND;
+    unsigned ttl = status == PJ_SUCCESS ? std::min<unsigned>(lookup->ttl, options.max_ttl) : options.negative_ttl;
+    double now = pjsipMonotonicMicros();
+
+    std::vector<Waiter> waiters;
+    bool shutting_down;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.erase(lookup->key);
+        waiters.swap(lookup->waiters);
+        shutting_down = stopping;
+
+        auto it = entries.find(lookup->key);
+        bool keep_stale = status != PJ_SUCCESS && it != entries.end() && it->second.status == PJ_SUCCESS &&
+                          it->second.expires_us > now;
+        if (!shutting_down && !keep_stale) {
+            if (it == entries.end() && (entries.size() >= MAX_ENTRIES || now >= next_sweep_us)) {
+                sweep(now);
+            }
+            Entry& entry = entries[lookup->key];
+            entry.status = status;
+            entry.addresses = addresses;
+            entry.expires_us = now + ttl * 1000000.0;
+            entry.refresh_us = entry.expires_us - ttl * (double)REFRESH_PERCENT * 10000.0;
+        }
+        if (status != PJ_SUCCESS) {
+            failures++;
+        }
+    }
+
+    PJSIPMetrics& metrics = PJSIPMetrics::instance();
+    metrics.record(PJSIPHistogram::DnsLookup, (uint64_t)(now - lookup->started_us));
+    if (status != PJ_SUCCESS) {
+        metrics.increment(PJSIPCounter::DnsLookupsFailed);
+        if (!shutting_down) {
+            PJW_LOG_WARN("⚠️ DNS lookup for %s failed: %d", lookup->target.host.c_str(), status);
+        }
+    } else {
+        PJW_LOG_DEBUG("🌐 %s resolved to %u address(es), TTL %us", lookup->target.host.c_str(), addresses.count, ttl);
+    }
+
+    for (const Waiter& waiter : waiters) {
+        // pjsip's transactions are being torn down, like pjsip's own
+        // resolver it is not called back any more
+        if (shutting_down && !waiter.prewarm) {
+            continue;
+        }
+        pjsip_server_addresses ordered = addresses;
+        order(ordered);
+        complete(waiter, status, &ordered, ttl, false);
+    }
+    delete lookup;
+}
+
+// Targets nobody asks for again would otherwise stay forever, request()
+// only drops an expired entry it finds
+void PJSIPDnsCache::sweep(double now) {
+    next_sweep_us = now + SWEEP_INTERVAL_S * 1000000.0;
+
+    auto soonest = entries.end();
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it->second.expires_us <= now) {
+            it = entries.erase(it);
+            expired++;
+            continue;
+        }
+        if (soonest == entries.end() || it->second.expires_us < soonest->second.expires_us) {
+            soonest = it;
+        }
+        ++it;
+    }
+    if (entries.size() >= MAX_ENTRIES && soonest != entries.end()) {
+        entries.erase(soonest);
+    }
+}
+
+void PJSIPDnsCache::complete(const Waiter& waiter, pj_status_t status, const pjsip_server_addresses* addresses,
+                             unsigned ttl, bool cached) {
+    if (waiter.cb) {
+        (*waiter.cb)(status, waiter.token, status == PJ_SUCCESS ? addresses : nullptr);
+        return;
+    }
+    if (!waiter.prewarm) {
+        return;
+    }
+
+    Prewarm* prewarm = waiter.prewarm.get();
+    bool last;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        PJSIPDnsResult& result = prewarm->results[waiter.index];
+        result.status = status;
+        result.addresses.count = 0;
+        if (status == PJ_SUCCESS && addresses) {
+            result.addresses = *addresses;
+        }
+        result.ttl = ttl;
+        result.cached = cached;
+        last = --prewarm->remaining == 0;
+    }
+
+    if (last) {
+        auto keep = waiter.prewarm;
+        prewarm->settle->call([keep](Napi::Env env, Napi::Function) {
+            Napi::Array results = Napi::Array::New(env, keep->results.size());
+            for (size_t i = 0; i < keep->results.size(); i++) {
+                results.Set((uint32_t)i, resultObject(env, keep->results[i]));
+            }
+            keep->deferred.Resolve(results);
+        });
+        prewarm->settle->release();
+    }
+}
+
+Napi::Value PJSIPDnsCache::prewarm(Napi::Env env, const std::vector<std::string>& targets) {
+    auto job = std::make_shared<Prewarm>(env);
+    if (!isActive()) {
+        job->deferred.Reject(Napi::Error::New(env, "DNS cache is not enabled, initialize with dns.nameservers").Value());
+        return job->deferred.Promise();
+    }
+    if (targets.empty()) {
+        job->deferred.Resolve(Napi::Array::New(env));
+        return job->deferred.Promise();
+    }
+
+    job->settle = PJSIPJsCallback::create(env, "pjsip-dns-prewarm");
+    job->results.resize(targets.size());
+    job->remaining = targets.size();
+    for (size_t i = 0; i < targets.size(); i++) {
+        job->results[i].target = targets[i];
+        job->results[i].status = PJ_EPENDING;
+        job->results[i].addresses.count = 0;
+        job->results[i].ttl = 0;
+        job->results[i].cached = false;
+    }
+
+    for (size_t i = 0; i < targets.size(); i++) {
+        Waiter waiter = { nullptr, nullptr, job, i };
+        Target target;
+        if (parseTarget(targets[i], target)) {
+            request(target, waiter);
+        } else {
+            complete(waiter, PJ_EINVAL, nullptr, 0, false);
+        }
+    }
+    return job->deferred.Promise();
+}
+
+void PJSIPDnsCache::prewarm(const std::vector<std::string>& targets) {
+    if (!isActive()) {
+        return;
+    }
+    for (const std::string& text : targets) {
+        Target target;
+        if (parseTarget(text, target)) {
+            request(target, Waiter{ nullptr, nullptr, nullptr, 0 });
+        }
+    }
+}
+
+unsigned PJSIPDnsCache::flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    unsigned count = (unsigned)entries.size();
+    entries.clear();
+    return count;
+}
+
+PJSIPDnsStats PJSIPDnsCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    PJSIPDnsStats out;
+    out.active = resolver != nullptr && !stopping;
+    out.hits = hits;
+    out.negative_hits = negative_hits;
+    out.misses = misses;
+    out.coalesced = coalesced;
+    out.refreshes = refreshes;
+    out.expired = expired;
+    out.queries = queries;
+    out.failures = failures;
+    out.entries = (unsigned)entries.size();
+    out.pending = (unsigned)pending.size();
+    return out;
+}
+
+// "10.0.0.53", "10.0.0.53:5353", "[::1]:5353" or a bare IPv6 address
+bool PJSIPDnsCache::parseNameserver(const std::string& text, std::string& host, uint16_t& port) {
+    int number = 53;
+    if (!text.empty() && text[0] == '[') {
+        size_t close = text.find(']');
+        if (close == std::string::npos) {
+            return false;
+        }
+        host = text.substr(1, close - 1);
+        if (close + 1 < text.size() && (text[close + 1] != ':' || !parsePort(text.substr(close + 2), number))) {
+            return false;
+        }
+    } else {
+        size_t colon = text.find(':');
+        if (colon != std::string::npos && text.find(':', colon + 1) == std::string::npos) {
+            host = text.substr(0, colon);
+            if (!parsePort(text.substr(colon + 1), number)) {
+                return false;
+            }
+        } else {
+            host = text;
+        }
+    }
+
+    pj_str_t address = pj_str((char*)host.c_str());
+    pj_in6_addr parsed;
+    if (pj_inet_pton(pj_AF_INET(), &address, &parsed) != PJ_SUCCESS &&
+        pj_inet_pton(pj_AF_INET6(), &address, &parsed) != PJ_SUCCESS) {
+        return false;
+    }
+    port = (uint16_t)number;
+    return true;
+}
+
+// A SIP URI the way pjsip_get_dest_info() sees it, or a bare host[:port]
+bool PJSIPDnsCache::parseTarget(const std::string& text, Target& out) {
+    std::string rest = text;
+    out.secure = false;
+    std::string scheme = lowercase(rest.substr(0, 5));
+    if (scheme == "sips:") {
+        out.secure = true;
+        rest = rest.substr(5);
+    } else if (scheme.compare(0, 4, "sip:") == 0) {
+        rest = rest.substr(4);
+    }
+
+    size_t at = rest.find('@');
+    if (at != std::string::npos) {
+        rest = rest.substr(at + 1);
+    }
+    size_t headers = rest.find('?');
+    if (headers != std::string::npos) {
+        rest.resize(headers);
+    }
+    std::string params;
+    size_t semicolon = rest.find(';');
+    if (semicolon != std::string::npos) {
+        params = rest.substr(semicolon + 1);
+        rest.resize(semicolon);
+    }
+
+    out.port = 0;
+    if (!rest.empty() && rest[0] == '[') {
+        size_t close = rest.find(']');
+        if (close == std::string::npos) {
+            return false;
+        }
+        out.host = rest.substr(1, close - 1);
+        if (close + 1 < rest.size() && (rest[close + 1] != ':' || !parsePort(rest.substr(close + 2), out.port))) {
+            return false;
+        }
+    } else {
+        size_t colon = rest.find(':');
+        out.host = rest.substr(0, colon);
+        if (colon != std::string::npos && !parsePort(rest.substr(colon + 1), out.port)) {
+            return false;
+        }
+    }
+
+    out.type = PJSIP_TRANSPORT_UNSPECIFIED;
+    while (!params.empty()) {
+        size_t next = params.find(';');
+        std::string param = lowercase(params.substr(0, next));
+        params = next == std::string::npos ? "" : params.substr(next + 1);
+        if (param == "transport=udp") {
+            out.type = PJSIP_TRANSPORT_UDP;
+        } else if (param == "transport=tcp") {
+            out.type = PJSIP_TRANSPORT_TCP;
+        } else if (param == "transport=tls") {
+            out.type = PJSIP_TRANSPORT_TLS;
+        } else if (param.compare(0, 6, "maddr=") == 0) {
+            out.host = param.substr(6);
+        }
+    }
+
+    // sips: only goes over TLS and TLS is secure, IPv6 literals go over the
+    // IPv6 flavour
+    if (out.secure) {
+        out.type = PJSIP_TRANSPORT_TLS;
+    }
+    out.secure = out.type == PJSIP_TRANSPORT_TLS;
+    if (out.type != PJSIP_TRANSPORT_UNSPECIFIED && out.host.find(':') != std::string::npos) {
+        out.type = (pjsip_transport_type_e)(out.type | PJSIP_TRANSPORT_IPV6);
+    }
+    return !out.host.empty();
+}
+
+std::string PJSIPDnsCache::keyOf(const Target& target) {
+    return lowercase(target.host) + ":" + std::to_string(target.port) + ":" + std::to_string((int)target.type) +
+           (target.secure ? ":s" : "");
+}
+
+// The transport a target goes over before NAPTR has a say: the URI's, else
+// UDP, else whatever stream transport the engine listens on
+pjsip_transport_type_e PJSIPDnsCache::preferredType(const Target& target) const {
+    if (target.type != PJSIP_TRANSPORT_UNSPECIFIED) {
+        return target.type;
+    }
+    if (target.secure) {
+        return PJSIP_TRANSPORT_TLS;
+    }
+    static const pjsip_transport_type_e ORDER[] = { PJSIP_TRANSPORT_UDP, PJSIP_TRANSPORT_TCP, PJSIP_TRANSPORT_TLS };
+    for (pjsip_transport_type_e type : ORDER) {
+        if (transports & (1u << type)) {
+            return type;
+        }
+    }
+    return PJSIP_TRANSPORT_UDP;
+}
+
+bool PJSIPDnsCache::numericAddress(const Target& target, pjsip_server_addresses& out) const {
+    pj_str_t host = pj_str((char*)target.host.c_str());
+    pj_in6_addr parsed;
+    bool ipv6;
+    if (pj_inet_pton(pj_AF_INET(), &host, &parsed) == PJ_SUCCESS) {
+        ipv6 = false;
+    } else if (pj_inet_pton(pj_AF_INET6(), &host, &parsed) == PJ_SUCCESS) {
+        ipv6 = true;
+    } else {
+        return false;
+    }
+
+    pjsip_transport_type_e type = preferredType(target);
+    if (ipv6) {
+        type = (pjsip_transport_type_e)(type | PJSIP_TRANSPORT_IPV6);
+    }
+    out.count = 1;
+    out.entry[0].type = type;
+    out.entry[0].priority = 0;
+    out.entry[0].weight = 0;
+    pj_sockaddr_init(ipv6 ? pj_AF_INET6() : pj_AF_INET(), &out.entry[0].addr, &host,
+                     (pj_uint16_t)(target.port != 0 ? target.port : defaultPort(type)));
+    out.entry[0].addr_len = (int)pj_sockaddr_get_len(&out.entry[0].addr);
+    return true;
+}
+
+void PJSIPDnsCache::order(pjsip_server_addresses& addresses) const {
+    shuffleByWeight(addresses);
+    if (flows) {
+        flows->preferConnected(addresses);
+    }
+}
+
+// RFC 2782 ordering within each priority: picked at random in proportion to
+// weight, per request, so a cached answer still spreads load
+void PJSIPDnsCache::shuffleByWeight(pjsip_server_addresses& addresses) {
+    static thread_local std::minstd_rand random(std::random_device{}());
+
+    unsigned start = 0;
+    while (start < addresses.count) {
+        unsigned end = start;
+        while (end < addresses.count && addresses.entry[end].priority == addresses.entry[start].priority) {
+            end++;
+        }
+        for (unsigned i = start; i + 1 < end; i++) {
+            unsigned total = 0;
+            for (unsigned j = i; j < end; j++) {
+                total += addresses.entry[j].weight + 1;
+            }
+            unsigned pick = (unsigned)(random() % total);
+            unsigned chosen = i;
+            while (pick >= addresses.entry[chosen].weight + 1) {
+                pick -= addresses.entry[chosen].weight + 1;
+                chosen++;
+            }
+            std::swap(addresses.entry[i], addresses.entry[chosen]);
+        }
+        start = end;
+    }
+}
+
+Napi::Object PJSIPDnsCache::resultObject(Napi::Env env, const PJSIPDnsResult& result) {
+    Napi::Array addresses = Napi::Array::New(env, result.addresses.count);
+    for (unsigned i = 0; i < result.addresses.count; i++) {
+        char host[PJ_INET6_ADDRSTRLEN];
+        pj_sockaddr_print(&result.addresses.entry[i].addr, host, sizeof(host), 0);
+
+        Napi::Object address = Napi::Object::New(env);
+        address.Set("address", Napi::String::New(env, host));
+        address.Set("port", Napi::Number::New(env, pj_sockaddr_get_port(&result.addresses.entry[i].addr)));
+        address.Set("transport", Napi::String::New(env,
+            lowercase(pjsip_transport_get_type_name(result.addresses.entry[i].type))));
+        address.Set("priority", Napi::Number::New(env, result.addresses.entry[i].priority));
+        address.Set("weight", Napi::Number::New(env, result.addresses.entry[i].weight));
+        addresses.Set(i, address);
+    }
+
+    Napi::Object object = Napi::Object::New(env);
+    object.Set("target", Napi::String::New(env, result.target));
+    object.Set("status", Napi::Number::New(env, result.status));
+    object.Set("addresses", addresses);
+    object.Set("ttl", Napi::Number::New(env, result.ttl));
+    object.Set("cached", Napi::Boolean::New(env, result.cached));
+    return object;
+}
@@ -0,0 +1,216 @@
+#ifndef NODE_PJSIP_DNS_CACHE_H
+#define NODE_PJSIP_DNS_CACHE_H
+
+#include <napi.h>
+#include <pjlib-util.h>
+#include <pjsua-lib/pjsua.h>
+
+#include "flow_table.h"
+#include "js_callback.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct PJSIPDnsOptions {
+    std::vector<std::string> nameservers;   // "ip" or "ip:port", "[ipv6]:port"; empty = getaddrinfo
+    unsigned max_ttl;                       // seconds, caps every record's TTL
+    unsigned negative_ttl;                  // seconds a failed lookup is answered from the cache
+    bool naptr;                             // NAPTR before SRV when the URI names no transport
+
+    PJSIPDnsOptions();
+};
+
+struct PJSIPDnsStats {
+    bool active;
+    uint64_t hits;
+    uint64_t negative_hits;         // answered with a remembered failure
+    uint64_t misses;                // lookups started
+    uint64_t coalesced;             // requests that joined a lookup in flight
+    uint64_t refreshes;             // lookups started ahead of expiry for hot entries
+    uint64_t expired;
+    uint64_t queries;               // DNS queries sent
+    uint64_t failures;              // lookups that ended without an address
+    unsigned entries;
+    unsigned pending;
+};
+
+// One prewarm() target
+struct PJSIPDnsResult {
+    std::string target;
+    pj_status_t status;
+    pjsip_server_addresses addresses;
+    unsigned ttl;                   // seconds left in the cache
+    bool cached;                    // answered without a lookup
+};
+
+// Resolution of SIP next hops on pjsip's asynchronous DNS resolver, behind a
+// process-wide cache.
+//
+// Installed as pjsip's external resolver, so every registrar, proxy and
+// call destination goes through it. Targets are keyed by host, port,
+// transport and sips: an entry lives for the smallest TTL of the records
+// behind it (capped at max_ttl), a lookup that found nothing for
+// negative_ttl. Concurrent requests for a target in flight wait for the
+// one lookup, and an entry hit in the last REFRESH_PERCENT of its life is
+// looked up again in the background, so a steady stream of requests never
+// waits on DNS. Expired entries are swept every SWEEP_INTERVAL_S, and at
+// MAX_ENTRIES the one closest to expiry makes room. Lookups follow RFC 3263: NAPTR (optional), SRV, then A or
+// AAAA, falling back to A on the default port when there is no SRV.
+//
+// Among addresses of equal priority, those we already hold a TCP/TLS flow
+// to come first (see PJSIPFlowTable), so accounts behind one proxy share
+// its connection instead of each opening one to another record.
+//
+// Nameservers take a port, so tests can point the engine at a stand-in DNS
+// server on localhost.
+class PJSIPDnsCache {
+public:
+    static const unsigned DEFAULT_MAX_TTL = 3600;
+    static const unsigned DEFAULT_NEGATIVE_TTL = 30;
+    static const unsigned REFRESH_PERCENT = 10;
+    static const unsigned MAX_SRV_TARGETS = 4;     // address lookups per SRV answer
+    static const unsigned MAX_ENTRIES = 16384;
+    static const unsigned SWEEP_INTERVAL_S = 60;
+
+    explicit PJSIPDnsCache(const PJSIPFlowTable* flows);
+    ~PJSIPDnsCache();
+
+    PJSIPDnsCache(const PJSIPDnsCache&) = delete;
+    PJSIPDnsCache& operator=(const PJSIPDnsCache&) = delete;
+
+    // After pjsua_init(), before anything is sent. transport_types has bit
+    // 1 << type set for every transport the engine listens on.
+    bool start(pjsip_endpoint* endpt, const PJSIPDnsOptions& options, unsigned transport_types);
+    bool isActive() const;
+
+    // JS thread. The promise resolves with one result per target once all
+    // of them are in the cache (or known to fail); without a promise the
+    // lookups just run.
+    Napi::Value prewarm(Napi::Env env, const std::vector<std::string>& targets);
+    void prewarm(const std::vector<std::string>& targets);
+
+    unsigned flush();               // drops every entry, returns how many
+    PJSIPDnsStats stats() const;
+
+    // Shutdown, after pjsua_destroy()
+    void clear();
+
+    static bool parseNameserver(const std::string& text, std::string& host, uint16_t& port);
+    static Napi::Object resultObject(Napi::Env env, const PJSIPDnsResult& result);
+
+private:
+    struct Target {
+        std::string host;
+        int port;                   // 0 = none in the URI
+        pjsip_transport_type_e type;
+        bool secure;
+    };
+
+    struct Prewarm {
+        Napi::Promise::Deferred deferred;
+        std::shared_ptr<PJSIPJsCallback> settle;
+        std::vector<PJSIPDnsResult> results;
+        size_t remaining;           // cache mutex
+
+        explicit Prewarm(Napi::Env env) : deferred(Napi::Promise::Deferred::New(env)), remaining(0) {}
+    };
+
+    // Who is told about a result: pjsip (cb, token) or a prewarm() slot
+    struct Waiter {
+        pjsip_resolver_callback* cb;
+        void* token;
+        std::shared_ptr<Prewarm> prewarm;
+        size_t index;
+    };
+
+    struct Entry {
+        pj_status_t status;         // not PJ_SUCCESS: negative entry
+        pjsip_server_addresses addresses;
+        double expires_us;
+        double refresh_us;          // a hit after this starts a refresh
+    };
+
+    struct Lookup;
+
+    // A server the lookup needs addresses for: an SRV target or the host itself
+    struct Server {
+        Lookup* lookup;
+        std::string name;
+        uint16_t port;
+        unsigned priority;
+        unsigned weight;
+        std::vector<pj_sockaddr> addresses;
+    };
+
+    // One target being resolved, shared by every request that arrives meanwhile
+    struct Lookup {
+        PJSIPDnsCache* cache;
+        std::string key;
+        Target target;
+        pjsip_transport_type_e type;   // chosen by NAPTR or the URI
+        std::string srv_name;       // NAPTR replacement, else derived from the type
+        pj_status_t error;          // last failed query
+        double started_us;
+        uint32_t ttl;               // smallest TTL seen
+        std::vector<Server> servers;
+        unsigned outstanding;       // address queries in flight
+        std::vector<Waiter> waiters;
+    };
+
+    static void resolve(pjsip_resolver_t* resolver, pj_pool_t* pool, const pjsip_host_info* target, void* token,
+                        pjsip_resolver_callback* cb);
+    static pj_status_t onEndpointStop();
+
+    void request(const Target& target, const Waiter& waiter);
+    bool registerModule();
+
+    // Lookup stages, each one ends in the next query or in finish()
+    void begin(Lookup* lookup);
+    void queryNaptr(Lookup* lookup);
+    void querySrv(Lookup* lookup);
+    void queryAddresses(Lookup* lookup);
+    pj_status_t startQuery(const std::string& name, int type, pj_dns_callback* cb, void* user_data);
+    static void onNaptr(void* user_data, pj_status_t status, pj_dns_parsed_packet* response);
+    static void onSrv(void* user_data, pj_status_t status, pj_dns_parsed_packet* response);
+    static void onAddress(void* user_data, pj_status_t status, pj_dns_parsed_packet* response);
+    void finish(Lookup* lookup);
+    void sweep(double now);         // mutex held
+
+    void complete(const Waiter& waiter, pj_status_t status, const pjsip_server_addresses* addresses, unsigned ttl,
+                  bool cached);
+
+    static bool parseTarget(const std::string& text, Target& out);
+    static std::string keyOf(const Target& target);
+    pjsip_transport_type_e preferredType(const Target& target) const;
+    bool numericAddress(const Target& target, pjsip_server_addresses& out) const;
+    static void shuffleByWeight(pjsip_server_addresses& addresses);
+    void order(pjsip_server_addresses& addresses) const;      // per request
+
+    static PJSIPDnsCache* active;
+
+    const PJSIPFlowTable* flows;
+    mutable std::mutex mutex;
+    pj_dns_resolver* resolver;      // ours, pjsip only sees the external resolver
+    pjsip_ext_resolver ext;
+    PJSIPDnsOptions options;
+    unsigned transports;            // 1 << pjsip_transport_type_e
+    bool stopping;                  // endpoint going away, no new queries
+    std::unordered_map<std::string, Entry> entries;
+    std::unordered_map<std::string, Lookup*> pending;
+    double next_sweep_us;
+
+    uint64_t hits;
+    uint64_t negative_hits;
+    uint64_t misses;
+    uint64_t coalesced;
+    uint64_t refreshes;
+    uint64_t expired;
+    uint64_t queries;
+    uint64_t failures;
+};
+
+#endif
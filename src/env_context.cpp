@@ -0,0 +1,125 @@
+#include "env_context.h"
+#include "pjsip_wrapper.h"
+#include "pj_thread_util.h"
+
+#include <mutex>
+
+std::shared_mutex PJSIPEnvContext::registry_mutex;
+PJSIPEnvContext* PJSIPEnvContext::registry[PJSIPEnvContext::MAX_ENVS] = {};
+std::atomic<uint8_t> PJSIPEnvContext::account_owners[PJSUA_MAX_ACC] = {};
+
+// PJSIPEnvContext implementation
+PJSIPEnvContext::PJSIPEnvContext(unsigned env_id) : env_id(env_id) {
+}
+
+// Env teardown, on the env's own thread. Node has already closed the env's
+// ThreadSafeFunctions by now, the dispatcher and worker notice through their
+// finalizers and skip the release.
+PJSIPEnvContext::~PJSIPEnvContext() {
+    // Unpublish first so PJSIP threads stop routing events here
+    {
+        std::unique_lock<std::shared_mutex> lock(registry_mutex);
+        registry[env_id] = nullptr;
+    }
+
+    commands.stop();
+    PJSIPWrapper::getInstance()->releaseEnvCallbacks(env_id);
+
+    // Whatever this env still holds goes back without waiting on the network,
+    // a terminating worker cannot wait for un-REGISTER answers
+    PJSIPWrapper::getInstance()->detach(env_id, false);
+    events.stop();
+
+    // Matches attach(), after the last pjsua call from this thread
+    pj_shutdown();
+}
+
+// Every env's JS thread calls pjsua directly, whichever env started the
+// engine. pjlib is kept initialized while any env is loaded (pj_init() is
+// counted), so the thread can be registered here, before the engine exists,
+// and stays registered across engine restarts.
+PJSIPEnvContext* PJSIPEnvContext::attach(Napi::Env env) {
+    if (pj_init() != PJ_SUCCESS) {
+        return nullptr;
+    }
+    if (!pjsipRegisterThread("pjsip-js")) {
+        pj_shutdown();
+        return nullptr;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(registry_mutex);
+    for (unsigned i = 0; i < MAX_ENVS; i++) {
+        if (registry[i] == nullptr) {
+            registry[i] = new PJSIPEnvContext(i);
+            env.SetInstanceData(registry[i]);   // deleted by Node on env teardown
+            return registry[i];
+        }
+    }
+    lock.unlock();
+    pj_shutdown();
+    return nullptr;
+}
+
+PJSIPEnvContext* PJSIPEnvContext::route(pjsua_acc_id acc_id) {
+    uint8_t owner = PJSIPAccountTable::isValidId(acc_id) ? account_owners[acc_id].load(std::memory_order_acquire) : 0;
+    if (owner > 0) {
+        return registry[owner - 1];     // null once the owner is gone, its events are dropped
+    }
+
+    for (PJSIPEnvContext* context : registry) {
+        if (context && context->events.isActive()) {
+            return context;
+        }
+    }
+    return nullptr;
+}
+
+void PJSIPEnvContext::post(const PJSIPEvent& event) {
+    std::shared_lock<std::shared_mutex> lock(registry_mutex);
+    PJSIPEnvContext* context = route(event.acc_id);
+    if (context) {
+        context->events.post(event);
+    }
+}
+
+size_t PJSIPEnvContext::queueDepth(pjsua_acc_id acc_id) {
+    std::shared_lock<std::shared_mutex> lock(registry_mutex);
+    PJSIPEnvContext* context = route(acc_id);
+    return context ? context->events.depth() : 0;
+}
+
+void PJSIPEnvContext::queueTotals(uint64_t& depth, uint64_t& dropped) {
+    depth = 0;
+    dropped = 0;
+
+    std::shared_lock<std::shared_mutex> lock(registry_mutex);
+    for (PJSIPEnvContext* context : registry) {
+        if (context) {
+            depth += context->events.depth();
+            dropped += context->events.droppedCount();
+        }
+    }
+}
+
+void PJSIPEnvContext::setAccountOwner(pjsua_acc_id acc_id, unsigned env_id) {
+    if (PJSIPAccountTable::isValidId(acc_id) && env_id < MAX_ENVS) {
+        account_owners[acc_id].store((uint8_t)(env_id + 1), std::memory_order_release);
+    }
+}
+
+void PJSIPEnvContext::clearAccountOwner(pjsua_acc_id acc_id) {
+    if (PJSIPAccountTable::isValidId(acc_id)) {
+        account_owners[acc_id].store(0, std::memory_order_release);
+    }
+}
+
+void PJSIPEnvContext::clearAccountOwners() {
+    for (std::atomic<uint8_t>& owner : account_owners) {
+        owner.store(0, std::memory_order_release);
+    }
+}
+
+bool PJSIPEnvContext::isOwnedBy(pjsua_acc_id acc_id, unsigned env_id) {
+    return PJSIPAccountTable::isValidId(acc_id) &&
+           account_owners[acc_id].load(std::memory_order_acquire) == env_id + 1;
+}
@@ -0,0 +1,69 @@
+#ifndef NODE_PJSIP_ENV_CONTEXT_H
+#define NODE_PJSIP_ENV_CONTEXT_H
+
+#include <napi.h>
+#include <pjsua-lib/pjsua.h>
+
+#include "command_worker.h"
+#include "event_queue.h"
+
+#include <atomic>
+#include <cstdint>
+#include <shared_mutex>
+
+// Per-environment state for the main thread and every worker_thread that
+// loads the addon.
+//
+// pjsua keeps all of its state in one process-wide pjsua_var, so the SIP
+// engine is shared: the first env to call init() starts it and later envs
+// attach to it. Each env gets its own event delivery and command thread, and
+// owns the accounts and listeners it creates. Events of an account are
+// delivered on the loop of the env that added it, so load can be sharded
+// across workers. The context is the env's instance data: on env teardown it
+// detaches from the engine, and the last env to go destroys it.
+class PJSIPEnvContext {
+public:
+    static const unsigned MAX_ENVS = 16;
+
+    ~PJSIPEnvContext();
+
+    PJSIPEnvContext(const PJSIPEnvContext&) = delete;
+    PJSIPEnvContext& operator=(const PJSIPEnvContext&) = delete;
+
+    // Module init, registers the env's thread with pjlib - returns nullptr once
+    // MAX_ENVS envs have loaded the addon or if pjlib cannot be initialized
+    static PJSIPEnvContext* attach(Napi::Env env);
+    static PJSIPEnvContext* get(Napi::Env env) { return env.GetInstanceData<PJSIPEnvContext>(); }
+
+    // Any thread. Events of an account go to the env that added it, events
+    // of accounts nobody added (none so far) to the first subscribed env.
+    static void post(const PJSIPEvent& event);
+    static size_t queueDepth(pjsua_acc_id acc_id);
+    static void queueTotals(uint64_t& depth, uint64_t& dropped);
+
+    // Account ownership, set when the account is added and cleared when removed
+    static void setAccountOwner(pjsua_acc_id acc_id, unsigned env_id);
+    static void clearAccountOwner(pjsua_acc_id acc_id);
+    static void clearAccountOwners();
+    static bool isOwnedBy(pjsua_acc_id acc_id, unsigned env_id);
+
+    unsigned id() const { return env_id; }
+    PJSIPEventDispatcher& getEventDispatcher() { return events; }
+    PJSIPCommandWorker& getCommandWorker() { return commands; }
+
+private:
+    explicit PJSIPEnvContext(unsigned env_id);
+
+    // Shared registry lock held
+    static PJSIPEnvContext* route(pjsua_acc_id acc_id);
+
+    unsigned env_id;
+    PJSIPEventDispatcher events;
+    PJSIPCommandWorker commands;
+
+    static std::shared_mutex registry_mutex;
+    static PJSIPEnvContext* registry[MAX_ENVS];
+    static std::atomic<uint8_t> account_owners[PJSUA_MAX_ACC];   // env id + 1, 0 = none
+};
+
+#endif
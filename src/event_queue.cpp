@@ -0,0 +1,121 @@
+#include "event_queue.h"
+#include "metrics.h"
+
+// PJSIPEventDispatcher implementation
+PJSIPEventDispatcher::PJSIPEventDispatcher()
+    : queue(DEFAULT_CAPACITY), batch(nullptr), generation(0), active(false),
+      drain_pending(false), dropped(0), coalesced(0), batches(0), delivered(0) {
+}
+
+PJSIPEventDispatcher::~PJSIPEventDispatcher() {
+}
+
+Napi::ArrayBuffer PJSIPEventDispatcher::start(Napi::Env env, Napi::Function callback) {
+    stop();
+
+    Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, MAX_BATCH * sizeof(PJSIPEvent));
+
+    {
+        std::lock_guard<std::mutex> lock(tsfn_mutex);
+        batch_ref = Napi::Persistent(buffer);
+        batch = static_cast<PJSIPEvent*>(buffer.Data());
+        uint32_t for_generation = ++generation;
+        tsfn = Napi::ThreadSafeFunction::New(env, callback, "pjsip-events", 0, 1,
+            [this, for_generation](Napi::Env) { onFinalize(for_generation); });
+        drain_pending.store(false, std::memory_order_relaxed);
+        active.store(true, std::memory_order_release);
+    }
+
+    // Hand over anything queued while nobody was subscribed
+    if (queue.depth() > 0 && !drain_pending.exchange(true, std::memory_order_acq_rel)) {
+        scheduleDrain();
+    }
+    return buffer;
+}
+
+void PJSIPEventDispatcher::stop() {
+    std::lock_guard<std::mutex> lock(tsfn_mutex);
+    if (!active.exchange(false, std::memory_order_acq_rel)) {
+        return;
+    }
+    tsfn.Release();
+}
+
+// Runs after stop() released the function, or earlier when Node closes it
+// on env teardown - then nothing may call into it again, not even Release()
+void PJSIPEventDispatcher::onFinalize(uint32_t for_generation) {
+    std::lock_guard<std::mutex> lock(tsfn_mutex);
+    if (for_generation == generation) {
+        active.store(false, std::memory_order_release);
+    }
+}
+
+void PJSIPEventDispatcher::post(const PJSIPEvent& event) {
+    if (!isActive()) {
+        return;
+    }
+
+    if (!queue.push(event)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // Only the producer that flips the flag pays for the event-loop hop,
+    // everything pushed until the drain runs rides along in that batch.
+    if (drain_pending.exchange(true, std::memory_order_acq_rel)) {
+        coalesced.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    scheduleDrain();
+}
+
+void PJSIPEventDispatcher::scheduleDrain() {
+    std::lock_guard<std::mutex> lock(tsfn_mutex);
+    if (!active.load(std::memory_order_acquire)) {
+        drain_pending.store(false, std::memory_order_release);
+        return;
+    }
+
+    uint32_t for_generation = generation;
+    napi_status status = tsfn.NonBlockingCall([this, for_generation](Napi::Env env, Napi::Function callback) {
+        drain(env, callback, for_generation);
+    });
+    if (status != napi_ok) {
+        drain_pending.store(false, std::memory_order_release);
+    }
+}
+
+void PJSIPEventDispatcher::drain(Napi::Env env, Napi::Function callback, uint32_t for_generation) {
+    // Left over from a previous subscription - its buffer is gone
+    if (for_generation != generation || batch == nullptr) {
+        return;
+    }
+
+    // Clear the flag before popping so a concurrent push either lands in
+    // this batch or schedules the next one.
+    drain_pending.store(false, std::memory_order_release);
+
+    size_t count = queue.popBatch(batch, MAX_BATCH);
+    if (count == 0) {
+        return;
+    }
+
+    batches.fetch_add(1, std::memory_order_relaxed);
+    delivered.fetch_add(count, std::memory_order_relaxed);
+
+    PJSIPMetrics& metrics = PJSIPMetrics::instance();
+    double now_us = pjsipMonotonicMicros();
+    for (size_t i = 0; i < count; i++) {
+        double waited_us = now_us - batch[i].timestamp_us;
+        metrics.record(PJSIPHistogram::EventQueueLatency, waited_us > 0 ? (uint64_t)waited_us : 0);
+    }
+    metrics.increment(PJSIPCounter::EventsDelivered, count);
+
+    // More than one batch worth was queued - yield to the loop and come back
+    if (queue.depth() > 0 && !drain_pending.exchange(true, std::memory_order_acq_rel)) {
+        scheduleDrain();
+    }
+
+    // Records are only valid until the callback returns
+    callback.Call({ Napi::Number::New(env, (double)count) });
+}
@@ -0,0 +1,92 @@
+#ifndef NODE_PJSIP_EVENT_QUEUE_H
+#define NODE_PJSIP_EVENT_QUEUE_H
+
+#include <napi.h>
+
+#include "mpsc_ring.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// Event kinds produced by the PJSIP callbacks
+enum class PJSIPEventType : int32_t {
+    RegState = 1,
+    IncomingCall = 2,
+    CallState = 3,
+    CallMediaState = 4
+};
+
+// Fixed-layout event record, shared byte-for-byte with JS through an
+// Int32Array/Float64Array view (8 int32 slots, timestamp in slot 3 of the
+// Float64Array). Filling one does no allocation or string formatting.
+struct PJSIPEvent {
+    PJSIPEventType type;
+    int32_t acc_id;
+    int32_t call_id;
+    int32_t state;          // pjsip_inv_state, or registration expiry for RegState
+    int32_t status_code;    // last SIP status code
+    int32_t media_status;   // pjsua_call_media_status
+    double timestamp_us;    // monotonic clock, see pjsipMonotonicMicros()
+};
+
+static_assert(sizeof(PJSIPEvent) == 32, "PJSIPEvent layout is shared with JS");
+
+// Monotonic timestamp used for event records, exposed to JS as getMonotonicTime()
+inline double pjsipMonotonicMicros() {
+    return (double)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Producers are the PJSIP worker threads, the consumer is the JS thread
+typedef PJSIPMpscRing<PJSIPEvent> PJSIPEventQueue;
+
+// Delivers queued events to a single JS callback through one
+// ThreadSafeFunction, one event-loop hop per batch. Each batch is popped
+// straight into a JS-owned ArrayBuffer that is handed out once by start(),
+// the callback only receives the record count.
+class PJSIPEventDispatcher {
+public:
+    static const size_t DEFAULT_CAPACITY = 65536;
+    static const size_t MAX_BATCH = 1024;
+
+    PJSIPEventDispatcher();
+    ~PJSIPEventDispatcher();
+
+    // JS thread only - returns the shared batch buffer
+    Napi::ArrayBuffer start(Napi::Env env, Napi::Function callback);
+    void stop();
+
+    // Any thread - never blocks
+    void post(const PJSIPEvent& event);
+
+    bool isActive() const { return active.load(std::memory_order_acquire); }
+    size_t depth() const { return queue.depth(); }
+    size_t capacity() const { return queue.capacity(); }
+    uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+    uint64_t coalescedCount() const { return coalesced.load(std::memory_order_relaxed); }
+    uint64_t batchCount() const { return batches.load(std::memory_order_relaxed); }
+    uint64_t deliveredCount() const { return delivered.load(std::memory_order_relaxed); }
+
+private:
+    void scheduleDrain();
+    void onFinalize(uint32_t for_generation);
+    void drain(Napi::Env env, Napi::Function callback, uint32_t for_generation);
+
+    PJSIPEventQueue queue;
+    Napi::Reference<Napi::ArrayBuffer> batch_ref;
+    PJSIPEvent* batch;
+    uint32_t generation;
+    Napi::ThreadSafeFunction tsfn;
+    std::mutex tsfn_mutex;
+    std::atomic<bool> active;
+    std::atomic<bool> drain_pending;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> coalesced;
+    std::atomic<uint64_t> batches;
+    std::atomic<uint64_t> delivered;
+};
+
+#endif
@@ -0,0 +1,231 @@
+#include "flow_table.h"
+#include "event_queue.h"
+#include "log_sink.h"
+#include "transport_set.h"
+
+#include <pjsua-lib/pjsua_internal.h>
+
+#include <algorithm>
+
+static bool isConnectionType(int base_type) {
+    return base_type == PJSIP_TRANSPORT_TCP || base_type == PJSIP_TRANSPORT_TLS;
+}
+
+// PJSIPFlowTable implementation
+PJSIPFlowTable::PJSIPFlowTable() : peak(0), opened(0), closed(0), failed(0), shared(0), orphaned(0) {
+    std::fill(account_flows, account_flows + PJSUA_MAX_ACC, nullptr);
+}
+
+void PJSIPFlowTable::configure(const PJSIPFlowOptions& flow_options) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        options = flow_options;
+    }
+
+    // Read by pjsip every time a connection goes idle, so it also covers
+    // connections accepted from proxies
+    if (flow_options.keep_alive >= 0) {
+        pjsip_cfg()->tcp.keep_alive_interval = flow_options.keep_alive;
+        pjsip_cfg()->tls.keep_alive_interval = flow_options.keep_alive;
+    }
+}
+
+void PJSIPFlowTable::configureAccount(pjsua_acc_config& cfg, const PJSIPAccountConfig& account) const {
+    PJSIPFlowOptions defaults;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        defaults = options;
+    }
+
+    int outbound = account.outbound >= 0 ? account.outbound : defaults.outbound;
+    if (outbound >= 0) {
+        cfg.use_rfc5626 = outbound ? PJ_TRUE : PJ_FALSE;
+    }
+    // pjsua_acc_add() copies it. Without one pjsua makes up a new instance
+    // per add, and the registrar keeps the old flow's binding until it expires.
+    if (!account.instance_id.empty()) {
+        cfg.rfc5626_instance_id = pj_str((char*)account.instance_id.c_str());
+    }
+
+    int keep_alive = account.keep_alive >= 0 ? account.keep_alive : defaults.keep_alive;
+    if (keep_alive >= 0) {
+        cfg.ka_interval = (unsigned)keep_alive;
+    }
+    if (defaults.reconnect_delay >= 0) {
+        cfg.reg_first_retry_interval = (unsigned)defaults.reconnect_delay;
+    }
+    if (defaults.reconnect_spread >= 0) {
+        cfg.reg_retry_random_interval = (unsigned)defaults.reconnect_spread;
+    }
+}
+
+void PJSIPFlowTable::onTransportState(pjsip_transport* tp, pjsip_transport_state state) {
+    if (!tp || !PJSIP_TRANSPORT_IS_RELIABLE(tp)) {
+        return;
+    }
+
+    if (state == PJSIP_TP_STATE_CONNECTED) {
+        Flow flow;
+        flow.remote_addr = tp->key.rem_addr;
+        flow.base_type = (int)tp->key.type & ~PJSIP_TRANSPORT_IPV6;
+        flow.info.type = (pjsip_transport_type_e)tp->key.type;
+        flow.info.outgoing = tp->dir == PJSIP_TP_DIR_OUTGOING;
+        flow.info.connected_us = pjsipMonotonicMicros();
+        flow.info.accounts = 0;
+
+        char remote[PJ_INET6_ADDRSTRLEN + 10];
+        pj_sockaddr_print(&tp->key.rem_addr, remote, sizeof(remote), 3);
+        flow.info.remote = remote;
+        flow.info.local = std::string(tp->local_name.host.ptr, tp->local_name.host.slen) + ":" +
+                          std::to_string(tp->local_name.port);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (flows.emplace(tp, std::move(flow)).second) {
+            opened++;
+            peak = std::max(peak, (unsigned)flows.size());
+            PJW_LOG_DEBUG("🔗 %s flow to %s up", PJSIPTransportSet::typeName((pjsip_transport_type_e)tp->key.type),
+                          remote);
+        }
+        return;
+    }
+
+    // A shut down transport still carries what is in flight, it is gone
+    // once disconnected or destroyed (whichever is reported first)
+    if (state != PJSIP_TP_STATE_DISCONNECTED && state != PJSIP_TP_STATE_DESTROY) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = flows.find(tp);
+    if (it == flows.end()) {
+        return;
+    }
+    unsigned accounts = it->second.info.accounts;
+    if (accounts > 0) {
+        failed++;
+        orphaned += accounts;
+        for (const pjsip_transport*& flow : account_flows) {
+            if (flow == tp) {
+                flow = nullptr;
+            }
+        }
+        PJW_LOG_WARN("⚠️ %s flow to %s lost with %u account(s) registered over it",
+                     PJSIPTransportSet::typeName(it->second.info.type), it->second.info.remote.c_str(), accounts);
+    }
+    flows.erase(it);
+    closed++;
+}
+
+void PJSIPFlowTable::onRegState(pjsua_acc_id acc_id, bool registered) {
+    if (acc_id < 0 || acc_id >= (pjsua_acc_id)PJSUA_MAX_ACC) {
+        return;
+    }
+
+    // pjsua holds the account lock around on_reg_state, the client
+    // registration cannot go away under us
+    const pjsip_transport* tp = nullptr;
+    if (registered && pjsua_var.acc[acc_id].regc) {
+        pjsip_regc_info info;
+        if (pjsip_regc_get_info(pjsua_var.acc[acc_id].regc, &info) == PJ_SUCCESS) {
+            tp = info.transport;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (account_flows[acc_id] == tp) {
+        return;
+    }
+    detachAccount(acc_id);
+
+    auto it = tp ? flows.find(tp) : flows.end();
+    if (it == flows.end()) {
+        return;     // UDP, or a flow that is already gone
+    }
+    if (it->second.info.accounts > 0) {
+        shared++;
+    }
+    it->second.info.accounts++;
+    account_flows[acc_id] = tp;
+}
+
+void PJSIPFlowTable::onAccountRemoved(pjsua_acc_id acc_id) {
+    if (acc_id < 0 || acc_id >= (pjsua_acc_id)PJSUA_MAX_ACC) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    detachAccount(acc_id);
+}
+
+void PJSIPFlowTable::detachAccount(pjsua_acc_id acc_id) {
+    const pjsip_transport* tp = account_flows[acc_id];
+    account_flows[acc_id] = nullptr;
+    if (!tp) {
+        return;
+    }
+    auto it = flows.find(tp);
+    if (it != flows.end() && it->second.info.accounts > 0) {
+        it->second.info.accounts--;
+    }
+}
+
+void PJSIPFlowTable::preferConnected(pjsip_server_addresses& addresses) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (flows.empty()) {
+        return;
+    }
+
+    auto connected = [this](const auto& entry) {
+        int base_type = (int)entry.type & ~PJSIP_TRANSPORT_IPV6;
+        if (!isConnectionType(base_type)) {
+            return false;
+        }
+        for (const auto& it : flows) {
+            const Flow& flow = it.second;
+            if (flow.info.outgoing && flow.base_type == base_type &&
+                pj_sockaddr_cmp(&flow.remote_addr, &entry.addr) == 0) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // Priorities stay as DNS gave them, only equals are reordered
+    unsigned start = 0;
+    while (start < addresses.count) {
+        unsigned end = start;
+        while (end < addresses.count && addresses.entry[end].priority == addresses.entry[start].priority) {
+            end++;
+        }
+        if (end - start > 1) {
+            std::stable_partition(addresses.entry + start, addresses.entry + end, connected);
+        }
+        start = end;
+    }
+}
+
+void PJSIPFlowTable::snapshot(std::vector<PJSIPFlowInfo>& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    out.reserve(out.size() + flows.size());
+    for (const auto& it : flows) {
+        out.push_back(it.second.info);
+    }
+}
+
+PJSIPFlowStats PJSIPFlowTable::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    PJSIPFlowStats out;
+    out.active = (unsigned)flows.size();
+    out.peak = peak;
+    out.opened = opened;
+    out.closed = closed;
+    out.failed = failed;
+    out.shared = shared;
+    out.orphaned = orphaned;
+    return out;
+}
+
+void PJSIPFlowTable::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    flows.clear();
+    std::fill(account_flows, account_flows + PJSUA_MAX_ACC, nullptr);
+}
@@ -0,0 +1,107 @@
+#ifndef NODE_PJSIP_FLOW_TABLE_H
+#define NODE_PJSIP_FLOW_TABLE_H
+
+#include <pjsua-lib/pjsua.h>
+
+#include "account_table.h"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// The init "flows" option. Negative values keep pjsip's defaults.
+struct PJSIPFlowOptions {
+    int keep_alive;         // seconds: CRLF keepalive on idle TCP/TLS flows and UDP ka_interval, 0 = off
+    int outbound;           // RFC 5626 for accounts that do not say (pjsua default: on)
+    int reconnect_delay;    // seconds before re-REGISTERing over a new flow (reg_first_retry_interval)
+    int reconnect_spread;   // random seconds added to that delay (reg_retry_random_interval)
+
+    PJSIPFlowOptions() : keep_alive(-1), outbound(-1), reconnect_delay(-1), reconnect_spread(-1) {}
+};
+
+struct PJSIPFlowInfo {
+    pjsip_transport_type_e type;
+    std::string local;              // "address:port"
+    std::string remote;
+    bool outgoing;                  // we connected, not accepted
+    double connected_us;            // pjsipMonotonicMicros()
+    unsigned accounts;              // registered over this flow
+};
+
+struct PJSIPFlowStats {
+    unsigned active;
+    unsigned peak;
+    uint64_t opened;
+    uint64_t closed;
+    uint64_t failed;                // closed while accounts were registered over it
+    uint64_t shared;                // registrations that joined a flow another account already used
+    uint64_t orphaned;              // accounts that lost their flow and re-register
+};
+
+// Connection-oriented SIP transports (flows) and the accounts registered
+// over them.
+//
+// pjsip already keeps one TCP/TLS connection per remote address, transport
+// type and listener and hands it to every request for that next hop, so
+// thousands of accounts behind one proxy share a handful of sockets and TLS
+// handshakes. What undoes that is DNS handing a different SRV/A record to
+// each account: preferConnected() moves the addresses we already hold a flow
+// to ahead of their equals, so the cache's weighted shuffle picks among
+// servers only for the first connection.
+//
+// The options keep flows up (RFC 5626 outbound, CRLF keepalives so NATs and
+// proxies do not time them out) and spread the re-REGISTERs that follow a
+// flow going down: pjsua re-registers every account of a failed transport
+// after reg_first_retry_interval plus up to reg_retry_random_interval.
+class PJSIPFlowTable {
+public:
+    PJSIPFlowTable();
+
+    PJSIPFlowTable(const PJSIPFlowTable&) = delete;
+    PJSIPFlowTable& operator=(const PJSIPFlowTable&) = delete;
+
+    // Before the first transport, sets pjsip's TCP/TLS keepalive interval
+    void configure(const PJSIPFlowOptions& options);
+
+    // addAccount(), per-account settings win over the init options
+    void configureAccount(pjsua_acc_config& cfg, const PJSIPAccountConfig& account) const;
+
+    // pjsua callbacks
+    void onTransportState(pjsip_transport* tp, pjsip_transport_state state);
+    void onRegState(pjsua_acc_id acc_id, bool registered);
+    void onAccountRemoved(pjsua_acc_id acc_id);
+
+    // DNS resolver thread, see PJSIPDnsCache. Reorders within each priority.
+    void preferConnected(pjsip_server_addresses& addresses) const;
+
+    void snapshot(std::vector<PJSIPFlowInfo>& out) const;
+    PJSIPFlowStats stats() const;
+
+    // Shutdown, after pjsua_destroy()
+    void clear();
+
+private:
+    struct Flow {
+        PJSIPFlowInfo info;
+        pj_sockaddr remote_addr;
+        int base_type;              // type without the IPv6 bit
+    };
+
+    void detachAccount(pjsua_acc_id acc_id);    // mutex held
+
+    mutable std::mutex mutex;
+    PJSIPFlowOptions options;
+    std::unordered_map<const pjsip_transport*, Flow> flows;
+    const pjsip_transport* account_flows[PJSUA_MAX_ACC];
+
+    unsigned peak;
+    uint64_t opened;
+    uint64_t closed;
+    uint64_t failed;
+    uint64_t shared;
+    uint64_t orphaned;
+};
+
+#endif
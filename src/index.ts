@@ -3,20 +3,692 @@ import { load } from './native';
 
 // Native addon interface
 interface NativePJSIP {
-  init(): boolean;
-  shutdown(): boolean;
+  init(options?: InitOptions): boolean;
+  shutdown(options?: ShutdownOptions): boolean;
   addAccount(aor: string, registrar: string, username: string, password: string, proxy?: string): number;
+  addAccounts(accounts: AccountConfig[] | Buffer, options?: AddAccountsOptions): Promise<ProvisionResult>;
+  unregisterAccounts(accountIds: number[] | null, options?: UnregisterAccountsOptions): Promise<UnregisterResult>;
+  snapshotAccounts(): Buffer;
+  setDraining(enabled: boolean): boolean;
+  hangupAllCalls(): number;
+  addAccountAsync(config: AccountConfig): Promise<number>;
+  removeAccountAsync(accId: number): Promise<boolean>;
+  registerAccountAsync(accId: number): Promise<boolean>;
+  unregisterAccountAsync(accId: number): Promise<boolean>;
+  makeCallAsync(accId: number, destination: string, sdp?: string): Promise<number>;
+  answerCallAsync(callId: number): Promise<boolean>;
+  hangupCallAsync(callId: number): Promise<boolean>;
+  shutdownAsync(options?: ShutdownOptions): Promise<boolean>;
   removeAccount(accId: number): boolean;
   getAccountInfo(accId: number): AccountInfo | null;
   getAccounts(): AccountInfo[];
+  getAccountPoolStats(): AccountPoolStats;
   registerAccount(accId: number): boolean;
   unregisterAccount(accId: number): boolean;
-  makeCall(accId: number, destination: string): boolean;
+  makeCall(accId: number, destination: string, sdp?: string): number;
   answerCall(accId: number, callId: string, fromTag: string, toTag: string, cseqNum: number): boolean;
   hangupCall(accId: number, callId: string, fromTag: string, toTag: string, cseqNum: number): boolean;
+  setCallSdp(callId: number, sdp: string): boolean;
+  getCallSdp(callId: number): CallSdp;
   getVersion(): string;
   getLocalIP(): string;
   getBoundPort(): number;
+  getTransports(): TransportInfo[];
+  setEventCallback(callback: ((count: number) => void) | null): ArrayBuffer | boolean;
+  getEventQueueStats(): EventQueueStats;
+  getMetrics(): Metrics;
+  getPrometheusMetrics(): string;
+  resetMetrics(): void;
+  startMediaStats(intervalMs: number, callback: (count: number) => void): ArrayBuffer;
+  stopMediaStats(): boolean;
+  getMediaStatsCounters(): MediaStatsCounters;
+  getCalls(): ArrayBuffer;
+  getCall(callId: number): CallInfoRecord | null;
+  getCallStats(): CallStats;
+  setAdmissionPolicy(policy: AdmissionPolicy): boolean;
+  setLogOptions(options: LogOptions): boolean;
+  getLogStats(): LogStats;
+  flushLog(): void;
+  getAdmissionStats(): AdmissionStats;
+  getMonotonicTime(): number;
+  getCallConfSlot(callId: number): number;
+  connectMedia(sourceSlot: number, sinkSlot: number): boolean;
+  disconnectMedia(sourceSlot: number, sinkSlot: number): boolean;
+  createPlayer(path: string, loop?: boolean): MediaPort | null;
+  destroyPlayer(playerId: number): boolean;
+  createRecorder(path: string): MediaPort | null;
+  destroyRecorder(recorderId: number): boolean;
+  createMediaTap(options: MediaTapOptions, callback: (firstFrame: number, frames: number) => void): NativeMediaTap | null;
+  destroyMediaTap(tapId: number): boolean;
+  injectTapAudio(tapId: number, pcm: ArrayBufferView): number;
+  getMediaTapStats(tapId: number): MediaTapStats | null;
+  startRecording(callId: number, path: string, options?: RecordingOptions): number;
+  stopRecording(recordingId: number): Promise<RecordingStats> | null;
+  getRecordingStats(recordingId: number): RecordingStats | null;
+  bridgeCalls(callA: number, callB: number, options?: BridgeOptions): boolean;
+  unbridgeCalls(callId: number): boolean;
+  getCallBridge(callId: number): CallBridge | null;
+  getBridgeStats(): BridgeStats;
+  prewarmDns(targets: string[]): Promise<DnsResult[]>;
+  flushDnsCache(): number;
+  getDnsStats(): DnsStats;
+  getFlows(): FlowInfo[];
+  getFlowStats(): FlowStats;
+  startCapture(options: CaptureOptions): boolean;
+  stopCapture(): CaptureStats;
+  getCaptureStats(): CaptureStats;
+  getCodecs(): CodecInfo[];
+  setCodecPriority(codecId: string, priority: number): boolean;
+  setCodecParams(codecId: string, params: CodecParams): boolean;
+  getCallCodec(callId: number): CallCodec | null;
+  getCodecUsage(): CodecUsage | null;
+}
+
+// Player or recorder attached to the conference bridge
+export interface MediaPort {
+  id: number;
+  slot: number;
+}
+
+// PCM tap on the conference bridge, 16-bit mono at the bridge clock rate
+export interface MediaTapOptions {
+  callId?: number;    // connect the call to the tap (and the tap back to the call with inject)
+  frames?: number;    // ring capacity in frames, default 50 (one second at 20 ms)
+  inject?: boolean;   // enable injectTapAudio()
+}
+
+interface NativeMediaTap extends MediaPort {
+  buffer: ArrayBuffer;
+  clockRate: number;
+  samplesPerFrame: number;
+  frameBytes: number;
+  frames: number;
+}
+
+export interface MediaTap extends MediaPort {
+  clockRate: number;
+  samplesPerFrame: number;
+  frameBytes: number;
+  frames: number;
+}
+
+// Registered codec with its default parameters
+export interface CodecInfo {
+  id: string;                // 'PCMU/8000/1', usable with setCodecPriority()
+  description: string;
+  priority: number;          // 0 = disabled
+  clockRate: number;
+  channels: number;
+  bitrate: number;           // average bits per second
+  payloadType: number;
+  ptime: number;             // ms per packet
+  vad: boolean;
+  plc: boolean;
+  cng: boolean;
+  penh: boolean;
+}
+
+// Codec defaults to change, omitted fields stay as they are
+export interface CodecParams {
+  ptime?: number;            // rounded to whole codec frames
+  vad?: boolean;
+  plc?: boolean;
+  cng?: boolean;
+  penh?: boolean;            // perceptual enhancement
+}
+
+// Negotiated audio codec of one call
+export interface CallCodec {
+  id: string;
+  clockRate: number;
+  channels: number;
+  payloadType: number;
+  ptime: number;
+  vad: boolean;
+  resampled: boolean;        // clock differs from the bridge's
+}
+
+// Bridge-wide transcoding cost of the codecs in use
+export interface CodecUsage {
+  bridgeClockRate: number;
+  streams: number;           // calls with active audio
+  resampled: number;         // of which not at the bridge clock
+  connections: number;       // directed call-to-call bridge connections
+  transcoded: number;        // of which between different codecs
+  codecs: Record<string, number>; // streams per codec id
+}
+
+export interface MediaTapStats {
+  captured: number;
+  dropped: number;      // frames lost because the listener fell behind
+  delivered: number;
+  injected: number;
+  played: number;
+  underruns: number;    // bridge pulls that found nothing injected
+  queued: number;
+  maxQueued: number;
+}
+
+export interface BridgeOptions {
+  relay?: boolean;           // forward RTP untouched when the codecs match, default true
+  hangupTogether?: boolean;  // either leg ending hangs up the other, default true
+}
+
+export interface CallBridge {
+  peer: number;
+  mode: 'relay' | 'mixed' | 'pending';
+  hangupTogether: boolean;
+  relayedRtp: number;        // packets received on this leg and forwarded
+  relayedRtcp: number;
+  mediaUpdates: number;      // re-INVITEs and hold changes handled natively
+}
+
+export interface BridgeStats {
+  pairs: number;
+  relayed: number;
+  mixed: number;
+  pending: number;
+}
+
+export interface RecordingOptions {
+  stereo?: boolean;                      // left: what the call receives, right: what it is sent
+  encoding?: 'pcm' | 'pcmu' | 'pcma';    // 16-bit linear (default) or G.711 in the WAV file
+  bufferMs?: number;                     // disk stall absorbed without loss, default 2000
+  sync?: boolean;                        // fsync before stopRecording() resolves
+}
+
+export interface RecordingStats {
+  callId: number;
+  stereo: boolean;
+  encoding: 'pcm' | 'pcmu' | 'pcma';
+  finished: boolean;    // file complete and closed
+  frames: number;       // per channel
+  durationMs: number;
+  dropped: number;      // frames lost because the writer fell behind
+  bytes: number;
+  writeErrors: number;
+  maxQueued: number;
+  clockRate: number;
+  ptime: number;
+}
+
+// Engine sizing options, omitted fields keep pjsua's defaults
+export interface InitOptions {
+  maxCalls?: number;         // concurrent calls, capped at PJSUA_MAX_CALLS
+  threadCount?: number;      // SIP worker threads
+  mediaThreadCount?: number; // media worker threads
+  mediaIoqueue?: boolean;    // give media its own ioqueue
+  clockRate?: number;        // conference bridge clock rate
+  ptime?: number;            // audio frame length in ms
+  confPorts?: number;        // conference bridge port count
+  audioDevice?: 'default' | 'null' | 'none'; // 'null' for servers without a sound card
+  autoConnectAudio?: boolean; // bridge calls to slot 0, defaults to true only with a sound device
+  logLevel?: number;         // pjlib log level 0-6, default 4
+  transports?: TransportConfig[]; // SIP listeners, default one UDP socket on 5060
+  media?: 'full' | 'signalling'; // 'signalling': SIP only, no streams, codecs or bridge clock
+  sdp?: string;              // signalling mode: body for calls without their own
+  dns?: DnsOptions;          // asynchronous resolver and cache, default blocking getaddrinfo
+  flows?: FlowOptions;       // keepalive, outbound and reconnect pacing of TCP/TLS connections
+}
+
+// Connections to proxies and registrars, see InitOptions.flows
+export interface FlowOptions {
+  keepAliveInterval?: number; // seconds between CRLF keepalives on idle TCP/TLS flows and UDP, 0 = off
+  outbound?: boolean;        // RFC 5626 outbound for accounts that do not say, default true
+  reconnectDelay?: number;   // seconds before re-REGISTERing after a flow fails
+  reconnectSpread?: number;  // up to this many random seconds added to reconnectDelay, default 10
+}
+
+export interface FlowInfo {
+  transport: string;         // 'tcp', 'tls', 'tcp6', 'tls6'
+  local: string;             // 'address:port'
+  remote: string;
+  outgoing: boolean;         // opened by us, not accepted
+  connectedAt: number;       // monotonic microseconds
+  accounts: number;          // registered over this flow
+}
+
+export interface FlowStats {
+  active: number;
+  peak: number;
+  opened: number;
+  closed: number;
+  failed: number;            // closed with accounts registered over them
+  shared: number;            // registrations that joined another account's flow
+  orphaned: number;          // accounts that lost their flow
+}
+
+// Resolution of registrars, proxies and call targets, see InitOptions.dns
+export interface DnsOptions {
+  nameservers: string | string[]; // '10.0.0.53', '127.0.0.1:5353', '[::1]:53'
+  maxTtl?: number;           // seconds, caps record TTLs, default 3600
+  negativeTtl?: number;      // seconds a failed lookup is remembered, default 30
+  naptr?: boolean;           // NAPTR before SRV for URIs without a transport, default true
+}
+
+export interface DnsAddress {
+  address: string;
+  port: number;
+  transport: string;         // 'udp', 'tcp', 'tls', 'udp6', ...
+  priority: number;          // SRV priority and weight, 0 without SRV
+  weight: number;
+}
+
+// One prewarmDns() target
+export interface DnsResult {
+  target: string;
+  status: number;            // 0, else the pjlib status of the failed lookup
+  addresses: DnsAddress[];
+  ttl: number;               // seconds the answer stays cached
+  cached: boolean;           // already in the cache
+}
+
+export interface DnsStats {
+  active: boolean;
+  hits: number;
+  negativeHits: number;      // answered with a remembered failure
+  misses: number;
+  coalesced: number;         // requests that waited for a lookup already in flight
+  refreshes: number;         // lookups started ahead of expiry
+  expired: number;
+  queries: number;           // DNS queries sent
+  failures: number;
+  entries: number;
+  pending: number;
+}
+
+// SIP message capture, see startCapture()
+export interface CaptureOptions {
+  format?: 'pcap' | 'hep';   // default 'pcap'
+  path?: string;             // pcap: file, numbered before the extension when rotating
+  rotateBytes?: number;      // pcap: start a new file after this many bytes, 0 = one file
+  maxFiles?: number;         // pcap: rotated files kept, oldest removed, 0 = all
+  collector?: string;        // hep: 'ip:port' or '[ipv6]:port', port defaults to 9060
+  agentId?: number;          // hep: capture agent id
+  password?: string;         // hep: auth key
+  sample?: number;           // fraction of dialogs (by Call-ID) captured, default 1
+  methods?: string | string[]; // request methods, responses by CSeq method
+  callIds?: string | string[];
+  accounts?: number[];       // account ids, matched against From and To
+  bufferKb?: number;         // ring per SIP thread, default 1024
+}
+
+export interface CaptureStats {
+  active: boolean;
+  format: 'pcap' | 'hep';
+  captured: number;          // messages copied into a ring
+  filtered: number;          // skipped by filters or sampling
+  dropped: number;           // lost because the writer fell behind
+  written: number;
+  bytes: number;             // SIP bytes written or sent
+  files: number;             // pcap files opened
+  writeErrors: number;
+  rings: number;             // SIP threads that captured
+  file: string;              // pcap file being written
+}
+
+// One SIP listener, see InitOptions.transports
+export interface TransportConfig {
+  type?: 'udp' | 'tcp' | 'tls' | 'udp6' | 'tcp6' | 'tls6'; // default 'udp'
+  port?: number;             // default 5060 (5061 for TLS), 0 = ephemeral
+  bindAddress?: string;      // default any interface
+  publicAddress?: string;    // host advertised in Via/Contact
+  sockets?: number;          // UDP: sockets sharing the port via SO_REUSEPORT
+  pendingReads?: number;     // UDP: concurrent ioqueue reads per socket
+  recvBufferSize?: number;   // SO_RCVBUF bytes
+  sendBufferSize?: number;   // SO_SNDBUF bytes
+  certFile?: string;         // TLS
+  privateKeyFile?: string;   // TLS
+  caListFile?: string;       // TLS
+  password?: string;         // TLS private key password
+  verifyServer?: boolean;    // TLS
+  verifyClient?: boolean;    // TLS, also requires a client certificate
+}
+
+export interface TransportInfo {
+  id: number;
+  type: string;
+  listener: number;          // index into InitOptions.transports
+  socket: number;            // socket index within a UDP listener
+  address: string;
+  port: number;
+  rxPackets: number;         // SIP messages, all connections of a TCP/TLS listener
+  rxBytes: number;
+  txPackets: number;
+  txBytes: number;
+}
+
+// Runtime logging configuration, see setLogOptions()
+export interface LogOptions {
+  level?: number;            // wrapper log level: 1 error, 2 warning, 3 info, 4 debug
+  pjsipLevel?: number;       // pjlib log level 0-6
+  target?: 'stdout' | 'stderr' | 'file' | 'callback' | 'none';
+  path?: string;             // for target 'file'
+  callback?: (entries: LogEntry[]) => void; // for target 'callback', one call per batch
+  filter?: string;           // only lines containing this substring
+  sources?: Array<'wrapper' | 'pjsip'>;
+}
+
+export interface LogEntry {
+  level: number;
+  source: 'wrapper' | 'pjsip';
+  message: string;
+  timestamp: number;         // microseconds, same clock as getMonotonicTime()
+}
+
+export interface LogStats {
+  written: number;
+  dropped: number;           // ring buffer full
+  filtered: number;
+  callbackDropped: number;   // JS callback queue full
+  depth: number;
+  capacity: number;
+}
+
+// Event kinds produced by the native event pipeline
+export enum NativeEventType {
+  RegState = 1,
+  IncomingCall = 2,
+  CallState = 3,
+  CallMediaState = 4
+}
+
+// Invite session states (pjsip_inv_state)
+export enum CallState {
+  Null = 0,
+  Calling = 1,
+  Incoming = 2,
+  Early = 3,
+  Connecting = 4,
+  Confirmed = 5,
+  Disconnected = 6
+}
+
+// Call media states (pjsua_call_media_status)
+export enum MediaStatus {
+  None = 0,
+  Active = 1,
+  LocalHold = 2,
+  RemoteHold = 3,
+  Error = 4
+}
+
+// Structured call event, only built when somebody listens for it
+export interface CallEvent {
+  callId: number;
+  accId: number;
+  state: CallState;
+  statusCode: number;
+  mediaStatus: MediaStatus;
+  timestamp: number; // microseconds, same clock as getMonotonicTime()
+}
+
+// Native event record layout: 32 bytes, 8 int32 slots with the
+// timestamp stored as a float64 in the last 8 bytes
+const EVENT_RECORD_INTS = 8;
+const EVENT_TYPE = 0;
+const EVENT_ACC_ID = 1;
+const EVENT_CALL_ID = 2;
+const EVENT_STATE = 3;
+const EVENT_STATUS_CODE = 4;
+const EVENT_MEDIA_STATUS = 5;
+const EVENT_TIMESTAMP = 3; // float64 slot
+
+export enum CallDirection {
+  Unknown = 0,
+  Outgoing = 1,
+  Incoming = 2
+}
+
+// Native call table record layout: 64 bytes, 8 int32 slots followed by
+// 4 float64 timestamps (microseconds, 0 = not reached yet)
+export const CALL_RECORD_INTS = 16;
+export const CALL_RECORD_DOUBLES = 8;
+export const CALL_ID = 0;
+export const CALL_ACC_ID = 1;
+export const CALL_STATE = 2;
+export const CALL_STATUS_CODE = 3;
+export const CALL_MEDIA_STATUS = 4;
+export const CALL_DIRECTION = 5;
+export const CALL_STATE_CHANGES = 6;
+export const CALL_CREATED_AT = 4; // float64 slots
+export const CALL_CONNECTED_AT = 5;
+export const CALL_DISCONNECTED_AT = 6;
+export const CALL_UPDATED_AT = 7;
+
+// Snapshot of every active call, read record i at ints[i * CALL_RECORD_INTS + CALL_*]
+// and times[i * CALL_RECORD_DOUBLES + CALL_*_AT]
+export interface CallTableSnapshot {
+  count: number;
+  ints: Int32Array;
+  times: Float64Array;
+}
+
+// Native media stats record layout: 128 bytes, 8 int32 slots followed by
+// 12 float64 slots. Jitter and RTT in milliseconds, loss percentages cover
+// the interval since the previous snapshot.
+export const MEDIA_STATS_RECORD_INTS = 32;
+export const MEDIA_STATS_RECORD_DOUBLES = 16;
+export const MEDIA_CALL_ID = 0;
+export const MEDIA_ACC_ID = 1;
+export const MEDIA_INDEX = 2;
+export const MEDIA_RX_PACKETS = 3;
+export const MEDIA_RX_LOST = 4;
+export const MEDIA_RX_DISCARDED = 5;
+export const MEDIA_TX_PACKETS = 6;
+export const MEDIA_TX_LOST = 7;
+export const MEDIA_RX_BYTES = 4; // float64 slots
+export const MEDIA_TX_BYTES = 5;
+export const MEDIA_RX_JITTER = 6;
+export const MEDIA_RX_JITTER_MAX = 7;
+export const MEDIA_TX_JITTER = 8;
+export const MEDIA_RTT = 9;
+export const MEDIA_RTT_MEAN = 10;
+export const MEDIA_RX_LOSS_PCT = 11;
+export const MEDIA_TX_LOSS_PCT = 12;
+export const MEDIA_R_FACTOR = 13;
+export const MEDIA_MOS = 14;
+export const MEDIA_SAMPLED_AT = 15;
+
+// One interval of RTP/RTCP stats, read record i at ints[i * MEDIA_STATS_RECORD_INTS + MEDIA_*]
+// and values[i * MEDIA_STATS_RECORD_DOUBLES + MEDIA_*]. Only valid inside the listener.
+export interface MediaStatsSnapshot {
+  count: number;
+  ints: Int32Array;
+  values: Float64Array;
+}
+
+export interface MediaStatsCounters {
+  running: boolean;
+  samples: number;
+  skipped: number;    // intervals skipped while a listener still held the previous snapshot
+  records: number;
+}
+
+// One call from the native call table
+// Signalling mode bodies of one call, null until set or received
+export interface CallSdp {
+  local: string | null;      // setCallSdp() / makeCall() body
+  remote: string | null;     // last offer or answer from the peer
+}
+
+export interface CallInfoRecord {
+  callId: number;
+  accId: number;
+  state: CallState;
+  statusCode: number;
+  mediaStatus: MediaStatus;
+  direction: CallDirection;
+  stateChanges: number;
+  remoteUri: string;
+  createdAt: number;
+  connectedAt: number;
+  updatedAt: number;
+}
+
+export interface CallStats {
+  active: number;
+  capacity: number;
+  peak: number;
+  total: number;
+}
+
+// Incoming call admission, evaluated natively before JS hears about a call.
+// Zero disables a limit.
+export interface AdmissionPolicy {
+  maxCalls?: number;            // concurrent calls, over it -> 503
+  maxCallsPerAccount?: number;  // concurrent calls per account, over it -> 486
+  cps?: number;                 // new incoming calls per second, over it -> 503
+  cpsBurst?: number;            // token bucket size, defaults to cps
+  maxCpu?: number;              // process CPU % of all cores, over it -> 503
+  maxQueueDepth?: number;       // undelivered native events, over it -> 503
+  retryAfter?: number;          // Retry-After seconds on 503, default 5
+  acceptCode?: 200 | 180 | 183; // 200 auto-answers (default), 180/183 leave it to answerCall()
+}
+
+export interface AdmissionStats {
+  offered: number;
+  accepted: number;
+  rejectedOverload: number;
+  rejectedGlobalLimit: number;
+  rejectedRate: number;
+  rejectedAccountLimit: number;
+  rejectedDraining: number;
+  active: number;
+  cpu: number;
+  draining: boolean;
+}
+
+// Native event pipeline counters
+export interface EventQueueStats {
+  depth: number;
+  capacity: number;
+  dropped: number;
+  coalesced: number;
+  batches: number;
+  delivered: number;
+}
+
+// Latency distribution, all values in microseconds
+export interface HistogramSummary {
+  count: number;
+  sum: number;
+  max: number;
+  p50: number;
+  p90: number;
+  p99: number;
+  p999: number;
+}
+
+// Native metrics snapshot
+export interface Metrics {
+  counters: {
+    callsIncoming: number;
+    callsOutgoing: number;
+    callsConnected: number;
+    callsFailed: number;
+    callsEnded: number;
+    registrationsSent: number;
+    registrationsSucceeded: number;
+    registrationsFailed: number;
+    callbacks: number;
+    eventsDelivered: number;
+    dnsCacheHits: number;
+    dnsCacheMisses: number;
+    dnsLookupsFailed: number;
+  };
+  gauges: {
+    activeCalls: number;
+    activeRegistrations: number;
+    eventQueueDepth: number;
+    eventsDropped: number;
+    dnsCacheEntries: number;
+    sipFlows: number;
+  };
+  histograms: {
+    inviteToAnswer: HistogramSummary;
+    registerRoundTrip: HistogramSummary;
+    callbackDuration: HistogramSummary;
+    eventQueueLatency: HistogramSummary;
+    dnsLookup: HistogramSummary;
+  };
+  failures: {
+    call: { [statusCode: string]: number };
+    registration: { [statusCode: string]: number };
+  };
+}
+
+// Account configuration for addAccount/addAccounts
+export interface AccountConfig {
+  aor: string;
+  registrar: string;
+  username: string;
+  password: string;
+  proxy?: string;
+  regTimeout?: number;
+  outbound?: boolean;        // RFC 5626 outbound, default InitOptions.flows.outbound
+  instanceId?: string;       // '<urn:uuid:...>', keep it across restarts
+  keepAliveInterval?: number; // seconds between UDP keepalives, 0 = off
+}
+
+// Pacing for bulk registration
+export interface AddAccountsOptions {
+  rate?: number;            // REGISTERs per second, default 50
+  burst?: number;           // REGISTERs sent back to back, default 10
+  jitter?: number;          // +/- fraction of each send gap, default 0.2
+  window?: number;          // max REGISTERs awaiting a response, default 100
+  regTimeout?: number;      // registration expiry in seconds
+  refreshSpread?: number;   // +/- fraction of regTimeout per account, default 0.1
+  onProgress?: (progress: ProvisionProgress) => void;
+}
+
+export interface ProvisionProgress {
+  total: number;
+  added: number;
+  registered: number;
+  failed: number;
+  inFlight: number;
+}
+
+export interface ProvisionResult extends ProvisionProgress {
+  accountIds: number[];     // -1 where the account could not be added
+}
+
+// Pacing for unregisterAccounts(), same meaning as for addAccounts()
+export interface UnregisterAccountsOptions {
+  rate?: number;
+  burst?: number;
+  jitter?: number;
+  window?: number;
+  onProgress?: (progress: UnregisterProgress) => void;
+}
+
+export interface UnregisterProgress {
+  total: number;
+  unregistered: number;
+  failed: number;
+  inFlight: number;
+}
+
+export interface UnregisterResult extends UnregisterProgress {
+  accountIds: number[];     // unknown ids come back as -1 and count as failed
+}
+
+export interface DrainOptions extends UnregisterAccountsOptions {
+  timeout?: number;         // ms to let calls end on their own, default 30000
+  hangupGrace?: number;     // ms to wait for BYEs after the timeout, default 2000
+  unregister?: boolean;     // unregister every account meanwhile, default true
+  pollInterval?: number;    // ms, default 250
+}
+
+export interface DrainResult {
+  callsAtStart: number;
+  callsHungUp: number;      // still up at the timeout
+  unregistration: UnregisterResult | null;
+}
+
+export interface ShutdownOptions {
+  network?: boolean;        // false: no un-REGISTER or BYE, for a drained node
 }
 
 // Account information interface
@@ -29,6 +701,15 @@ export interface AccountInfo {
   regState: number;
 }
 
+// Native account record allocator, blocks are recycled on removal
+export interface AccountPoolStats {
+  inUse: number;
+  free: number;
+  bytesReserved: number;
+  allocations: number;  // blocks taken from the heap
+  reuses: number;       // blocks served from a free list
+}
+
 // Call information interface
 export interface CallInfo {
   callId: string;
@@ -42,6 +723,9 @@ export interface CallInfo {
 export class PJSIP extends EventEmitter {
   private native: NativePJSIP;
   private isInitialized: boolean = false;
+  private eventInts: Int32Array = new Int32Array(0);
+  private eventTimes: Float64Array = new Float64Array(0);
+  private mediaStats: MediaStatsSnapshot | null = null;
 
   constructor() {
     super();
@@ -51,14 +735,17 @@ export class PJSIP extends EventEmitter {
   /**
    * Initialize PJSIP library
    */
-  async init(): Promise<boolean> {
+  async init(options: InitOptions = {}): Promise<boolean> {
     if (this.isInitialized) {
       return true;
     }
 
     try {
-      const result = this.native.init();
+      const result = this.native.init(options);
       if (result) {
+        const buffer = this.native.setEventCallback((count) => this.dispatchEvents(count)) as ArrayBuffer;
+        this.eventInts = new Int32Array(buffer);
+        this.eventTimes = new Float64Array(buffer);
         this.isInitialized = true;
         this.emit('initialized');
       }
@@ -72,13 +759,13 @@ export class PJSIP extends EventEmitter {
   /**
    * Shutdown PJSIP library
    */
-  async shutdown(): Promise<boolean> {
+  async shutdown(options?: ShutdownOptions): Promise<boolean> {
     if (!this.isInitialized) {
       return true;
     }
 
     try {
-      const result = this.native.shutdown();
+      const result = this.native.shutdown(options);
       if (result) {
         this.isInitialized = false;
         this.emit('shutdown');
@@ -119,6 +806,155 @@ export class PJSIP extends EventEmitter {
     return accountId;
   }
 
+  /**
+   * Add many SIP accounts and register them at a paced rate.
+   * Accepts account objects or a Buffer of NUL-terminated
+   * aor, registrar, username, password, proxy records.
+   */
+  addAccounts(accounts: AccountConfig[] | Buffer, options: AddAccountsOptions = {}): Promise<ProvisionResult> {
+    if (!this.isInitialized) {
+      return Promise.reject(new Error('PJSIP not initialized'));
+    }
+
+    return this.native.addAccounts(accounts, options).then((result) => {
+      for (const accountId of result.accountIds) {
+        if (accountId >= 0) {
+          this.emit('accountAdded', accountId);
+        }
+      }
+      return result;
+    });
+  }
+
+  /**
+   * Unregister the given accounts, or every registered one, at a paced rate.
+   * The accounts stay in place until removed or shut down.
+   */
+  unregisterAccounts(accountIds: number[] | null = null, options: UnregisterAccountsOptions = {}): Promise<UnregisterResult> {
+    if (!this.isInitialized) {
+      return Promise.reject(new Error('PJSIP not initialized'));
+    }
+
+    return this.native.unregisterAccounts(accountIds, options);
+  }
+
+  /**
+   * Every account as addAccounts() Buffer records, passwords included.
+   * Treat the result as a secret.
+   */
+  snapshotAccounts(): Buffer {
+    return this.native.snapshotAccounts();
+  }
+
+  /**
+   * Bring back a snapshotAccounts() Buffer in one paced bulk add
+   */
+  restoreAccounts(snapshot: Buffer, options: AddAccountsOptions = {}): Promise<ProvisionResult> {
+    return this.addAccounts(snapshot, options);
+  }
+
+  /**
+   * Refuse new calls (503 to incoming, -1 from makeCall) while calls up continue
+   */
+  setDraining(enabled: boolean): boolean {
+    return this.native.setDraining(enabled);
+  }
+
+  /**
+   * Hang up every call, returns how many were up
+   */
+  hangupAllCalls(): number {
+    return this.native.hangupAllCalls();
+  }
+
+  /**
+   * Take the node out of service: refuse new calls, unregister in paced
+   * batches, give calls up to timeout to end and hang up the rest.
+   * Follow with shutdownAsync({ network: false }).
+   */
+  async drain(options: DrainOptions = {}): Promise<DrainResult> {
+    const timeout = options.timeout ?? 30000;
+    const pollInterval = options.pollInterval ?? 250;
+    const activeCalls = () => this.native.getCallStats().active;
+    const waitForCalls = async (until: number) => {
+      while (activeCalls() > 0 && Date.now() < until) {
+        await new Promise((resolve) => setTimeout(resolve, pollInterval));
+      }
+    };
+
+    this.native.setDraining(true);
+    this.emit('draining');
+    const callsAtStart = activeCalls();
+    const unregistration = options.unregister === false ? Promise.resolve(null)
+                                                         : this.unregisterAccounts(null, options);
+
+    await waitForCalls(Date.now() + timeout);
+    let callsHungUp = 0;
+    if (activeCalls() > 0) {
+      callsHungUp = this.native.hangupAllCalls();
+      await waitForCalls(Date.now() + (options.hangupGrace ?? 2000));
+    }
+
+    return { callsAtStart, callsHungUp, unregistration: await unregistration };
+  }
+
+  /**
+   * Promise-returning variants. These run on a native thread registered with
+   * pjlib, so slow pjsua calls never block the event loop; account commands
+   * queued together share one pjsua lock acquisition. They reject when the
+   * native call fails.
+   */
+  async addAccountAsync(config: AccountConfig): Promise<number> {
+    if (!this.isInitialized) {
+      throw new Error('PJSIP not initialized');
+    }
+
+    const accountId = await this.native.addAccountAsync(config);
+    this.emit('accountAdded', accountId);
+    return accountId;
+  }
+
+  async removeAccountAsync(accountId: number): Promise<boolean> {
+    const result = await this.native.removeAccountAsync(accountId);
+    this.emit('accountRemoved', accountId);
+    return result;
+  }
+
+  registerAccountAsync(accountId: number): Promise<boolean> {
+    this.emit('registering', accountId);
+    return this.native.registerAccountAsync(accountId);
+  }
+
+  unregisterAccountAsync(accountId: number): Promise<boolean> {
+    this.emit('unregistering', accountId);
+    return this.native.unregisterAccountAsync(accountId);
+  }
+
+  async makeCallAsync(accountId: number, destination: string, sdp?: string): Promise<number> {
+    const callId = await this.native.makeCallAsync(accountId, destination, sdp);
+    this.emit('callInitiated', accountId, destination, callId);
+    return callId;
+  }
+
+  answerCallAsync(callId: number): Promise<boolean> {
+    return this.native.answerCallAsync(callId);
+  }
+
+  hangupCallAsync(callId: number): Promise<boolean> {
+    return this.native.hangupCallAsync(callId);
+  }
+
+  async shutdownAsync(options?: ShutdownOptions): Promise<boolean> {
+    if (!this.isInitialized) {
+      return true;
+    }
+
+    const result = await this.native.shutdownAsync(options);
+    this.isInitialized = false;
+    this.emit('shutdown');
+    return result;
+  }
+
   /**
    * Remove SIP account
    */
@@ -157,6 +993,13 @@ export class PJSIP extends EventEmitter {
     return this.native.getAccounts();
   }
 
+  /**
+   * Get native account record allocator counters
+   */
+  getAccountPoolStats(): AccountPoolStats {
+    return this.native.getAccountPoolStats();
+  }
+
   /**
    * Register account
    */
@@ -190,19 +1033,95 @@ export class PJSIP extends EventEmitter {
   }
 
   /**
-   * Make a call
+   * Make a call, returns the call id or -1. The SDP offer is only accepted
+   * in signalling mode.
    */
-  makeCall(accountId: number, destination: string): boolean {
+  makeCall(accountId: number, destination: string, sdp?: string): number {
     if (!this.isInitialized) {
-      return false;
+      return -1;
     }
 
-    const result = this.native.makeCall(accountId, destination);
-    if (result) {
-      this.emit('callInitiated', accountId, destination);
+    const callId = this.native.makeCall(accountId, destination, sdp);
+    if (callId >= 0) {
+      this.emit('callInitiated', accountId, destination, callId);
     }
 
-    return result;
+    return callId;
+  }
+
+  /**
+   * Copy every active call out of the native call table in one pass
+   */
+  getCalls(): CallTableSnapshot {
+    const buffer = this.native.getCalls();
+    return {
+      count: buffer.byteLength / (CALL_RECORD_INTS * 4),
+      ints: new Int32Array(buffer),
+      times: new Float64Array(buffer)
+    };
+  }
+
+  /**
+   * Get one call, including its remote URI
+   */
+  getCall(callId: number): CallInfoRecord | null {
+    return this.native.getCall(callId);
+  }
+
+  /**
+   * Signalling mode: SDP sent in the next answer or offer of this call
+   */
+  setCallSdp(callId: number, sdp: string): boolean {
+    return this.native.setCallSdp(callId, sdp);
+  }
+
+  /**
+   * Signalling mode: local and remote SDP of a call, for passthrough
+   */
+  getCallSdp(callId: number): CallSdp {
+    return this.native.getCallSdp(callId);
+  }
+
+  /**
+   * Set the incoming call admission policy
+   */
+  setAdmissionPolicy(policy: AdmissionPolicy): boolean {
+    return this.native.setAdmissionPolicy(policy);
+  }
+
+  /**
+   * Change log level, destination and filtering at runtime
+   */
+  setLogOptions(options: LogOptions): boolean {
+    return this.native.setLogOptions(options);
+  }
+
+  /**
+   * Get native log sink counters
+   */
+  getLogStats(): LogStats {
+    return this.native.getLogStats();
+  }
+
+  /**
+   * Wait (up to a second) until queued log lines have been written
+   */
+  flushLog(): void {
+    this.native.flushLog();
+  }
+
+  /**
+   * Get accepted and rejected incoming call counters
+   */
+  getAdmissionStats(): AdmissionStats {
+    return this.native.getAdmissionStats();
+  }
+
+  /**
+   * Get active, peak and total call counts
+   */
+  getCallStats(): CallStats {
+    return this.native.getCallStats();
   }
 
   /**
@@ -258,6 +1177,374 @@ export class PJSIP extends EventEmitter {
     return this.native.getBoundPort();
   }
 
+  /**
+   * Get every SIP listener with its message and byte counters
+   */
+  getTransports(): TransportInfo[] {
+    return this.native.getTransports();
+  }
+
+  /**
+   * Get the conference bridge slot of a call
+   */
+  getCallConfSlot(callId: number): number {
+    return this.native.getCallConfSlot(callId);
+  }
+
+  /**
+   * Route audio from one bridge slot to another
+   */
+  connectMedia(sourceSlot: number, sinkSlot: number): boolean {
+    return this.native.connectMedia(sourceSlot, sinkSlot);
+  }
+
+  /**
+   * Stop routing audio from one bridge slot to another
+   */
+  disconnectMedia(sourceSlot: number, sinkSlot: number): boolean {
+    return this.native.disconnectMedia(sourceSlot, sinkSlot);
+  }
+
+  /**
+   * Create a WAV file player on the bridge
+   */
+  createPlayer(path: string, loop: boolean = false): MediaPort | null {
+    return this.native.createPlayer(path, loop);
+  }
+
+  /**
+   * Destroy a WAV file player
+   */
+  destroyPlayer(playerId: number): boolean {
+    return this.native.destroyPlayer(playerId);
+  }
+
+  /**
+   * Create a WAV file recorder on the bridge
+   */
+  createRecorder(path: string): MediaPort | null {
+    return this.native.createRecorder(path);
+  }
+
+  /**
+   * Destroy a WAV file recorder
+   */
+  destroyRecorder(recorderId: number): boolean {
+    return this.native.destroyRecorder(recorderId);
+  }
+
+  /**
+   * Stream PCM from the bridge into `onAudio` without copying. Each call
+   * gets a Buffer view of one or more whole frames that is only valid until
+   * it returns; copy what you keep.
+   */
+  createMediaTap(options: MediaTapOptions, onAudio: (pcm: Buffer, frames: number) => void): MediaTap | null {
+    let frameBytes = 0;
+    let ring: ArrayBuffer | null = null;
+    const tap = this.native.createMediaTap(options, (firstFrame, frames) => {
+      if (ring) {
+        onAudio(Buffer.from(ring, firstFrame * frameBytes, frames * frameBytes), frames);
+      }
+    });
+    if (!tap) {
+      return null;
+    }
+    frameBytes = tap.frameBytes;
+    ring = tap.buffer;
+    return {
+      id: tap.id,
+      slot: tap.slot,
+      clockRate: tap.clockRate,
+      samplesPerFrame: tap.samplesPerFrame,
+      frameBytes: tap.frameBytes,
+      frames: tap.frames
+    };
+  }
+
+  /**
+   * Detach and destroy a PCM tap
+   */
+  destroyMediaTap(tapId: number): boolean {
+    return this.native.destroyMediaTap(tapId);
+  }
+
+  /**
+   * Queue PCM to play into the tap's sinks, returns the bytes accepted (whole frames)
+   */
+  injectTapAudio(tapId: number, pcm: ArrayBufferView): number {
+    return this.native.injectTapAudio(tapId, pcm);
+  }
+
+  /**
+   * Get capture/inject counters of a tap
+   */
+  getMediaTapStats(tapId: number): MediaTapStats | null {
+    return this.native.getMediaTapStats(tapId);
+  }
+
+  /**
+   * Record a call to a WAV file, returns the recording id or -1
+   */
+  startRecording(callId: number, path: string, options?: RecordingOptions): number {
+    return this.native.startRecording(callId, path, options);
+  }
+
+  /**
+   * Stop a recording, resolves once the file is complete; null for an unknown id
+   */
+  stopRecording(recordingId: number): Promise<RecordingStats> | null {
+    return this.native.stopRecording(recordingId);
+  }
+
+  /**
+   * Get write counters of a recording
+   */
+  getRecordingStats(recordingId: number): RecordingStats | null {
+    return this.native.getRecordingStats(recordingId);
+  }
+
+  /**
+   * Link two calls' audio natively, relaying RTP when their codecs match
+   */
+  bridgeCalls(callA: number, callB: number, options?: BridgeOptions): boolean {
+    return this.native.bridgeCalls(callA, callB, options);
+  }
+
+  /**
+   * Split a bridged pair, both calls stay up and unconnected
+   */
+  unbridgeCalls(callId: number): boolean {
+    return this.native.unbridgeCalls(callId);
+  }
+
+  /**
+   * Get the bridge a call is part of, null if none
+   */
+  getCallBridge(callId: number): CallBridge | null {
+    return this.native.getCallBridge(callId);
+  }
+
+  /**
+   * Count bridged pairs by mode
+   */
+  getBridgeStats(): BridgeStats {
+    return this.native.getBridgeStats();
+  }
+
+  /**
+   * Resolve SIP URIs or host[:port] targets into the DNS cache ahead of use
+   */
+  prewarmDns(targets: string[]): Promise<DnsResult[]> {
+    return this.native.prewarmDns(targets);
+  }
+
+  /**
+   * Drop every cached DNS answer, returns how many there were
+   */
+  flushDnsCache(): number {
+    return this.native.flushDnsCache();
+  }
+
+  /**
+   * Get DNS cache hit, miss and lookup counters
+   */
+  getDnsStats(): DnsStats {
+    return this.native.getDnsStats();
+  }
+
+  /**
+   * List TCP/TLS connections and the accounts registered over each
+   */
+  getFlows(): FlowInfo[] {
+    return this.native.getFlows();
+  }
+
+  /**
+   * Count connections opened, shared and lost
+   */
+  getFlowStats(): FlowStats {
+    return this.native.getFlowStats();
+  }
+
+  /**
+   * Start capturing SIP messages to pcap files or a HEP collector,
+   * replacing a capture already running
+   */
+  startCapture(options: CaptureOptions): boolean {
+    return this.native.startCapture(options);
+  }
+
+  /**
+   * Stop capturing, returns once everything captured is written
+   */
+  stopCapture(): CaptureStats {
+    return this.native.stopCapture();
+  }
+
+  /**
+   * Get capture counters, of the last capture when none is running
+   */
+  getCaptureStats(): CaptureStats {
+    return this.native.getCaptureStats();
+  }
+
+  /**
+   * List registered codecs by priority
+   */
+  getCodecs(): CodecInfo[] {
+    return this.native.getCodecs();
+  }
+
+  /**
+   * Set the priority of a codec, a prefix like 'speex' or '*' for all; 0 disables
+   */
+  setCodecPriority(codecId: string, priority: number): boolean {
+    return this.native.setCodecPriority(codecId, priority);
+  }
+
+  /**
+   * Offer only the given codecs, in that order
+   */
+  pinCodecs(codecIds: string[]): boolean {
+    if (!this.native.setCodecPriority('*', 0)) {
+      return false;
+    }
+    return codecIds.every((codecId, i) => this.native.setCodecPriority(codecId, Math.max(255 - i, 1)));
+  }
+
+  /**
+   * Change packetization, VAD, PLC, CNG or enhancement of a codec for new streams
+   */
+  setCodecParams(codecId: string, params: CodecParams): boolean {
+    return this.native.setCodecParams(codecId, params);
+  }
+
+  /**
+   * Get the negotiated audio codec of a call
+   */
+  getCallCodec(callId: number): CallCodec | null {
+    return this.native.getCallCodec(callId);
+  }
+
+  /**
+   * Count streams per codec and bridge connections that transcode
+   */
+  getCodecUsage(): CodecUsage | null {
+    return this.native.getCodecUsage();
+  }
+
+  /**
+   * Get native event pipeline counters
+   */
+  getEventQueueStats(): EventQueueStats {
+    return this.native.getEventQueueStats();
+  }
+
+  /**
+   * Get native counters, gauges and latency percentiles
+   */
+  getMetrics(): Metrics {
+    return this.native.getMetrics();
+  }
+
+  /**
+   * Get the same metrics in Prometheus text exposition format
+   */
+  getPrometheusMetrics(): string {
+    return this.native.getPrometheusMetrics();
+  }
+
+  /**
+   * Zero all counters and histograms
+   */
+  resetMetrics(): void {
+    this.native.resetMetrics();
+  }
+
+  /**
+   * Sample RTP/RTCP stats of every active call each interval and emit them
+   * as one 'mediaStats' snapshot, read in place from a shared buffer
+   */
+  startMediaStats(intervalMs: number = 1000): void {
+    const buffer = this.native.startMediaStats(intervalMs, (count) => {
+      if (this.mediaStats) {
+        this.mediaStats.count = count;
+        this.emit('mediaStats', this.mediaStats);
+      }
+    });
+    this.mediaStats = { count: 0, ints: new Int32Array(buffer), values: new Float64Array(buffer) };
+  }
+
+  /**
+   * Stop the RTP/RTCP sampler
+   */
+  stopMediaStats(): boolean {
+    this.mediaStats = null;
+    return this.native.stopMediaStats();
+  }
+
+  /**
+   * Get RTP/RTCP sampler counters
+   */
+  getMediaStatsCounters(): MediaStatsCounters {
+    return this.native.getMediaStatsCounters();
+  }
+
+  /**
+   * Get the native monotonic clock used for event timestamps (microseconds)
+   */
+  getMonotonicTime(): number {
+    return this.native.getMonotonicTime();
+  }
+
+  /**
+   * Re-emit a batch of native events. Records are read in place from the
+   * shared buffer, which native reuses once this returns.
+   */
+  private dispatchEvents(count: number): void {
+    const ints = this.eventInts;
+    for (let i = 0; i < count; i++) {
+      const base = i * EVENT_RECORD_INTS;
+      const accId = ints[base + EVENT_ACC_ID];
+      const callId = ints[base + EVENT_CALL_ID];
+      switch (ints[base + EVENT_TYPE]) {
+        case NativeEventType.RegState:
+          if (ints[base + EVENT_STATUS_CODE] === 200) {
+            this.emit(ints[base + EVENT_STATE] > 0 ? 'registered' : 'unregistered', accId);
+          } else {
+            this.emit('registerFailed', accId, ints[base + EVENT_STATUS_CODE]);
+          }
+          break;
+        case NativeEventType.IncomingCall:
+          this.emit('incomingCall', accId, callId);
+          break;
+        case NativeEventType.CallState:
+          if (this.listenerCount('callState') > 0) {
+            this.emit('callState', this.readCallEvent(i));
+          }
+          break;
+        case NativeEventType.CallMediaState:
+          if (this.listenerCount('callMediaState') > 0) {
+            this.emit('callMediaState', this.readCallEvent(i));
+          }
+          break;
+      }
+    }
+  }
+
+  private readCallEvent(index: number): CallEvent {
+    const base = index * EVENT_RECORD_INTS;
+    const ints = this.eventInts;
+    return {
+      callId: ints[base + EVENT_CALL_ID],
+      accId: ints[base + EVENT_ACC_ID],
+      state: ints[base + EVENT_STATE],
+      statusCode: ints[base + EVENT_STATUS_CODE],
+      mediaStatus: ints[base + EVENT_MEDIA_STATUS],
+      timestamp: this.eventTimes[index * 4 + EVENT_TIMESTAMP]
+    };
+  }
+
   /**
    * Check if initialized
    */
@@ -0,0 +1,111 @@
+#ifndef NODE_PJSIP_JS_CALLBACK_H
+#define NODE_PJSIP_JS_CALLBACK_H
+
+#include <napi.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+// A ThreadSafeFunction that native threads may keep calling and releasing
+// after its env is gone.
+//
+// Node closes every ThreadSafeFunction of an env when the env is torn down,
+// a worker_thread's included, and a call or a release after that touches
+// freed memory. The finalizer marks this closed under the mutex that calls
+// and release() take, so from then on they do nothing. The finalizer holds
+// a reference, so the object outlives it. on_finalize runs there too, on
+// the env's thread, for JS references that have to be dropped with the
+// function (the buffers native threads write into).
+class PJSIPJsCallback {
+public:
+    static std::shared_ptr<PJSIPJsCallback> create(Napi::Env env, Napi::Function callback, const char* name,
+                                                   size_t max_queue = 0,
+                                                   std::function<void(Napi::Env)> on_finalize = nullptr) {
+        std::shared_ptr<PJSIPJsCallback> self(new PJSIPJsCallback());
+        std::lock_guard<std::mutex> lock(self->mutex);
+        self->tsfn = Napi::ThreadSafeFunction::New(env, callback, name, max_queue, 1,
+            [self, on_finalize](Napi::Env finalizing) {
+                {
+                    std::lock_guard<std::mutex> lock(self->mutex);
+                    self->open = false;
+                    self->released = true;
+                }
+                if (on_finalize) {
+                    on_finalize(finalizing);
+                }
+            });
+        self->open = true;
+        return self;
+    }
+
+    // Same with a no-op function, for callbacks that only settle a promise
+    static std::shared_ptr<PJSIPJsCallback> create(Napi::Env env, const char* name,
+                                                   std::function<void(Napi::Env)> on_finalize = nullptr) {
+        return create(env, Napi::Function::New(env, [](const Napi::CallbackInfo&) {}), name, 0,
+                      std::move(on_finalize));
+    }
+
+    PJSIPJsCallback(const PJSIPJsCallback&) = delete;
+    PJSIPJsCallback& operator=(const PJSIPJsCallback&) = delete;
+
+    // Any thread - false once released or closed, or when the queue is full
+    template <typename Callback>
+    bool call(Callback&& callback) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return open && tsfn.NonBlockingCall(std::forward<Callback>(callback)) == napi_ok;
+    }
+
+    // Runs fn under the lock while the env is alive, so JS memory it writes
+    // cannot be freed under it. Returns false without running it otherwise.
+    template <typename Fn>
+    bool whileOpen(Fn&& fn) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!open) {
+            return false;
+        }
+        fn();
+        return true;
+    }
+
+    // Any thread, once; later calls do nothing
+    void release() {
+        std::lock_guard<std::mutex> lock(mutex);
+        open = false;
+        if (!released) {
+            released = true;
+            tsfn.Release();
+        }
+    }
+
+    bool isOpen() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return open;
+    }
+
+    // Owning env's thread
+    void ref(Napi::Env env) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (open) {
+            tsfn.Ref(env);
+        }
+    }
+
+    void unref(Napi::Env env) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (open) {
+            tsfn.Unref(env);
+        }
+    }
+
+private:
+    PJSIPJsCallback() : open(false), released(false) {}
+
+    std::mutex mutex;
+    Napi::ThreadSafeFunction tsfn;
+    bool open;                      // calls go through
+    bool released;                  // Release() done or Node closed it
+};
+
+#endif
@@ -0,0 +1,260 @@
+#include "log_sink.h"
+#include "event_queue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstring>
+#include <memory>
+
+// Drain interval when nobody pokes the thread
+static const auto DRAIN_INTERVAL = std::chrono::milliseconds(20);
+
+// PJSIPLogSink implementation
+PJSIPLogSink& PJSIPLogSink::instance() {
+    static PJSIPLogSink sink;
+    return sink;
+}
+
+PJSIPLogSink::PJSIPLogSink()
+    : ring(RING_CAPACITY), max_level((int32_t)PJSIPLogLevel::Info), running(true),
+      flush_requests(0), flushed(0), written(0), dropped(0), filtered(0), callback_dropped(0) {
+    config.target = PJSIPLogTarget::Stdout;
+    config.wrapper_enabled = true;
+    config.pjlib_enabled = true;
+    worker = std::thread(&PJSIPLogSink::run, this);
+}
+
+PJSIPLogSink::~PJSIPLogSink() {
+    running.store(false);
+    wake.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void PJSIPLogSink::log(PJSIPLogLevel level, const char* format, ...) {
+    PJSIPLogRecord record;
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(record.text, sizeof(record.text), format, args);
+    va_end(args);
+    if (length < 0) {
+        return;
+    }
+
+    record.level = (int32_t)level;
+    record.source = (int32_t)PJSIPLogSource::Wrapper;
+    record.length = (uint32_t)std::min((size_t)length, sizeof(record.text) - 1);
+    record.reserved = 0;
+    record.timestamp_us = pjsipMonotonicMicros();
+
+    if (!ring.push(record)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    } else if (ring.depth() > RING_CAPACITY / 2) {
+        wake.notify_all();
+    }
+}
+
+void PJSIPLogSink::write(PJSIPLogSource source, int level, const char* data, size_t length) {
+    while (length > 0 && (data[length - 1] == '\n' || data[length - 1] == '\r')) {
+        length--;
+    }
+
+    PJSIPLogRecord record;
+    record.level = level;
+    record.source = (int32_t)source;
+    record.length = (uint32_t)std::min(length, sizeof(record.text));
+    record.reserved = 0;
+    record.timestamp_us = pjsipMonotonicMicros();
+    memcpy(record.text, data, record.length);
+
+    if (!ring.push(record)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    } else if (ring.depth() > RING_CAPACITY / 2) {
+        wake.notify_all();
+    }
+}
+
+void PJSIPLogSink::pjlibWriter(int level, const char* data, int length) {
+    if (length > 0) {
+        instance().write(PJSIPLogSource::Pjlib, level, data, (size_t)length);
+    }
+}
+
+bool PJSIPLogSink::setTarget(PJSIPLogTarget new_target, const std::string& path) {
+    std::shared_ptr<FILE> new_file;
+    if (new_target == PJSIPLogTarget::File) {
+        FILE* opened = fopen(path.c_str(), "a");
+        if (!opened) {
+            return false;
+        }
+        new_file.reset(opened, fclose);
+    }
+
+    // The old file and callback are closed by whoever drops them last,
+    // here or at the end of a drain pass still writing to them
+    std::lock_guard<std::mutex> lock(config_mutex);
+    config.file = std::move(new_file);
+    if (new_target != PJSIPLogTarget::Callback) {
+        config.callback.reset();
+    }
+    config.target = new_target;
+    return true;
+}
+
+bool PJSIPLogSink::setCallback(Napi::Env env, Napi::Function callback) {
+    std::shared_ptr<PJSIPJsCallback> fn = PJSIPJsCallback::create(env, callback, "pjsip-log", 64);
+    fn->unref(env); // logging alone never keeps the process alive
+    std::shared_ptr<PJSIPJsCallback> shared(fn.get(), [fn](PJSIPJsCallback*) { fn->release(); });
+
+    std::lock_guard<std::mutex> lock(config_mutex);
+    config.file.reset();
+    config.callback = std::move(shared);
+    config.target = PJSIPLogTarget::Callback;
+    return true;
+}
+
+void PJSIPLogSink::setFilter(const std::string& substring, bool wrapper, bool pjlib) {
+    std::lock_guard<std::mutex> lock(config_mutex);
+    config.filter = substring;
+    config.wrapper_enabled = wrapper;
+    config.pjlib_enabled = pjlib;
+}
+
+void PJSIPLogSink::flush() {
+    uint64_t request = flush_requests.fetch_add(1) + 1;
+    wake.notify_all();
+
+    // Bounded wait, a stuck writer must not hang the caller
+    std::unique_lock<std::mutex> lock(wake_mutex);
+    wake.wait_for(lock, std::chrono::seconds(1), [this, request] {
+        return flushed.load() >= request || !running.load();
+    });
+}
+
+PJSIPLogStats PJSIPLogSink::stats() const {
+    PJSIPLogStats result;
+    result.written = written.load(std::memory_order_relaxed);
+    result.dropped = dropped.load(std::memory_order_relaxed);
+    result.filtered = filtered.load(std::memory_order_relaxed);
+    result.callback_dropped = callback_dropped.load(std::memory_order_relaxed);
+    result.depth = ring.depth();
+    result.capacity = ring.capacity();
+    return result;
+}
+
+void PJSIPLogSink::run() {
+    std::vector<PJSIPLogRecord> batch(MAX_BATCH);
+    std::string text;
+    text.reserve(MAX_BATCH * 128);
+
+    while (running.load()) {
+        {
+            std::unique_lock<std::mutex> lock(wake_mutex);
+            wake.wait_for(lock, DRAIN_INTERVAL, [this] {
+                return !running.load() || ring.depth() > RING_CAPACITY / 2 ||
+                       flush_requests.load() > flushed.load();
+            });
+        }
+
+        uint64_t request = flush_requests.load();
+        drain(batch, text);
+        if (request > flushed.load()) {
+            flushed.store(request);
+            wake.notify_all();
+        }
+    }
+    drain(batch, text);
+}
+
+bool PJSIPLogSink::accept(const Config& current, const PJSIPLogRecord& record) {
+    bool source_enabled = record.source == (int32_t)PJSIPLogSource::Pjlib ? current.pjlib_enabled
+                                                                           : current.wrapper_enabled;
+    if (!source_enabled) {
+        filtered.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    const std::string& filter = current.filter;
+    if (!filter.empty() &&
+        std::search(record.text, record.text + record.length, filter.begin(), filter.end()) ==
+            record.text + record.length) {
+        filtered.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void PJSIPLogSink::drain(std::vector<PJSIPLogRecord>& batch, std::string& text) {
+    Config current;
+    for (;;) {
+        size_t count = ring.popBatch(batch.data(), batch.size());
+        if (count == 0) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(config_mutex);
+            current = config;
+        }
+
+        if (current.target == PJSIPLogTarget::Callback && current.callback) {
+            auto records = std::make_shared<std::vector<PJSIPLogRecord>>();
+            records->reserve(count);
+            for (size_t i = 0; i < count; i++) {
+                if (accept(current, batch[i])) {
+                    records->push_back(batch[i]);
+                }
+            }
+            if (records->empty()) {
+                continue;
+            }
+
+            size_t delivered = records->size();
+            // Fails once the env that set the callback is gone, too
+            bool queued = current.callback->call([records](Napi::Env env, Napi::Function callback) {
+                Napi::Array entries = Napi::Array::New(env, records->size());
+                for (size_t i = 0; i < records->size(); i++) {
+                    const PJSIPLogRecord& record = (*records)[i];
+                    Napi::Object entry = Napi::Object::New(env);
+                    entry.Set("level", Napi::Number::New(env, record.level));
+                    entry.Set("source", Napi::String::New(env,
+                        record.source == (int32_t)PJSIPLogSource::Pjlib ? "pjsip" : "wrapper"));
+                    entry.Set("message", Napi::String::New(env, record.text, record.length));
+                    entry.Set("timestamp", Napi::Number::New(env, record.timestamp_us));
+                    entries.Set((uint32_t)i, entry);
+                }
+                callback.Call({ entries });
+            });
+            if (queued) {
+                written.fetch_add(delivered, std::memory_order_relaxed);
+            } else {
+                callback_dropped.fetch_add(delivered, std::memory_order_relaxed);
+            }
+            continue;
+        }
+
+        FILE* out = current.target == PJSIPLogTarget::File ? current.file.get()
+                  : current.target == PJSIPLogTarget::Stdout ? stdout
+                  : current.target == PJSIPLogTarget::Stderr ? stderr
+                  : nullptr;
+        if (!out) {
+            continue;
+        }
+
+        text.clear();
+        size_t accepted = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (accept(current, batch[i])) {
+                text.append(batch[i].text, batch[i].length);
+                text.push_back('\n');
+                accepted++;
+            }
+        }
+        if (!text.empty()) {
+            fwrite(text.data(), 1, text.size(), out);
+            fflush(out);
+            written.fetch_add(accepted, std::memory_order_relaxed);
+        }
+    }
+}
@@ -0,0 +1,152 @@
+#ifndef NODE_PJSIP_LOG_SINK_H
+#define NODE_PJSIP_LOG_SINK_H
+
+#include <napi.h>
+
+#include "js_callback.h"
+#include "mpsc_ring.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Same scale as pjlib log levels
+enum class PJSIPLogLevel : int32_t {
+    Error = 1,
+    Warning = 2,
+    Info = 3,
+    Debug = 4,
+    Trace = 5
+};
+
+enum class PJSIPLogSource : int32_t {
+    Wrapper = 0,
+    Pjlib = 1
+};
+
+enum class PJSIPLogTarget {
+    None,
+    Stdout,
+    Stderr,
+    File,
+    Callback
+};
+
+// One preformatted line, copied into the ring by value
+struct PJSIPLogRecord {
+    int32_t level;
+    int32_t source;             // PJSIPLogSource
+    uint32_t length;
+    uint32_t reserved;
+    double timestamp_us;        // pjsipMonotonicMicros()
+    char text[232];             // truncated, not NUL-terminated
+};
+
+static_assert(sizeof(PJSIPLogRecord) == 256, "PJSIPLogRecord should stay one 256-byte cell");
+
+struct PJSIPLogStats {
+    uint64_t written;
+    uint64_t dropped;           // ring full
+    uint64_t filtered;          // removed by the substring filter
+    uint64_t callback_dropped;  // JS callback queue full or its env gone
+    size_t depth;
+    size_t capacity;
+};
+
+// Process-wide, non-blocking log sink.
+//
+// Producers (wrapper code through PJW_LOG and pjlib through log_cfg.cb) format
+// into a stack record and push it into a preallocated ring; nothing on a
+// PJSIP thread ever touches a stream, a file or a lock. A background thread
+// drains the ring in batches and writes each batch with a single write, or
+// hands it to a JS callback through a ThreadSafeFunction.
+class PJSIPLogSink {
+public:
+    static const size_t RING_CAPACITY = 8192;
+    static const size_t MAX_BATCH = 256;
+
+    static PJSIPLogSink& instance();
+
+    // Hot path check, inlined into PJW_LOG
+    bool enabled(PJSIPLogLevel level) const {
+        return (int32_t)level <= max_level.load(std::memory_order_relaxed);
+    }
+
+    void log(PJSIPLogLevel level, const char* format, ...)
+#if defined(__GNUC__)
+        __attribute__((format(printf, 3, 4)))
+#endif
+        ;
+    void write(PJSIPLogSource source, int level, const char* data, size_t length);
+
+    // Signature of pjsua_logging_config.cb
+    static void pjlibWriter(int level, const char* data, int length);
+
+    // Configuration, JS thread
+    void setLevel(PJSIPLogLevel level) { max_level.store((int32_t)level, std::memory_order_relaxed); }
+    PJSIPLogLevel level() const { return (PJSIPLogLevel)max_level.load(std::memory_order_relaxed); }
+    bool setTarget(PJSIPLogTarget target, const std::string& path);
+    bool setCallback(Napi::Env env, Napi::Function callback);
+    void setFilter(const std::string& substring, bool wrapper, bool pjlib);
+    void flush();
+
+    PJSIPLogStats stats() const;
+
+private:
+    // Where records go. The drain thread copies it under config_mutex and
+    // writes without the lock, so a slow disk or pipe never holds up JS;
+    // the file and the callback stay open until the last copy lets go.
+    struct Config {
+        PJSIPLogTarget target;
+        std::shared_ptr<FILE> file;
+        std::shared_ptr<PJSIPJsCallback> callback;
+        std::string filter;
+        bool wrapper_enabled;
+        bool pjlib_enabled;
+    };
+
+    PJSIPLogSink();
+    ~PJSIPLogSink();
+
+    void run();
+    void drain(std::vector<PJSIPLogRecord>& batch, std::string& text);
+    bool accept(const Config& current, const PJSIPLogRecord& record);
+
+    PJSIPMpscRing<PJSIPLogRecord> ring;
+    std::atomic<int32_t> max_level;
+
+    std::mutex config_mutex;
+    Config config;
+
+    std::thread worker;
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    std::atomic<bool> running;
+    std::atomic<uint64_t> flush_requests;
+    std::atomic<uint64_t> flushed;
+
+    std::atomic<uint64_t> written;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> filtered;
+    std::atomic<uint64_t> callback_dropped;
+};
+
+// Formats only when the level is enabled
+#define PJW_LOG(level, ...) \
+    do { \
+        if (PJSIPLogSink::instance().enabled(level)) { \
+            PJSIPLogSink::instance().log(level, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define PJW_LOG_ERROR(...) PJW_LOG(PJSIPLogLevel::Error, __VA_ARGS__)
+#define PJW_LOG_WARN(...) PJW_LOG(PJSIPLogLevel::Warning, __VA_ARGS__)
+#define PJW_LOG_INFO(...) PJW_LOG(PJSIPLogLevel::Info, __VA_ARGS__)
+#define PJW_LOG_DEBUG(...) PJW_LOG(PJSIPLogLevel::Debug, __VA_ARGS__)
+
+#endif
@@ -0,0 +1,231 @@
+#include "media_stats.h"
+#include "pj_thread_util.h"
+
+#include <pjsua-lib/pjsua_internal.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+// PJSIPMediaStatsSampler implementation
+PJSIPMediaStatsSampler::PJSIPMediaStatsSampler(const PJSIPCallTable* calls)
+    : calls(calls), history(new CallHistory[PJSUA_MAX_CALLS]), scratch(new PJSIPMediaStatsRecord[PJSUA_MAX_CALLS]),
+      snapshot(nullptr), generation(0), owner_env(0), interval_ms(1000), running(false), running_flag(false), delivery_pending(false),
+      samples(0), skipped(0), records(0) {
+    memset(history.get(), 0, sizeof(CallHistory) * PJSUA_MAX_CALLS);
+}
+
+PJSIPMediaStatsSampler::~PJSIPMediaStatsSampler() {
+    stop();
+}
+
+Napi::ArrayBuffer PJSIPMediaStatsSampler::start(Napi::Env env, unsigned env_id, Napi::Function js_callback,
+                                                 unsigned interval) {
+    std::lock_guard<std::mutex> control(control_mutex);
+    halt();
+
+    Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, PJSUA_MAX_CALLS * sizeof(PJSIPMediaStatsRecord));
+
+    // The buffer is referenced until the callback is finalized, on this thread
+    auto snapshot_ref = std::make_shared<Napi::Reference<Napi::ArrayBuffer>>(Napi::Persistent(buffer));
+    std::shared_ptr<PJSIPJsCallback> started = PJSIPJsCallback::create(env, js_callback, "pjsip-media-stats", 0,
+        [snapshot_ref](Napi::Env) { snapshot_ref->Reset(); });
+
+    std::lock_guard<std::mutex> lock(mutex);
+    snapshot = static_cast<PJSIPMediaStatsRecord*>(buffer.Data());
+    callback = started;
+    generation.fetch_add(1, std::memory_order_relaxed);
+    owner_env = env_id;
+    memset(history.get(), 0, sizeof(CallHistory) * PJSUA_MAX_CALLS);
+    interval_ms = std::max(interval, MIN_INTERVAL_MS);
+    delivery_pending.store(false, std::memory_order_relaxed);
+    running = true;
+    running_flag.store(true, std::memory_order_release);
+    worker = std::thread(&PJSIPMediaStatsSampler::run, this);
+    return buffer;
+}
+
+void PJSIPMediaStatsSampler::stop() {
+    std::lock_guard<std::mutex> control(control_mutex);
+    halt();
+}
+
+void PJSIPMediaStatsSampler::release(unsigned env_id) {
+    std::lock_guard<std::mutex> control(control_mutex);
+    if (owner_env == env_id) {
+        halt();
+    }
+}
+
+void PJSIPMediaStatsSampler::halt() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+        running_flag.store(false, std::memory_order_release);
+    }
+    cv.notify_all();
+    worker.join();
+    callback->release();
+    callback.reset();
+}
+
+PJSIPMediaStatsCounters PJSIPMediaStatsSampler::counters() const {
+    PJSIPMediaStatsCounters result;
+    result.samples = samples.load(std::memory_order_relaxed);
+    result.skipped = skipped.load(std::memory_order_relaxed);
+    result.records = records.load(std::memory_order_relaxed);
+    return result;
+}
+
+void PJSIPMediaStatsSampler::run() {
+    pjsipRegisterThread("pjsip-media-stats");
+    active_calls.reserve(PJSUA_MAX_CALLS);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    auto next = std::chrono::steady_clock::now();
+    while (running) {
+        next += std::chrono::milliseconds(interval_ms);
+        cv.wait_until(lock, next, [this] { return !running; });
+        if (!running) {
+            break;
+        }
+
+        // JS still reading the last snapshot - leave its buffer alone
+        if (delivery_pending.load(std::memory_order_acquire)) {
+            skipped.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        lock.unlock();
+        size_t count = sample(pjsipMonotonicMicros());
+        bool copied = callback->whileOpen([this, count]() {
+            memcpy(snapshot, scratch.get(), count * sizeof(PJSIPMediaStatsRecord));
+        });
+        if (copied) {
+            delivery_pending.store(true, std::memory_order_release);
+            uint32_t for_generation = generation.load(std::memory_order_relaxed);
+            bool queued = callback->call([this, for_generation, count](Napi::Env env, Napi::Function js_callback) {
+                deliver(env, js_callback, for_generation, count);
+            });
+            if (!queued) {
+                delivery_pending.store(false, std::memory_order_release);
+            }
+        }
+        lock.lock();
+    }
+}
+
+size_t PJSIPMediaStatsSampler::sample(double now_us) {
+    calls->snapshot(active_calls);
+
+    size_t count = 0;
+    for (const PJSIPCallRecord& call : active_calls) {
+        if (sampleCall(call, now_us, scratch[count])) {
+            count++;
+        }
+    }
+    return count;
+}
+
+bool PJSIPMediaStatsSampler::sampleCall(const PJSIPCallRecord& call, double now_us, PJSIPMediaStatsRecord& out) {
+    if (call.media_status == PJSUA_CALL_MEDIA_NONE || call.media_status == PJSUA_CALL_MEDIA_ERROR) {
+        return false;
+    }
+
+    // Unlocked read of the audio index; pjsua_call_get_stream_stat() takes the
+    // call lock and rejects an index that went stale in between.
+    int media_index = pjsua_var.calls[call.call_id].audio_idx;
+    if (media_index < 0) {
+        return false;
+    }
+
+    pjsua_stream_stat stat;
+    if (pjsua_call_get_stream_stat(call.call_id, (unsigned)media_index, &stat) != PJ_SUCCESS) {
+        return false;
+    }
+    const pjmedia_rtcp_stat& rtcp = stat.rtcp;
+
+    CallHistory& previous = history[call.call_id];
+    if (previous.created_us != call.created_us) {
+        memset(&previous, 0, sizeof(previous));
+        previous.created_us = call.created_us;
+    }
+
+    uint32_t rx_received = rtcp.rx.pkt - previous.rx_packets;
+    uint32_t rx_lost = rtcp.rx.loss - previous.rx_lost;
+    uint32_t tx_sent = rtcp.tx.pkt - previous.tx_packets;
+    uint32_t tx_lost = rtcp.tx.loss - previous.tx_lost;
+    previous.rx_packets = rtcp.rx.pkt;
+    previous.rx_lost = rtcp.rx.loss;
+    previous.tx_packets = rtcp.tx.pkt;
+    previous.tx_lost = rtcp.tx.loss;
+
+    out.call_id = call.call_id;
+    out.acc_id = call.acc_id;
+    out.media_index = media_index;
+    out.rx_packets = rtcp.rx.pkt;
+    out.rx_lost = rtcp.rx.loss;
+    out.rx_discarded = rtcp.rx.discard;
+    out.tx_packets = rtcp.tx.pkt;
+    out.tx_lost = rtcp.tx.loss;
+    out.rx_bytes = (double)rtcp.rx.bytes;
+    out.tx_bytes = (double)rtcp.tx.bytes;
+
+    // pjmedia keeps jitter and RTT in microseconds
+    out.rx_jitter_ms = rtcp.rx.jitter.last / 1000.0;
+    out.rx_jitter_max_ms = rtcp.rx.jitter.n > 0 ? rtcp.rx.jitter.max / 1000.0 : 0.0;
+    out.tx_jitter_ms = rtcp.tx.jitter.last / 1000.0;
+    out.rtt_ms = rtcp.rtt.last / 1000.0;
+    out.rtt_mean_ms = rtcp.rtt.mean / 1000.0;
+    out.rx_loss_pct = rx_received + rx_lost > 0 ? 100.0 * rx_lost / (rx_received + rx_lost) : 0.0;
+    out.tx_loss_pct = tx_sent > 0 ? std::min(100.0, 100.0 * tx_lost / tx_sent) : 0.0;
+
+    // Our receive side is what this node's users hear
+    out.r_factor = rFactor(out.rtt_ms, out.rx_jitter_ms, out.rx_loss_pct);
+    out.mos = mosFromR(out.r_factor);
+    out.sampled_us = now_us;
+    return true;
+}
+
+void PJSIPMediaStatsSampler::deliver(Napi::Env env, Napi::Function js_callback, uint32_t for_generation, size_t count) {
+    // Left over from a previous start() - its buffer is gone
+    if (for_generation != generation.load(std::memory_order_relaxed) || !isRunning()) {
+        return;
+    }
+
+    samples.fetch_add(1, std::memory_order_relaxed);
+    records.fetch_add(count, std::memory_order_relaxed);
+
+    // Records are only valid until the callback returns; a throwing
+    // listener must not stall the sampler
+    try {
+        js_callback.Call({ Napi::Number::New(env, (double)count) });
+    } catch (...) {
+        delivery_pending.store(false, std::memory_order_release);
+        throw;
+    }
+    delivery_pending.store(false, std::memory_order_release);
+}
+
+// Simplified E-model: one-way delay is half the RTT plus a jitter buffer of
+// twice the jitter and 10 ms of codec delay, each percent of loss costs 2.5.
+double PJSIPMediaStatsSampler::rFactor(double rtt_ms, double jitter_ms, double loss_pct) {
+    double effective_ms = rtt_ms / 2.0 + jitter_ms * 2.0 + 10.0;
+    double r = effective_ms < 160.0 ? 93.2 - effective_ms / 40.0
+                                    : 93.2 - (effective_ms - 120.0) / 10.0;
+    r -= loss_pct * 2.5;
+    return std::min(100.0, std::max(0.0, r));
+}
+
+double PJSIPMediaStatsSampler::mosFromR(double r) {
+    if (r <= 0.0) {
+        return 1.0;
+    }
+    if (r >= 100.0) {
+        return 4.5;
+    }
+    return 1.0 + 0.035 * r + 0.000007 * r * (r - 60.0) * (100.0 - r);
+}
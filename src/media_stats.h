@@ -0,0 +1,119 @@
+#ifndef NODE_PJSIP_MEDIA_STATS_H
+#define NODE_PJSIP_MEDIA_STATS_H
+
+#include <napi.h>
+#include <pjsua-lib/pjsua.h>
+
+#include "call_table.h"
+#include "js_callback.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Per-call RTP/RTCP sample. Layout is shared with src/index.ts and
+// lib/index.js: 8 int32 slots followed by 12 float64 slots.
+struct PJSIPMediaStatsRecord {
+    int32_t call_id;
+    int32_t acc_id;
+    int32_t media_index;
+    uint32_t rx_packets;
+    uint32_t rx_lost;
+    uint32_t rx_discarded;
+    uint32_t tx_packets;
+    uint32_t tx_lost;           // as reported by the remote's RTCP RR
+    double rx_bytes;
+    double tx_bytes;
+    double rx_jitter_ms;        // last value
+    double rx_jitter_max_ms;
+    double tx_jitter_ms;        // remote's view of our stream, last RR
+    double rtt_ms;              // last RTCP round trip, 0 until the first RR
+    double rtt_mean_ms;
+    double rx_loss_pct;         // since the previous sample of this call
+    double tx_loss_pct;
+    double r_factor;            // simplified ITU-T G.107 E-model
+    double mos;
+    double sampled_us;          // pjsipMonotonicMicros()
+};
+
+static_assert(sizeof(PJSIPMediaStatsRecord) == 128, "PJSIPMediaStatsRecord layout is shared with JS");
+
+struct PJSIPMediaStatsCounters {
+    uint64_t samples;           // snapshots delivered
+    uint64_t skipped;           // intervals skipped while JS still held the previous one
+    uint64_t records;           // call records delivered
+};
+
+// Samples the audio stream of every active call on its own pjlib-registered
+// thread and hands all of them to JS as one snapshot per interval. Records
+// are copied into a JS-owned ArrayBuffer handed out once by start(); the
+// sampler only writes it while no delivery is outstanding and the env that
+// owns it is alive, so JS reads it in place until the callback returns. A
+// tick that finds the previous snapshot still undelivered is skipped and
+// counted. There is one sampler per process, started and stopped by any env.
+class PJSIPMediaStatsSampler {
+public:
+    static const unsigned MIN_INTERVAL_MS = 100;
+
+    explicit PJSIPMediaStatsSampler(const PJSIPCallTable* calls);
+    ~PJSIPMediaStatsSampler();
+
+    // JS thread of the calling env - returns the shared snapshot buffer
+    Napi::ArrayBuffer start(Napi::Env env, unsigned env_id, Napi::Function callback, unsigned interval_ms);
+
+    // Any thread
+    void stop();
+    void release(unsigned env_id);     // stops it if that env started it
+    bool isRunning() const { return running_flag.load(std::memory_order_acquire); }
+    PJSIPMediaStatsCounters counters() const;
+
+    // E-model estimate from one-way delay, jitter and loss
+    static double rFactor(double rtt_ms, double jitter_ms, double loss_pct);
+    static double mosFromR(double r_factor);
+
+private:
+    // Previous cumulative counters, for per-interval loss
+    struct CallHistory {
+        double created_us;
+        uint32_t rx_packets;
+        uint32_t rx_lost;
+        uint32_t tx_packets;
+        uint32_t tx_lost;
+    };
+
+    // control_mutex held
+    void halt();
+
+    void run();
+    size_t sample(double now_us);
+    bool sampleCall(const PJSIPCallRecord& call, double now_us, PJSIPMediaStatsRecord& out);
+    void deliver(Napi::Env env, Napi::Function js_callback, uint32_t for_generation, size_t count);
+
+    const PJSIPCallTable* calls;
+    std::vector<PJSIPCallRecord> active_calls;  // sampler thread scratch
+    std::unique_ptr<CallHistory[]> history;     // indexed by call id, sampler thread only
+    std::unique_ptr<PJSIPMediaStatsRecord[]> scratch;  // sampler thread, copied into snapshot
+
+    // JS memory, valid while callback is open
+    PJSIPMediaStatsRecord* snapshot;
+    std::shared_ptr<PJSIPJsCallback> callback;
+    std::atomic<uint32_t> generation;
+    unsigned owner_env;
+
+    std::mutex control_mutex;                   // start() and stop() from any env
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable cv;
+    unsigned interval_ms;
+    bool running;
+    std::atomic<bool> running_flag;
+    std::atomic<bool> delivery_pending;
+    std::atomic<uint64_t> samples;
+    std::atomic<uint64_t> skipped;
+    std::atomic<uint64_t> records;
+};
+
+#endif
@@ -0,0 +1,306 @@
+#include "media_tap.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// PJSIPMediaTap implementation
+PJSIPMediaTap::PJSIPMediaTap(const PJSIPMediaTapFormat& format)
+    : fmt(format), pool(nullptr), conf_slot(PJSUA_INVALID_ID), closed(false), refs(1), capture_ring(nullptr),
+      capture_write(0), capture_read(0), drain_pending(false), inject_write(0), inject_read(0),
+      inject_started(false), captured(0), dropped(0), delivered(0), injected(0), played(0),
+      underruns(0), max_queued(0) {
+    pj_bzero(&port, sizeof(port));
+}
+
+PJSIPMediaTap::~PJSIPMediaTap() {
+}
+
+PJSIPMediaTap* PJSIPMediaTap::create(Napi::Env env, Napi::Function callback, const PJSIPMediaTapFormat& format,
+                                     bool inject, Napi::ArrayBuffer& buffer) {
+    PJSIPMediaTap* tap = new PJSIPMediaTap(format);
+    size_t ring_bytes = (size_t)format.capacity * format.frame_bytes;
+
+    buffer = Napi::ArrayBuffer::New(env, ring_bytes);
+    tap->capture_ring = static_cast<uint8_t*>(buffer.Data());
+    if (inject) {
+        tap->inject_ring.reset(new uint8_t[ring_bytes]);
+    }
+
+    // The ring is referenced until the callback is finalized, on this thread
+    auto ring_ref = std::make_shared<Napi::Reference<Napi::ArrayBuffer>>(Napi::Persistent(buffer));
+    tap->callback = PJSIPJsCallback::create(env, callback, "pjsip-media-tap", 0,
+        [ring_ref](Napi::Env) { ring_ref->Reset(); });
+
+    tap->pool = pjsua_pool_create("mtap%p", 512, 512);
+    if (tap->pool == nullptr) {
+        tap->callback->release();
+        delete tap;
+        return nullptr;
+    }
+
+    pj_str_t name = pj_str((char*)"node-pjsip-tap");
+    pjmedia_port_info_init(&tap->port.info, &name, PJMEDIA_SIG_CLASS_APP('T', 'P'), format.clock_rate, 1, 16,
+                           format.samples_per_frame);
+    tap->port.port_data.pdata = tap;
+    tap->port.put_frame = &PJSIPMediaTap::onPutFrame;
+    tap->port.get_frame = &PJSIPMediaTap::onGetFrame;
+    tap->port.on_destroy = &PJSIPMediaTap::onDestroy;
+
+    if (pjmedia_port_init_grp_lock(&tap->port, tap->pool, nullptr) != PJ_SUCCESS) {
+        pj_pool_safe_release(&tap->pool);
+        tap->callback->release();
+        delete tap;
+        return nullptr;
+    }
+
+    if (pjsua_conf_add_port(tap->pool, &tap->port, &tap->conf_slot) != PJ_SUCCESS) {
+        tap->closed.store(true, std::memory_order_relaxed);
+        pjmedia_port_destroy(&tap->port);   // last reference, runs onDestroy()
+        return nullptr;
+    }
+
+    return tap;
+}
+
+void PJSIPMediaTap::destroy() {
+    closed.store(true, std::memory_order_release);
+    if (conf_slot != PJSUA_INVALID_ID) {
+        pjsua_conf_remove_port(conf_slot);
+    }
+
+    // Drops our reference; the bridge may still hold one until its next tick
+    pjmedia_port_destroy(&port);
+}
+
+pj_status_t PJSIPMediaTap::onDestroy(pjmedia_port* port) {
+    PJSIPMediaTap* tap = static_cast<PJSIPMediaTap*>(port->port_data.pdata);
+    pj_pool_safe_release(&tap->pool);
+    tap->callback->release();
+    tap->release();
+    return PJ_SUCCESS;
+}
+
+void PJSIPMediaTap::retain() {
+    refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PJSIPMediaTap::release() {
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete this;
+    }
+}
+
+PJSIPMediaTapStats PJSIPMediaTap::stats() const {
+    PJSIPMediaTapStats result;
+    result.captured = captured.load(std::memory_order_relaxed);
+    result.dropped = dropped.load(std::memory_order_relaxed);
+    result.delivered = delivered.load(std::memory_order_relaxed);
+    result.injected = injected.load(std::memory_order_relaxed);
+    result.played = played.load(std::memory_order_relaxed);
+    result.underruns = underruns.load(std::memory_order_relaxed);
+    result.queued = capture_write.load(std::memory_order_relaxed) - capture_read.load(std::memory_order_relaxed);
+    result.max_queued = max_queued.load(std::memory_order_relaxed);
+    return result;
+}
+
+// Bridge -> tap, on the bridge clock thread
+pj_status_t PJSIPMediaTap::onPutFrame(pjmedia_port* port, pjmedia_frame* frame) {
+    static_cast<PJSIPMediaTap*>(port->port_data.pdata)->capture(frame);
+    return PJ_SUCCESS;
+}
+
+void PJSIPMediaTap::capture(const pjmedia_frame* frame) {
+    if (closed.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    uint32_t write = capture_write.load(std::memory_order_relaxed);
+    uint32_t read = capture_read.load(std::memory_order_acquire);
+    if (write - read >= fmt.capacity) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // Silence keeps the stream continuous for transcription
+    bool written = callback->whileOpen([&]() {
+        uint8_t* dst = capture_ring + (size_t)(write % fmt.capacity) * fmt.frame_bytes;
+        size_t copied = 0;
+        if (frame->type == PJMEDIA_FRAME_TYPE_AUDIO && frame->buf) {
+            copied = std::min((size_t)frame->size, (size_t)fmt.frame_bytes);
+            memcpy(dst, frame->buf, copied);
+        }
+        memset(dst + copied, 0, fmt.frame_bytes - copied);
+    });
+    if (!written) {
+        return;     // env gone, nobody left to read it
+    }
+
+    capture_write.store(write + 1, std::memory_order_release);
+    captured.fetch_add(1, std::memory_order_relaxed);
+    if (write + 1 - read > max_queued.load(std::memory_order_relaxed)) {
+        max_queued.store(write + 1 - read, std::memory_order_relaxed);   // single writer
+    }
+
+    // Only the first frame after a drain pays for the event-loop hop
+    if (drain_pending.exchange(true, std::memory_order_acq_rel)) {
+        return;
+    }
+    retain();
+    bool queued = callback->call([this](Napi::Env env, Napi::Function js_callback) {
+        try {
+            drain(env, js_callback);
+        } catch (...) {
+            release();
+            throw;
+        }
+        release();
+    });
+    if (!queued) {
+        drain_pending.store(false, std::memory_order_release);
+        release();
+    }
+}
+
+void PJSIPMediaTap::drain(Napi::Env env, Napi::Function js_callback) {
+    // Clear the flag first so a frame written meanwhile schedules the next drain
+    drain_pending.store(false, std::memory_order_release);
+    if (closed.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    uint32_t read = capture_read.load(std::memory_order_relaxed);
+    uint32_t write = capture_write.load(std::memory_order_acquire);
+    while (read != write) {
+        // One call per contiguous run, at most two per drain
+        uint32_t first = read % fmt.capacity;
+        uint32_t count = std::min(write - read, fmt.capacity - first);
+        read += count;
+        delivered.fetch_add(count, std::memory_order_relaxed);
+
+        // Frames are only valid until the callback returns, then the bridge may reuse them
+        try {
+            js_callback.Call({ Napi::Number::New(env, first), Napi::Number::New(env, count) });
+        } catch (...) {
+            capture_read.store(read, std::memory_order_release);
+            throw;
+        }
+        capture_read.store(read, std::memory_order_release);
+    }
+}
+
+// Tap -> bridge, on the bridge clock thread
+pj_status_t PJSIPMediaTap::onGetFrame(pjmedia_port* port, pjmedia_frame* frame) {
+    PJSIPMediaTap* tap = static_cast<PJSIPMediaTap*>(port->port_data.pdata);
+    frame->type = PJMEDIA_FRAME_TYPE_NONE;
+    frame->size = 0;
+    if (!tap->inject_ring || tap->closed.load(std::memory_order_acquire)) {
+        return PJ_SUCCESS;
+    }
+
+    uint32_t read = tap->inject_read.load(std::memory_order_relaxed);
+    uint32_t write = tap->inject_write.load(std::memory_order_acquire);
+    if (read == write) {
+        if (tap->inject_started.load(std::memory_order_relaxed)) {
+            tap->underruns.fetch_add(1, std::memory_order_relaxed);
+        }
+        return PJ_SUCCESS;
+    }
+
+    const PJSIPMediaTapFormat& fmt = tap->fmt;
+    memcpy(frame->buf, tap->inject_ring.get() + (size_t)(read % fmt.capacity) * fmt.frame_bytes, fmt.frame_bytes);
+    frame->size = fmt.frame_bytes;
+    frame->type = PJMEDIA_FRAME_TYPE_AUDIO;
+    tap->inject_read.store(read + 1, std::memory_order_release);
+    tap->played.fetch_add(1, std::memory_order_relaxed);
+    return PJ_SUCCESS;
+}
+
+size_t PJSIPMediaTap::inject(const uint8_t* data, size_t length) {
+    if (!inject_ring) {
+        return 0;
+    }
+
+    uint32_t write = inject_write.load(std::memory_order_relaxed);
+    uint32_t read = inject_read.load(std::memory_order_acquire);
+    uint32_t space = fmt.capacity - (write - read);
+    uint32_t frames = (uint32_t)std::min((size_t)space, length / fmt.frame_bytes);
+
+    for (uint32_t i = 0; i < frames; i++, write++) {
+        memcpy(inject_ring.get() + (size_t)(write % fmt.capacity) * fmt.frame_bytes,
+               data + (size_t)i * fmt.frame_bytes, fmt.frame_bytes);
+    }
+    inject_write.store(write, std::memory_order_release);
+    injected.fetch_add(frames, std::memory_order_relaxed);
+    if (frames > 0) {
+        inject_started.store(true, std::memory_order_relaxed);
+    }
+    return (size_t)frames * fmt.frame_bytes;
+}
+
+// PJSIPMediaTapTable implementation
+PJSIPMediaTapTable::PJSIPMediaTapTable() : next_id(1) {
+}
+
+int PJSIPMediaTapTable::add(PJSIPMediaTap* tap, unsigned env_id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    int tap_id = next_id++;
+    taps[tap_id] = { tap, env_id };
+    return tap_id;
+}
+
+bool PJSIPMediaTapTable::destroy(int tap_id) {
+    PJSIPMediaTap* tap = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = taps.find(tap_id);
+        if (it == taps.end()) {
+            return false;
+        }
+        tap = it->second.tap;
+        taps.erase(it);
+    }
+    tap->destroy();
+    return true;
+}
+
+void PJSIPMediaTapTable::release(unsigned env_id) {
+    std::vector<PJSIPMediaTap*> removed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = taps.begin(); it != taps.end();) {
+            if (it->second.env_id == env_id) {
+                removed.push_back(it->second.tap);
+                it = taps.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (PJSIPMediaTap* tap : removed) {
+        tap->destroy();
+    }
+}
+
+void PJSIPMediaTapTable::clear() {
+    std::map<int, Entry> removed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        removed.swap(taps);
+    }
+    for (auto& entry : removed) {
+        entry.second.tap->destroy();
+    }
+}
+
+std::shared_ptr<PJSIPMediaTap> PJSIPMediaTapTable::get(int tap_id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = taps.find(tap_id);
+    if (it == taps.end()) {
+        return nullptr;
+    }
+    // destroy() takes the entry out under the same lock, so the port's reference is still held here
+    PJSIPMediaTap* tap = it->second.tap;
+    tap->retain();
+    return std::shared_ptr<PJSIPMediaTap>(tap, [](PJSIPMediaTap* held) { held->release(); });
+}
@@ -0,0 +1,141 @@
+#ifndef NODE_PJSIP_MEDIA_TAP_H
+#define NODE_PJSIP_MEDIA_TAP_H
+
+#include <napi.h>
+#include <pjsua-lib/pjsua.h>
+
+#include "js_callback.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+
+// Geometry of a tap, 16-bit mono PCM at the bridge clock rate
+struct PJSIPMediaTapFormat {
+    unsigned clock_rate;
+    unsigned samples_per_frame;
+    unsigned frame_bytes;
+    unsigned capacity;          // frames per ring
+};
+
+struct PJSIPMediaTapStats {
+    uint64_t captured;          // frames written by the bridge
+    uint64_t dropped;           // frames lost because JS had not caught up
+    uint64_t delivered;         // frames handed to JS
+    uint64_t injected;          // frames queued by injectTapAudio()
+    uint64_t played;            // injected frames pulled by the bridge
+    uint64_t underruns;         // bridge pulls that found the inject ring empty
+    uint32_t queued;            // capture frames waiting for JS right now
+    uint32_t max_queued;
+};
+
+// A conference bridge port that streams what it receives to JS and plays
+// what JS injects.
+//
+// Capture is a single-producer/single-consumer ring of whole frames whose
+// storage is a JS-owned ArrayBuffer: the bridge clock thread writes frames
+// in place, one ThreadSafeFunction hop hands JS the filled range, JS reads
+// it through Buffer views without a copy and the range is released when
+// the callback returns. A full ring drops the newest frame and counts it,
+// the bridge thread never waits. Inject is the reverse ring in native
+// memory, filled from the JS thread and drained by the bridge.
+//
+// Lifetime is reference counted: the port holds one until the bridge has
+// really let go of it (its group lock's last reference releases the pool
+// and the callback), and so do table lookups and queued drains. The ring
+// belongs to the callback and goes away with its env, so the bridge only
+// writes it while the callback is open.
+class PJSIPMediaTap {
+public:
+    static const unsigned DEFAULT_CAPACITY = 50;   // one second of 20 ms frames
+    static const unsigned MAX_CAPACITY = 3000;
+
+    PJSIPMediaTap(const PJSIPMediaTap&) = delete;
+    PJSIPMediaTap& operator=(const PJSIPMediaTap&) = delete;
+
+    // JS thread - returns nullptr and cleans up after itself on failure
+    static PJSIPMediaTap* create(Napi::Env env, Napi::Function callback, const PJSIPMediaTapFormat& format,
+                                 bool inject, Napi::ArrayBuffer& buffer);
+
+    // Any thread, the tap must not be touched afterwards unless a reference is held
+    void destroy();
+
+    // Any thread, the last release() deletes the tap
+    void retain();
+    void release();
+
+    pjsua_conf_port_id slot() const { return conf_slot; }
+    bool hasInject() const { return inject_ring != nullptr; }
+    const PJSIPMediaTapFormat& format() const { return fmt; }
+    PJSIPMediaTapStats stats() const;
+
+    // JS thread - whole frames only, returns the bytes accepted
+    size_t inject(const uint8_t* data, size_t length);
+
+private:
+    PJSIPMediaTap(const PJSIPMediaTapFormat& format);
+    ~PJSIPMediaTap();
+
+    static pj_status_t onPutFrame(pjmedia_port* port, pjmedia_frame* frame);
+    static pj_status_t onGetFrame(pjmedia_port* port, pjmedia_frame* frame);
+    static pj_status_t onDestroy(pjmedia_port* port);
+
+    void capture(const pjmedia_frame* frame);
+    void drain(Napi::Env env, Napi::Function js_callback);
+
+    PJSIPMediaTapFormat fmt;
+    pjmedia_port port;
+    pj_pool_t* pool;
+    pjsua_conf_port_id conf_slot;
+    std::atomic<bool> closed;
+    std::atomic<int> refs;
+
+    // Capture ring, storage owned by JS and valid while callback is open
+    std::shared_ptr<PJSIPJsCallback> callback;
+    uint8_t* capture_ring;
+    std::atomic<uint32_t> capture_write;    // bridge thread
+    std::atomic<uint32_t> capture_read;     // JS thread
+    std::atomic<bool> drain_pending;
+
+    // Inject ring, JS thread -> bridge thread
+    std::unique_ptr<uint8_t[]> inject_ring;
+    std::atomic<uint32_t> inject_write;
+    std::atomic<uint32_t> inject_read;
+    std::atomic<bool> inject_started;
+
+    std::atomic<uint64_t> captured;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> delivered;
+    std::atomic<uint64_t> injected;
+    std::atomic<uint64_t> played;
+    std::atomic<uint64_t> underruns;
+    std::atomic<uint32_t> max_queued;
+};
+
+// Live taps by id, with the env that created each. Any thread: ids are
+// handed out on JS threads, shutdown and env teardown retire them too.
+class PJSIPMediaTapTable {
+public:
+    PJSIPMediaTapTable();
+
+    int add(PJSIPMediaTap* tap, unsigned env_id);
+    bool destroy(int tap_id);
+    void release(unsigned env_id);
+    void clear();
+
+    // Holds a reference, so the tap stays valid even if destroyed meanwhile
+    std::shared_ptr<PJSIPMediaTap> get(int tap_id);
+
+private:
+    struct Entry {
+        PJSIPMediaTap* tap;
+        unsigned env_id;
+    };
+
+    std::mutex mutex;
+    std::map<int, Entry> taps;
+    int next_id;
+};
+
+#endif
@@ -0,0 +1,291 @@
+#include "metrics.h"
+#include "event_queue.h"
+
+#include <pjsua-lib/pjsua.h>
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+
+// PJSIPHistogramSnapshot implementation
+uint64_t PJSIPHistogramSnapshot::percentile(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(q * (double)count);
+    if (rank >= count) {
+        rank = count - 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+        if (seen > rank) {
+            return std::min(PJSIPMetrics::bucketUpperBound(i), max);
+        }
+    }
+    return max;
+}
+
+// PJSIPMetrics implementation
+PJSIPMetrics& PJSIPMetrics::instance() {
+    static PJSIPMetrics metrics;
+    return metrics;
+}
+
+PJSIPMetrics::PJSIPMetrics()
+    : shards(new Shard[SHARDS]), next_shard(0), register_sent_us(new std::atomic<double>[PJSUA_MAX_ACC]) {
+    reset();
+}
+
+PJSIPMetrics::Shard& PJSIPMetrics::shard() {
+    // Assigned round-robin on a thread's first sample
+    thread_local uint32_t index = next_shard.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+    return shards[index];
+}
+
+size_t PJSIPMetrics::bucketIndex(uint64_t value) {
+    const uint64_t sub_buckets = 1ull << SUB_BUCKET_BITS;
+    if (value < sub_buckets) {
+        return (size_t)value;
+    }
+    if (value >= (1ull << MAX_VALUE_BITS)) {
+        value = (1ull << MAX_VALUE_BITS) - 1;
+    }
+    unsigned exponent = 63;
+    while (!(value & (1ull << exponent))) {
+        exponent--;
+    }
+    uint64_t mantissa = (value >> (exponent - SUB_BUCKET_BITS)) & (sub_buckets - 1);
+    return (size_t)(((exponent - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS) + mantissa);
+}
+
+uint64_t PJSIPMetrics::bucketUpperBound(size_t index) {
+    const uint64_t sub_buckets = 1ull << SUB_BUCKET_BITS;
+    if (index < sub_buckets) {
+        return (uint64_t)index;
+    }
+    unsigned exponent = (unsigned)(index >> SUB_BUCKET_BITS) + SUB_BUCKET_BITS - 1;
+    uint64_t mantissa = index & (sub_buckets - 1);
+    uint64_t lower = (sub_buckets + mantissa) << (exponent - SUB_BUCKET_BITS);
+    return lower + (1ull << (exponent - SUB_BUCKET_BITS)) - 1;
+}
+
+void PJSIPMetrics::record(PJSIPHistogram histogram, uint64_t micros) {
+    Histogram& h = shard().histograms[(size_t)histogram];
+    h.count.fetch_add(1, std::memory_order_relaxed);
+    h.sum.fetch_add(micros, std::memory_order_relaxed);
+    h.buckets[bucketIndex(micros)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t current = h.max.load(std::memory_order_relaxed);
+    while (micros > current && !h.max.compare_exchange_weak(current, micros, std::memory_order_relaxed)) {
+    }
+}
+
+void PJSIPMetrics::recordFailure(PJSIPFailureKind kind, int status_code) {
+    if (status_code < 0 || status_code >= MAX_STATUS_CODE) {
+        status_code = 0;
+    }
+    shard().failures[(size_t)kind][status_code].fetch_add(1, std::memory_order_relaxed);
+}
+
+void PJSIPMetrics::onRegisterSent(int acc_id, double now_us) {
+    increment(PJSIPCounter::RegistrationsSent);
+    if (acc_id >= 0 && acc_id < (int)PJSUA_MAX_ACC) {
+        register_sent_us[acc_id].store(now_us, std::memory_order_relaxed);
+    }
+}
+
+void PJSIPMetrics::onRegisterCompleted(int acc_id, int status_code, double now_us) {
+    double sent_us = 0;
+    if (acc_id >= 0 && acc_id < (int)PJSUA_MAX_ACC) {
+        sent_us = register_sent_us[acc_id].exchange(0, std::memory_order_relaxed);
+    }
+
+    if (status_code / 100 == 2) {
+        increment(PJSIPCounter::RegistrationsSucceeded);
+        if (sent_us > 0) {
+            record(PJSIPHistogram::RegisterRoundTrip, (uint64_t)(now_us - sent_us));
+        }
+    } else {
+        increment(PJSIPCounter::RegistrationsFailed);
+        recordFailure(PJSIPFailureKind::Registration, status_code);
+    }
+}
+
+void PJSIPMetrics::snapshot(PJSIPMetricsSnapshot& out) const {
+    for (size_t c = 0; c < (size_t)PJSIPCounter::Count; c++) {
+        out.counters[c] = 0;
+    }
+    for (size_t h = 0; h < (size_t)PJSIPHistogram::Count; h++) {
+        out.histograms[h].count = 0;
+        out.histograms[h].sum = 0;
+        out.histograms[h].max = 0;
+        out.histograms[h].buckets.assign(BUCKETS, 0);
+    }
+    std::vector<uint64_t> failures[(size_t)PJSIPFailureKind::Count];
+    for (auto& codes : failures) {
+        codes.assign(MAX_STATUS_CODE, 0);
+    }
+
+    for (size_t s = 0; s < SHARDS; s++) {
+        const Shard& shard = shards[s];
+        for (size_t c = 0; c < (size_t)PJSIPCounter::Count; c++) {
+            out.counters[c] += shard.counters[c].value.load(std::memory_order_relaxed);
+        }
+        for (size_t h = 0; h < (size_t)PJSIPHistogram::Count; h++) {
+            const Histogram& source = shard.histograms[h];
+            PJSIPHistogramSnapshot& target = out.histograms[h];
+            target.count += source.count.load(std::memory_order_relaxed);
+            target.sum += source.sum.load(std::memory_order_relaxed);
+            target.max = std::max(target.max, source.max.load(std::memory_order_relaxed));
+            for (size_t b = 0; b < BUCKETS; b++) {
+                target.buckets[b] += source.buckets[b].load(std::memory_order_relaxed);
+            }
+        }
+        for (size_t k = 0; k < (size_t)PJSIPFailureKind::Count; k++) {
+            for (int code = 0; code < MAX_STATUS_CODE; code++) {
+                failures[k][code] += shard.failures[k][code].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    for (size_t k = 0; k < (size_t)PJSIPFailureKind::Count; k++) {
+        out.failures[k].clear();
+        for (int code = 0; code < MAX_STATUS_CODE; code++) {
+            if (failures[k][code] > 0) {
+                out.failures[k].push_back(std::make_pair(code, failures[k][code]));
+            }
+        }
+    }
+}
+
+void PJSIPMetrics::reset() {
+    for (size_t s = 0; s < SHARDS; s++) {
+        Shard& shard = shards[s];
+        for (auto& counter : shard.counters) {
+            counter.value.store(0, std::memory_order_relaxed);
+        }
+        for (auto& histogram : shard.histograms) {
+            histogram.count.store(0, std::memory_order_relaxed);
+            histogram.sum.store(0, std::memory_order_relaxed);
+            histogram.max.store(0, std::memory_order_relaxed);
+            for (auto& bucket : histogram.buckets) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+        }
+        for (auto& codes : shard.failures) {
+            for (auto& code : codes) {
+                code.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+    for (unsigned i = 0; i < PJSUA_MAX_ACC; i++) {
+        register_sent_us[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+const char* PJSIPMetrics::counterName(PJSIPCounter counter) {
+    switch (counter) {
+    case PJSIPCounter::CallsIncoming: return "calls_incoming";
+    case PJSIPCounter::CallsOutgoing: return "calls_outgoing";
+    case PJSIPCounter::CallsConnected: return "calls_connected";
+    case PJSIPCounter::CallsFailed: return "calls_failed";
+    case PJSIPCounter::CallsEnded: return "calls_ended";
+    case PJSIPCounter::RegistrationsSent: return "registrations_sent";
+    case PJSIPCounter::RegistrationsSucceeded: return "registrations_succeeded";
+    case PJSIPCounter::RegistrationsFailed: return "registrations_failed";
+    case PJSIPCounter::Callbacks: return "callbacks";
+    case PJSIPCounter::EventsDelivered: return "events_delivered";
+    case PJSIPCounter::DnsCacheHits: return "dns_cache_hits";
+    case PJSIPCounter::DnsCacheMisses: return "dns_cache_misses";
+    case PJSIPCounter::DnsLookupsFailed: return "dns_lookups_failed";
+    default: return "unknown";
+    }
+}
+
+const char* PJSIPMetrics::histogramName(PJSIPHistogram histogram) {
+    switch (histogram) {
+    case PJSIPHistogram::InviteToAnswer: return "invite_to_answer";
+    case PJSIPHistogram::RegisterRoundTrip: return "register_round_trip";
+    case PJSIPHistogram::CallbackDuration: return "callback_duration";
+    case PJSIPHistogram::EventQueueLatency: return "event_queue_latency";
+    case PJSIPHistogram::DnsLookup: return "dns_lookup";
+    default: return "unknown";
+    }
+}
+
+// PJSIPCallbackTimer implementation
+PJSIPCallbackTimer::PJSIPCallbackTimer() : start_us(pjsipMonotonicMicros()) {
+}
+
+PJSIPCallbackTimer::~PJSIPCallbackTimer() {
+    PJSIPMetrics& metrics = PJSIPMetrics::instance();
+    metrics.increment(PJSIPCounter::Callbacks);
+    metrics.record(PJSIPHistogram::CallbackDuration, (uint64_t)(pjsipMonotonicMicros() - start_us));
+}
+
+// Prometheus rendering
+static void appendLine(std::string& out, const char* format, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 2, 3)))
+#endif
+    ;
+
+static void appendLine(std::string& out, const char* format, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (length > 0) {
+        out.append(line, std::min((size_t)length, sizeof(line) - 1));
+    }
+}
+
+std::string pjsipRenderPrometheus(const PJSIPMetricsSnapshot& snapshot, const PJSIPMetricsGauges& gauges) {
+    static const double QUANTILES[] = { 0.5, 0.9, 0.99, 0.999 };
+    std::string out;
+    out.reserve(8192);
+
+    for (size_t c = 0; c < (size_t)PJSIPCounter::Count; c++) {
+        const char* name = PJSIPMetrics::counterName((PJSIPCounter)c);
+        appendLine(out, "# TYPE node_pjsip_%s_total counter\n", name);
+        appendLine(out, "node_pjsip_%s_total %llu\n", name, (unsigned long long)snapshot.counters[c]);
+    }
+
+    appendLine(out, "# TYPE node_pjsip_active_calls gauge\nnode_pjsip_active_calls %llu\n",
+               (unsigned long long)gauges.active_calls);
+    appendLine(out, "# TYPE node_pjsip_active_registrations gauge\nnode_pjsip_active_registrations %llu\n",
+               (unsigned long long)gauges.active_registrations);
+    appendLine(out, "# TYPE node_pjsip_event_queue_depth gauge\nnode_pjsip_event_queue_depth %llu\n",
+               (unsigned long long)gauges.event_queue_depth);
+    appendLine(out, "# TYPE node_pjsip_events_dropped_total counter\nnode_pjsip_events_dropped_total %llu\n",
+               (unsigned long long)gauges.events_dropped);
+    appendLine(out, "# TYPE node_pjsip_dns_cache_entries gauge\nnode_pjsip_dns_cache_entries %llu\n",
+               (unsigned long long)gauges.dns_cache_entries);
+    appendLine(out, "# TYPE node_pjsip_sip_flows gauge\nnode_pjsip_sip_flows %llu\n",
+               (unsigned long long)gauges.sip_flows);
+
+    appendLine(out, "# TYPE node_pjsip_failures_total counter\n");
+    static const char* const KINDS[] = { "call", "registration" };
+    for (size_t k = 0; k < (size_t)PJSIPFailureKind::Count; k++) {
+        for (const auto& failure : snapshot.failures[k]) {
+            appendLine(out, "node_pjsip_failures_total{kind=\"%s\",code=\"%d\"} %llu\n", KINDS[k], failure.first,
+                       (unsigned long long)failure.second);
+        }
+    }
+
+    for (size_t h = 0; h < (size_t)PJSIPHistogram::Count; h++) {
+        const char* name = PJSIPMetrics::histogramName((PJSIPHistogram)h);
+        const PJSIPHistogramSnapshot& histogram = snapshot.histograms[h];
+        appendLine(out, "# TYPE node_pjsip_%s_seconds summary\n", name);
+        for (double q : QUANTILES) {
+            appendLine(out, "node_pjsip_%s_seconds{quantile=\"%g\"} %.6f\n", name, q,
+                       (double)histogram.percentile(q) / 1e6);
+        }
+        appendLine(out, "node_pjsip_%s_seconds_sum %.6f\n", name, (double)histogram.sum / 1e6);
+        appendLine(out, "node_pjsip_%s_seconds_count %llu\n", name, (unsigned long long)histogram.count);
+    }
+
+    return out;
+}
@@ -0,0 +1,144 @@
+#ifndef NODE_PJSIP_METRICS_H
+#define NODE_PJSIP_METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class PJSIPCounter : uint32_t {
+    CallsIncoming,
+    CallsOutgoing,
+    CallsConnected,
+    CallsFailed,            // ended without being answered
+    CallsEnded,
+    RegistrationsSent,
+    RegistrationsSucceeded,
+    RegistrationsFailed,
+    Callbacks,
+    EventsDelivered,
+    DnsCacheHits,           // positive and negative
+    DnsCacheMisses,
+    DnsLookupsFailed,
+    Count
+};
+
+enum class PJSIPHistogram : uint32_t {
+    InviteToAnswer,         // INVITE sent or received -> call confirmed
+    RegisterRoundTrip,      // REGISTER sent -> 2xx
+    CallbackDuration,       // time spent inside a pjsua callback
+    EventQueueLatency,      // event posted -> popped on the JS thread
+    DnsLookup,              // cache miss -> answer from the nameservers
+    Count
+};
+
+enum class PJSIPFailureKind : uint32_t {
+    Call,
+    Registration,
+    Count
+};
+
+// Merged histogram, all values in microseconds
+struct PJSIPHistogramSnapshot {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    std::vector<uint64_t> buckets;
+
+    uint64_t percentile(double q) const;
+};
+
+struct PJSIPMetricsSnapshot {
+    uint64_t counters[(size_t)PJSIPCounter::Count];
+    PJSIPHistogramSnapshot histograms[(size_t)PJSIPHistogram::Count];
+    std::vector<std::pair<int, uint64_t>> failures[(size_t)PJSIPFailureKind::Count];  // status code, count
+};
+
+// Process-wide metrics recorded from the PJSIP callbacks.
+//
+// Every thread writes to one of SHARDS cache-line aligned shards, picked
+// once per thread, so concurrent callbacks never share a counter cache line.
+// Histograms are HDR-style log-linear: 16 sub-buckets per power of two
+// (about 6% relative error) from 1 us to ~71 minutes. snapshot() sums the
+// shards with relaxed loads and never blocks a writer; a snapshot taken
+// while threads record may be off by the samples in flight.
+class PJSIPMetrics {
+public:
+    static const size_t SHARDS = 16;
+    static const unsigned SUB_BUCKET_BITS = 4;
+    static const unsigned MAX_VALUE_BITS = 32;
+    static const size_t BUCKETS = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS;
+    static const int MAX_STATUS_CODE = 700;
+
+    static PJSIPMetrics& instance();
+
+    void increment(PJSIPCounter counter, uint64_t amount = 1) {
+        shard().counters[(size_t)counter].value.fetch_add(amount, std::memory_order_relaxed);
+    }
+    void record(PJSIPHistogram histogram, uint64_t micros);
+    void recordFailure(PJSIPFailureKind kind, int status_code);
+
+    // REGISTER round trips, keyed by account id
+    void onRegisterSent(int acc_id, double now_us);
+    void onRegisterCompleted(int acc_id, int status_code, double now_us);
+
+    void snapshot(PJSIPMetricsSnapshot& out) const;
+    void reset();
+
+    static size_t bucketIndex(uint64_t value);
+    static uint64_t bucketUpperBound(size_t index);
+
+    static const char* counterName(PJSIPCounter counter);
+    static const char* histogramName(PJSIPHistogram histogram);
+
+private:
+    PJSIPMetrics();
+
+    struct alignas(64) PaddedCounter {
+        std::atomic<uint64_t> value;
+    };
+
+    struct Histogram {
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> max;
+        std::atomic<uint64_t> buckets[BUCKETS];
+    };
+
+    struct alignas(64) Shard {
+        PaddedCounter counters[(size_t)PJSIPCounter::Count];
+        Histogram histograms[(size_t)PJSIPHistogram::Count];
+        std::atomic<uint64_t> failures[(size_t)PJSIPFailureKind::Count][MAX_STATUS_CODE];
+    };
+
+    Shard& shard();
+
+    std::unique_ptr<Shard[]> shards;
+    std::atomic<uint32_t> next_shard;
+    std::unique_ptr<std::atomic<double>[]> register_sent_us;
+};
+
+// Records the enclosing scope into PJSIPHistogram::CallbackDuration
+class PJSIPCallbackTimer {
+public:
+    PJSIPCallbackTimer();
+    ~PJSIPCallbackTimer();
+
+private:
+    double start_us;
+};
+
+// Prometheus text exposition format, gauges are passed in by the caller
+struct PJSIPMetricsGauges {
+    uint64_t active_calls;
+    uint64_t active_registrations;
+    uint64_t event_queue_depth;
+    uint64_t events_dropped;
+    uint64_t dns_cache_entries;
+    uint64_t sip_flows;
+};
+
+std::string pjsipRenderPrometheus(const PJSIPMetricsSnapshot& snapshot, const PJSIPMetricsGauges& gauges);
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef NODE_PJSIP_MPSC_RING_H
+#define NODE_PJSIP_MPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded lock-free multi-producer / single-consumer ring (one sequence
+// number per cell). Producers never block: push() fails when the ring is
+// full and the caller counts the drop. T must be cheap to copy.
+template <typename T>
+class PJSIPMpscRing {
+public:
+    explicit PJSIPMpscRing(size_t capacity) : enqueue_pos(0), dequeue_pos(0) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        cells = new Cell[size];
+        mask = size - 1;
+        for (size_t i = 0; i < size; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~PJSIPMpscRing() {
+        delete[] cells;
+    }
+
+    PJSIPMpscRing(const PJSIPMpscRing&) = delete;
+    PJSIPMpscRing& operator=(const PJSIPMpscRing&) = delete;
+
+    // Returns false when the ring is full
+    bool push(const T& value) {
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell* cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell->value = value;
+                    cell->sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // full
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Consumer only - pops up to max_count values into out, returns the number popped
+    size_t popBatch(T* out, size_t max_count) {
+        size_t count = 0;
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        while (count < max_count) {
+            Cell* cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            if ((intptr_t)seq - (intptr_t)(pos + 1) < 0) {
+                break; // empty, or producer has not finished writing this cell
+            }
+            out[count++] = cell->value;
+            cell->sequence.store(pos + mask + 1, std::memory_order_release);
+            pos++;
+        }
+        dequeue_pos.store(pos, std::memory_order_relaxed);
+        return count;
+    }
+
+    size_t depth() const {
+        size_t head = enqueue_pos.load(std::memory_order_relaxed);
+        size_t tail = dequeue_pos.load(std::memory_order_relaxed);
+        return head > tail ? head - tail : 0;
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+private:
+    struct alignas(64) Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    Cell* cells;
+    size_t mask;
+    alignas(64) std::atomic<size_t> enqueue_pos;
+    alignas(64) std::atomic<size_t> dequeue_pos;
+};
+
+#endif
@@ -0,0 +1,713 @@
+#include "packet_capture.h"
+#include "log_sink.h"
+#include "pj_thread_util.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+// pcap file format, LINKTYPE_RAW: each packet starts with its IP header
+static const uint32_t PCAP_MAGIC = 0xa1b2c3d4;
+static const uint32_t PCAP_LINKTYPE_RAW = 101;
+static const uint32_t PCAP_SNAPLEN = 65535;
+
+static const uint8_t PROTO_TCP = 6;
+static const uint8_t PROTO_UDP = 17;
+
+// Longest message kept whole, so the datagram still fits in 16-bit lengths
+static const uint32_t MAX_PAYLOAD = 65000;
+
+static const uint32_t SAMPLE_SCALE = 1000000;
+
+static pjsip_module capture_module;
+
+static void putBE16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back((uint8_t)(value >> 8));
+    out.push_back((uint8_t)(value & 0xff));
+}
+
+static void putBE32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        out.push_back((uint8_t)((value >> shift) & 0xff));
+    }
+}
+
+static void putNative16(std::vector<uint8_t>& out, uint16_t value) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + 2);
+}
+
+static void putNative32(std::vector<uint8_t>& out, uint32_t value) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + 4);
+}
+
+static void setBE16(std::vector<uint8_t>& out, size_t offset, uint16_t value) {
+    out[offset] = (uint8_t)(value >> 8);
+    out[offset + 1] = (uint8_t)(value & 0xff);
+}
+
+// RFC 1071 ones' complement sum
+static uint32_t sumWords(const uint8_t* data, size_t length, uint32_t sum) {
+    size_t i = 0;
+    for (; i + 1 < length; i += 2) {
+        sum += (uint32_t)(data[i] << 8 | data[i + 1]);
+    }
+    if (i < length) {
+        sum += (uint32_t)(data[i] << 8);
+    }
+    return sum;
+}
+
+static uint16_t foldSum(uint32_t sum) {
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return (uint16_t)(~sum & 0xffff);
+}
+
+static bool sameText(const pj_str_t& text, const std::string& value) {
+    return (size_t)text.slen == value.size() && memcmp(text.ptr, value.data(), value.size()) == 0;
+}
+
+// FNV-1a, only has to spread Call-IDs evenly
+static uint64_t hashText(const pj_str_t& text) {
+    uint64_t hash = 14695981039346656037ull;
+    for (pj_ssize_t i = 0; i < text.slen; i++) {
+        hash = (hash ^ (uint8_t)text.ptr[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+static void copyIn(uint8_t* ring, uint64_t capacity, uint64_t pos, const void* data, size_t length) {
+    size_t offset = (size_t)(pos & (capacity - 1));
+    size_t first = std::min(length, (size_t)(capacity - offset));
+    memcpy(ring + offset, data, first);
+    memcpy(ring, static_cast<const uint8_t*>(data) + first, length - first);
+}
+
+static void copyOut(const uint8_t* ring, uint64_t capacity, uint64_t pos, void* data, size_t length) {
+    size_t offset = (size_t)(pos & (capacity - 1));
+    size_t first = std::min(length, (size_t)(capacity - offset));
+    memcpy(data, ring + offset, first);
+    memcpy(static_cast<uint8_t*>(data) + first, ring, length - first);
+}
+
+static uint64_t paddedLength(uint32_t length) {
+    return ((uint64_t)length + 7) & ~(uint64_t)7;
+}
+
+// PJSIPCaptureOptions implementation
+PJSIPCaptureOptions::PJSIPCaptureOptions() : format(PJSIPCaptureFormat::Pcap), rotate_bytes(0), max_files(0),
+    agent_id(0), sample(1.0), buffer_kb(PJSIPPacketCapture::DEFAULT_BUFFER_KB) {
+}
+
+PJSIPPacketCapture* PJSIPPacketCapture::active = nullptr;
+
+// PJSIPPacketCapture implementation
+PJSIPPacketCapture::PJSIPPacketCapture() : running(false), sample_threshold(SAMPLE_SCALE), ring_bytes(0),
+    generation(0), file(nullptr), file_bytes(0), file_index(0), sock(PJ_INVALID_SOCKET), captured(0), filtered(0),
+    dropped(0), written(0), bytes(0), files(0), write_errors(0) {
+    pj_bzero(&collector, sizeof(collector));
+}
+
+PJSIPPacketCapture::~PJSIPPacketCapture() {
+    std::lock_guard<std::mutex> control(control_mutex);
+    halt();
+}
+
+bool PJSIPPacketCapture::start(const PJSIPCaptureOptions& capture_options) {
+    std::lock_guard<std::mutex> control(control_mutex);
+    halt();
+
+    std::vector<Account> parsed;
+    for (const std::string& aor : capture_options.accounts) {
+        Account account;
+        if (!parseAor(aor, account)) {
+            PJW_LOG_ERROR("❌ Capture: cannot match account %s", aor.c_str());
+            return false;
+        }
+        parsed.push_back(std::move(account));
+    }
+
+    options = capture_options;
+    accounts = std::move(parsed);
+    sample_threshold = (uint32_t)(std::min(1.0, std::max(0.0, options.sample)) * SAMPLE_SCALE);
+    unsigned buffer_kb = std::min(MAX_BUFFER_KB, std::max(64u, options.buffer_kb));
+    ring_bytes = 1;
+    while (ring_bytes < (uint64_t)buffer_kb * 1024) {
+        ring_bytes <<= 1;
+    }
+
+    captured = 0;
+    filtered = 0;
+    dropped = 0;
+    written = 0;
+    bytes = 0;
+    files = 0;
+    write_errors = 0;
+    file_index = 0;
+
+    // Open the output here so a bad path or collector fails the call
+    if (options.format == PJSIPCaptureFormat::Pcap) {
+        if (options.path.empty() || !openFile()) {
+            PJW_LOG_ERROR("❌ Capture: cannot open %s", options.path.c_str());
+            return false;
+        }
+    } else {
+        pj_str_t text = pj_str((char*)options.collector.c_str());
+        pj_status_t status = pj_sockaddr_parse(pj_AF_UNSPEC(), 0, &text, &collector);
+        if (status == PJ_SUCCESS && pj_sockaddr_get_port(&collector) == 0) {
+            pj_sockaddr_set_port(&collector, DEFAULT_HEP_PORT);
+        }
+        if (status == PJ_SUCCESS) {
+            status = pj_sock_socket(collector.addr.sa_family, pj_SOCK_DGRAM(), 0, &sock);
+        }
+        if (status != PJ_SUCCESS) {
+            PJW_LOG_ERROR("❌ Capture: cannot send to collector %s: %d", options.collector.c_str(), status);
+            sock = PJ_INVALID_SOCKET;
+            return false;
+        }
+    }
+
+    generation++;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = true;
+    }
+    writer = std::thread(&PJSIPPacketCapture::run, this);
+
+    // Next to pjsua's message logger: received messages are parsed, sent
+    // ones already printed
+    active = this;
+    pj_bzero(&capture_module, sizeof(capture_module));
+    capture_module.name = pj_str((char*)"mod-node-pjsip-capture");
+    capture_module.id = -1;
+    capture_module.priority = PJSIP_MOD_PRIORITY_TRANSPORT_LAYER - 1;
+    capture_module.on_rx_request = &PJSIPPacketCapture::onRxMessage;
+    capture_module.on_rx_response = &PJSIPPacketCapture::onRxMessage;
+    capture_module.on_tx_request = &PJSIPPacketCapture::onTxMessage;
+    capture_module.on_tx_response = &PJSIPPacketCapture::onTxMessage;
+
+    pj_status_t status = pjsip_endpt_register_module(pjsua_get_pjsip_endpt(), &capture_module);
+    if (status != PJ_SUCCESS) {
+        PJW_LOG_ERROR("❌ Error registering capture module: %d", status);
+        halt();
+        return false;
+    }
+
+    PJW_LOG_INFO("🔎 SIP capture started (%s to %s)", formatName(options.format),
+                 options.format == PJSIPCaptureFormat::Pcap ? options.path.c_str() : options.collector.c_str());
+    return true;
+}
+
+PJSIPCaptureStats PJSIPPacketCapture::stop() {
+    std::lock_guard<std::mutex> control(control_mutex);
+    halt();
+    return stats();
+}
+
+void PJSIPPacketCapture::halt() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running && !writer.joinable()) {
+            return;
+        }
+    }
+
+    // pjsip takes the module list write lock, so once this returns no SIP
+    // thread is inside the callbacks. pjsua_destroy() may have unloaded it
+    // already (id back to -1).
+    if (capture_module.id >= 0) {
+        pjsip_endpt_unregister_module(pjsua_get_pjsip_endpt(), &capture_module);
+    }
+    active = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    cv.notify_all();
+    if (writer.joinable()) {
+        writer.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    rings.clear();
+    PJW_LOG_INFO("🔎 SIP capture stopped (%llu written, %llu dropped)",
+                 (unsigned long long)written.load(), (unsigned long long)dropped.load());
+}
+
+PJSIPCaptureStats PJSIPPacketCapture::stats() const {
+    PJSIPCaptureStats out;
+    std::lock_guard<std::mutex> lock(mutex);
+    out.active = running;
+    out.format = options.format;
+    out.captured = captured.load(std::memory_order_relaxed);
+    out.filtered = filtered.load(std::memory_order_relaxed);
+    out.dropped = dropped.load(std::memory_order_relaxed);
+    out.written = written.load(std::memory_order_relaxed);
+    out.bytes = bytes.load(std::memory_order_relaxed);
+    out.files = files.load(std::memory_order_relaxed);
+    out.write_errors = write_errors.load(std::memory_order_relaxed);
+    out.rings = (unsigned)rings.size();
+    out.file = file_name;
+    return out;
+}
+
+// SIP threads
+
+pj_bool_t PJSIPPacketCapture::onRxMessage(pjsip_rx_data* rdata) {
+    PJSIPPacketCapture* capture = active;
+    if (!capture || !rdata->msg_info.msg || !rdata->tp_info.transport) {
+        return PJ_FALSE;
+    }
+    if (!capture->matches(rdata->msg_info.msg)) {
+        capture->filtered.fetch_add(1, std::memory_order_relaxed);
+        return PJ_FALSE;
+    }
+
+    const pjsip_transport* tp = rdata->tp_info.transport;
+    Record record;
+    pj_bzero(&record, sizeof(record));
+    // This message only: a TCP read or a UDP datagram can carry several
+    record.length = (uint32_t)rdata->msg_info.len;
+    record.outgoing = 0;
+    record.protocol = ((int)tp->key.type & ~PJSIP_TRANSPORT_IPV6) == PJSIP_TRANSPORT_UDP ? PROTO_UDP : PROTO_TCP;
+    toEndpoint(rdata->pkt_info.src_addr, record.src);
+    localEndpoint(tp, record.dst);
+    capture->push(record, rdata->msg_info.msg_buf);
+    return PJ_FALSE;
+}
+
+pj_status_t PJSIPPacketCapture::onTxMessage(pjsip_tx_data* tdata) {
+    PJSIPPacketCapture* capture = active;
+    if (!capture || !tdata->msg || !tdata->tp_info.transport) {
+        return PJ_SUCCESS;
+    }
+    if (!capture->matches(tdata->msg)) {
+        capture->filtered.fetch_add(1, std::memory_order_relaxed);
+        return PJ_SUCCESS;
+    }
+
+    const pjsip_transport* tp = tdata->tp_info.transport;
+    Record record;
+    pj_bzero(&record, sizeof(record));
+    record.length = (uint32_t)(tdata->buf.cur - tdata->buf.start);
+    record.outgoing = 1;
+    record.protocol = ((int)tp->key.type & ~PJSIP_TRANSPORT_IPV6) == PJSIP_TRANSPORT_UDP ? PROTO_UDP : PROTO_TCP;
+    localEndpoint(tp, record.src);
+    toEndpoint(tdata->tp_info.dst_addr, record.dst);
+    capture->push(record, tdata->buf.start);
+    return PJ_SUCCESS;
+}
+
+bool PJSIPPacketCapture::matches(const pjsip_msg* msg) const {
+    if (!options.call_ids.empty() || sample_threshold < SAMPLE_SCALE) {
+        const pjsip_cid_hdr* cid = (const pjsip_cid_hdr*)pjsip_msg_find_hdr(msg, PJSIP_H_CALL_ID, nullptr);
+        pj_str_t call_id = cid ? cid->id : pj_str((char*)"");
+        if (!options.call_ids.empty() &&
+            std::none_of(options.call_ids.begin(), options.call_ids.end(),
+                         [&call_id](const std::string& wanted) { return sameText(call_id, wanted); })) {
+            return false;
+        }
+        if (hashText(call_id) % SAMPLE_SCALE >= sample_threshold) {
+            return false;
+        }
+    }
+
+    if (!options.methods.empty()) {
+        const pj_str_t* method = nullptr;
+        if (msg->type == PJSIP_REQUEST_MSG) {
+            method = &msg->line.req.method.name;
+        } else {
+            const pjsip_cseq_hdr* cseq = (const pjsip_cseq_hdr*)pjsip_msg_find_hdr(msg, PJSIP_H_CSEQ, nullptr);
+            method = cseq ? &cseq->method.name : nullptr;
+        }
+        if (!method || std::none_of(options.methods.begin(), options.methods.end(),
+                                    [method](const std::string& wanted) { return sameText(*method, wanted); })) {
+            return false;
+        }
+    }
+
+    return accounts.empty() || matchesAccount(msg);
+}
+
+bool PJSIPPacketCapture::matchesAccount(const pjsip_msg* msg) const {
+    static const pjsip_hdr_e HEADERS[] = { PJSIP_H_FROM, PJSIP_H_TO };
+    for (pjsip_hdr_e type : HEADERS) {
+        const pjsip_fromto_hdr* hdr = (const pjsip_fromto_hdr*)pjsip_msg_find_hdr(msg, type, nullptr);
+        if (!hdr || !hdr->uri) {
+            continue;
+        }
+        const void* uri = pjsip_uri_get_uri(hdr->uri);
+        if (!PJSIP_URI_SCHEME_IS_SIP(uri) && !PJSIP_URI_SCHEME_IS_SIPS(uri)) {
+            continue;
+        }
+        const pjsip_sip_uri* sip_uri = (const pjsip_sip_uri*)uri;
+        for (const Account& account : accounts) {
+            if (sameText(sip_uri->user, account.user) && pj_stricmp2(&sip_uri->host, account.host.c_str()) == 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void PJSIPPacketCapture::push(const Record& header, const char* data) {
+    Ring* ring = threadRing();
+    Record record = header;
+    record.length = std::min(record.length, MAX_PAYLOAD);
+
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    uint64_t usec = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+    record.sec = (uint32_t)(usec / 1000000);
+    record.usec = (uint32_t)(usec % 1000000);
+
+    uint64_t size = sizeof(Record) + paddedLength(record.length);
+    uint64_t write = ring->write.load(std::memory_order_relaxed);
+    uint64_t read = ring->read.load(std::memory_order_acquire);
+    if (size > ring->capacity - (write - read)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    copyIn(ring->data.get(), ring->capacity, write, &record, sizeof(Record));
+    copyIn(ring->data.get(), ring->capacity, write + sizeof(Record), data, record.length);
+    ring->write.store(write + size, std::memory_order_release);
+    captured.fetch_add(1, std::memory_order_relaxed);
+}
+
+// The calling thread's ring, created with its first message of a capture
+PJSIPPacketCapture::Ring* PJSIPPacketCapture::threadRing() {
+    struct Cached {
+        const PJSIPPacketCapture* owner;
+        uint64_t generation;
+        Ring* ring;
+    };
+    static thread_local Cached cached = { nullptr, 0, nullptr };
+    if (cached.owner == this && cached.generation == generation) {
+        return cached.ring;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    rings.push_back(std::unique_ptr<Ring>(new Ring(ring_bytes)));
+    cached = { this, generation, rings.back().get() };
+    return cached.ring;
+}
+
+void PJSIPPacketCapture::toEndpoint(const pj_sockaddr& addr, Endpoint& out) {
+    pj_bzero(&out, sizeof(out));
+    bool ipv6 = addr.addr.sa_family == pj_AF_INET6();
+    out.family = ipv6 ? 6 : 4;
+    if (ipv6 || addr.addr.sa_family == pj_AF_INET()) {
+        memcpy(out.addr, pj_sockaddr_get_addr(&addr), pj_sockaddr_get_addr_len(&addr));
+        out.port = pj_sockaddr_get_port(&addr);
+    }
+}
+
+// Listeners bound to the any address report the published one instead
+void PJSIPPacketCapture::localEndpoint(const pjsip_transport* tp, Endpoint& out) {
+    toEndpoint(tp->local_addr, out);
+    if (!pj_sockaddr_has_addr(&tp->local_addr)) {
+        pj_sockaddr published;
+        if (pj_sockaddr_parse(pj_AF_UNSPEC(), 0, &tp->local_name.host, &published) == PJ_SUCCESS) {
+            uint16_t port = out.port;
+            toEndpoint(published, out);
+            out.port = port;
+        }
+    }
+    if (out.port == 0) {
+        out.port = (uint16_t)tp->local_name.port;
+    }
+}
+
+// Writer thread
+
+void PJSIPPacketCapture::run() {
+    if (options.format == PJSIPCaptureFormat::Hep) {
+        pjsipRegisterThread("pjsip-capture");
+    }
+
+    std::vector<uint8_t> staging;
+    std::vector<size_t> offsets;
+    std::vector<uint8_t> packet;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        cv.wait_for(lock, std::chrono::milliseconds(WRITE_INTERVAL_MS), [this] { return !running; });
+        bool last = !running;
+        lock.unlock();
+
+        staging.clear();
+        offsets.clear();
+        drain(staging, offsets);
+
+        // Each ring is in order, interleave the threads
+        auto timeOf = [&staging](size_t offset) {
+            Record record;
+            memcpy(&record, staging.data() + offset, sizeof(Record));
+            return (uint64_t)record.sec * 1000000 + record.usec;
+        };
+        std::stable_sort(offsets.begin(), offsets.end(),
+                         [&timeOf](size_t a, size_t b) { return timeOf(a) < timeOf(b); });
+
+        for (size_t offset : offsets) {
+            Record record;
+            memcpy(&record, staging.data() + offset, sizeof(Record));
+            writeRecord(record, staging.data() + offset + sizeof(Record), packet);
+        }
+        if (file) {
+            fflush(file);
+        }
+
+        lock.lock();
+        if (last) {
+            break;
+        }
+    }
+    lock.unlock();
+    closeOutput();
+}
+
+void PJSIPPacketCapture::drain(std::vector<uint8_t>& staging, std::vector<size_t>& offsets) {
+    std::vector<Ring*> current;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const std::unique_ptr<Ring>& ring : rings) {
+            current.push_back(ring.get());
+        }
+    }
+
+    for (Ring* ring : current) {
+        uint64_t read = ring->read.load(std::memory_order_relaxed);
+        uint64_t write = ring->write.load(std::memory_order_acquire);
+        while (read < write) {
+            Record record;
+            copyOut(ring->data.get(), ring->capacity, read, &record, sizeof(Record));
+            size_t offset = staging.size();
+            staging.resize(offset + sizeof(Record) + record.length);
+            memcpy(staging.data() + offset, &record, sizeof(Record));
+            copyOut(ring->data.get(), ring->capacity, read + sizeof(Record), staging.data() + offset + sizeof(Record),
+                    record.length);
+            offsets.push_back(offset);
+            read += sizeof(Record) + paddedLength(record.length);
+        }
+        ring->read.store(read, std::memory_order_release);
+    }
+}
+
+void PJSIPPacketCapture::writeRecord(const Record& record, const uint8_t* data, std::vector<uint8_t>& packet) {
+    if (options.format == PJSIPCaptureFormat::Pcap) {
+        writePcap(record, data, packet);
+    } else {
+        sendHep(record, data, packet);
+    }
+}
+
+// IPv4/IPv6 + UDP around the message, checksums included so Wireshark
+// does not flag every packet
+void PJSIPPacketCapture::writePcap(const Record& record, const uint8_t* data, std::vector<uint8_t>& packet) {
+    if (options.rotate_bytes > 0 && file_bytes >= options.rotate_bytes) {
+        closeOutput();
+        openFile();
+    }
+    if (!file) {
+        write_errors.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    bool ipv6 = record.src.family == 6 && record.dst.family == 6;
+    uint32_t address_length = ipv6 ? 16 : 4;
+    uint32_t udp_length = 8 + record.length;
+    uint32_t ip_length = (ipv6 ? 40 : 20) + udp_length;
+
+    packet.clear();
+    putNative32(packet, record.sec);
+    putNative32(packet, record.usec);
+    putNative32(packet, ip_length);
+    putNative32(packet, ip_length);
+
+    size_t ip_start = packet.size();
+    if (ipv6) {
+        putBE32(packet, 0x60000000);
+        putBE16(packet, (uint16_t)udp_length);
+        packet.push_back(PROTO_UDP);
+        packet.push_back(64);
+        packet.insert(packet.end(), record.src.addr, record.src.addr + 16);
+        packet.insert(packet.end(), record.dst.addr, record.dst.addr + 16);
+    } else {
+        packet.push_back(0x45);
+        packet.push_back(0);
+        putBE16(packet, (uint16_t)ip_length);
+        putBE16(packet, 0);
+        putBE16(packet, 0x4000);    // don't fragment
+        packet.push_back(64);
+        packet.push_back(PROTO_UDP);
+        putBE16(packet, 0);
+        packet.insert(packet.end(), record.src.addr, record.src.addr + 4);
+        packet.insert(packet.end(), record.dst.addr, record.dst.addr + 4);
+        setBE16(packet, ip_start + 10, foldSum(sumWords(packet.data() + ip_start, 20, 0)));
+    }
+
+    size_t udp_start = packet.size();
+    putBE16(packet, record.src.port);
+    putBE16(packet, record.dst.port);
+    putBE16(packet, (uint16_t)udp_length);
+    putBE16(packet, 0);
+    packet.insert(packet.end(), data, data + record.length);
+
+    uint32_t sum = sumWords(record.src.addr, address_length, 0);
+    sum = sumWords(record.dst.addr, address_length, sum);
+    sum += PROTO_UDP + udp_length;
+    sum = sumWords(packet.data() + udp_start, udp_length, sum);
+    uint16_t checksum = foldSum(sum);
+    setBE16(packet, udp_start + 6, checksum ? checksum : 0xffff);
+
+    if (fwrite(packet.data(), 1, packet.size(), file) != packet.size()) {
+        write_errors.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    file_bytes += packet.size();
+    written.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(record.length, std::memory_order_relaxed);
+}
+
+// HEPv3: "HEP3", total length, then vendor/type/length chunks
+void PJSIPPacketCapture::sendHep(const Record& record, const uint8_t* data, std::vector<uint8_t>& packet) {
+    auto chunk = [&packet](uint16_t type, const void* value, size_t length) {
+        putBE16(packet, 0);
+        putBE16(packet, type);
+        putBE16(packet, (uint16_t)(6 + length));
+        const uint8_t* bytes = static_cast<const uint8_t*>(value);
+        packet.insert(packet.end(), bytes, bytes + length);
+    };
+    auto chunk8 = [&chunk](uint16_t type, uint8_t value) { chunk(type, &value, 1); };
+    auto chunk16 = [&chunk](uint16_t type, uint16_t value) {
+        uint8_t bytes[2] = { (uint8_t)(value >> 8), (uint8_t)(value & 0xff) };
+        chunk(type, bytes, 2);
+    };
+    auto chunk32 = [&chunk](uint16_t type, uint32_t value) {
+        uint8_t bytes[4] = { (uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8),
+                             (uint8_t)(value & 0xff) };
+        chunk(type, bytes, 4);
+    };
+
+    bool ipv6 = record.src.family == 6 && record.dst.family == 6;
+    packet.clear();
+    packet.insert(packet.end(), { 'H', 'E', 'P', '3', 0, 0 });
+    chunk8(0x0001, ipv6 ? 10 : 2);
+    chunk8(0x0002, record.protocol);
+    chunk(ipv6 ? 0x0005 : 0x0003, record.src.addr, ipv6 ? 16 : 4);
+    chunk(ipv6 ? 0x0006 : 0x0004, record.dst.addr, ipv6 ? 16 : 4);
+    chunk16(0x0007, record.src.port);
+    chunk16(0x0008, record.dst.port);
+    chunk32(0x0009, record.sec);
+    chunk32(0x000a, record.usec);
+    chunk8(0x000b, 1);              // SIP
+    chunk32(0x000c, options.agent_id);
+    if (!options.password.empty()) {
+        chunk(0x000e, options.password.data(), options.password.size());
+    }
+    chunk(0x000f, data, record.length);
+    setBE16(packet, 4, (uint16_t)packet.size());
+
+    pj_ssize_t length = (pj_ssize_t)packet.size();
+    if (pj_sock_sendto(sock, packet.data(), &length, 0, &collector, pj_sockaddr_get_len(&collector)) != PJ_SUCCESS) {
+        write_errors.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    written.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(record.length, std::memory_order_relaxed);
+}
+
+// "trace.pcap" rotates through trace.0.pcap, trace.1.pcap, ...
+bool PJSIPPacketCapture::openFile() {
+    std::string name = options.path;
+    if (options.rotate_bytes > 0) {
+        size_t slash = name.find_last_of("/\\");
+        size_t dot = name.rfind('.');
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+            dot = name.size();
+        }
+        name = name.substr(0, dot) + "." + std::to_string(file_index) + name.substr(dot);
+
+        if (options.max_files > 0 && file_index >= options.max_files) {
+            std::string old = options.path.substr(0, dot) + "." + std::to_string(file_index - options.max_files) +
+                              options.path.substr(dot);
+            std::remove(old.c_str());
+        }
+        file_index++;
+    }
+
+    file = fopen(name.c_str(), "wb");
+    file_bytes = 0;
+    if (!file) {
+        PJW_LOG_WARN("⚠️ Capture: cannot open %s", name.c_str());
+        return false;
+    }
+
+    std::vector<uint8_t> header;
+    putNative32(header, PCAP_MAGIC);    // host byte order, readers swap by it
+    putNative16(header, 2);
+    putNative16(header, 4);
+    putNative32(header, 0);         // thiszone
+    putNative32(header, 0);         // sigfigs
+    putNative32(header, PCAP_SNAPLEN);
+    putNative32(header, PCAP_LINKTYPE_RAW);
+    if (fwrite(header.data(), 1, header.size(), file) != header.size()) {
+        write_errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    file_bytes = header.size();
+    files.fetch_add(1, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    file_name = name;
+    return true;
+}
+
+void PJSIPPacketCapture::closeOutput() {
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+    if (sock != PJ_INVALID_SOCKET) {
+        pj_sock_close(sock);
+        sock = PJ_INVALID_SOCKET;
+    }
+}
+
+bool PJSIPPacketCapture::parseAor(const std::string& aor, Account& out) {
+    size_t start = aor.find('<');
+    start = start == std::string::npos ? 0 : start + 1;
+    size_t colon = aor.find(':', start);
+    if (colon == std::string::npos) {
+        return false;
+    }
+
+    std::string rest = aor.substr(colon + 1);
+    size_t at = rest.find('@');
+    out.user = at == std::string::npos ? "" : rest.substr(0, at);
+    std::string host = at == std::string::npos ? rest : rest.substr(at + 1);
+    if (!host.empty() && host[0] == '[') {
+        size_t close = host.find(']');
+        out.host = host.substr(1, close == std::string::npos ? std::string::npos : close - 1);
+    } else {
+        out.host = host.substr(0, host.find_first_of(":;>?"));
+    }
+    return !out.host.empty();
+}
+
+bool PJSIPPacketCapture::parseFormat(const std::string& name, PJSIPCaptureFormat& format) {
+    if (name == "pcap") {
+        format = PJSIPCaptureFormat::Pcap;
+    } else if (name == "hep") {
+        format = PJSIPCaptureFormat::Hep;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* PJSIPPacketCapture::formatName(PJSIPCaptureFormat format) {
+    return format == PJSIPCaptureFormat::Hep ? "hep" : "pcap";
+}
@@ -0,0 +1,180 @@
+#ifndef NODE_PJSIP_PACKET_CAPTURE_H
+#define NODE_PJSIP_PACKET_CAPTURE_H
+
+#include <pjsua-lib/pjsua.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class PJSIPCaptureFormat {
+    Pcap,       // rotated capture files
+    Hep         // HEPv3 datagrams to a collector (Homer, heplify-server)
+};
+
+struct PJSIPCaptureOptions {
+    PJSIPCaptureFormat format;
+    std::string path;                   // pcap: file, numbered before the extension when rotating
+    uint64_t rotate_bytes;              // pcap: next file after this many bytes, 0 = one file
+    unsigned max_files;                 // pcap: rotated files kept, 0 = all
+    std::string collector;              // hep: "ip:port" or "[ipv6]:port"
+    uint32_t agent_id;                  // hep: capture agent id
+    std::string password;               // hep: auth key, empty = none
+    double sample;                      // fraction of Call-IDs captured, 1 = every message
+    std::vector<std::string> methods;   // request method, CSeq method for responses; empty = all
+    std::vector<std::string> call_ids;  // empty = all
+    std::vector<std::string> accounts;  // AORs matched against From and To; empty = all
+    unsigned buffer_kb;                 // ring per SIP thread
+
+    PJSIPCaptureOptions();
+};
+
+struct PJSIPCaptureStats {
+    bool active;
+    PJSIPCaptureFormat format;
+    uint64_t captured;                  // messages copied into a ring
+    uint64_t filtered;                  // skipped by the filters or sampling
+    uint64_t dropped;                   // lost because a ring was full
+    uint64_t written;                   // written to a file or sent to the collector
+    uint64_t bytes;                     // SIP bytes written
+    uint32_t files;                     // pcap files opened
+    uint32_t write_errors;
+    unsigned rings;
+    std::string file;                   // pcap file being written
+};
+
+// SIP message capture for production tracing, without pjlib's message log.
+//
+// A pjsip module next to the transport layer, registered only while a
+// capture runs, so there is nothing on the message path otherwise. It
+// checks the filters and copies each message with its addresses into a
+// single-producer ring owned by the calling thread; a full ring drops and
+// counts. Every WRITE_INTERVAL_MS the writer thread drains the rings, sorts
+// the batch by time and writes it out:
+//
+// - pcap (LINKTYPE_RAW): every message as a UDP datagram between the real
+//   addresses and ports, TLS already decrypted, so Wireshark decodes it as
+//   SIP whatever the transport. Files rotate at rotate_bytes.
+// - HEPv3 over UDP to a collector, with the real transport protocol.
+//
+// Sampling hashes the Call-ID, so a sampled dialog is captured whole.
+class PJSIPPacketCapture {
+public:
+    static const unsigned WRITE_INTERVAL_MS = 100;
+    static const unsigned DEFAULT_BUFFER_KB = 1024;
+    static const unsigned MAX_BUFFER_KB = 65536;
+    static const uint16_t DEFAULT_HEP_PORT = 9060;
+
+    PJSIPPacketCapture();
+    ~PJSIPPacketCapture();
+
+    PJSIPPacketCapture(const PJSIPPacketCapture&) = delete;
+    PJSIPPacketCapture& operator=(const PJSIPPacketCapture&) = delete;
+
+    // JS thread, while the engine runs. start() replaces a running capture;
+    // stop() returns once everything captured is written.
+    bool start(const PJSIPCaptureOptions& options);
+    PJSIPCaptureStats stop();
+    PJSIPCaptureStats stats() const;
+
+    static bool parseFormat(const std::string& name, PJSIPCaptureFormat& format);
+    static const char* formatName(PJSIPCaptureFormat format);
+
+private:
+    // An address as it goes on the wire
+    struct Endpoint {
+        uint8_t family;                 // 4 or 6
+        uint8_t addr[16];
+        uint16_t port;
+    };
+
+    // Ring entry, the message follows padded to 8 bytes
+    struct Record {
+        uint32_t length;
+        uint8_t outgoing;
+        uint8_t protocol;               // IPPROTO_UDP or IPPROTO_TCP
+        Endpoint src;
+        Endpoint dst;
+        uint32_t sec;
+        uint32_t usec;
+    };
+
+    struct Ring {
+        std::unique_ptr<uint8_t[]> data;
+        uint64_t capacity;              // power of two
+        std::atomic<uint64_t> write;    // owning SIP thread
+        std::atomic<uint64_t> read;     // writer thread
+
+        explicit Ring(uint64_t capacity) : data(new uint8_t[capacity]), capacity(capacity), write(0), read(0) {}
+    };
+
+    struct Account {
+        std::string user;
+        std::string host;
+    };
+
+    static pj_bool_t onRxMessage(pjsip_rx_data* rdata);
+    static pj_status_t onTxMessage(pjsip_tx_data* tdata);
+
+    // SIP threads
+    bool matches(const pjsip_msg* msg) const;
+    bool matchesAccount(const pjsip_msg* msg) const;
+    void push(const Record& record, const char* data);
+    Ring* threadRing();
+    static void localEndpoint(const pjsip_transport* tp, Endpoint& out);
+    static void toEndpoint(const pj_sockaddr& addr, Endpoint& out);
+
+    // Writer thread
+    void run();
+    void drain(std::vector<uint8_t>& staging, std::vector<size_t>& offsets);
+    void writeRecord(const Record& record, const uint8_t* data, std::vector<uint8_t>& packet);
+    void writePcap(const Record& record, const uint8_t* data, std::vector<uint8_t>& packet);
+    void sendHep(const Record& record, const uint8_t* data, std::vector<uint8_t>& packet);
+    bool openFile();
+    void closeOutput();
+
+    void halt();                        // control mutex held
+
+    static bool parseAor(const std::string& aor, Account& out);
+
+    static PJSIPPacketCapture* active;
+
+    std::mutex control_mutex;           // start/stop from any env
+    mutable std::mutex mutex;           // rings, file name, writer state
+    std::condition_variable cv;
+    std::thread writer;
+    bool running;
+
+    // Fixed while the module is registered
+    PJSIPCaptureOptions options;
+    std::vector<Account> accounts;
+    uint32_t sample_threshold;          // Call-ID hashes per million captured
+    uint64_t ring_bytes;
+    uint64_t generation;                // thread rings of older captures are stale
+
+    std::vector<std::unique_ptr<Ring>> rings;
+
+    // Writer thread
+    FILE* file;
+    std::string file_name;              // mutex
+    uint64_t file_bytes;
+    uint32_t file_index;
+    pj_sock_t sock;
+    pj_sockaddr collector;
+
+    std::atomic<uint64_t> captured;
+    std::atomic<uint64_t> filtered;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> written;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint32_t> files;
+    std::atomic<uint32_t> write_errors;
+};
+
+#endif
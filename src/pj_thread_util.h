@@ -0,0 +1,20 @@
+#ifndef NODE_PJSIP_PJ_THREAD_UTIL_H
+#define NODE_PJSIP_PJ_THREAD_UTIL_H
+
+#include <pjlib.h>
+
+// Registers the calling native thread with pjlib so it may call into pjsua.
+// Safe to call repeatedly; the descriptor must outlive the thread, hence
+// thread_local storage.
+inline bool pjsipRegisterThread(const char* name) {
+    if (pj_thread_is_registered()) {
+        return true;
+    }
+
+    static thread_local pj_thread_desc desc;
+    pj_thread_t* thread = nullptr;
+    pj_bzero(desc, sizeof(desc));
+    return pj_thread_register(name, desc, &thread) == PJ_SUCCESS;
+}
+
+#endif
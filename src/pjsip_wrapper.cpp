@@ -1,21 +1,26 @@
 #include "pjsip_wrapper.h"
 #include <napi.h>
-#include <iostream>
+#include <pjsua-lib/pjsua_internal.h>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <sstream>
 
-// Static instance
-PJSIPWrapper* PJSIPWrapper::instance = nullptr;
-
-// PJSIPAccount implementation
-PJSIPAccount::PJSIPAccount() : acc_id(PJSUA_INVALID_ID), is_registered(false) {
-    pj_bzero(&acc_info, sizeof(acc_info));
-}
-
-PJSIPAccount::~PJSIPAccount() {
+// PJSIPInitOptions implementation
+PJSIPInitOptions::PJSIPInitOptions() : max_calls(-1), thread_cnt(-1), media_thread_cnt(-1),
+    has_ioqueue(-1), clock_rate(-1), ptime(-1), conf_ports(-1),
+    audio_device(PJSIPAudioDevice::Default), auto_connect_audio(-1), log_level(-1),
+    media_mode(PJSIPMediaMode::Full) {
 }
 
 // PJSIPWrapper implementation
-PJSIPWrapper::PJSIPWrapper() : is_initialized(false), next_account_id(0), transport_id(PJSUA_INVALID_ID) {
+PJSIPWrapper::PJSIPWrapper() : is_initialized(false), attached_envs(0), media_mode(PJSIPMediaMode::Full),
+    audio_device(PJSIPAudioDevice::Default), auto_connect_audio(true), admission(&PJSIPEnvContext::queueDepth),
+    registrations(this),
+    media_stats(&calls), codecs(&calls), dns(&flows) {
+    for (std::atomic<pjsua_transport_id>& id : env_primary) {
+        id.store(PJSUA_INVALID_ID, std::memory_order_relaxed);
+    }
 }
 
 PJSIPWrapper::~PJSIPWrapper() {
@@ -23,99 +28,394 @@ PJSIPWrapper::~PJSIPWrapper() {
 }
 
 PJSIPWrapper* PJSIPWrapper::getInstance() {
-    if (instance == nullptr) {
-        instance = new PJSIPWrapper();
+    // Built on first use by whichever env loads the addon first and never
+    // destroyed: the engine it holds is shut down by the last env to detach,
+    // not at exit, after the log sink and metrics are gone
+    static PJSIPWrapper* wrapper = new PJSIPWrapper();
+    return wrapper;
+}
+
+// Fills an event record from pjsua's call slot directly. pjsua_call_get_info()
+// would format a dozen strings for the four numbers we need. Only called from
+// pjsua callbacks, which run with the call's dialog lock held.
+static void fillCallEvent(PJSIPEvent& event, PJSIPEventType type, pjsua_call_id call_id) {
+    const pjsua_call& call = pjsua_var.calls[call_id];
+    
+    event.type = type;
+    event.acc_id = call.acc_id;
+    event.call_id = call_id;
+    event.state = call.inv ? (int32_t)call.inv->state : (int32_t)PJSIP_INV_STATE_NULL;
+    event.status_code = (int32_t)call.last_code;
+    event.media_status = call.audio_idx >= 0 ? (int32_t)call.media[call.audio_idx].state
+                                             : (int32_t)PJSUA_CALL_MEDIA_NONE;
+    event.timestamp_us = pjsipMonotonicMicros();
+}
+
+// Remote party as the dialog has it, From of an incoming call or To of an outgoing one
+static std::string remoteInfo(const pjsua_call& call) {
+    if (!call.inv || !call.inv->dlg) {
+        return std::string();
+    }
+    return std::string(call.inv->dlg->remote.info_str.ptr, call.inv->dlg->remote.info_str.slen);
+}
+
+// SDP text for JS. Bodies larger than a SIP packet cannot have been on the wire.
+static std::shared_ptr<const std::string> printSdp(const pjmedia_sdp_session* sdp) {
+    char buffer[PJSIP_MAX_PKT_LEN];
+    int length = pjmedia_sdp_print(sdp, buffer, sizeof(buffer));
+    if (length <= 0) {
+        return nullptr;
+    }
+    return std::make_shared<const std::string>(buffer, (size_t)length);
+}
+
+// Parsed bodies point into their text, so both live in the given pool
+static pjmedia_sdp_session* parseSdp(pj_pool_t* pool, const std::string& text) {
+    char* copy = (char*)pj_pool_alloc(pool, text.size() + 1);
+    memcpy(copy, text.c_str(), text.size() + 1);
+    
+    pjmedia_sdp_session* sdp = nullptr;
+    if (pjmedia_sdp_parse(pool, copy, text.size(), &sdp) != PJ_SUCCESS) {
+        return nullptr;
+    }
+    return sdp;
+}
+
+// Answer latency and failure codes, read back from the call table after update()
+static void recordCallMetrics(const PJSIPCallTable& calls, const PJSIPEvent& event) {
+    if (event.state != PJSIP_INV_STATE_CONFIRMED && event.state != PJSIP_INV_STATE_DISCONNECTED) {
+        return;
+    }
+    
+    PJSIPCallRecord record;
+    calls.get(event.call_id, record);  // still filled in once the call is closed
+    PJSIPMetrics& metrics = PJSIPMetrics::instance();
+    
+    if (event.state == PJSIP_INV_STATE_CONFIRMED) {
+        if (record.connected_us == event.timestamp_us) {  // first CONFIRMED only
+            metrics.increment(PJSIPCounter::CallsConnected);
+            double answer_us = record.connected_us - record.created_us;
+            metrics.record(PJSIPHistogram::InviteToAnswer, answer_us > 0 ? (uint64_t)answer_us : 0);
+        }
+        return;
+    }
+    
+    metrics.increment(PJSIPCounter::CallsEnded);
+    if (record.connected_us == 0) {
+        metrics.increment(PJSIPCounter::CallsFailed);
+        metrics.recordFailure(PJSIPFailureKind::Call, event.status_code);
     }
-    return instance;
 }
 
 // PJSIP callback handlers
+void PJSIPWrapper::pjsip_on_reg_started(pjsua_acc_id acc_id, pj_bool_t renew) {
+    PJSIPCallbackTimer timer;
+    PJ_UNUSED_ARG(renew);
+    PJSIPMetrics::instance().onRegisterSent(acc_id, pjsipMonotonicMicros());
+}
+
 void PJSIPWrapper::pjsip_on_reg_state(pjsua_acc_id acc_id) {
+    PJSIPCallbackTimer timer;
     PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
     pjsua_acc_info acc_info;
     pj_status_t status = pjsua_acc_get_info(acc_id, &acc_info);
     
     if (status == PJ_SUCCESS) {
         std::string aor = std::string(acc_info.acc_uri.ptr, acc_info.acc_uri.slen);
+        PJSIPMetrics::instance().onRegisterCompleted(acc_id, acc_info.status, pjsipMonotonicMicros());
         
         if (acc_info.status == PJSIP_SC_OK) {
-            std::cout << "✅ Registration successful for: " << aor << std::endl;
+            PJW_LOG_INFO("✅ Registration successful for: %s", aor.c_str());
             if (wrapper->on_registered) {
                 wrapper->on_registered(aor);
             }
         } else {
-            std::cout << "❌ Registration failed for: " << aor << " (Status: " << acc_info.status << ")" << std::endl;
+            PJW_LOG_WARN("❌ Registration failed for: %s (Status: %d)", aor.c_str(), (int)acc_info.status);
             if (wrapper->on_register_failed) {
                 wrapper->on_register_failed(aor);
             }
         }
         
-        // Update account registration status
-        std::lock_guard<std::mutex> lock(wrapper->accounts_mutex);
-        for (auto& account : wrapper->accounts) {
-            if (account->acc_id == acc_id) {
-                account->is_registered = (acc_info.status == PJSIP_SC_OK);
-                account->acc_info = acc_info;
-                break;
-            }
-        }
+        PJSIPEvent event = { PJSIPEventType::RegState, acc_id, PJSUA_INVALID_ID,
+                             (int32_t)acc_info.expires, (int32_t)acc_info.status,
+                             PJSUA_CALL_MEDIA_NONE, pjsipMonotonicMicros() };
+        PJSIPEnvContext::post(event);
+        
+        // Update account registration status - no lock, see PJSIPAccountTable
+        wrapper->accounts.updateRegState(acc_id, acc_info.status, acc_info.expires);
+        wrapper->registrations.onRegState(acc_id, acc_info.status);
+        wrapper->flows.onRegState(acc_id, acc_info.status == PJSIP_SC_OK && acc_info.expires > 0);
     }
 }
 
 void PJSIPWrapper::pjsip_on_incoming_call(pjsua_acc_id acc_id, pjsua_call_id call_id, pjsip_rx_data *rdata) {
+    PJSIPCallbackTimer timer;
     PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
-    pjsua_call_info call_info;
+    PJSIPMetrics::instance().increment(PJSIPCounter::CallsIncoming);
     
-    pjsua_call_get_info(call_id, &call_info);
-    std::string caller = std::string(call_info.remote_info.ptr, call_info.remote_info.slen);
+    // Shed load before anything reaches JS
+    unsigned accept_code = PJSIP_SC_OK;
+    if (wrapper->admission.admit(acc_id, call_id, accept_code) != PJSIPAdmissionResult::Accepted) {
+        return;
+    }
+    
+    PJSIPEvent event;
+    fillCallEvent(event, PJSIPEventType::IncomingCall, call_id);
+    PJSIPEnvContext::post(event);
+    
+    // The dialog already holds the From header text, no need for pjsua_call_get_info()
+    std::string remote_uri = remoteInfo(pjsua_var.calls[call_id]);
+    if (wrapper->calls.update(event)) {
+        wrapper->calls.open(call_id, acc_id, PJSIPCallDirection::Incoming, remote_uri);
+    }
     
-    std::cout << "📞 Incoming call from: " << caller << std::endl;
+    PJW_LOG_INFO("📞 Incoming call (Call ID: %d, account: %d)", call_id, acc_id);
     
     if (wrapper->on_incoming_call) {
-        wrapper->on_incoming_call(caller);
+        wrapper->on_incoming_call(remote_uri);
     }
     
-    // Auto-answer for demo (you can change this behavior)
-    pjsua_call_answer(call_id, 200, NULL, NULL);
+    // 200 auto-answers; 180/183 leave the decision to the application
+    pjsua_call_setting opt;
+    wrapper->callSetting(opt);
+    pjsua_call_answer2(call_id, &opt, accept_code, NULL, NULL);
 }
 
 void PJSIPWrapper::pjsip_on_call_state(pjsua_call_id call_id, pjsip_event *e) {
+    PJSIPCallbackTimer timer;
     PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
-    pjsua_call_info call_info;
     
-    pjsua_call_get_info(call_id, &call_info);
-    std::string state_text = std::string(call_info.state_text.ptr, call_info.state_text.slen);
+    PJSIPEvent event;
+    fillCallEvent(event, PJSIPEventType::CallState, call_id);
+    
+    // Calls turned away by admission control never reach JS
+    // Outgoing calls count against the caps from CALLING, incoming ones from
+    // admit(); both are released here, so the ledger only moves under the dialog lock
+    bool rejected = wrapper->admission.isRejected(call_id);
+    if (event.state == PJSIP_INV_STATE_CALLING) {
+        wrapper->admission.onOutgoingCall(event.acc_id, call_id);
+    } else if (event.state == PJSIP_INV_STATE_DISCONNECTED) {
+        wrapper->admission.onCallEnded(call_id);
+        wrapper->calls.releaseSdp(call_id);
+        wrapper->recordings.onCallEnded(call_id);
+        wrapper->bridges.onCallEnded(call_id);
+    }
+    if (rejected) {
+        return;
+    }
+    
+    PJSIPEnvContext::post(event);
+    
+    // Outgoing calls are opened by their first callback (CALLING, inside
+    // make_call). The dialog lock keeps their DISCONNECTED from coming first.
+    if (wrapper->calls.update(event)) {
+        const pjsua_call& call = pjsua_var.calls[call_id];
+        if (call.inv && call.inv->role == PJSIP_ROLE_UAC) {
+            wrapper->calls.open(call_id, event.acc_id, PJSIPCallDirection::Outgoing, remoteInfo(call));
+        }
+    }
+    recordCallMetrics(wrapper->calls, event);
     
-    std::cout << "📞 Call " << call_id << " state: " << state_text << std::endl;
+    const char* state_name = pjsip_inv_state_name((pjsip_inv_state)event.state);
+    PJW_LOG_DEBUG("📞 Call %d state: %s", call_id, state_name);
     
     if (wrapper->on_call_state) {
-        wrapper->on_call_state(state_text);
+        wrapper->on_call_state(state_name);
     }
 }
 
 void PJSIPWrapper::pjsip_on_call_media_state(pjsua_call_id call_id) {
-    pjsua_call_info call_info;
-    pjsua_call_get_info(call_id, &call_info);
+    PJSIPCallbackTimer timer;
+    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
+    
+    if (wrapper->admission.isRejected(call_id)) {
+        return;
+    }
+    
+    // Outgoing calls only see the remote body here, once it has been negotiated
+    const pjsua_call& call = pjsua_var.calls[call_id];
+    const pjmedia_sdp_session* remote = nullptr;
+    if (wrapper->media_mode == PJSIPMediaMode::Signalling && call.inv && call.inv->neg &&
+        pjmedia_sdp_neg_get_active_remote(call.inv->neg, &remote) == PJ_SUCCESS) {
+        wrapper->calls.setSdp(call_id, PJSIPSdpSide::Remote, printSdp(remote));
+    }
+    
+    PJSIPEvent event;
+    fillCallEvent(event, PJSIPEventType::CallMediaState, call_id);
+    PJSIPEnvContext::post(event);
+    wrapper->calls.update(event);
+    
+    // Bridged pairs route themselves, re-INVITEs included
+    if (wrapper->bridges.onMediaState(call_id)) {
+        return;
+    }
+    
+    // Headless nodes leave routing to the application
+    if (event.media_status == PJSUA_CALL_MEDIA_ACTIVE && wrapper->auto_connect_audio) {
+        pjsua_conf_port_id conf_slot = pjsua_call_get_conf_port(call_id);
+        pjsua_conf_connect(conf_slot, 0);
+        pjsua_conf_connect(0, conf_slot);
+        PJW_LOG_DEBUG("🔊 Media connected for call %d", call_id);
+    }
+}
+
+// Full media mode only. Audio transports get a relay adapter that stays a
+// pass-through until the call is bridged with one on the same codec.
+pjmedia_transport* PJSIPWrapper::pjsip_on_create_media_transport(pjsua_call_id call_id, unsigned media_idx,
+                                                                 pjmedia_transport *base_tp, unsigned flags) {
+    return PJSIPWrapper::getInstance()->bridges.wrapTransport(call_id, media_idx, base_tp, flags);
+}
+
+void PJSIPWrapper::pjsip_on_transport_state(pjsip_transport *tp, pjsip_transport_state state,
+                                            const pjsip_transport_state_info *info) {
+    PJSIPCallbackTimer timer;
+    PJ_UNUSED_ARG(info);
+    PJSIPWrapper::getInstance()->flows.onTransportState(tp, state);
+}
+
+// Signalling mode only. pjsua built a body without media lines; put the
+// application's in its place, keeping pjsua's origin so re-offers still
+// bump the version. The remote offer, if any, is kept for JS first.
+void PJSIPWrapper::pjsip_on_call_sdp_created(pjsua_call_id call_id, pjmedia_sdp_session *sdp, pj_pool_t *pool,
+                                             const pjmedia_sdp_session *rem_sdp) {
+    PJSIPCallbackTimer timer;
+    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
+    
+    if (rem_sdp) {
+        wrapper->calls.setSdp(call_id, PJSIPSdpSide::Remote, printSdp(rem_sdp));
+    }
+    
+    // makeCall() hands its body over as user data, the call id is not known
+    // yet. A body in the table only counts once the call is open, anything
+    // there before belongs to no call.
+    const std::string* text = static_cast<const std::string*>(pjsua_call_get_user_data(call_id));
+    std::shared_ptr<const std::string> local;
+    PJSIPCallRecord record;
+    if (text == nullptr && wrapper->calls.get(call_id, record)) {
+        local = wrapper->calls.getSdp(call_id, PJSIPSdpSide::Local);
+        text = local.get();
+    }
+    if (text == nullptr) {
+        text = wrapper->default_sdp.get();
+    }
+    if (text == nullptr) {
+        return;
+    }
     
-    if (call_info.media_status == PJSUA_CALL_MEDIA_ACTIVE) {
-        pjsua_conf_connect(call_info.conf_slot, 0);
-        pjsua_conf_connect(0, call_info.conf_slot);
-        std::cout << "🔊 Media connected for call " << call_id << std::endl;
+    pjmedia_sdp_session* replacement = parseSdp(pool, *text);
+    if (replacement == nullptr) {
+        PJW_LOG_WARN("⚠️ Call %d: invalid SDP, sending pjsua's media-less body", call_id);
+        return;
+    }
+    pj_uint32_t origin_id = sdp->origin.id;
+    pj_uint32_t origin_version = sdp->origin.version;
+    *sdp = *replacement;
+    sdp->origin.id = origin_id;
+    sdp->origin.version = origin_version;
+}
+
+// Signalling mode asks pjsua for no streams at all, so no RTP sockets or
+// codecs are set up per call
+void PJSIPWrapper::callSetting(pjsua_call_setting& opt) const {
+    pjsua_call_setting_default(&opt);
+    if (media_mode == PJSIPMediaMode::Signalling) {
+        opt.aud_cnt = 0;
+        opt.vid_cnt = 0;
     }
 }
 
+bool PJSIPWrapper::hasMedia(const char* what) const {
+    if (media_mode == PJSIPMediaMode::Signalling) {
+        PJW_LOG_ERROR("❌ Cannot create %s, media is disabled", what);
+        return false;
+    }
+    return true;
+}
+
 // Core functions - Real PJSIP API
-bool PJSIPWrapper::initialize() {
-    if (is_initialized) {
+bool PJSIPWrapper::initialize(const PJSIPInitOptions& options, unsigned env_id) {
+    std::lock_guard<std::mutex> lock(env_mutex);
+    uint32_t env_bit = 1u << env_id;
+    if (attached_envs & env_bit) {
+        return true;
+    }
+    
+    if (!is_initialized) {
+        if (!start(options)) {
+            return false;
+        }
+    } else {
+        // Engine sizing and media are fixed by the env that started it
+        if (!options.transports.empty() && !transports.add(options.transports, env_transports[env_id])) {
+            PJW_LOG_ERROR("❌ Error creating SIP transports for env %u", env_id);
+            return false;
+        }
+        if (!env_transports[env_id].empty()) {
+            env_primary[env_id].store(env_transports[env_id].front(), std::memory_order_release);
+        }
+        PJW_LOG_INFO("✅ Env %u attached to the running engine (%u own transports)", env_id,
+                     (unsigned)env_transports[env_id].size());
+    }
+    
+    attached_envs |= env_bit;
+    return true;
+}
+
+bool PJSIPWrapper::detach(unsigned env_id, bool network) {
+    std::lock_guard<std::mutex> lock(env_mutex);
+    uint32_t env_bit = 1u << env_id;
+    if (!(attached_envs & env_bit)) {
         return true;
     }
     
+    attached_envs &= ~env_bit;
+    if (attached_envs == 0) {
+        return shutdown(network);
+    }
+    
+    releaseEnv(env_id);
+    PJW_LOG_INFO("✅ Env %u detached from the engine", env_id);
+    return true;
+}
+
+// Hangs up the calls of the env's accounts, removes the accounts and closes
+// the env's listeners. pjsua_acc_del un-REGISTERs without waiting.
+void PJSIPWrapper::releaseEnv(unsigned env_id) {
+    std::vector<PJSIPCallRecord> records;
+    calls.snapshot(records);
+    for (const PJSIPCallRecord& record : records) {
+        if (PJSIPEnvContext::isOwnedBy(record.acc_id, env_id)) {
+            pjsua_call_hangup(record.call_id, 0, NULL, NULL);
+        }
+    }
+    
+    for (const std::shared_ptr<const PJSIPAccount>& account : accounts.snapshot()) {
+        if (PJSIPEnvContext::isOwnedBy(account->acc_id, env_id)) {
+            removeAccount(account->acc_id);
+        }
+    }
+    
+    env_primary[env_id].store(PJSUA_INVALID_ID, std::memory_order_release);
+    transports.close(env_transports[env_id]);
+    env_transports[env_id].clear();
+}
+
+// What an env started that calls back into its JS: media taps, the stats
+// sampler and provisioning batches. Node has closed their functions by now,
+// so this stops the native side still driving them.
+void PJSIPWrapper::releaseEnvCallbacks(unsigned env_id) {
+    registrations.cancel(env_id);
+    media_taps.release(env_id);
+    media_stats.release(env_id);
+}
+
+bool PJSIPWrapper::start(const PJSIPInitOptions& options) {
     pj_status_t status;
     
     // Create pjsua first
     status = pjsua_create();
     if (status != PJ_SUCCESS) {
-        std::cerr << "❌ Error in pjsua_create(): " << status << std::endl;
+        PJW_LOG_ERROR("❌ Error in pjsua_create(): %d", status);
         return false;
     }
     
@@ -125,30 +425,122 @@ bool PJSIPWrapper::initialize() {
     pjsua_media_config_default(&media_cfg);
     
     // Set callbacks
+    ua_cfg.cb.on_reg_started = &PJSIPWrapper::pjsip_on_reg_started;
     ua_cfg.cb.on_reg_state = &PJSIPWrapper::pjsip_on_reg_state;
     ua_cfg.cb.on_incoming_call = &PJSIPWrapper::pjsip_on_incoming_call;
     ua_cfg.cb.on_call_state = &PJSIPWrapper::pjsip_on_call_state;
     ua_cfg.cb.on_call_media_state = &PJSIPWrapper::pjsip_on_call_media_state;
+    ua_cfg.cb.on_transport_state = &PJSIPWrapper::pjsip_on_transport_state;
+    media_mode = options.media_mode;
+    default_sdp.reset();
+    if (media_mode == PJSIPMediaMode::Signalling) {
+        ua_cfg.cb.on_call_sdp_created = &PJSIPWrapper::pjsip_on_call_sdp_created;
+        if (!options.sdp.empty()) {
+            default_sdp = std::make_shared<const std::string>(options.sdp);
+        }
+    } else {
+        ua_cfg.cb.on_create_media_transport = &PJSIPWrapper::pjsip_on_create_media_transport;
+    }
+    
+    // Engine sizing
+    if (options.max_calls > 0) {
+        if (options.max_calls > PJSUA_MAX_CALLS) {
+            PJW_LOG_WARN("⚠️ maxCalls %d exceeds PJSUA_MAX_CALLS (%d), rebuild pjproject to raise it",
+                         options.max_calls, (int)PJSUA_MAX_CALLS);
+        }
+        ua_cfg.max_calls = (unsigned)std::min(options.max_calls, (int)PJSUA_MAX_CALLS);
+    }
+    if (options.thread_cnt >= 0) {
+        ua_cfg.thread_cnt = (unsigned)options.thread_cnt;
+    }
+    if (options.media_thread_cnt >= 0) {
+        media_cfg.thread_cnt = (unsigned)options.media_thread_cnt;
+    }
+    if (options.has_ioqueue >= 0) {
+        media_cfg.has_ioqueue = options.has_ioqueue ? PJ_TRUE : PJ_FALSE;
+    }
+    if (options.clock_rate > 0) {
+        media_cfg.clock_rate = (unsigned)options.clock_rate;
+    }
+    if (options.ptime > 0) {
+        media_cfg.audio_frame_ptime = (unsigned)options.ptime;
+    }
+    if (options.conf_ports > 0) {
+        media_cfg.max_media_ports = (unsigned)options.conf_ports;
+    } else if (media_cfg.max_media_ports < ua_cfg.max_calls + 2) {
+        // Every call needs a bridge port, plus the sound device and spare
+        media_cfg.max_media_ports = ua_cfg.max_calls + 2;
+    }
+    
+    // pjsua always brings up its media endpoint, keep it as small and idle as
+    // it goes: no worker threads or ioqueue, a bridge with no callers on it
+    // and nothing to clock it
+    if (media_mode == PJSIPMediaMode::Signalling) {
+        media_cfg.thread_cnt = 0;
+        media_cfg.has_ioqueue = PJ_FALSE;
+        media_cfg.max_media_ports = 2;
+        media_cfg.no_vad = PJ_TRUE;
+        media_cfg.ec_tail_len = 0;
+    }
     
-    // Configure logging
-    log_cfg.console_level = 4; // Info level
-    log_cfg.level = 4;
+    // Configure logging - pjlib output goes through the async sink too
+    int log_level = options.log_level >= 0 ? options.log_level : 4;
+    log_cfg.level = (unsigned)log_level;
+    log_cfg.console_level = (unsigned)log_level;
+    log_cfg.cb = &PJSIPLogSink::pjlibWriter;
     
     // Initialize pjsua
     status = pjsua_init(&ua_cfg, &log_cfg, &media_cfg);
     if (status != PJ_SUCCESS) {
-        std::cerr << "❌ Error in pjsua_init(): " << status << std::endl;
+        PJW_LOG_ERROR("❌ Error in pjsua_init(): %d", status);
         pjsua_destroy();
         return false;
     }
     
-    // Add UDP transport
-    pjsua_transport_config_default(&udp_cfg);
-    udp_cfg.port = 5060; // Default SIP port
+    // Keepalive on every TCP/TLS connection, before the first one exists
+    flows.configure(options.flows);
     
-    status = pjsua_transport_create(PJSIP_TRANSPORT_UDP, &udp_cfg, &transport_id);
-    if (status != PJ_SUCCESS) {
-        std::cerr << "❌ Error creating transport: " << status << std::endl;
+    // Asynchronous resolver and cache for every next hop, installed before
+    // the first request can go out. NAPTR only picks transports we listen on.
+    if (!options.dns.nameservers.empty()) {
+        unsigned transport_types = 0;
+        for (const PJSIPTransportConfig& listener : options.transports) {
+            transport_types |= 1u << (listener.type & ~PJSIP_TRANSPORT_IPV6);
+        }
+        if (!dns.start(pjsua_get_pjsip_endpt(), options.dns,
+                       transport_types ? transport_types : 1u << PJSIP_TRANSPORT_UDP)) {
+            pjsua_destroy();
+            return false;
+        }
+    }
+    
+    // Pick the bridge clock. Without a sound card there is nothing to
+    // connect slot 0 to, so calls are only bridged on request.
+    audio_device = media_mode == PJSIPMediaMode::Signalling ? PJSIPAudioDevice::None : options.audio_device;
+    if (audio_device == PJSIPAudioDevice::Null) {
+        status = pjsua_set_null_snd_dev();
+        if (status != PJ_SUCCESS) {
+            PJW_LOG_ERROR("❌ Error setting null sound device: %d", status);
+            pjsua_destroy();
+            return false;
+        }
+    } else if (audio_device == PJSIPAudioDevice::None) {
+        pjsua_set_no_snd_dev();
+    }
+    auto_connect_audio = options.auto_connect_audio >= 0 ? options.auto_connect_audio != 0
+                                                         : audio_device == PJSIPAudioDevice::Default;
+    if (media_mode == PJSIPMediaMode::Signalling) {
+        auto_connect_audio = false;
+    }
+    
+    // SIP listeners, one UDP socket on 5060 unless configured
+    std::vector<PJSIPTransportConfig> listeners = options.transports;
+    if (listeners.empty()) {
+        listeners.push_back(PJSIPTransportConfig());
+    }
+    if (!transports.start(listeners)) {
+        PJW_LOG_ERROR("❌ Error creating SIP transports");
+        transports.clear();
         pjsua_destroy();
         return false;
     }
@@ -156,96 +548,153 @@ bool PJSIPWrapper::initialize() {
     // Start pjsua
     status = pjsua_start();
     if (status != PJ_SUCCESS) {
-        std::cerr << "❌ Error starting pjsua: " << status << std::endl;
+        PJW_LOG_ERROR("❌ Error starting pjsua: %d", status);
         pjsua_destroy();
         return false;
     }
     
     is_initialized = true;
-    std::cout << "✅ PJSIP initialized successfully" << std::endl;
+    PJW_LOG_INFO("✅ PJSIP initialized successfully (max calls: %u, SIP threads: %u, media threads: %u, transports: %u%s)",
+                 ua_cfg.max_calls, ua_cfg.thread_cnt, media_cfg.thread_cnt, (unsigned)transports.count(),
+                 media_mode == PJSIPMediaMode::Signalling ? ", signalling only" : "");
     return true;
 }
 
-bool PJSIPWrapper::shutdown() {
+bool PJSIPWrapper::shutdown(bool network) {
     if (!is_initialized) {
         return true;
     }
     
-    std::cout << "🛑 Shutting down PJSIP..." << std::endl;
-    
-    // Clear accounts
-    {
-        std::lock_guard<std::mutex> lock(accounts_mutex);
-        accounts.clear();
+    PJW_LOG_INFO("🛑 Shutting down PJSIP%s...", network ? "" : " without network");
+    
+    // Stop bulk provisioning and the stats sampler before their threads lose pjsua
+    registrations.stop();
+    media_stats.stop();
+    media_taps.clear();
+    recordings.clear();
+    bridges.clear();
+    capture.stop();
+    
+    // Clear accounts and calls
+    accounts.clear();
+    PJSIPEnvContext::clearAccountOwners();
+    calls.clear();
+    admission.reset();
+    transports.clear();
+    for (unsigned i = 0; i < PJSIPEnvContext::MAX_ENVS; i++) {
+        env_primary[i].store(PJSUA_INVALID_ID, std::memory_order_release);
+        env_transports[i].clear();
     }
+    attached_envs = 0;
     
-    // Destroy pjsua
-    pjsua_destroy();
+    // Destroy pjsua. With the network it unregisters every account and hangs
+    // up every call, waiting for the answers; a drained node has nothing to say.
+    pjsua_destroy2(network ? 0 : PJSUA_DESTROY_NO_NETWORK);
+    admission.setDraining(false);
+    dns.clear();
+    flows.clear();
     
     is_initialized = false;
-    std::cout << "✅ PJSIP shutdown complete" << std::endl;
+    PJW_LOG_INFO("✅ PJSIP shutdown complete");
     return true;
 }
 
+// pjlib verbosity, forwarded through log_cfg.cb at runtime
+bool PJSIPWrapper::setPjlibLogLevel(int level) {
+    log_cfg.level = (unsigned)level;
+    log_cfg.console_level = (unsigned)level;
+    if (!is_initialized) {
+        return true;
+    }
+    return pjsua_reconfigure_logging(&log_cfg) == PJ_SUCCESS;
+}
+
 // Account management - Real PJSIP API
 int PJSIPWrapper::addAccount(const std::string& aor, const std::string& registrar, 
                            const std::string& username, const std::string& password,
                            const std::string& proxy) {
+    PJSIPAccountConfig config;
+    config.aor = aor;
+    config.registrar = registrar;
+    config.username = username;
+    config.password = password;
+    config.proxy = proxy;
+    return addAccount(config);
+}
+
+int PJSIPWrapper::addAccount(const PJSIPAccountConfig& config) {
     if (!is_initialized) {
-        std::cerr << "❌ PJSIP not initialized" << std::endl;
+        PJW_LOG_ERROR("❌ PJSIP not initialized");
         return -1;
     }
     
+    // Intern the strings first, the pjsua config points straight into the record
+    std::shared_ptr<PJSIPAccount> account = PJSIPAccount::create(config);
+    
     // Create account config
     pjsua_acc_config acc_cfg;
     pjsua_acc_config_default(&acc_cfg);
     
-    // Set account ID and registrar
-    acc_cfg.id = pj_str((char*)aor.c_str());
-    acc_cfg.reg_uri = pj_str((char*)registrar.c_str());
+    // Set account ID and registrar. Registration starts once the owning env
+    // is recorded, so not even the first answer can be routed elsewhere.
+    acc_cfg.id = account->aor;
+    acc_cfg.reg_uri = account->registrar;
+    acc_cfg.register_on_acc_add = PJ_FALSE;
+    if (config.reg_timeout > 0) {
+        acc_cfg.reg_timeout = config.reg_timeout;
+    }
     
-    // Set credentials
+    // Set credentials - pjsua keeps its own copy, the record does not
     acc_cfg.cred_count = 1;
     acc_cfg.cred_info[0].realm = pj_str((char*)"*");
     acc_cfg.cred_info[0].scheme = pj_str((char*)"digest");
-    acc_cfg.cred_info[0].username = pj_str((char*)username.c_str());
+    acc_cfg.cred_info[0].username = account->username;
     acc_cfg.cred_info[0].data_type = PJSIP_CRED_DATA_PLAIN_PASSWD;
-    acc_cfg.cred_info[0].data = pj_str((char*)password.c_str());
+    acc_cfg.cred_info[0].data = pj_str((char*)config.password.c_str());
     
     // Set proxy if provided
-    if (!proxy.empty()) {
+    if (account->proxy.slen > 0) {
         acc_cfg.proxy_cnt = 1;
-        acc_cfg.proxy[0] = pj_str((char*)proxy.c_str());
+        acc_cfg.proxy[0] = account->proxy;
+    }
+    
+    // Outbound, keepalive and re-REGISTER pacing for the account's flow
+    flows.configureAccount(acc_cfg, config);
+    
+    // An env with listeners of its own sends through them
+    if (config.env_id < PJSIPEnvContext::MAX_ENVS) {
+        acc_cfg.transport_id = env_primary[config.env_id].load(std::memory_order_acquire);
     }
     
-    // Add account
+    // Add account - only the first interactive account becomes the default,
+    // taking over from a local one; paced batches never do
     pjsua_acc_id acc_id;
-    pj_status_t status = pjsua_acc_add(&acc_cfg, PJ_TRUE, &acc_id);
+    PJSUA_LOCK();
+    pjsua_acc_id current_default = pjsua_acc_get_default();
+    bool has_default = pjsua_acc_is_valid(current_default) && pjsua_var.acc[current_default].cfg.reg_uri.slen > 0;
+    pj_status_t status = pjsua_acc_add(&acc_cfg, config.register_on_add && !has_default ? PJ_TRUE : PJ_FALSE, &acc_id);
+    PJSUA_UNLOCK();
     
     if (status != PJ_SUCCESS) {
-        std::cerr << "❌ Error adding account: " << status << std::endl;
+        PJW_LOG_ERROR("❌ Error adding account: %d", status);
         return -1;
     }
-    
-    // Create account object
-    auto account = std::make_unique<PJSIPAccount>();
     account->acc_id = acc_id;
-    account->aor = aor;
-    account->registrar = registrar;
-    account->username = username;
-    account->password = password;
-    account->proxy = proxy;
-    account->is_registered = false;
     
-    int account_index = next_account_id++;
+    // Store account in the slot pjsua assigned
+    accounts.insert(std::move(account));
+    PJSIPEnvContext::setAccountOwner(acc_id, config.env_id);
     
-    // Store account
-    {
-        std::lock_guard<std::mutex> lock(accounts_mutex);
-        accounts.push_back(std::move(account));
+    if (config.register_on_add) {
+        status = pjsua_acc_set_registration(acc_id, PJ_TRUE);
+        if (status != PJ_SUCCESS) {
+            PJW_LOG_ERROR("❌ Error registering account: %d", status);
+        }
     }
     
-    std::cout << "✅ Account added: " << aor << " (ID: " << acc_id << ")" << std::endl;
+    if (config.register_on_add) {
+        PJW_LOG_INFO("✅ Account added: %s (ID: %d)", config.aor.c_str(), acc_id);
+    }
     return acc_id;
 }
 
@@ -256,45 +705,79 @@ bool PJSIPWrapper::removeAccount(int acc_id) {
     
     pj_status_t status = pjsua_acc_del((pjsua_acc_id)acc_id);
     if (status != PJ_SUCCESS) {
-        std::cerr << "❌ Error removing account: " << status << std::endl;
+        PJW_LOG_ERROR("❌ Error removing account: %d", status);
         return false;
     }
     
-    // Remove from local storage
-    {
-        std::lock_guard<std::mutex> lock(accounts_mutex);
-        accounts.erase(
-            std::remove_if(accounts.begin(), accounts.end(),
-                [acc_id](const std::unique_ptr<PJSIPAccount>& account) {
-                    return account->acc_id == acc_id;
-                }),
-            accounts.end()
-        );
-    }
+    // Remove from local storage - readers holding the record keep it alive
+    accounts.remove((pjsua_acc_id)acc_id);
+    flows.onAccountRemoved((pjsua_acc_id)acc_id);
+    PJSIPEnvContext::clearAccountOwner((pjsua_acc_id)acc_id);
     
-    std::cout << "✅ Account removed (ID: " << acc_id << ")" << std::endl;
+    PJW_LOG_INFO("✅ Account removed (ID: %d)", acc_id);
     return true;
 }
 
-PJSIPAccount* PJSIPWrapper::getAccount(int acc_id) {
-    std::lock_guard<std::mutex> lock(accounts_mutex);
-    for (auto& account : accounts) {
-        if (account->acc_id == acc_id) {
-            return account.get();
-        }
-    }
-    return nullptr;
+std::shared_ptr<const PJSIPAccount> PJSIPWrapper::getAccount(int acc_id) {
+    return accounts.get((pjsua_acc_id)acc_id);
+}
+
+std::vector<std::shared_ptr<const PJSIPAccount>> PJSIPWrapper::getAllAccounts() {
+    return accounts.snapshot();
 }
 
-std::vector<PJSIPAccount*> PJSIPWrapper::getAllAccounts() {
-    std::vector<PJSIPAccount*> result;
-    std::lock_guard<std::mutex> lock(accounts_mutex);
+bool PJSIPWrapper::getRegState(int acc_id, PJSIPRegState& state) {
+    return accounts.getRegState((pjsua_acc_id)acc_id, state);
+}
+
+// Records carry the password, which only pjsua's copy of the config still has
+size_t PJSIPWrapper::snapshotAccounts(std::string& out, unsigned env_id) {
+    out.clear();
+    if (!is_initialized) {
+        return 0;
+    }
     
-    for (auto& account : accounts) {
-        result.push_back(account.get());
+    pj_pool_t* pool = pjsua_pool_create("snapshot%p", 1024, 1024);
+    if (pool == NULL) {
+        return 0;
     }
     
-    return result;
+    size_t count = 0;
+    for (const std::shared_ptr<const PJSIPAccount>& account : accounts.snapshot()) {
+        if (!PJSIPEnvContext::isOwnedBy(account->acc_id, env_id)) {
+            continue;
+        }
+        pjsua_acc_config acc_cfg;
+        pj_pool_reset(pool);
+        if (pjsua_acc_get_config(account->acc_id, pool, &acc_cfg) != PJ_SUCCESS) {
+            continue;
+        }
+        pj_str_t password = acc_cfg.cred_count > 0 ? acc_cfg.cred_info[0].data : pj_str((char*)"");
+        const pj_str_t* fields[5] = { &account->aor, &account->registrar, &account->username, &password,
+                                      &account->proxy };
+        for (const pj_str_t* field : fields) {
+            out.append(field->ptr, field->slen);
+            out.push_back('\0');
+        }
+        count++;
+    }
+    
+    pj_pool_release(pool);
+    return count;
+}
+
+void PJSIPWrapper::getMetricsGauges(PJSIPMetricsGauges& out) {
+    out.active_calls = calls.stats().active;
+    out.active_registrations = 0;
+    for (const std::shared_ptr<const PJSIPAccount>& account : accounts.snapshot()) {
+        PJSIPRegState state;
+        if (accounts.getRegState(account->acc_id, state) && state.is_registered) {
+            out.active_registrations++;
+        }
+    }
+    PJSIPEnvContext::queueTotals(out.event_queue_depth, out.events_dropped);
+    out.dns_cache_entries = dns.stats().entries;
+    out.sip_flows = flows.stats().active;
 }
 
 // Registration - Real PJSIP API
@@ -305,11 +788,11 @@ bool PJSIPWrapper::registerAccount(int acc_id) {
     
     pj_status_t status = pjsua_acc_set_registration((pjsua_acc_id)acc_id, PJ_TRUE);
     if (status != PJ_SUCCESS) {
-        std::cerr << "❌ Error registering account: " << status << std::endl;
+        PJW_LOG_ERROR("❌ Error registering account: %d", status);
         return false;
     }
     
-    std::cout << "🔄 Registration started for account ID: " << acc_id << std::endl;
+    PJW_LOG_DEBUG("🔄 Registration started for account ID: %d", acc_id);
     return true;
 }
 
@@ -320,11 +803,11 @@ bool PJSIPWrapper::unregisterAccount(int acc_id) {
     
     pj_status_t status = pjsua_acc_set_registration((pjsua_acc_id)acc_id, PJ_FALSE);
     if (status != PJ_SUCCESS) {
-        std::cerr << "❌ Error unregistering account: " << status << std::endl;
+        PJW_LOG_ERROR("❌ Error unregistering account: %d", status);
         return false;
     }
     
-    std::cout << "📤 Unregistration started for account ID: " << acc_id << std::endl;
+    PJW_LOG_DEBUG("📤 Unregistration started for account ID: %d", acc_id);
     return true;
 }
 
@@ -333,253 +816,1966 @@ bool PJSIPWrapper::refreshRegistration(int acc_id) {
 }
 
 // Call management - Real PJSIP API
-bool PJSIPWrapper::makeCall(int acc_id, const std::string& uri) {
+int PJSIPWrapper::makeCall(int acc_id, const std::string& uri, const std::string& sdp) {
     if (!is_initialized) {
-        return false;
+        return -1;
+    }
+    if (admission.isDraining()) {
+        PJW_LOG_WARN("⚠️ Draining, call to %s not placed", uri.c_str());
+        return -1;
+    }
+    if (!sdp.empty() && media_mode != PJSIPMediaMode::Signalling) {
+        PJW_LOG_ERROR("❌ A call SDP needs media set to 'signalling'");
+        return -1;
     }
     
     pj_str_t dest_uri = pj_str((char*)uri.c_str());
     pjsua_call_id call_id;
+    pjsua_call_setting opt;
+    callSetting(opt);
     
-    pj_status_t status = pjsua_call_make_call((pjsua_acc_id)acc_id, &dest_uri, 0, NULL, NULL, &call_id);
+    // The offer is built inside make_call, the body rides along as user data
+    void* offer = sdp.empty() ? NULL : (void*)&sdp;
+    pj_status_t status = pjsua_call_make_call((pjsua_acc_id)acc_id, &dest_uri, &opt, offer, NULL, &call_id);
     if (status != PJ_SUCCESS) {
-        std::cerr << "❌ Error making call: " << status << std::endl;
-        return false;
+        PJW_LOG_ERROR("❌ Error making call: %d", status);
+        return -1;
+    }
+    PJSIPMetrics::instance().increment(PJSIPCounter::CallsOutgoing);
+    
+    // Kept for re-offers, unless the call already failed inside make_call
+    if (offer) {
+        calls.setSdp(call_id, PJSIPSdpSide::Local, std::make_shared<const std::string>(sdp));
+        pjsua_call_set_user_data(call_id, NULL);
+        PJSIPCallRecord record;
+        if (!calls.get(call_id, record)) {
+            calls.releaseSdp(call_id);
+        }
     }
     
-    std::cout << "📞 Making call to: " << uri << " (Call ID: " << call_id << ")" << std::endl;
-    return true;
+    PJW_LOG_DEBUG("📞 Making call to: %s (Call ID: %d)", uri.c_str(), call_id);
+    return call_id;
 }
 
 bool PJSIPWrapper::answerCall(int call_id) {
-    pj_status_t status = pjsua_call_answer((pjsua_call_id)call_id, 200, NULL, NULL);
+    pjsua_call_setting opt;
+    callSetting(opt);
+    
+    // An SDP set after the offer arrived replaces the answer pjsua prepared then
+    pj_status_t status;
+    std::shared_ptr<const std::string> sdp = calls.getSdp((pjsua_call_id)call_id, PJSIPSdpSide::Local);
+    if (sdp && media_mode == PJSIPMediaMode::Signalling) {
+        pj_pool_t* pool = pjsua_pool_create("answer%p", 1024, 1024);
+        if (pool == NULL) {
+            return false;
+        }
+        pjmedia_sdp_session* answer = parseSdp(pool, *sdp);
+        status = answer ? pjsua_call_answer_with_sdp((pjsua_call_id)call_id, answer, &opt, 200, NULL, NULL)
+                        : PJMEDIA_SDP_EINSDP;
+        pj_pool_release(pool);
+    } else {
+        status = pjsua_call_answer2((pjsua_call_id)call_id, &opt, 200, NULL, NULL);
+    }
     if (status != PJ_SUCCESS) {
-        std::cerr << "❌ Error answering call: " << status << std::endl;
+        PJW_LOG_ERROR("❌ Error answering call: %d", status);
+        return false;
+    }
+    
+    PJW_LOG_DEBUG("✅ Call answered (Call ID: %d)", call_id);
+    return true;
+}
+
+unsigned PJSIPWrapper::hangupAllCalls() {
+    if (!is_initialized) {
+        return 0;
+    }
+    
+    unsigned active = calls.stats().active;
+    pjsua_call_hangup_all();
+    PJW_LOG_INFO("📴 Hung up %u calls", active);
+    return active;
+}
+
+bool PJSIPWrapper::setCallSdp(int call_id, const std::string& sdp) {
+    // A body for a slot with no call would go out with whichever call gets it next
+    if (media_mode != PJSIPMediaMode::Signalling || !PJSIPCallTable::isValidId(call_id) ||
+        !pjsua_call_is_active((pjsua_call_id)call_id)) {
         return false;
     }
     
-    std::cout << "✅ Call answered (Call ID: " << call_id << ")" << std::endl;
+    calls.setSdp(call_id, PJSIPSdpSide::Local, sdp.empty() ? nullptr : std::make_shared<const std::string>(sdp));
     return true;
 }
 
 bool PJSIPWrapper::hangupCall(int call_id) {
     pj_status_t status = pjsua_call_hangup((pjsua_call_id)call_id, 0, NULL, NULL);
     if (status != PJ_SUCCESS) {
-        std::cerr << "❌ Error hanging up call: " << status << std::endl;
+        PJW_LOG_ERROR("❌ Error hanging up call: %d", status);
         return false;
     }
     
-    std::cout << "📴 Call hung up (Call ID: " << call_id << ")" << std::endl;
+    PJW_LOG_DEBUG("📴 Call hung up (Call ID: %d)", call_id);
     return true;
 }
 
-// Event handlers
-void PJSIPWrapper::setOnRegistered(std::function<void(const std::string&)> callback) {
-    on_registered = callback;
+// Media routing
+int PJSIPWrapper::getCallConfSlot(int call_id) {
+    // Release builds of pjsua answer a bad id with PJ_EINVAL, not an invalid slot
+    if (!is_initialized || !PJSIPCallTable::isValidId(call_id) || !pjsua_call_is_active((pjsua_call_id)call_id)) {
+        return PJSUA_INVALID_ID;
+    }
+    
+    return pjsua_call_get_conf_port((pjsua_call_id)call_id);
 }
 
-void PJSIPWrapper::setOnRegisterFailed(std::function<void(const std::string&)> callback) {
-    on_register_failed = callback;
+bool PJSIPWrapper::connectMedia(int source_slot, int sink_slot) {
+    if (!is_initialized) {
+        return false;
+    }
+    
+    pj_status_t status = pjsua_conf_connect((pjsua_conf_port_id)source_slot, (pjsua_conf_port_id)sink_slot);
+    if (status != PJ_SUCCESS) {
+        PJW_LOG_ERROR("❌ Error connecting media %d -> %d: %d", source_slot, sink_slot, status);
+        return false;
+    }
+    
+    // Recordings of the sink follow what it is sent
+    recordings.onConnect((pjsua_conf_port_id)source_slot, (pjsua_conf_port_id)sink_slot);
+    return true;
 }
 
-void PJSIPWrapper::setOnUnregistered(std::function<void(const std::string&)> callback) {
-    on_unregistered = callback;
+bool PJSIPWrapper::disconnectMedia(int source_slot, int sink_slot) {
+    if (!is_initialized) {
+        return false;
+    }
+    
+    pj_status_t status = pjsua_conf_disconnect((pjsua_conf_port_id)source_slot, (pjsua_conf_port_id)sink_slot);
+    if (status != PJ_SUCCESS) {
+        PJW_LOG_ERROR("❌ Error disconnecting media %d -> %d: %d", source_slot, sink_slot, status);
+        return false;
+    }
+    
+    recordings.onDisconnect((pjsua_conf_port_id)source_slot, (pjsua_conf_port_id)sink_slot);
+    return true;
 }
 
-void PJSIPWrapper::setOnIncomingCall(std::function<void(const std::string&)> callback) {
-    on_incoming_call = callback;
+int PJSIPWrapper::createPlayer(const std::string& path, bool loop) {
+    if (!is_initialized || !hasMedia("player")) {
+        return PJSUA_INVALID_ID;
+    }
+    
+    pj_str_t file_name = pj_str((char*)path.c_str());
+    pjsua_player_id player_id;
+    
+    pj_status_t status = pjsua_player_create(&file_name, loop ? 0 : PJMEDIA_FILE_NO_LOOP, &player_id);
+    if (status != PJ_SUCCESS) {
+        PJW_LOG_ERROR("❌ Error creating player for %s: %d", path.c_str(), status);
+        return PJSUA_INVALID_ID;
+    }
+    
+    return player_id;
 }
 
-void PJSIPWrapper::setOnCallState(std::function<void(const std::string&)> callback) {
-    on_call_state = callback;
+// pjsua asserts on player and recorder ids out of range or not in use, and
+// release builds hand back PJ_EINVAL where a slot is expected. PJSUA_LOCK
+// held, creating and destroying them take it too.
+static bool isPlayerId(int player_id) {
+    return player_id >= 0 && player_id < (int)PJ_ARRAY_SIZE(pjsua_var.player) &&
+           pjsua_var.player[player_id].port != nullptr;
 }
 
-// Utility functions
-std::string PJSIPWrapper::getVersion() {
-    return "PJSIP " + std::string(pj_get_version());
+static bool isRecorderId(int recorder_id) {
+    return recorder_id >= 0 && recorder_id < (int)PJ_ARRAY_SIZE(pjsua_var.recorder) &&
+           pjsua_var.recorder[recorder_id].port != nullptr;
 }
 
-std::string PJSIPWrapper::getLocalIP() {
-    if (!is_initialized || transport_id == PJSUA_INVALID_ID) {
-        return "0.0.0.0";
+int PJSIPWrapper::getPlayerConfSlot(int player_id) {
+    if (!is_initialized) {
+        return PJSUA_INVALID_ID;
     }
     
-    pjsua_transport_info transport_info;
-    pj_status_t status = pjsua_transport_get_info(transport_id, &transport_info);
-    
-    if (status == PJ_SUCCESS) {
-        return std::string(transport_info.local_name.host.ptr, transport_info.local_name.host.slen);
+    PJSUA_LOCK();
+    int slot = isPlayerId(player_id) ? pjsua_player_get_conf_port((pjsua_player_id)player_id) : PJSUA_INVALID_ID;
+    PJSUA_UNLOCK();
+    return slot >= 0 ? slot : PJSUA_INVALID_ID;
+}
+
+bool PJSIPWrapper::destroyPlayer(int player_id) {
+    if (!is_initialized) {
+        return false;
     }
     
-    return "0.0.0.0";
+    PJSUA_LOCK();
+    bool destroyed = isPlayerId(player_id) && pjsua_player_destroy((pjsua_player_id)player_id) == PJ_SUCCESS;
+    PJSUA_UNLOCK();
+    return destroyed;
 }
 
-int PJSIPWrapper::getBoundPort() {
-    if (!is_initialized || transport_id == PJSUA_INVALID_ID) {
-        return 0;
+int PJSIPWrapper::createRecorder(const std::string& path) {
+    if (!is_initialized || !hasMedia("recorder")) {
+        return PJSUA_INVALID_ID;
     }
     
-    pjsua_transport_info transport_info;
-    pj_status_t status = pjsua_transport_get_info(transport_id, &transport_info);
+    pj_str_t file_name = pj_str((char*)path.c_str());
+    pjsua_recorder_id recorder_id;
     
-    if (status == PJ_SUCCESS) {
-        return transport_info.local_name.port;
+    pj_status_t status = pjsua_recorder_create(&file_name, 0, NULL, -1, 0, &recorder_id);
+    if (status != PJ_SUCCESS) {
+        PJW_LOG_ERROR("❌ Error creating recorder for %s: %d", path.c_str(), status);
+        return PJSUA_INVALID_ID;
     }
     
-    return 0;
+    return recorder_id;
 }
 
-// N-API function implementations
-Napi::Value Init(const Napi::CallbackInfo& info) {
-    Napi::Env env = info.Env();
-    
-    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
-    bool result = wrapper->initialize();
+int PJSIPWrapper::getRecorderConfSlot(int recorder_id) {
+    if (!is_initialized) {
+        return PJSUA_INVALID_ID;
+    }
     
-    return Napi::Boolean::New(env, result);
+    PJSUA_LOCK();
+    int slot = isRecorderId(recorder_id) ? pjsua_recorder_get_conf_port((pjsua_recorder_id)recorder_id)
+                                         : PJSUA_INVALID_ID;
+    PJSUA_UNLOCK();
+    return slot >= 0 ? slot : PJSUA_INVALID_ID;
 }
 
-Napi::Value AddAccount(const Napi::CallbackInfo& info) {
-    Napi::Env env = info.Env();
+bool PJSIPWrapper::destroyRecorder(int recorder_id) {
+    if (!is_initialized) {
+        return false;
+    }
+    
+    PJSUA_LOCK();
+    bool destroyed = isRecorderId(recorder_id) && pjsua_recorder_destroy((pjsua_recorder_id)recorder_id) == PJ_SUCCESS;
+    PJSUA_UNLOCK();
+    return destroyed;
+}
+
+int PJSIPWrapper::createMediaTap(Napi::Env env, Napi::Function callback, unsigned frames, bool inject,
+                                 Napi::ArrayBuffer& buffer) {
+    if (!is_initialized || !hasMedia("media tap")) {
+        return -1;
+    }
+    
+    // Same clock and frame size as the bridge, so it never resamples for us
+    PJSIPMediaTapFormat format;
+    format.clock_rate = media_cfg.clock_rate;
+    format.samples_per_frame = media_cfg.clock_rate * media_cfg.audio_frame_ptime / 1000;
+    format.frame_bytes = format.samples_per_frame * sizeof(int16_t);
+    format.capacity = std::min(std::max(frames, 2u), PJSIPMediaTap::MAX_CAPACITY);
+    
+    PJSIPMediaTap* tap = PJSIPMediaTap::create(env, callback, format, inject, buffer);
+    if (tap == nullptr) {
+        PJW_LOG_ERROR("❌ Error creating media tap");
+        return -1;
+    }
+    
+    return media_taps.add(tap, PJSIPEnvContext::get(env)->id());
+}
+
+bool PJSIPWrapper::destroyMediaTap(int tap_id) {
+    return media_taps.destroy(tap_id);
+}
+
+bool PJSIPWrapper::bridgeCalls(int call_a, int call_b, const PJSIPBridgeOptions& options) {
+    if (!is_initialized || !hasMedia("call bridging")) {
+        return false;
+    }
+    
+    // Validates both legs and claims them, nothing is touched on failure
+    if (!bridges.bridge((pjsua_call_id)call_a, (pjsua_call_id)call_b, options)) {
+        return false;
+    }
+    
+    // Off the sound device, the legs only hear each other
+    if (auto_connect_audio) {
+        int slots[2] = { getCallConfSlot(call_a), getCallConfSlot(call_b) };
+        for (int slot : slots) {
+            if (slot != PJSUA_INVALID_ID) {
+                pjsua_conf_disconnect(slot, 0);
+                pjsua_conf_disconnect(0, slot);
+            }
+        }
+    }
+    return true;
+}
+
+int PJSIPWrapper::startRecording(int call_id, const std::string& path, const PJSIPRecordingOptions& options) {
+    if (!is_initialized || !hasMedia("recording")) {
+        return -1;
+    }
+    
+    pjsua_conf_port_id call_slot = getCallConfSlot(call_id);
+    if (call_slot == PJSUA_INVALID_ID) {
+        PJW_LOG_WARN("⚠️ Call %d has no bridge slot to record", call_id);
+        return -1;
+    }
+    
+    // Bridge clock and frame size, nothing to resample
+    unsigned samples_per_frame = media_cfg.clock_rate * media_cfg.audio_frame_ptime / 1000;
+    return recordings.start((pjsua_call_id)call_id, call_slot, path, options, media_cfg.clock_rate, samples_per_frame);
+}
+
+bool PJSIPWrapper::startCapture(PJSIPCaptureOptions options, const std::vector<int>& account_ids) {
+    if (!is_initialized) {
+        PJW_LOG_ERROR("❌ PJSIP not initialized");
+        return false;
+    }
+    
+    // Matched by AOR on the SIP threads, no account lookups there
+    for (int acc_id : account_ids) {
+        std::shared_ptr<const PJSIPAccount> account = accounts.get((pjsua_acc_id)acc_id);
+        if (!account) {
+            PJW_LOG_ERROR("❌ Capture: no account %d", acc_id);
+            return false;
+        }
+        options.accounts.push_back(std::string(account->aor.ptr, account->aor.slen));
+    }
+    return capture.start(options);
+}
+
+// Codecs
+bool PJSIPWrapper::getCodecs(std::vector<PJSIPCodecInfo>& out) {
+    if (!is_initialized) {
+        return false;
+    }
+    
+    return codecs.list(out);
+}
+
+bool PJSIPWrapper::setCodecPriority(const std::string& id, unsigned priority) {
+    if (!is_initialized) {
+        return false;
+    }
+    
+    if (!codecs.setPriority(id, priority)) {
+        PJW_LOG_ERROR("❌ Error setting priority of codec %s", id.c_str());
+        return false;
+    }
+    
+    PJW_LOG_DEBUG("🎛️ Codec %s priority %u", id.c_str(), priority);
+    return true;
+}
+
+bool PJSIPWrapper::setCodecParams(const std::string& id, const PJSIPCodecParams& params) {
+    if (!is_initialized) {
+        return false;
+    }
+    
+    if (!codecs.setParams(id, params)) {
+        PJW_LOG_ERROR("❌ Error setting parameters of codec %s", id.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool PJSIPWrapper::getCallCodec(int call_id, PJSIPCallCodec& out) {
+    if (!is_initialized) {
+        return false;
+    }
+    
+    return codecs.callCodec((pjsua_call_id)call_id, media_cfg.clock_rate, out);
+}
+
+bool PJSIPWrapper::getCodecUsage(PJSIPCodecUsage& out) {
+    if (!is_initialized) {
+        return false;
+    }
+    
+    codecs.usage(media_cfg.clock_rate, out);
+    return true;
+}
+
+// Event handlers
+void PJSIPWrapper::setOnRegistered(std::function<void(const std::string&)> callback) {
+    on_registered = callback;
+}
+
+void PJSIPWrapper::setOnRegisterFailed(std::function<void(const std::string&)> callback) {
+    on_register_failed = callback;
+}
+
+void PJSIPWrapper::setOnUnregistered(std::function<void(const std::string&)> callback) {
+    on_unregistered = callback;
+}
+
+void PJSIPWrapper::setOnIncomingCall(std::function<void(const std::string&)> callback) {
+    on_incoming_call = callback;
+}
+
+void PJSIPWrapper::setOnCallState(std::function<void(const std::string&)> callback) {
+    on_call_state = callback;
+}
+
+// Utility functions
+std::string PJSIPWrapper::getVersion() {
+    return "PJSIP " + std::string(pj_get_version());
+}
+
+std::string PJSIPWrapper::getLocalIP() {
+    pjsua_transport_id transport_id = transports.primary();
+    if (!is_initialized || transport_id == PJSUA_INVALID_ID) {
+        return "0.0.0.0";
+    }
+    
+    pjsua_transport_info transport_info;
+    pj_status_t status = pjsua_transport_get_info(transport_id, &transport_info);
+    
+    if (status == PJ_SUCCESS) {
+        return std::string(transport_info.local_name.host.ptr, transport_info.local_name.host.slen);
+    }
+    
+    return "0.0.0.0";
+}
+
+int PJSIPWrapper::getBoundPort() {
+    pjsua_transport_id transport_id = transports.primary();
+    if (!is_initialized || transport_id == PJSUA_INVALID_ID) {
+        return 0;
+    }
+    
+    pjsua_transport_info transport_info;
+    pj_status_t status = pjsua_transport_get_info(transport_id, &transport_info);
+    
+    if (status == PJ_SUCCESS) {
+        return transport_info.local_name.port;
+    }
+    
+    return 0;
+}
+
+// N-API function implementations
+// Reads an optional integer property, keeping the default when absent
+static int getIntOption(const Napi::Object& options, const char* name, int default_value) {
+    if (!options.Has(name)) {
+        return default_value;
+    }
+    Napi::Value value = options.Get(name);
+    if (value.IsBoolean()) {
+        return value.As<Napi::Boolean>().Value() ? 1 : 0;
+    }
+    if (!value.IsNumber()) {
+        return default_value;
+    }
+    return value.As<Napi::Number>().Int32Value();
+}
+
+// Reads an optional numeric property, keeping the default when absent
+static double getDoubleOption(const Napi::Object& options, const char* name, double default_value) {
+    if (!options.Has(name) || !options.Get(name).IsNumber()) {
+        return default_value;
+    }
+    return options.Get(name).As<Napi::Number>().DoubleValue();
+}
+
+static std::string getStringOption(const Napi::Object& options, const char* name) {
+    if (!options.Has(name) || !options.Get(name).IsString()) {
+        return "";
+    }
+    return options.Get(name).As<Napi::String>().Utf8Value();
+}
+
+// Parses the "transports" init option into listener configs
+static bool parseTransportConfigs(const Napi::Array& list, std::vector<PJSIPTransportConfig>& configs,
+                                  std::string& error) {
+    for (uint32_t i = 0; i < list.Length(); i++) {
+        Napi::Value item = list.Get(i);
+        if (!item.IsObject()) {
+            error = "transports must be an array of objects";
+            return false;
+        }
+        Napi::Object object = item.As<Napi::Object>();
+        PJSIPTransportConfig config;
+        std::string type = getStringOption(object, "type");
+        if (!type.empty() && !PJSIPTransportSet::parseType(type, config.type)) {
+            error = "transport type must be 'udp', 'tcp', 'tls', 'udp6', 'tcp6' or 'tls6'";
+            return false;
+        }
+        config.port = getIntOption(object, "port", (config.type & ~PJSIP_TRANSPORT_IPV6) == PJSIP_TRANSPORT_TLS ? 5061 : 5060);
+        config.bind_address = getStringOption(object, "bindAddress");
+        config.public_address = getStringOption(object, "publicAddress");
+        config.count = (unsigned)std::max(1, getIntOption(object, "sockets", 1));
+        config.async_cnt = (unsigned)std::max(1, getIntOption(object, "pendingReads", 1));
+        config.rcvbuf = std::max(0, getIntOption(object, "recvBufferSize", 0));
+        config.sndbuf = std::max(0, getIntOption(object, "sendBufferSize", 0));
+        config.cert_file = getStringOption(object, "certFile");
+        config.privkey_file = getStringOption(object, "privateKeyFile");
+        config.ca_list_file = getStringOption(object, "caListFile");
+        config.password = getStringOption(object, "password");
+        config.verify_server = getIntOption(object, "verifyServer", 0) != 0;
+        config.verify_client = getIntOption(object, "verifyClient", 0) != 0;
+        if (config.port < 0 || config.port > 65535) {
+            error = "transport port must be between 0 and 65535";
+            return false;
+        }
+        configs.push_back(std::move(config));
+    }
+    return true;
+}
+
+Napi::Value Init(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    PJSIPInitOptions options;
+    if (info.Length() > 0 && info[0].IsObject()) {
+        Napi::Object config = info[0].As<Napi::Object>();
+        options.max_calls = getIntOption(config, "maxCalls", options.max_calls);
+        options.thread_cnt = getIntOption(config, "threadCount", options.thread_cnt);
+        options.media_thread_cnt = getIntOption(config, "mediaThreadCount", options.media_thread_cnt);
+        options.has_ioqueue = getIntOption(config, "mediaIoqueue", options.has_ioqueue);
+        options.clock_rate = getIntOption(config, "clockRate", options.clock_rate);
+        options.ptime = getIntOption(config, "ptime", options.ptime);
+        options.conf_ports = getIntOption(config, "confPorts", options.conf_ports);
+        options.auto_connect_audio = getIntOption(config, "autoConnectAudio", options.auto_connect_audio);
+        options.log_level = getIntOption(config, "logLevel", options.log_level);
+        if (config.Has("transports") && config.Get("transports").IsArray()) {
+            std::string error;
+            if (!parseTransportConfigs(config.Get("transports").As<Napi::Array>(), options.transports, error)) {
+                Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+                return env.Null();
+            }
+        }
+        if (config.Has("audioDevice") && config.Get("audioDevice").IsString()) {
+            std::string device = config.Get("audioDevice").As<Napi::String>().Utf8Value();
+            if (device == "null") {
+                options.audio_device = PJSIPAudioDevice::Null;
+            } else if (device == "none") {
+                options.audio_device = PJSIPAudioDevice::None;
+            } else if (device != "default") {
+                Napi::TypeError::New(env, "audioDevice must be 'default', 'null' or 'none'").ThrowAsJavaScriptException();
+                return env.Null();
+            }
+        }
+        if (config.Has("media") && config.Get("media").IsString()) {
+            std::string media = config.Get("media").As<Napi::String>().Utf8Value();
+            if (media == "signalling") {
+                options.media_mode = PJSIPMediaMode::Signalling;
+            } else if (media != "full") {
+                Napi::TypeError::New(env, "media must be 'full' or 'signalling'").ThrowAsJavaScriptException();
+                return env.Null();
+            }
+        }
+        options.sdp = getStringOption(config, "sdp");
+        if (config.Has("dns") && config.Get("dns").IsObject()) {
+            Napi::Object dns = config.Get("dns").As<Napi::Object>();
+            Napi::Value nameservers = dns.Get("nameservers");
+            if (nameservers.IsString()) {
+                options.dns.nameservers.push_back(nameservers.As<Napi::String>().Utf8Value());
+            } else if (nameservers.IsArray()) {
+                Napi::Array list = nameservers.As<Napi::Array>();
+                for (uint32_t i = 0; i < list.Length(); i++) {
+                    options.dns.nameservers.push_back(list.Get(i).ToString().Utf8Value());
+                }
+            }
+            for (const std::string& nameserver : options.dns.nameservers) {
+                std::string host;
+                uint16_t port;
+                if (!PJSIPDnsCache::parseNameserver(nameserver, host, port)) {
+                    Napi::TypeError::New(env, "dns.nameservers must be IP addresses, optionally with a port")
+                        .ThrowAsJavaScriptException();
+                    return env.Null();
+                }
+            }
+            options.dns.max_ttl = (unsigned)std::max(1, getIntOption(dns, "maxTtl", (int)options.dns.max_ttl));
+            options.dns.negative_ttl = (unsigned)std::max(0, getIntOption(dns, "negativeTtl",
+                                                                          (int)options.dns.negative_ttl));
+            options.dns.naptr = getIntOption(dns, "naptr", 1) != 0;
+        }
+        if (config.Has("flows") && config.Get("flows").IsObject()) {
+            Napi::Object flows = config.Get("flows").As<Napi::Object>();
+            options.flows.keep_alive = getIntOption(flows, "keepAliveInterval", options.flows.keep_alive);
+            options.flows.outbound = getIntOption(flows, "outbound", options.flows.outbound);
+            options.flows.reconnect_delay = getIntOption(flows, "reconnectDelay", options.flows.reconnect_delay);
+            options.flows.reconnect_spread = getIntOption(flows, "reconnectSpread", options.flows.reconnect_spread);
+        }
+    } else if (info.Length() > 0 && !info[0].IsUndefined()) {
+        Napi::TypeError::New(env, "Expected options object").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
+    bool result = wrapper->initialize(options, PJSIPEnvContext::get(env)->id());
+    
+    return Napi::Boolean::New(env, result);
+}
+
+// Per-account outbound and keepalive settings, see PJSIPFlowTable
+static void parseFlowOptions(const Napi::Object& object, PJSIPAccountConfig& config) {
+    config.outbound = getIntOption(object, "outbound", config.outbound);
+    config.instance_id = getStringOption(object, "instanceId");
+    config.keep_alive = getIntOption(object, "keepAliveInterval", config.keep_alive);
+}
+
+Napi::Value AddAccount(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
     
     if (info.Length() < 1 || !info[0].IsObject()) {
         Napi::TypeError::New(env, "Expected object with account configuration").ThrowAsJavaScriptException();
         return env.Null();
     }
     
-    Napi::Object config = info[0].As<Napi::Object>();
-    
-    std::string aor = config.Get("aor").As<Napi::String>().Utf8Value();
-    std::string registrar = config.Get("registrar").As<Napi::String>().Utf8Value();
-    std::string username = config.Get("username").As<Napi::String>().Utf8Value();
-    std::string password = config.Get("password").As<Napi::String>().Utf8Value();
-    std::string proxy = config.Has("proxy") ? config.Get("proxy").As<Napi::String>().Utf8Value() : "";
+    Napi::Object config = info[0].As<Napi::Object>();
+    
+    std::string aor = config.Get("aor").As<Napi::String>().Utf8Value();
+    std::string registrar = config.Get("registrar").As<Napi::String>().Utf8Value();
+    std::string username = config.Get("username").As<Napi::String>().Utf8Value();
+    std::string password = config.Get("password").As<Napi::String>().Utf8Value();
+    std::string proxy = config.Has("proxy") ? config.Get("proxy").As<Napi::String>().Utf8Value() : "";
+    
+    PJSIPAccountConfig account;
+    account.aor = aor;
+    account.registrar = registrar;
+    account.username = username;
+    account.password = password;
+    account.proxy = proxy;
+    parseFlowOptions(config, account);
+    account.env_id = PJSIPEnvContext::get(env)->id();
+    
+    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
+    int acc_id = wrapper->addAccount(account);
+    
+    return Napi::Number::New(env, acc_id);
+}
+
+// Accepts an array of account objects, or a Buffer of NUL-terminated
+// aor, registrar, username, password, proxy records (proxy may be empty)
+static bool parseAccountConfigs(const Napi::Value& value, std::vector<PJSIPAccountConfig>& configs) {
+    if (value.IsBuffer()) {
+        Napi::Buffer<char> buffer = value.As<Napi::Buffer<char>>();
+        const char* data = buffer.Data();
+        size_t length = buffer.Length();
+        size_t pos = 0;
+        std::string fields[5];
+        
+        while (pos < length) {
+            for (int i = 0; i < 5; i++) {
+                const char* end = (const char*)memchr(data + pos, '\0', length - pos);
+                if (!end) {
+                    return false;
+                }
+                fields[i].assign(data + pos, end - (data + pos));
+                pos = (end - data) + 1;
+            }
+            PJSIPAccountConfig config;
+            config.aor = fields[0];
+            config.registrar = fields[1];
+            config.username = fields[2];
+            config.password = fields[3];
+            config.proxy = fields[4];
+            configs.push_back(std::move(config));
+        }
+        return true;
+    }
+    
+    if (!value.IsArray()) {
+        return false;
+    }
+    
+    Napi::Array list = value.As<Napi::Array>();
+    configs.reserve(list.Length());
+    for (uint32_t i = 0; i < list.Length(); i++) {
+        Napi::Value item = list.Get(i);
+        if (!item.IsObject()) {
+            return false;
+        }
+        Napi::Object object = item.As<Napi::Object>();
+        PJSIPAccountConfig config;
+        config.aor = getStringOption(object, "aor");
+        config.registrar = getStringOption(object, "registrar");
+        config.username = getStringOption(object, "username");
+        config.password = getStringOption(object, "password");
+        config.proxy = getStringOption(object, "proxy");
+        config.reg_timeout = (unsigned)std::max(0, getIntOption(object, "regTimeout", 0));
+        parseFlowOptions(object, config);
+        if (config.aor.empty()) {
+            return false;
+        }
+        configs.push_back(std::move(config));
+    }
+    return true;
+}
+
+// Pacing shared by addAccounts() and unregisterAccounts(), returns onProgress if given
+static Napi::Function parsePacingOptions(const Napi::Object& options, PJSIPPacingOptions& pacing) {
+    pacing.rate = getDoubleOption(options, "rate", pacing.rate);
+    pacing.burst = (unsigned)std::max(1, getIntOption(options, "burst", (int)pacing.burst));
+    pacing.jitter = std::min(1.0, std::max(0.0, getDoubleOption(options, "jitter", pacing.jitter)));
+    pacing.window = (unsigned)std::max(1, getIntOption(options, "window", (int)pacing.window));
+    pacing.refresh_spread = std::max(0.0, getDoubleOption(options, "refreshSpread", pacing.refresh_spread));
+    
+    if (options.Has("onProgress") && options.Get("onProgress").IsFunction()) {
+        return options.Get("onProgress").As<Napi::Function>();
+    }
+    return Napi::Function();
+}
+
+static Napi::Value submitProvisionJob(Napi::Env env, std::shared_ptr<PJSIPProvisionJob> job,
+                                      Napi::Function on_progress, const char* name) {
+    bool registering = job->kind == PJSIPProvisionKind::Register;
+    Napi::Promise promise = job->deferred.Promise();
+    if (job->total() == 0) {
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("total", Napi::Number::New(env, 0));
+        if (registering) {
+            result.Set("added", Napi::Number::New(env, 0));
+            result.Set("registered", Napi::Number::New(env, 0));
+        } else {
+            result.Set("unregistered", Napi::Number::New(env, 0));
+        }
+        result.Set("failed", Napi::Number::New(env, 0));
+        result.Set("inFlight", Napi::Number::New(env, 0));
+        result.Set("accountIds", Napi::Array::New(env));
+        job->deferred.Resolve(result);
+        return promise;
+    }
+    
+    job->has_progress_callback = !on_progress.IsEmpty();
+    if (!job->has_progress_callback) {
+        on_progress = Napi::Function::New(env, [](const Napi::CallbackInfo&) {});
+    }
+    job->callback = PJSIPJsCallback::create(env, on_progress, name);
+    job->env_id = PJSIPEnvContext::get(env)->id();
+    
+    PJSIPWrapper::getInstance()->getRegistrationScheduler().submit(job);
+    return promise;
+}
+
+Napi::Value AddAccounts(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !(info[0].IsArray() || info[0].IsBuffer())) {
+        Napi::TypeError::New(env, "Expected array of account configurations or Buffer").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    auto job = std::make_shared<PJSIPProvisionJob>(env);
+    if (!parseAccountConfigs(info[0], job->configs)) {
+        Napi::TypeError::New(env, "Invalid account configuration list").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    unsigned env_id = PJSIPEnvContext::get(env)->id();
+    for (auto& config : job->configs) {
+        config.env_id = env_id;
+    }
+    
+    Napi::Function on_progress;
+    if (info.Length() > 1 && info[1].IsObject()) {
+        Napi::Object options = info[1].As<Napi::Object>();
+        on_progress = parsePacingOptions(options, job->pacing);
+        
+        unsigned reg_timeout = (unsigned)std::max(0, getIntOption(options, "regTimeout", 0));
+        if (reg_timeout > 0) {
+            for (auto& config : job->configs) {
+                if (config.reg_timeout == 0) {
+                    config.reg_timeout = reg_timeout;
+                }
+            }
+        }
+    }
+    
+    // First hops resolve while the job waits for its turn, so the paced
+    // REGISTERs find them cached
+    std::vector<std::string> hops;
+    for (const auto& config : job->configs) {
+        const std::string& hop = config.proxy.empty() ? config.registrar : config.proxy;
+        if (std::find(hops.begin(), hops.end(), hop) == hops.end()) {
+            hops.push_back(hop);
+        }
+    }
+    PJSIPWrapper::getInstance()->prewarmDns(hops);
+    
+    return submitProvisionJob(env, job, on_progress, "PJSIPAddAccounts");
+}
+
+// Unregisters the given accounts, or every registered one, through the same
+// pacing as addAccounts(). The accounts stay, so a drained node can still
+// answer for them until shutdown.
+Napi::Value UnregisterAccounts(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
+    
+    auto job = std::make_shared<PJSIPProvisionJob>(env, PJSIPProvisionKind::Unregister);
+    if (info.Length() > 0 && info[0].IsArray()) {
+        // Unknown ids stay in the result as -1 and count as failed; repeats go out once
+        Napi::Array ids = info[0].As<Napi::Array>();
+        std::vector<bool> seen(PJSUA_MAX_ACC, false);
+        for (uint32_t i = 0; i < ids.Length(); i++) {
+            Napi::Value id = ids.Get(i);
+            if (!id.IsNumber()) {
+                Napi::TypeError::New(env, "Expected array of account IDs").ThrowAsJavaScriptException();
+                return env.Null();
+            }
+            int acc_id = id.As<Napi::Number>().Int32Value();
+            if (!PJSIPAccountTable::isValidId(acc_id) || !wrapper->getAccount(acc_id)) {
+                job->acc_ids.push_back(PJSUA_INVALID_ID);
+                job->failed.fetch_add(1, std::memory_order_relaxed);
+            } else if (!seen[acc_id]) {
+                seen[acc_id] = true;
+                job->acc_ids.push_back(acc_id);
+            }
+        }
+    } else if (info.Length() > 0 && !info[0].IsNull() && !info[0].IsUndefined()) {
+        Napi::TypeError::New(env, "Expected array of account IDs or null").ThrowAsJavaScriptException();
+        return env.Null();
+    } else {
+        // This env's accounts only, other workers drain their own
+        unsigned env_id = PJSIPEnvContext::get(env)->id();
+        for (const std::shared_ptr<const PJSIPAccount>& account : wrapper->getAllAccounts()) {
+            PJSIPRegState state;
+            if (PJSIPEnvContext::isOwnedBy(account->acc_id, env_id) &&
+                wrapper->getRegState(account->acc_id, state) && state.is_registered) {
+                job->acc_ids.push_back(account->acc_id);
+            }
+        }
+    }
+    
+    Napi::Function on_progress;
+    if (info.Length() > 1 && info[1].IsObject()) {
+        on_progress = parsePacingOptions(info[1].As<Napi::Object>(), job->pacing);
+    }
+    return submitProvisionJob(env, job, on_progress, "PJSIPUnregisterAccounts");
+}
+
+// Same records addAccounts() takes, so restoring is one bulk call. Covers
+// the accounts this env added.
+Napi::Value SnapshotAccounts(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    std::string records;
+    PJSIPWrapper::getInstance()->snapshotAccounts(records, PJSIPEnvContext::get(env)->id());
+    return Napi::Buffer<char>::Copy(env, records.data(), records.size());
+}
+
+Napi::Value RegisterAccount(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Expected account ID").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    int acc_id = info[0].As<Napi::Number>().Int32Value();
+    
+    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
+    bool result = wrapper->registerAccount(acc_id);
+    
+    return Napi::Boolean::New(env, result);
+}
+
+Napi::Value UnregisterAccount(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Expected account ID").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    int acc_id = info[0].As<Napi::Number>().Int32Value();
+    
+    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
+    bool result = wrapper->unregisterAccount(acc_id);
+    
+    return Napi::Boolean::New(env, result);
+}
+
+static Napi::Object accountToObject(Napi::Env env, const PJSIPAccount& account, PJSIPWrapper* wrapper) {
+    PJSIPRegState reg_state = PJSIPRegState();
+    wrapper->getRegState(account.acc_id, reg_state);
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("acc_id", Napi::Number::New(env, account.acc_id));
+    result.Set("aor", Napi::String::New(env, account.aor.ptr, account.aor.slen));
+    result.Set("registrar", Napi::String::New(env, account.registrar.ptr, account.registrar.slen));
+    result.Set("username", Napi::String::New(env, account.username.ptr, account.username.slen));
+    result.Set("proxy", Napi::String::New(env, account.proxy.ptr, account.proxy.slen));
+    result.Set("is_registered", Napi::Boolean::New(env, reg_state.is_registered != 0));
+    result.Set("status_code", Napi::Number::New(env, reg_state.status_code));
+    result.Set("expires", Napi::Number::New(env, reg_state.expires));
+    
+    return result;
+}
+
+Napi::Value GetAccountInfo(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Expected account ID").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    int acc_id = info[0].As<Napi::Number>().Int32Value();
+    
+    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
+    std::shared_ptr<const PJSIPAccount> account = wrapper->getAccount(acc_id);
+    
+    if (!account) {
+        return env.Null();
+    }
+    
+    return accountToObject(env, *account, wrapper);
+}
+
+Napi::Value GetAccounts(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
+    std::vector<std::shared_ptr<const PJSIPAccount>> accounts = wrapper->getAllAccounts();
+    
+    Napi::Array result = Napi::Array::New(env, accounts.size());
+    for (size_t i = 0; i < accounts.size(); i++) {
+        result.Set((uint32_t)i, accountToObject(env, *accounts[i], wrapper));
+    }
+    
+    return result;
+}
+
+Napi::Value GetAccountPoolStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    PJSIPAccountPoolStats stats = PJSIPAccountPool::instance().stats();
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("inUse", Napi::Number::New(env, (double)stats.in_use));
+    result.Set("free", Napi::Number::New(env, (double)stats.free));
+    result.Set("bytesReserved", Napi::Number::New(env, (double)stats.bytes_reserved));
+    result.Set("allocations", Napi::Number::New(env, (double)stats.allocations));
+    result.Set("reuses", Napi::Number::New(env, (double)stats.reuses));
+    return result;
+}
+
+Napi::Value RemoveAccount(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Expected account ID").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    int acc_id = info[0].As<Napi::Number>().Int32Value();
+    
+    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
+    bool result = wrapper->removeAccount(acc_id);
+    
+    return Napi::Boolean::New(env, result);
+}
+
+// { network: false } skips the un-REGISTER/BYE round trips pjsua waits for
+static bool shutdownNetworkOption(const Napi::CallbackInfo& info) {
+    if (info.Length() > 0 && info[0].IsObject()) {
+        return getIntOption(info[0].As<Napi::Object>(), "network", 1) != 0;
+    }
+    return true;
+}
+
+Napi::Value Shutdown(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    bool network = shutdownNetworkOption(info);
+    PJSIPEnvContext* context = PJSIPEnvContext::get(env);
+    context->getCommandWorker().stop();
+    bool result = PJSIPWrapper::getInstance()->detach(context->id(), network);
+    context->getEventDispatcher().stop();
+    
+    return Napi::Boolean::New(env, result);
+}
+
+Napi::Value MakeCall(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsString()) {
+        Napi::TypeError::New(env, "Expected account ID and URI").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    int acc_id = info[0].As<Napi::Number>().Int32Value();
+    std::string uri = info[1].As<Napi::String>().Utf8Value();
+    std::string sdp = info.Length() > 2 && info[2].IsString() ? info[2].As<Napi::String>().Utf8Value() : "";
+    
+    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
+    int call_id = wrapper->makeCall(acc_id, uri, sdp);
+    
+    return Napi::Number::New(env, call_id);
+}
+
+Napi::Value AnswerCall(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Expected call ID").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    int call_id = info[0].As<Napi::Number>().Int32Value();
+    
+    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
+    bool result = wrapper->answerCall(call_id);
+    
+    return Napi::Boolean::New(env, result);
+}
+
+Napi::Value HangupCall(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Expected call ID").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    int call_id = info[0].As<Napi::Number>().Int32Value();
+    
+    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
+    bool result = wrapper->hangupCall(call_id);
+    
+    return Napi::Boolean::New(env, result);
+}
+
+Napi::Value SetCallSdp(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsString()) {
+        Napi::TypeError::New(env, "Expected call ID and SDP string").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    int call_id = info[0].As<Napi::Number>().Int32Value();
+    std::string sdp = info[1].As<Napi::String>().Utf8Value();
+    
+    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
+    return Napi::Boolean::New(env, wrapper->setCallSdp(call_id, sdp));
+}
+
+// Both sides as text, null where nothing was set or received
+Napi::Value GetCallSdp(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Expected call ID").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    int call_id = info[0].As<Napi::Number>().Int32Value();
+    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
+    std::shared_ptr<const std::string> local = wrapper->getCallSdp(call_id, PJSIPSdpSide::Local);
+    std::shared_ptr<const std::string> remote = wrapper->getCallSdp(call_id, PJSIPSdpSide::Remote);
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("local", local ? Napi::Value(Napi::String::New(env, *local)) : env.Null());
+    result.Set("remote", remote ? Napi::Value(Napi::String::New(env, *remote)) : env.Null());
+    return result;
+}
+
+// Promise-returning variants - run on the command worker thread
+static Napi::Value submitCommand(Napi::Env env, const char* name, PJSIPCommandLock lock, bool returns_bool,
+                                 std::function<int()> run) {
+    auto command = std::make_shared<PJSIPCommand>(env, name, lock, returns_bool, std::move(run));
+    return PJSIPEnvContext::get(env)->getCommandWorker().submit(env, command);
+}
+
+static Napi::Value submitBoolCommand(Napi::Env env, const char* name, PJSIPCommandLock lock,
+                                     std::function<bool()> run) {
+    return submitCommand(env, name, lock, true, [run]() { return run() ? 0 : -1; });
+}
+
+Napi::Value AddAccountAsync(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Expected object with account configuration").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    Napi::Object object = info[0].As<Napi::Object>();
+    PJSIPAccountConfig config;
+    config.aor = getStringOption(object, "aor");
+    config.registrar = getStringOption(object, "registrar");
+    config.username = getStringOption(object, "username");
+    config.password = getStringOption(object, "password");
+    config.proxy = getStringOption(object, "proxy");
+    config.reg_timeout = (unsigned)std::max(0, getIntOption(object, "regTimeout", 0));
+    parseFlowOptions(object, config);
+    config.env_id = PJSIPEnvContext::get(env)->id();
+    
+    return submitCommand(env, "addAccount", PJSIPCommandLock::Pjsua, false, [config]() {
+        return PJSIPWrapper::getInstance()->addAccount(config);
+    });
+}
+
+Napi::Value RemoveAccountAsync(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Expected account ID").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    // pjsua_acc_del() sends the un-REGISTER and tears down the registration
+    // with PJSUA_LOCK held; in a batch the lock would stay held across every
+    // delete, so each one takes and drops it on its own
+    int acc_id = info[0].As<Napi::Number>().Int32Value();
+    return submitBoolCommand(env, "removeAccount", PJSIPCommandLock::None, [acc_id]() {
+        return PJSIPWrapper::getInstance()->removeAccount(acc_id);
+    });
+}
+
+Napi::Value RegisterAccountAsync(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Expected account ID").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    int acc_id = info[0].As<Napi::Number>().Int32Value();
+    return submitBoolCommand(env, "registerAccount", PJSIPCommandLock::Pjsua, [acc_id]() {
+        return PJSIPWrapper::getInstance()->registerAccount(acc_id);
+    });
+}
+
+Napi::Value UnregisterAccountAsync(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Expected account ID").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    int acc_id = info[0].As<Napi::Number>().Int32Value();
+    return submitBoolCommand(env, "unregisterAccount", PJSIPCommandLock::Pjsua, [acc_id]() {
+        return PJSIPWrapper::getInstance()->unregisterAccount(acc_id);
+    });
+}
+
+// Call operations take the dialog lock before PJSUA_LOCK inside pjsua, so
+// they are never run under the batch lock
+Napi::Value MakeCallAsync(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsString()) {
+        Napi::TypeError::New(env, "Expected account ID and URI").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    int acc_id = info[0].As<Napi::Number>().Int32Value();
+    std::string uri = info[1].As<Napi::String>().Utf8Value();
+    std::string sdp = info.Length() > 2 && info[2].IsString() ? info[2].As<Napi::String>().Utf8Value() : "";
+    return submitCommand(env, "makeCall", PJSIPCommandLock::None, false, [acc_id, uri, sdp]() {
+        return PJSIPWrapper::getInstance()->makeCall(acc_id, uri, sdp);
+    });
+}
+
+Napi::Value AnswerCallAsync(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Expected call ID").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    int call_id = info[0].As<Napi::Number>().Int32Value();
+    return submitBoolCommand(env, "answerCall", PJSIPCommandLock::None, [call_id]() {
+        return PJSIPWrapper::getInstance()->answerCall(call_id);
+    });
+}
+
+Napi::Value HangupCallAsync(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Expected call ID").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    int call_id = info[0].As<Napi::Number>().Int32Value();
+    return submitBoolCommand(env, "hangupCall", PJSIPCommandLock::None, [call_id]() {
+        return PJSIPWrapper::getInstance()->hangupCall(call_id);
+    });
+}
+
+Napi::Value ShutdownAsync(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    bool network = shutdownNetworkOption(info);
+    PJSIPEnvContext* context = PJSIPEnvContext::get(env);
+    unsigned env_id = context->id();
+    auto command = std::make_shared<PJSIPCommand>(env, "shutdown", PJSIPCommandLock::Exclusive, true,
+                                                  [env_id, network]() {
+        return PJSIPWrapper::getInstance()->detach(env_id, network) ? 0 : -1;
+    });
+    command->on_complete = [context](Napi::Env) {
+        context->getEventDispatcher().stop();
+    };
+    return context->getCommandWorker().submit(env, command);
+}
+
+// Copies every active call record into one ArrayBuffer, 64 bytes per call
+// (see PJSIPCallRecord), instead of a pjsua_call_get_info() per call
+Napi::Value GetCalls(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    std::vector<PJSIPCallRecord> records;
+    size_t count = PJSIPWrapper::getInstance()->getCallTable().snapshot(records);
+    
+    Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, count * sizeof(PJSIPCallRecord));
+    if (count > 0) {
+        memcpy(buffer.Data(), records.data(), count * sizeof(PJSIPCallRecord));
+    }
+    return buffer;
+}
+
+Napi::Value GetCall(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Expected call ID").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    int call_id = info[0].As<Napi::Number>().Int32Value();
+    PJSIPCallTable& calls = PJSIPWrapper::getInstance()->getCallTable();
+    
+    PJSIPCallRecord record;
+    if (!calls.get(call_id, record)) {
+        return env.Null();
+    }
+    std::shared_ptr<const std::string> remote_uri = calls.getRemoteUri(call_id);
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("callId", Napi::Number::New(env, record.call_id));
+    result.Set("accId", Napi::Number::New(env, record.acc_id));
+    result.Set("state", Napi::Number::New(env, record.state));
+    result.Set("statusCode", Napi::Number::New(env, record.status_code));
+    result.Set("mediaStatus", Napi::Number::New(env, record.media_status));
+    result.Set("direction", Napi::Number::New(env, record.direction));
+    result.Set("stateChanges", Napi::Number::New(env, record.state_changes));
+    result.Set("remoteUri", Napi::String::New(env, remote_uri ? *remote_uri : ""));
+    result.Set("createdAt", Napi::Number::New(env, record.created_us));
+    result.Set("connectedAt", Napi::Number::New(env, record.connected_us));
+    result.Set("updatedAt", Napi::Number::New(env, record.updated_us));
+    return result;
+}
+
+Napi::Value GetCallStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    PJSIPCallTableStats stats = PJSIPWrapper::getInstance()->getCallTable().stats();
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("active", Napi::Number::New(env, stats.active));
+    result.Set("capacity", Napi::Number::New(env, stats.capacity));
+    result.Set("peak", Napi::Number::New(env, stats.peak));
+    result.Set("total", Napi::Number::New(env, (double)stats.total));
+    return result;
+}
+
+Napi::Value SetAdmissionPolicy(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Expected admission policy object").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    Napi::Object options = info[0].As<Napi::Object>();
+    PJSIPAdmissionConfig config;
+    config.max_calls = std::max(0, getIntOption(options, "maxCalls", 0));
+    config.max_calls_per_account = std::max(0, getIntOption(options, "maxCallsPerAccount", 0));
+    config.cps = std::max(0.0, getDoubleOption(options, "cps", 0));
+    config.cps_burst = std::max(0, getIntOption(options, "cpsBurst", 0));
+    config.max_cpu = std::max(0, getIntOption(options, "maxCpu", 0));
+    config.max_queue_depth = std::max(0, getIntOption(options, "maxQueueDepth", 0));
+    config.retry_after = std::max(0, getIntOption(options, "retryAfter", config.retry_after));
+    config.accept_code = getIntOption(options, "acceptCode", config.accept_code);
+    
+    if (config.accept_code != PJSIP_SC_OK && config.accept_code != PJSIP_SC_RINGING &&
+        config.accept_code != PJSIP_SC_PROGRESS) {
+        Napi::TypeError::New(env, "acceptCode must be 180, 183 or 200").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    PJSIPWrapper::getInstance()->getAdmissionController().configure(config);
+    return Napi::Boolean::New(env, true);
+}
+
+Napi::Value GetAdmissionStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    PJSIPAdmissionStats stats = PJSIPWrapper::getInstance()->getAdmissionController().stats();
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("offered", Napi::Number::New(env, (double)stats.offered));
+    result.Set("accepted", Napi::Number::New(env, (double)stats.accepted));
+    result.Set("rejectedOverload", Napi::Number::New(env, (double)stats.rejected_overload));
+    result.Set("rejectedGlobalLimit", Napi::Number::New(env, (double)stats.rejected_global));
+    result.Set("rejectedRate", Napi::Number::New(env, (double)stats.rejected_rate));
+    result.Set("rejectedAccountLimit", Napi::Number::New(env, (double)stats.rejected_account));
+    result.Set("rejectedDraining", Napi::Number::New(env, (double)stats.rejected_draining));
+    result.Set("active", Napi::Number::New(env, stats.active));
+    result.Set("cpu", Napi::Number::New(env, stats.cpu));
+    result.Set("draining", Napi::Boolean::New(env, PJSIPWrapper::getInstance()->getAdmissionController().isDraining()));
+    return result;
+}
+
+// Turns new incoming calls away with 503 and refuses makeCall(); calls up keep going
+Napi::Value SetDraining(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsBoolean()) {
+        Napi::TypeError::New(env, "Expected boolean").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    bool enabled = info[0].As<Napi::Boolean>().Value();
+    PJSIPWrapper::getInstance()->getAdmissionController().setDraining(enabled);
+    PJW_LOG_INFO(enabled ? "🚧 Draining, new calls are refused" : "✅ Draining stopped");
+    return Napi::Boolean::New(env, true);
+}
+
+Napi::Value HangupAllCalls(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), PJSIPWrapper::getInstance()->hangupAllCalls());
+}
+
+// Runtime logging configuration: level, pjsipLevel, target ('stdout', 'stderr',
+// 'file', 'callback', 'none'), path, callback, filter, sources
+Napi::Value SetLogOptions(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Expected logging options object").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    Napi::Object options = info[0].As<Napi::Object>();
+    PJSIPLogSink& sink = PJSIPLogSink::instance();
+    
+    if (options.Has("level")) {
+        int level = std::min(5, std::max(0, getIntOption(options, "level", (int)sink.level())));
+        sink.setLevel((PJSIPLogLevel)level);
+    }
+    if (options.Has("pjsipLevel")) {
+        int level = std::min(6, std::max(0, getIntOption(options, "pjsipLevel", 4)));
+        PJSIPWrapper::getInstance()->setPjlibLogLevel(level);
+    }
+    
+    if (options.Has("target")) {
+        std::string target = getStringOption(options, "target");
+        bool ok = true;
+        if (target == "stdout") {
+            ok = sink.setTarget(PJSIPLogTarget::Stdout, "");
+        } else if (target == "stderr") {
+            ok = sink.setTarget(PJSIPLogTarget::Stderr, "");
+        } else if (target == "none") {
+            ok = sink.setTarget(PJSIPLogTarget::None, "");
+        } else if (target == "file") {
+            std::string path = getStringOption(options, "path");
+            if (path.empty()) {
+                Napi::TypeError::New(env, "File target needs a path").ThrowAsJavaScriptException();
+                return env.Null();
+            }
+            ok = sink.setTarget(PJSIPLogTarget::File, path);
+        } else if (target == "callback") {
+            if (!options.Has("callback") || !options.Get("callback").IsFunction()) {
+                Napi::TypeError::New(env, "Callback target needs a callback function").ThrowAsJavaScriptException();
+                return env.Null();
+            }
+            ok = sink.setCallback(env, options.Get("callback").As<Napi::Function>());
+        } else {
+            Napi::TypeError::New(env, "target must be 'stdout', 'stderr', 'file', 'callback' or 'none'").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        if (!ok) {
+            return Napi::Boolean::New(env, false);
+        }
+    }
+    
+    if (options.Has("filter") || options.Has("sources")) {
+        bool wrapper = true;
+        bool pjlib = true;
+        if (options.Has("sources") && options.Get("sources").IsArray()) {
+            Napi::Array sources = options.Get("sources").As<Napi::Array>();
+            wrapper = false;
+            pjlib = false;
+            for (uint32_t i = 0; i < sources.Length(); i++) {
+                std::string source = sources.Get(i).ToString().Utf8Value();
+                wrapper = wrapper || source == "wrapper";
+                pjlib = pjlib || source == "pjsip";
+            }
+        }
+        sink.setFilter(getStringOption(options, "filter"), wrapper, pjlib);
+    }
+    
+    return Napi::Boolean::New(env, true);
+}
+
+Napi::Value GetLogStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    PJSIPLogStats stats = PJSIPLogSink::instance().stats();
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("written", Napi::Number::New(env, (double)stats.written));
+    result.Set("dropped", Napi::Number::New(env, (double)stats.dropped));
+    result.Set("filtered", Napi::Number::New(env, (double)stats.filtered));
+    result.Set("callbackDropped", Napi::Number::New(env, (double)stats.callback_dropped));
+    result.Set("depth", Napi::Number::New(env, (double)stats.depth));
+    result.Set("capacity", Napi::Number::New(env, (double)stats.capacity));
+    return result;
+}
+
+Napi::Value FlushLog(const Napi::CallbackInfo& info) {
+    PJSIPLogSink::instance().flush();
+    return info.Env().Undefined();
+}
+
+Napi::Value GetVersion(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
+    std::string version = wrapper->getVersion();
+    
+    return Napi::String::New(env, version);
+}
+
+Napi::Value GetLocalIP(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
+    std::string ip = wrapper->getLocalIP();
+    
+    return Napi::String::New(env, ip);
+}
+
+Napi::Value GetBoundPort(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
+    int port = wrapper->getBoundPort();
+    
+    return Napi::Number::New(env, port);
+}
+
+Napi::Value GetTransports(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    std::vector<PJSIPTransportInfo> transports;
+    PJSIPWrapper::getInstance()->getTransports(transports);
+    
+    Napi::Array result = Napi::Array::New(env, transports.size());
+    for (size_t i = 0; i < transports.size(); i++) {
+        const PJSIPTransportInfo& transport = transports[i];
+        Napi::Object entry = Napi::Object::New(env);
+        entry.Set("id", Napi::Number::New(env, transport.id));
+        entry.Set("type", Napi::String::New(env, PJSIPTransportSet::typeName(transport.type)));
+        entry.Set("listener", Napi::Number::New(env, transport.listener));
+        entry.Set("socket", Napi::Number::New(env, transport.shard));
+        entry.Set("address", Napi::String::New(env, transport.address));
+        entry.Set("port", Napi::Number::New(env, transport.port));
+        entry.Set("rxPackets", Napi::Number::New(env, (double)transport.stats.rx_packets));
+        entry.Set("rxBytes", Napi::Number::New(env, (double)transport.stats.rx_bytes));
+        entry.Set("txPackets", Napi::Number::New(env, (double)transport.stats.tx_packets));
+        entry.Set("txBytes", Napi::Number::New(env, (double)transport.stats.tx_bytes));
+        result.Set((uint32_t)i, entry);
+    }
+    
+    return result;
+}
+
+Napi::Value SetEventCallback(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    // Events of this env's accounts only
+    PJSIPEventDispatcher& events = PJSIPEnvContext::get(env)->getEventDispatcher();
+    
+    if (info.Length() < 1 || info[0].IsNull() || info[0].IsUndefined()) {
+        events.stop();
+        return Napi::Boolean::New(env, true);
+    }
+    
+    if (!info[0].IsFunction()) {
+        Napi::TypeError::New(env, "Expected event callback function").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    // The callback receives a record count, records live in the returned buffer
+    return events.start(env, info[0].As<Napi::Function>());
+}
+
+Napi::Value GetMonotonicTime(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    return Napi::Number::New(env, pjsipMonotonicMicros());
+}
+
+// "calls_incoming" -> "callsIncoming"
+static std::string metricKey(const char* name) {
+    std::string key;
+    for (bool upper = false; *name; name++) {
+        if (*name == '_') {
+            upper = true;
+            continue;
+        }
+        key += upper ? (char)toupper((unsigned char)*name) : *name;
+        upper = false;
+    }
+    return key;
+}
+
+Napi::Value GetMetrics(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    PJSIPMetricsSnapshot snapshot;
+    PJSIPMetrics::instance().snapshot(snapshot);
+    PJSIPMetricsGauges gauges;
+    PJSIPWrapper::getInstance()->getMetricsGauges(gauges);
+    
+    Napi::Object counters = Napi::Object::New(env);
+    for (size_t i = 0; i < (size_t)PJSIPCounter::Count; i++) {
+        counters.Set(metricKey(PJSIPMetrics::counterName((PJSIPCounter)i)),
+                     Napi::Number::New(env, (double)snapshot.counters[i]));
+    }
+    
+    Napi::Object gauge_values = Napi::Object::New(env);
+    gauge_values.Set("activeCalls", Napi::Number::New(env, (double)gauges.active_calls));
+    gauge_values.Set("activeRegistrations", Napi::Number::New(env, (double)gauges.active_registrations));
+    gauge_values.Set("eventQueueDepth", Napi::Number::New(env, (double)gauges.event_queue_depth));
+    gauge_values.Set("eventsDropped", Napi::Number::New(env, (double)gauges.events_dropped));
+    gauge_values.Set("dnsCacheEntries", Napi::Number::New(env, (double)gauges.dns_cache_entries));
+    gauge_values.Set("sipFlows", Napi::Number::New(env, (double)gauges.sip_flows));
+    
+    // Microseconds throughout
+    Napi::Object histograms = Napi::Object::New(env);
+    for (size_t i = 0; i < (size_t)PJSIPHistogram::Count; i++) {
+        const PJSIPHistogramSnapshot& histogram = snapshot.histograms[i];
+        Napi::Object entry = Napi::Object::New(env);
+        entry.Set("count", Napi::Number::New(env, (double)histogram.count));
+        entry.Set("sum", Napi::Number::New(env, (double)histogram.sum));
+        entry.Set("max", Napi::Number::New(env, (double)histogram.max));
+        entry.Set("p50", Napi::Number::New(env, (double)histogram.percentile(0.5)));
+        entry.Set("p90", Napi::Number::New(env, (double)histogram.percentile(0.9)));
+        entry.Set("p99", Napi::Number::New(env, (double)histogram.percentile(0.99)));
+        entry.Set("p999", Napi::Number::New(env, (double)histogram.percentile(0.999)));
+        histograms.Set(metricKey(PJSIPMetrics::histogramName((PJSIPHistogram)i)), entry);
+    }
+    
+    static const char* failure_kinds[] = { "call", "registration" };
+    Napi::Object failures = Napi::Object::New(env);
+    for (size_t kind = 0; kind < (size_t)PJSIPFailureKind::Count; kind++) {
+        Napi::Object codes = Napi::Object::New(env);
+        for (const std::pair<int, uint64_t>& failure : snapshot.failures[kind]) {
+            codes.Set(std::to_string(failure.first), Napi::Number::New(env, (double)failure.second));
+        }
+        failures.Set(failure_kinds[kind], codes);
+    }
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("counters", counters);
+    result.Set("gauges", gauge_values);
+    result.Set("histograms", histograms);
+    result.Set("failures", failures);
+    return result;
+}
+
+Napi::Value GetPrometheusMetrics(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    PJSIPMetricsSnapshot snapshot;
+    PJSIPMetrics::instance().snapshot(snapshot);
+    PJSIPMetricsGauges gauges;
+    PJSIPWrapper::getInstance()->getMetricsGauges(gauges);
+    
+    return Napi::String::New(env, pjsipRenderPrometheus(snapshot, gauges));
+}
+
+Napi::Value ResetMetrics(const Napi::CallbackInfo& info) {
+    PJSIPMetrics::instance().reset();
+    return info.Env().Undefined();
+}
+
+Napi::Value GetEventQueueStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    PJSIPEventDispatcher& events = PJSIPEnvContext::get(env)->getEventDispatcher();
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("depth", Napi::Number::New(env, (double)events.depth()));
+    result.Set("capacity", Napi::Number::New(env, (double)events.capacity()));
+    result.Set("dropped", Napi::Number::New(env, (double)events.droppedCount()));
+    result.Set("coalesced", Napi::Number::New(env, (double)events.coalescedCount()));
+    result.Set("batches", Napi::Number::New(env, (double)events.batchCount()));
+    result.Set("delivered", Napi::Number::New(env, (double)events.deliveredCount()));
+    
+    return result;
+}
+
+Napi::Value StartMediaStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsFunction()) {
+        Napi::TypeError::New(env, "Expected interval in milliseconds and callback function").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    // The sampler thread registers with pjlib and queries pjsua streams
+    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
+    if (!wrapper->isInitialized()) {
+        Napi::Error::New(env, "PJSIP not initialized").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    unsigned interval_ms = (unsigned)std::max(0, info[0].As<Napi::Number>().Int32Value());
+    
+    // The callback receives a record count, records live in the returned buffer
+    return wrapper->getMediaStatsSampler().start(env, PJSIPEnvContext::get(env)->id(), info[1].As<Napi::Function>(),
+                                                 interval_ms);
+}
+
+Napi::Value StopMediaStats(const Napi::CallbackInfo& info) {
+    PJSIPWrapper::getInstance()->getMediaStatsSampler().stop();
+    return Napi::Boolean::New(info.Env(), true);
+}
+
+Napi::Value GetMediaStatsCounters(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    PJSIPMediaStatsSampler& sampler = PJSIPWrapper::getInstance()->getMediaStatsSampler();
+    PJSIPMediaStatsCounters counters = sampler.counters();
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("running", Napi::Boolean::New(env, sampler.isRunning()));
+    result.Set("samples", Napi::Number::New(env, (double)counters.samples));
+    result.Set("skipped", Napi::Number::New(env, (double)counters.skipped));
+    result.Set("records", Napi::Number::New(env, (double)counters.records));
+    return result;
+}
+
+Napi::Value GetCallConfSlot(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Expected call ID").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    int call_id = info[0].As<Napi::Number>().Int32Value();
+    
+    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
+    int slot = wrapper->getCallConfSlot(call_id);
+    
+    return Napi::Number::New(env, slot);
+}
+
+Napi::Value ConnectMedia(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsNumber()) {
+        Napi::TypeError::New(env, "Expected source and sink slots").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    int source_slot = info[0].As<Napi::Number>().Int32Value();
+    int sink_slot = info[1].As<Napi::Number>().Int32Value();
+    
+    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
+    bool result = wrapper->connectMedia(source_slot, sink_slot);
+    
+    return Napi::Boolean::New(env, result);
+}
+
+Napi::Value DisconnectMedia(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsNumber()) {
+        Napi::TypeError::New(env, "Expected source and sink slots").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    int source_slot = info[0].As<Napi::Number>().Int32Value();
+    int sink_slot = info[1].As<Napi::Number>().Int32Value();
+    
+    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
+    bool result = wrapper->disconnectMedia(source_slot, sink_slot);
+    
+    return Napi::Boolean::New(env, result);
+}
+
+Napi::Value CreatePlayer(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Expected WAV file path").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    std::string path = info[0].As<Napi::String>().Utf8Value();
+    bool loop = info.Length() > 1 && info[1].ToBoolean();
     
     PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
-    int acc_id = wrapper->addAccount(aor, registrar, username, password, proxy);
+    int player_id = wrapper->createPlayer(path, loop);
+    if (player_id == PJSUA_INVALID_ID) {
+        return env.Null();
+    }
     
-    return Napi::Number::New(env, acc_id);
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("id", Napi::Number::New(env, player_id));
+    result.Set("slot", Napi::Number::New(env, wrapper->getPlayerConfSlot(player_id)));
+    
+    return result;
 }
 
-Napi::Value RegisterAccount(const Napi::CallbackInfo& info) {
+Napi::Value DestroyPlayer(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
     if (info.Length() < 1 || !info[0].IsNumber()) {
-        Napi::TypeError::New(env, "Expected account ID").ThrowAsJavaScriptException();
+        Napi::TypeError::New(env, "Expected player ID").ThrowAsJavaScriptException();
         return env.Null();
     }
     
-    int acc_id = info[0].As<Napi::Number>().Int32Value();
+    int player_id = info[0].As<Napi::Number>().Int32Value();
     
     PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
-    bool result = wrapper->registerAccount(acc_id);
+    bool result = wrapper->destroyPlayer(player_id);
     
     return Napi::Boolean::New(env, result);
 }
 
-Napi::Value UnregisterAccount(const Napi::CallbackInfo& info) {
+Napi::Value CreateRecorder(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Expected WAV file path").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    std::string path = info[0].As<Napi::String>().Utf8Value();
+    
+    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
+    int recorder_id = wrapper->createRecorder(path);
+    if (recorder_id == PJSUA_INVALID_ID) {
+        return env.Null();
+    }
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("id", Napi::Number::New(env, recorder_id));
+    result.Set("slot", Napi::Number::New(env, wrapper->getRecorderConfSlot(recorder_id)));
+    
+    return result;
+}
+
+Napi::Value DestroyRecorder(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
     if (info.Length() < 1 || !info[0].IsNumber()) {
-        Napi::TypeError::New(env, "Expected account ID").ThrowAsJavaScriptException();
+        Napi::TypeError::New(env, "Expected recorder ID").ThrowAsJavaScriptException();
         return env.Null();
     }
     
-    int acc_id = info[0].As<Napi::Number>().Int32Value();
+    int recorder_id = info[0].As<Napi::Number>().Int32Value();
     
     PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
-    bool result = wrapper->unregisterAccount(acc_id);
+    bool result = wrapper->destroyRecorder(recorder_id);
     
     return Napi::Boolean::New(env, result);
 }
 
-Napi::Value GetAccountInfo(const Napi::CallbackInfo& info) {
+Napi::Value CreateMediaTap(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
-    if (info.Length() < 1 || !info[0].IsNumber()) {
-        Napi::TypeError::New(env, "Expected account ID").ThrowAsJavaScriptException();
+    if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsFunction()) {
+        Napi::TypeError::New(env, "Expected tap options and frame callback").ThrowAsJavaScriptException();
         return env.Null();
     }
     
-    int acc_id = info[0].As<Napi::Number>().Int32Value();
+    Napi::Object options = info[0].As<Napi::Object>();
+    int call_id = getIntOption(options, "callId", PJSUA_INVALID_ID);
+    int frames = getIntOption(options, "frames", (int)PJSIPMediaTap::DEFAULT_CAPACITY);
+    bool inject = options.Has("inject") && options.Get("inject").ToBoolean();
     
     PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
-    PJSIPAccount* account = wrapper->getAccount(acc_id);
     
-    if (!account) {
+    // Resolve the call first so a bad id does not leave a tap behind
+    int call_slot = PJSUA_INVALID_ID;
+    if (call_id != PJSUA_INVALID_ID) {
+        call_slot = wrapper->getCallConfSlot(call_id);
+        if (call_slot == PJSUA_INVALID_ID) {
+            PJW_LOG_WARN("⚠️ Call %d has no bridge slot to tap", call_id);
+            return env.Null();
+        }
+    }
+    
+    Napi::ArrayBuffer buffer;
+    int tap_id = wrapper->createMediaTap(env, info[1].As<Napi::Function>(), (unsigned)std::max(frames, 0), inject, buffer);
+    if (tap_id < 0) {
+        return env.Null();
+    }
+    // Another env may already have destroyed it
+    std::shared_ptr<PJSIPMediaTap> tap = wrapper->getMediaTap(tap_id);
+    if (!tap) {
         return env.Null();
     }
     
+    if (call_slot != PJSUA_INVALID_ID) {
+        bool connected = wrapper->connectMedia(call_slot, tap->slot());
+        if (connected && inject) {
+            connected = wrapper->connectMedia(tap->slot(), call_slot);
+        }
+        if (!connected) {
+            wrapper->destroyMediaTap(tap_id);
+            return env.Null();
+        }
+    }
+    
+    const PJSIPMediaTapFormat& format = tap->format();
     Napi::Object result = Napi::Object::New(env);
-    result.Set("acc_id", Napi::Number::New(env, account->acc_id));
-    result.Set("aor", Napi::String::New(env, account->aor));
-    result.Set("registrar", Napi::String::New(env, account->registrar));
-    result.Set("username", Napi::String::New(env, account->username));
-    result.Set("proxy", Napi::String::New(env, account->proxy));
-    result.Set("is_registered", Napi::Boolean::New(env, account->is_registered));
+    result.Set("id", Napi::Number::New(env, tap_id));
+    result.Set("slot", Napi::Number::New(env, tap->slot()));
+    result.Set("buffer", buffer);
+    result.Set("clockRate", Napi::Number::New(env, format.clock_rate));
+    result.Set("samplesPerFrame", Napi::Number::New(env, format.samples_per_frame));
+    result.Set("frameBytes", Napi::Number::New(env, format.frame_bytes));
+    result.Set("frames", Napi::Number::New(env, format.capacity));
     
     return result;
 }
 
-Napi::Value RemoveAccount(const Napi::CallbackInfo& info) {
+Napi::Value DestroyMediaTap(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
     if (info.Length() < 1 || !info[0].IsNumber()) {
-        Napi::TypeError::New(env, "Expected account ID").ThrowAsJavaScriptException();
+        Napi::TypeError::New(env, "Expected tap ID").ThrowAsJavaScriptException();
         return env.Null();
     }
     
-    int acc_id = info[0].As<Napi::Number>().Int32Value();
+    int tap_id = info[0].As<Napi::Number>().Int32Value();
+    return Napi::Boolean::New(env, PJSIPWrapper::getInstance()->destroyMediaTap(tap_id));
+}
+
+Napi::Value InjectTapAudio(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
     
-    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
-    bool result = wrapper->removeAccount(acc_id);
+    if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsTypedArray()) {
+        Napi::TypeError::New(env, "Expected tap ID and PCM buffer").ThrowAsJavaScriptException();
+        return env.Null();
+    }
     
-    return Napi::Boolean::New(env, result);
+    std::shared_ptr<PJSIPMediaTap> tap = PJSIPWrapper::getInstance()->getMediaTap(info[0].As<Napi::Number>().Int32Value());
+    if (!tap) {
+        return Napi::Number::New(env, 0);
+    }
+    
+    Napi::TypedArray pcm = info[1].As<Napi::TypedArray>();
+    const uint8_t* data = static_cast<const uint8_t*>(pcm.ArrayBuffer().Data()) + pcm.ByteOffset();
+    
+    // Bytes accepted, the caller keeps the rest for later
+    return Napi::Number::New(env, (double)tap->inject(data, pcm.ByteLength()));
 }
 
-Napi::Value Shutdown(const Napi::CallbackInfo& info) {
+Napi::Value GetMediaTapStats(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
-    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
-    bool result = wrapper->shutdown();
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Expected tap ID").ThrowAsJavaScriptException();
+        return env.Null();
+    }
     
-    return Napi::Boolean::New(env, result);
+    std::shared_ptr<PJSIPMediaTap> tap = PJSIPWrapper::getInstance()->getMediaTap(info[0].As<Napi::Number>().Int32Value());
+    if (!tap) {
+        return env.Null();
+    }
+    
+    PJSIPMediaTapStats stats = tap->stats();
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("captured", Napi::Number::New(env, (double)stats.captured));
+    result.Set("dropped", Napi::Number::New(env, (double)stats.dropped));
+    result.Set("delivered", Napi::Number::New(env, (double)stats.delivered));
+    result.Set("injected", Napi::Number::New(env, (double)stats.injected));
+    result.Set("played", Napi::Number::New(env, (double)stats.played));
+    result.Set("underruns", Napi::Number::New(env, (double)stats.underruns));
+    result.Set("queued", Napi::Number::New(env, stats.queued));
+    result.Set("maxQueued", Napi::Number::New(env, stats.max_queued));
+    
+    return result;
 }
 
-Napi::Value MakeCall(const Napi::CallbackInfo& info) {
+Napi::Value StartRecording(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
     if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsString()) {
-        Napi::TypeError::New(env, "Expected account ID and URI").ThrowAsJavaScriptException();
+        Napi::TypeError::New(env, "Expected call ID and file path").ThrowAsJavaScriptException();
         return env.Null();
     }
     
-    int acc_id = info[0].As<Napi::Number>().Int32Value();
-    std::string uri = info[1].As<Napi::String>().Utf8Value();
+    int call_id = info[0].As<Napi::Number>().Int32Value();
+    std::string path = info[1].As<Napi::String>().Utf8Value();
+    
+    PJSIPRecordingOptions options;
+    if (info.Length() > 2 && info[2].IsObject()) {
+        Napi::Object config = info[2].As<Napi::Object>();
+        options.stereo = getIntOption(config, "stereo", 0) != 0;
+        options.sync = getIntOption(config, "sync", 0) != 0;
+        options.buffer_ms = (unsigned)std::max(getIntOption(config, "bufferMs", (int)options.buffer_ms), 0);
+        
+        std::string encoding = getStringOption(config, "encoding");
+        if (encoding == "pcmu") {
+            options.encoding = PJSIPRecordingEncoding::Pcmu;
+        } else if (encoding == "pcma") {
+            options.encoding = PJSIPRecordingEncoding::Pcma;
+        } else if (!encoding.empty() && encoding != "pcm") {
+            Napi::TypeError::New(env, "Recording encoding must be 'pcm', 'pcmu' or 'pcma'").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+    }
     
-    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
-    bool result = wrapper->makeCall(acc_id, uri);
+    int recording_id = PJSIPWrapper::getInstance()->startRecording(call_id, path, options);
+    return Napi::Number::New(env, recording_id);
+}
+
+Napi::Value StopRecording(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
     
-    return Napi::Boolean::New(env, result);
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Expected recording ID").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    // Resolves once the file is flushed and closed
+    Napi::Value promise = PJSIPWrapper::getInstance()->stopRecording(env, info[0].As<Napi::Number>().Int32Value());
+    return promise.IsEmpty() ? env.Null() : promise;
 }
 
-Napi::Value AnswerCall(const Napi::CallbackInfo& info) {
+Napi::Value GetRecordingStats(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
     if (info.Length() < 1 || !info[0].IsNumber()) {
-        Napi::TypeError::New(env, "Expected call ID").ThrowAsJavaScriptException();
+        Napi::TypeError::New(env, "Expected recording ID").ThrowAsJavaScriptException();
         return env.Null();
     }
     
-    int call_id = info[0].As<Napi::Number>().Int32Value();
+    PJSIPRecordingStats stats;
+    if (!PJSIPWrapper::getInstance()->getRecordingStats(info[0].As<Napi::Number>().Int32Value(), stats)) {
+        return env.Null();
+    }
+    return PJSIPCallRecorder::statsObject(env, stats);
+}
+
+Napi::Value BridgeCalls(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
     
-    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
-    bool result = wrapper->answerCall(call_id);
+    if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsNumber()) {
+        Napi::TypeError::New(env, "Expected two call IDs").ThrowAsJavaScriptException();
+        return env.Null();
+    }
     
-    return Napi::Boolean::New(env, result);
+    PJSIPBridgeOptions options;
+    if (info.Length() > 2 && info[2].IsObject()) {
+        Napi::Object config = info[2].As<Napi::Object>();
+        options.relay = getIntOption(config, "relay", options.relay) != 0;
+        options.hangup_together = getIntOption(config, "hangupTogether", options.hangup_together) != 0;
+    }
+    
+    int call_a = info[0].As<Napi::Number>().Int32Value();
+    int call_b = info[1].As<Napi::Number>().Int32Value();
+    return Napi::Boolean::New(env, PJSIPWrapper::getInstance()->bridgeCalls(call_a, call_b, options));
 }
 
-Napi::Value HangupCall(const Napi::CallbackInfo& info) {
+Napi::Value UnbridgeCalls(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
     if (info.Length() < 1 || !info[0].IsNumber()) {
@@ -587,56 +2783,424 @@ Napi::Value HangupCall(const Napi::CallbackInfo& info) {
         return env.Null();
     }
     
-    int call_id = info[0].As<Napi::Number>().Int32Value();
+    return Napi::Boolean::New(env, PJSIPWrapper::getInstance()->unbridgeCalls(info[0].As<Napi::Number>().Int32Value()));
+}
+
+Napi::Value GetCallBridge(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
     
-    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
-    bool result = wrapper->hangupCall(call_id);
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Expected call ID").ThrowAsJavaScriptException();
+        return env.Null();
+    }
     
-    return Napi::Boolean::New(env, result);
+    PJSIPBridgeInfo bridge;
+    if (!PJSIPWrapper::getInstance()->getCallBridge(info[0].As<Napi::Number>().Int32Value(), bridge)) {
+        return env.Null();
+    }
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("peer", Napi::Number::New(env, bridge.peer));
+    result.Set("mode", Napi::String::New(env, PJSIPCallBridge::modeName(bridge.mode)));
+    result.Set("hangupTogether", Napi::Boolean::New(env, bridge.hangup_together));
+    result.Set("relayedRtp", Napi::Number::New(env, (double)bridge.relayed_rtp));
+    result.Set("relayedRtcp", Napi::Number::New(env, (double)bridge.relayed_rtcp));
+    result.Set("mediaUpdates", Napi::Number::New(env, bridge.media_updates));
+    
+    return result;
 }
 
-Napi::Value GetVersion(const Napi::CallbackInfo& info) {
+Napi::Value GetBridgeStats(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
-    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
-    std::string version = wrapper->getVersion();
+    PJSIPBridgeStats stats = PJSIPWrapper::getInstance()->getBridgeStats();
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("pairs", Napi::Number::New(env, stats.pairs));
+    result.Set("relayed", Napi::Number::New(env, stats.relayed));
+    result.Set("mixed", Napi::Number::New(env, stats.mixed));
+    result.Set("pending", Napi::Number::New(env, stats.pending));
     
-    return Napi::String::New(env, version);
+    return result;
 }
 
-Napi::Value GetLocalIP(const Napi::CallbackInfo& info) {
+// Resolves SIP URIs or host[:port] targets into the DNS cache
+Napi::Value PrewarmDns(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
-    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
-    std::string ip = wrapper->getLocalIP();
+    if (info.Length() < 1 || !info[0].IsArray()) {
+        Napi::TypeError::New(env, "Expected array of SIP URIs or hosts").ThrowAsJavaScriptException();
+        return env.Null();
+    }
     
-    return Napi::String::New(env, ip);
+    Napi::Array list = info[0].As<Napi::Array>();
+    std::vector<std::string> targets;
+    for (uint32_t i = 0; i < list.Length(); i++) {
+        Napi::Value target = list.Get(i);
+        if (!target.IsString()) {
+            Napi::TypeError::New(env, "Expected array of SIP URIs or hosts").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        targets.push_back(target.As<Napi::String>().Utf8Value());
+    }
+    
+    return PJSIPWrapper::getInstance()->prewarmDns(env, targets);
 }
 
-Napi::Value GetBoundPort(const Napi::CallbackInfo& info) {
+Napi::Value FlushDnsCache(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    return Napi::Number::New(env, PJSIPWrapper::getInstance()->flushDnsCache());
+}
+
+Napi::Value GetDnsStats(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
-    PJSIPWrapper* wrapper = PJSIPWrapper::getInstance();
-    int port = wrapper->getBoundPort();
+    PJSIPDnsStats stats = PJSIPWrapper::getInstance()->getDnsStats();
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("active", Napi::Boolean::New(env, stats.active));
+    result.Set("hits", Napi::Number::New(env, (double)stats.hits));
+    result.Set("negativeHits", Napi::Number::New(env, (double)stats.negative_hits));
+    result.Set("misses", Napi::Number::New(env, (double)stats.misses));
+    result.Set("coalesced", Napi::Number::New(env, (double)stats.coalesced));
+    result.Set("refreshes", Napi::Number::New(env, (double)stats.refreshes));
+    result.Set("expired", Napi::Number::New(env, (double)stats.expired));
+    result.Set("queries", Napi::Number::New(env, (double)stats.queries));
+    result.Set("failures", Napi::Number::New(env, (double)stats.failures));
+    result.Set("entries", Napi::Number::New(env, stats.entries));
+    result.Set("pending", Napi::Number::New(env, stats.pending));
     
-    return Napi::Number::New(env, port);
+    return result;
+}
+
+Napi::Value GetFlows(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    std::vector<PJSIPFlowInfo> flows;
+    PJSIPWrapper::getInstance()->getFlows(flows);
+    
+    Napi::Array result = Napi::Array::New(env, flows.size());
+    for (size_t i = 0; i < flows.size(); i++) {
+        const PJSIPFlowInfo& flow = flows[i];
+        Napi::Object entry = Napi::Object::New(env);
+        entry.Set("transport", Napi::String::New(env, PJSIPTransportSet::typeName(flow.type)));
+        entry.Set("local", Napi::String::New(env, flow.local));
+        entry.Set("remote", Napi::String::New(env, flow.remote));
+        entry.Set("outgoing", Napi::Boolean::New(env, flow.outgoing));
+        entry.Set("connectedAt", Napi::Number::New(env, flow.connected_us));
+        entry.Set("accounts", Napi::Number::New(env, flow.accounts));
+        result.Set((uint32_t)i, entry);
+    }
+    
+    return result;
+}
+
+Napi::Value GetFlowStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    PJSIPFlowStats stats = PJSIPWrapper::getInstance()->getFlowStats();
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("active", Napi::Number::New(env, stats.active));
+    result.Set("peak", Napi::Number::New(env, stats.peak));
+    result.Set("opened", Napi::Number::New(env, (double)stats.opened));
+    result.Set("closed", Napi::Number::New(env, (double)stats.closed));
+    result.Set("failed", Napi::Number::New(env, (double)stats.failed));
+    result.Set("shared", Napi::Number::New(env, (double)stats.shared));
+    result.Set("orphaned", Napi::Number::New(env, (double)stats.orphaned));
+    
+    return result;
+}
+
+static bool getStringList(const Napi::Object& options, const char* name, std::vector<std::string>& out) {
+    if (!options.Has(name) || options.Get(name).IsUndefined()) {
+        return true;
+    }
+    Napi::Value value = options.Get(name);
+    if (value.IsString()) {
+        out.push_back(value.As<Napi::String>().Utf8Value());
+        return true;
+    }
+    if (!value.IsArray()) {
+        return false;
+    }
+    Napi::Array list = value.As<Napi::Array>();
+    for (uint32_t i = 0; i < list.Length(); i++) {
+        out.push_back(list.Get(i).ToString().Utf8Value());
+    }
+    return true;
+}
+
+static Napi::Object captureStatsObject(Napi::Env env, const PJSIPCaptureStats& stats) {
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("active", Napi::Boolean::New(env, stats.active));
+    result.Set("format", Napi::String::New(env, PJSIPPacketCapture::formatName(stats.format)));
+    result.Set("captured", Napi::Number::New(env, (double)stats.captured));
+    result.Set("filtered", Napi::Number::New(env, (double)stats.filtered));
+    result.Set("dropped", Napi::Number::New(env, (double)stats.dropped));
+    result.Set("written", Napi::Number::New(env, (double)stats.written));
+    result.Set("bytes", Napi::Number::New(env, (double)stats.bytes));
+    result.Set("files", Napi::Number::New(env, stats.files));
+    result.Set("writeErrors", Napi::Number::New(env, stats.write_errors));
+    result.Set("rings", Napi::Number::New(env, stats.rings));
+    result.Set("file", Napi::String::New(env, stats.file));
+    return result;
+}
+
+Napi::Value StartCapture(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Expected capture options").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    Napi::Object config = info[0].As<Napi::Object>();
+    PJSIPCaptureOptions options;
+    std::string format = getStringOption(config, "format");
+    if (!format.empty() && !PJSIPPacketCapture::parseFormat(format, options.format)) {
+        Napi::TypeError::New(env, "Capture format must be 'pcap' or 'hep'").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    options.path = getStringOption(config, "path");
+    options.rotate_bytes = (uint64_t)std::max(0.0, getDoubleOption(config, "rotateBytes", 0));
+    options.max_files = (unsigned)std::max(0, getIntOption(config, "maxFiles", 0));
+    options.collector = getStringOption(config, "collector");
+    options.agent_id = (uint32_t)std::max(0.0, getDoubleOption(config, "agentId", 0));
+    options.password = getStringOption(config, "password");
+    options.sample = getDoubleOption(config, "sample", options.sample);
+    options.buffer_kb = (unsigned)std::max(0, getIntOption(config, "bufferKb", (int)options.buffer_kb));
+    if (options.format == PJSIPCaptureFormat::Pcap ? options.path.empty() : options.collector.empty()) {
+        Napi::TypeError::New(env, "pcap capture needs a path, hep capture a collector").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (!getStringList(config, "methods", options.methods) || !getStringList(config, "callIds", options.call_ids)) {
+        Napi::TypeError::New(env, "methods and callIds must be strings or arrays of strings").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    std::vector<int> account_ids;
+    if (config.Has("accounts") && config.Get("accounts").IsArray()) {
+        Napi::Array list = config.Get("accounts").As<Napi::Array>();
+        for (uint32_t i = 0; i < list.Length(); i++) {
+            Napi::Value id = list.Get(i);
+            if (!id.IsNumber()) {
+                Napi::TypeError::New(env, "accounts must be account IDs").ThrowAsJavaScriptException();
+                return env.Null();
+            }
+            account_ids.push_back(id.As<Napi::Number>().Int32Value());
+        }
+    }
+    
+    return Napi::Boolean::New(env, PJSIPWrapper::getInstance()->startCapture(options, account_ids));
+}
+
+// Returns the final counters once everything captured is written
+Napi::Value StopCapture(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    return captureStatsObject(env, PJSIPWrapper::getInstance()->stopCapture());
+}
+
+Napi::Value GetCaptureStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    return captureStatsObject(env, PJSIPWrapper::getInstance()->getCaptureStats());
+}
+
+Napi::Value GetCodecs(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    std::vector<PJSIPCodecInfo> codecs;
+    PJSIPWrapper::getInstance()->getCodecs(codecs);
+    
+    Napi::Array result = Napi::Array::New(env, codecs.size());
+    for (size_t i = 0; i < codecs.size(); i++) {
+        const PJSIPCodecInfo& codec = codecs[i];
+        Napi::Object entry = Napi::Object::New(env);
+        entry.Set("id", Napi::String::New(env, codec.id));
+        entry.Set("description", Napi::String::New(env, codec.description));
+        entry.Set("priority", Napi::Number::New(env, codec.priority));
+        entry.Set("clockRate", Napi::Number::New(env, codec.clock_rate));
+        entry.Set("channels", Napi::Number::New(env, codec.channels));
+        entry.Set("bitrate", Napi::Number::New(env, codec.avg_bps));
+        entry.Set("payloadType", Napi::Number::New(env, codec.payload_type));
+        entry.Set("ptime", Napi::Number::New(env, codec.ptime));
+        entry.Set("vad", Napi::Boolean::New(env, codec.vad));
+        entry.Set("plc", Napi::Boolean::New(env, codec.plc));
+        entry.Set("cng", Napi::Boolean::New(env, codec.cng));
+        entry.Set("penh", Napi::Boolean::New(env, codec.penh));
+        result.Set(i, entry);
+    }
+    return result;
+}
+
+Napi::Value SetCodecPriority(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 2 || !info[0].IsString() || !info[1].IsNumber()) {
+        Napi::TypeError::New(env, "Expected codec ID and priority").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    std::string id = info[0].As<Napi::String>().Utf8Value();
+    int priority = info[1].As<Napi::Number>().Int32Value();
+    if (priority < 0 || priority > 255) {
+        Napi::TypeError::New(env, "priority must be between 0 and 255").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    return Napi::Boolean::New(env, PJSIPWrapper::getInstance()->setCodecPriority(id, (unsigned)priority));
+}
+
+Napi::Value SetCodecParams(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 2 || !info[0].IsString() || !info[1].IsObject()) {
+        Napi::TypeError::New(env, "Expected codec ID and parameters object").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    std::string id = info[0].As<Napi::String>().Utf8Value();
+    Napi::Object options = info[1].As<Napi::Object>();
+    PJSIPCodecParams params;
+    params.ptime = getIntOption(options, "ptime", params.ptime);
+    params.vad = getIntOption(options, "vad", params.vad);
+    params.plc = getIntOption(options, "plc", params.plc);
+    params.cng = getIntOption(options, "cng", params.cng);
+    params.penh = getIntOption(options, "penh", params.penh);
+    
+    return Napi::Boolean::New(env, PJSIPWrapper::getInstance()->setCodecParams(id, params));
+}
+
+Napi::Value GetCallCodec(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Expected call ID").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    PJSIPCallCodec codec;
+    if (!PJSIPWrapper::getInstance()->getCallCodec(info[0].As<Napi::Number>().Int32Value(), codec)) {
+        return env.Null();
+    }
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("id", Napi::String::New(env, codec.id));
+    result.Set("clockRate", Napi::Number::New(env, codec.clock_rate));
+    result.Set("channels", Napi::Number::New(env, codec.channels));
+    result.Set("payloadType", Napi::Number::New(env, codec.payload_type));
+    result.Set("ptime", Napi::Number::New(env, codec.ptime));
+    result.Set("vad", Napi::Boolean::New(env, codec.vad));
+    result.Set("resampled", Napi::Boolean::New(env, codec.resampled));
+    return result;
+}
+
+Napi::Value GetCodecUsage(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    PJSIPCodecUsage usage;
+    if (!PJSIPWrapper::getInstance()->getCodecUsage(usage)) {
+        return env.Null();
+    }
+    
+    Napi::Object by_codec = Napi::Object::New(env);
+    for (const auto& entry : usage.by_codec) {
+        by_codec.Set(entry.first, Napi::Number::New(env, entry.second));
+    }
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("bridgeClockRate", Napi::Number::New(env, usage.bridge_clock_rate));
+    result.Set("streams", Napi::Number::New(env, usage.streams));
+    result.Set("resampled", Napi::Number::New(env, usage.resampled));
+    result.Set("connections", Napi::Number::New(env, usage.connections));
+    result.Set("transcoded", Napi::Number::New(env, usage.transcoded));
+    result.Set("codecs", by_codec);
+    return result;
 }
 
 // Export bindings to Node.js
 Napi::Object InitPjsipWrapper(Napi::Env env, Napi::Object exports) {
+    if (PJSIPEnvContext::attach(env) == nullptr) {
+        Napi::Error::New(env, "node-pjsip is loaded in too many threads, or pjlib failed to initialize").ThrowAsJavaScriptException();
+        return exports;
+    }
+    
     exports.Set(Napi::String::New(env, "Init"), Napi::Function::New<Init>(env));
     exports.Set(Napi::String::New(env, "addAccount"), Napi::Function::New<AddAccount>(env));
+    exports.Set(Napi::String::New(env, "addAccounts"), Napi::Function::New<AddAccounts>(env));
+    exports.Set(Napi::String::New(env, "unregisterAccounts"), Napi::Function::New<UnregisterAccounts>(env));
+    exports.Set(Napi::String::New(env, "snapshotAccounts"), Napi::Function::New<SnapshotAccounts>(env));
     exports.Set(Napi::String::New(env, "registerAccount"), Napi::Function::New<RegisterAccount>(env));
     exports.Set(Napi::String::New(env, "unregisterAccount"), Napi::Function::New<UnregisterAccount>(env));
     exports.Set(Napi::String::New(env, "getAccountInfo"), Napi::Function::New<GetAccountInfo>(env));
+    exports.Set(Napi::String::New(env, "getAccounts"), Napi::Function::New<GetAccounts>(env));
+    exports.Set(Napi::String::New(env, "getAccountPoolStats"), Napi::Function::New<GetAccountPoolStats>(env));
     exports.Set(Napi::String::New(env, "removeAccount"), Napi::Function::New<RemoveAccount>(env));
     exports.Set(Napi::String::New(env, "shutdown"), Napi::Function::New<Shutdown>(env));
+    exports.Set(Napi::String::New(env, "addAccountAsync"), Napi::Function::New<AddAccountAsync>(env));
+    exports.Set(Napi::String::New(env, "removeAccountAsync"), Napi::Function::New<RemoveAccountAsync>(env));
+    exports.Set(Napi::String::New(env, "registerAccountAsync"), Napi::Function::New<RegisterAccountAsync>(env));
+    exports.Set(Napi::String::New(env, "unregisterAccountAsync"), Napi::Function::New<UnregisterAccountAsync>(env));
+    exports.Set(Napi::String::New(env, "makeCallAsync"), Napi::Function::New<MakeCallAsync>(env));
+    exports.Set(Napi::String::New(env, "answerCallAsync"), Napi::Function::New<AnswerCallAsync>(env));
+    exports.Set(Napi::String::New(env, "hangupCallAsync"), Napi::Function::New<HangupCallAsync>(env));
+    exports.Set(Napi::String::New(env, "shutdownAsync"), Napi::Function::New<ShutdownAsync>(env));
     exports.Set(Napi::String::New(env, "makeCall"), Napi::Function::New<MakeCall>(env));
     exports.Set(Napi::String::New(env, "answerCall"), Napi::Function::New<AnswerCall>(env));
+    exports.Set(Napi::String::New(env, "getCalls"), Napi::Function::New<GetCalls>(env));
+    exports.Set(Napi::String::New(env, "getCall"), Napi::Function::New<GetCall>(env));
+    exports.Set(Napi::String::New(env, "getCallStats"), Napi::Function::New<GetCallStats>(env));
+    exports.Set(Napi::String::New(env, "setAdmissionPolicy"), Napi::Function::New<SetAdmissionPolicy>(env));
+    exports.Set(Napi::String::New(env, "getAdmissionStats"), Napi::Function::New<GetAdmissionStats>(env));
+    exports.Set(Napi::String::New(env, "setDraining"), Napi::Function::New<SetDraining>(env));
+    exports.Set(Napi::String::New(env, "hangupAllCalls"), Napi::Function::New<HangupAllCalls>(env));
+    exports.Set(Napi::String::New(env, "setLogOptions"), Napi::Function::New<SetLogOptions>(env));
+    exports.Set(Napi::String::New(env, "getLogStats"), Napi::Function::New<GetLogStats>(env));
+    exports.Set(Napi::String::New(env, "flushLog"), Napi::Function::New<FlushLog>(env));
     exports.Set(Napi::String::New(env, "hangupCall"), Napi::Function::New<HangupCall>(env));
+    exports.Set(Napi::String::New(env, "setCallSdp"), Napi::Function::New<SetCallSdp>(env));
+    exports.Set(Napi::String::New(env, "getCallSdp"), Napi::Function::New<GetCallSdp>(env));
     exports.Set(Napi::String::New(env, "getVersion"), Napi::Function::New<GetVersion>(env));
     exports.Set(Napi::String::New(env, "getLocalIP"), Napi::Function::New<GetLocalIP>(env));
     exports.Set(Napi::String::New(env, "getBoundPort"), Napi::Function::New<GetBoundPort>(env));
+    exports.Set(Napi::String::New(env, "getTransports"), Napi::Function::New<GetTransports>(env));
+    exports.Set(Napi::String::New(env, "setEventCallback"), Napi::Function::New<SetEventCallback>(env));
+    exports.Set(Napi::String::New(env, "getEventQueueStats"), Napi::Function::New<GetEventQueueStats>(env));
+    exports.Set(Napi::String::New(env, "getMonotonicTime"), Napi::Function::New<GetMonotonicTime>(env));
+    exports.Set(Napi::String::New(env, "getMetrics"), Napi::Function::New<GetMetrics>(env));
+    exports.Set(Napi::String::New(env, "getPrometheusMetrics"), Napi::Function::New<GetPrometheusMetrics>(env));
+    exports.Set(Napi::String::New(env, "resetMetrics"), Napi::Function::New<ResetMetrics>(env));
+    exports.Set(Napi::String::New(env, "startMediaStats"), Napi::Function::New<StartMediaStats>(env));
+    exports.Set(Napi::String::New(env, "stopMediaStats"), Napi::Function::New<StopMediaStats>(env));
+    exports.Set(Napi::String::New(env, "getMediaStatsCounters"), Napi::Function::New<GetMediaStatsCounters>(env));
+    exports.Set(Napi::String::New(env, "getCallConfSlot"), Napi::Function::New<GetCallConfSlot>(env));
+    exports.Set(Napi::String::New(env, "connectMedia"), Napi::Function::New<ConnectMedia>(env));
+    exports.Set(Napi::String::New(env, "disconnectMedia"), Napi::Function::New<DisconnectMedia>(env));
+    exports.Set(Napi::String::New(env, "createPlayer"), Napi::Function::New<CreatePlayer>(env));
+    exports.Set(Napi::String::New(env, "destroyPlayer"), Napi::Function::New<DestroyPlayer>(env));
+    exports.Set(Napi::String::New(env, "createRecorder"), Napi::Function::New<CreateRecorder>(env));
+    exports.Set(Napi::String::New(env, "destroyRecorder"), Napi::Function::New<DestroyRecorder>(env));
+    exports.Set(Napi::String::New(env, "createMediaTap"), Napi::Function::New<CreateMediaTap>(env));
+    exports.Set(Napi::String::New(env, "destroyMediaTap"), Napi::Function::New<DestroyMediaTap>(env));
+    exports.Set(Napi::String::New(env, "injectTapAudio"), Napi::Function::New<InjectTapAudio>(env));
+    exports.Set(Napi::String::New(env, "getMediaTapStats"), Napi::Function::New<GetMediaTapStats>(env));
+    exports.Set(Napi::String::New(env, "startRecording"), Napi::Function::New<StartRecording>(env));
+    exports.Set(Napi::String::New(env, "stopRecording"), Napi::Function::New<StopRecording>(env));
+    exports.Set(Napi::String::New(env, "getRecordingStats"), Napi::Function::New<GetRecordingStats>(env));
+    exports.Set(Napi::String::New(env, "bridgeCalls"), Napi::Function::New<BridgeCalls>(env));
+    exports.Set(Napi::String::New(env, "unbridgeCalls"), Napi::Function::New<UnbridgeCalls>(env));
+    exports.Set(Napi::String::New(env, "getCallBridge"), Napi::Function::New<GetCallBridge>(env));
+    exports.Set(Napi::String::New(env, "getBridgeStats"), Napi::Function::New<GetBridgeStats>(env));
+    exports.Set(Napi::String::New(env, "prewarmDns"), Napi::Function::New<PrewarmDns>(env));
+    exports.Set(Napi::String::New(env, "flushDnsCache"), Napi::Function::New<FlushDnsCache>(env));
+    exports.Set(Napi::String::New(env, "getDnsStats"), Napi::Function::New<GetDnsStats>(env));
+    exports.Set(Napi::String::New(env, "getFlows"), Napi::Function::New<GetFlows>(env));
+    exports.Set(Napi::String::New(env, "getFlowStats"), Napi::Function::New<GetFlowStats>(env));
+    exports.Set(Napi::String::New(env, "startCapture"), Napi::Function::New<StartCapture>(env));
+    exports.Set(Napi::String::New(env, "stopCapture"), Napi::Function::New<StopCapture>(env));
+    exports.Set(Napi::String::New(env, "getCaptureStats"), Napi::Function::New<GetCaptureStats>(env));
+    exports.Set(Napi::String::New(env, "getCodecs"), Napi::Function::New<GetCodecs>(env));
+    exports.Set(Napi::String::New(env, "setCodecPriority"), Napi::Function::New<SetCodecPriority>(env));
+    exports.Set(Napi::String::New(env, "setCodecParams"), Napi::Function::New<SetCodecParams>(env));
+    exports.Set(Napi::String::New(env, "getCallCodec"), Napi::Function::New<GetCallCodec>(env));
+    exports.Set(Napi::String::New(env, "getCodecUsage"), Napi::Function::New<GetCodecUsage>(env));
     
     return exports;
 }
\ No newline at end of file
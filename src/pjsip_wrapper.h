@@ -8,47 +8,97 @@
 #include <pjlib-util.h>
 #include <pjlib.h>
 
+#include "account_table.h"
+#include "admission.h"
+#include "call_bridge.h"
+#include "call_recorder.h"
+#include "call_table.h"
+#include "codec_control.h"
+#include "command_worker.h"
+#include "dns_cache.h"
+#include "env_context.h"
+#include "event_queue.h"
+#include "flow_table.h"
+#include "log_sink.h"
+#include "media_stats.h"
+#include "media_tap.h"
+#include "metrics.h"
+#include "packet_capture.h"
+#include "registration_scheduler.h"
+#include "transport_set.h"
+
 #include <memory>
 #include <map>
 #include <string>
 #include <vector>
 #include <functional>
 #include <mutex>
+#include <atomic>
 
 // Forward declarations
 class PJSIPWrapper;
 
-// PJSIP Account class - uses real PJSIP types
-class PJSIPAccount {
-public:
-    pjsua_acc_id acc_id;
-    std::string aor;
-    std::string registrar;
-    std::string username;
-    std::string password;
-    std::string proxy;
-    bool is_registered;
-    pjsua_acc_info acc_info;
-    
-    PJSIPAccount();
-    ~PJSIPAccount();
+// Audio device used to clock the conference bridge
+enum class PJSIPAudioDevice {
+    Default,    // system sound device
+    Null,       // null device - bridge is clocked but nothing is played
+    None        // no device - bridge is not clocked, calls never get mixed
+};
+
+// What the engine is set up to carry
+enum class PJSIPMediaMode {
+    Full,       // audio streams, codecs and the conference bridge
+    Signalling  // SIP only - calls carry no streams, SDP comes from the application
 };
 
-// PJSIP Wrapper class - uses real PJSIP API
+// Engine sizing options for Init(). Negative values keep pjsua's defaults.
+struct PJSIPInitOptions {
+    int max_calls;          // ua_cfg.max_calls, capped at PJSUA_MAX_CALLS
+    int thread_cnt;         // ua_cfg.thread_cnt - SIP worker threads
+    int media_thread_cnt;   // media_cfg.thread_cnt - media worker threads
+    int has_ioqueue;        // media_cfg.has_ioqueue - separate media ioqueue
+    int clock_rate;         // media_cfg.clock_rate - conference bridge rate
+    int ptime;              // media_cfg.audio_frame_ptime in milliseconds
+    int conf_ports;         // media_cfg.max_media_ports - conference bridge size
+    PJSIPAudioDevice audio_device;
+    int auto_connect_audio; // bridge new calls to slot 0, -1 = only with a sound device
+    int log_level;          // pjlib log level 0-6, -1 keeps 4
+    PJSIPMediaMode media_mode;
+    std::string sdp;        // signalling mode: body for offers/answers without a per-call one
+    std::vector<PJSIPTransportConfig> transports;  // empty = one UDP socket on 5060
+    PJSIPDnsOptions dns;    // no nameservers: pjsip resolves with blocking getaddrinfo
+    PJSIPFlowOptions flows; // keepalive, outbound and reconnect pacing of TCP/TLS flows
+    
+    PJSIPInitOptions();
+};
+
+// PJSIP Wrapper class - uses real PJSIP API. One per process like pjsua
+// itself, shared by every env (see PJSIPEnvContext).
 class PJSIPWrapper {
 private:
-    static PJSIPWrapper* instance;
-    bool is_initialized;
-    std::vector<std::unique_ptr<PJSIPAccount>> accounts;
-    pjsua_acc_id next_account_id;
-    std::mutex accounts_mutex;
+    std::atomic<bool> is_initialized;  // read by every env's JS thread and the registration scheduler
+    PJSIPAccountTable accounts;
+    PJSIPCallTable calls;
     
     // PJSIP configuration
     pjsua_config ua_cfg;
     pjsua_logging_config log_cfg;
     pjsua_media_config media_cfg;
-    pjsua_transport_config udp_cfg;
-    pjsua_transport_id transport_id;
+    
+    // SIP listeners, the first one backs getLocalIP/getBoundPort
+    PJSIPTransportSet transports;
+    
+    // Envs using the engine and the listeners each one added when attaching
+    std::mutex env_mutex;
+    uint32_t attached_envs;
+    std::vector<pjsua_transport_id> env_transports[PJSIPEnvContext::MAX_ENVS];
+    std::atomic<pjsua_transport_id> env_primary[PJSIPEnvContext::MAX_ENVS];  // read by addAccount, any thread
+    
+    // Media routing
+    PJSIPMediaMode media_mode;
+    PJSIPAudioDevice audio_device;
+    bool auto_connect_audio;
+    std::shared_ptr<const std::string> default_sdp;  // signalling mode, may be null
     
     // Event callbacks
     std::function<void(const std::string&)> on_registered;
@@ -57,23 +107,65 @@ private:
     std::function<void(const std::string&)> on_incoming_call;
     std::function<void(const std::string&)> on_call_state;
     
+    // Incoming call load shedding
+    PJSIPAdmissionController admission;
+    
+    // Paced bulk registration
+    PJSIPRegistrationScheduler registrations;
+    
+    // Periodic RTP/RTCP snapshots of every active call
+    PJSIPMediaStatsSampler media_stats;
+    
+    // PCM capture/inject ports on the bridge
+    PJSIPMediaTapTable media_taps;
+    
+    // Per-call WAV recording with a batched background writer
+    PJSIPCallRecorder recordings;
+    
+    // Back-to-back call pairs, relayed or mixed natively
+    PJSIPCallBridge bridges;
+    
+    // Codec priorities, parameters and per-call negotiation reports
+    PJSIPCodecControl codecs;
+    
+    // TCP/TLS connections and the accounts registered over them
+    PJSIPFlowTable flows;
+    
+    // Asynchronous SIP next-hop resolution with a shared cache
+    PJSIPDnsCache dns;
+    
+    // SIP message capture to pcap files or a HEP collector
+    PJSIPPacketCapture capture;
+    
+    bool start(const PJSIPInitOptions& options);
+    void releaseEnv(unsigned env_id);
+    void callSetting(pjsua_call_setting& opt) const;
+    bool hasMedia(const char* what) const;
+    
 public:
     PJSIPWrapper();
     ~PJSIPWrapper();
     
     static PJSIPWrapper* getInstance();
     
-    // Core functions - Real PJSIP API
-    bool initialize();
-    bool shutdown();
+    // Core functions - Real PJSIP API. The first env to initialize starts
+    // the engine, later ones attach with their own listeners (if any); an env
+    // detaching takes its accounts and listeners along, the last one shuts down.
+    bool initialize(const PJSIPInitOptions& options = PJSIPInitOptions(), unsigned env_id = 0);
+    bool detach(unsigned env_id, bool network = true);
+    bool shutdown(bool network = true);    // network = false: no un-REGISTER or BYE, nothing waited for
+    void releaseEnvCallbacks(unsigned env_id);  // env teardown, attached or not
     
     // Account management - Real PJSIP API
     int addAccount(const std::string& aor, const std::string& registrar, 
                    const std::string& username, const std::string& password,
                    const std::string& proxy = "");
+    int addAccount(const PJSIPAccountConfig& config);
     bool removeAccount(int acc_id);
-    PJSIPAccount* getAccount(int acc_id);
-    std::vector<PJSIPAccount*> getAllAccounts();
+    std::shared_ptr<const PJSIPAccount> getAccount(int acc_id);
+    std::vector<std::shared_ptr<const PJSIPAccount>> getAllAccounts();
+    bool getRegState(int acc_id, PJSIPRegState& state);
+    size_t snapshotAccounts(std::string& out, unsigned env_id);   // addAccounts() Buffer records, returns the count
     
     // Registration - Real PJSIP API
     bool registerAccount(int acc_id);
@@ -81,9 +173,61 @@ public:
     bool refreshRegistration(int acc_id);
     
     // Call management - Real PJSIP API
-    bool makeCall(int acc_id, const std::string& uri);
+    int makeCall(int acc_id, const std::string& uri, const std::string& sdp = "");   // returns the call id, -1 on failure
     bool answerCall(int call_id);
     bool hangupCall(int call_id);
+    unsigned hangupAllCalls();                      // returns the calls that were still up
+    
+    // Signalling mode - SDP the application supplies for, or received on, a call
+    bool setCallSdp(int call_id, const std::string& sdp);
+    std::shared_ptr<const std::string> getCallSdp(int call_id, PJSIPSdpSide side) { return calls.getSdp(call_id, side); }
+    PJSIPMediaMode getMediaMode() const { return media_mode; }
+    
+    // Media routing - conference bridge slots chosen by the application
+    int getCallConfSlot(int call_id);
+    bool connectMedia(int source_slot, int sink_slot);
+    bool disconnectMedia(int source_slot, int sink_slot);
+    int createPlayer(const std::string& path, bool loop);
+    int getPlayerConfSlot(int player_id);
+    bool destroyPlayer(int player_id);
+    int createRecorder(const std::string& path);
+    int getRecorderConfSlot(int recorder_id);
+    bool destroyRecorder(int recorder_id);
+    int createMediaTap(Napi::Env env, Napi::Function callback, unsigned frames, bool inject,
+                       Napi::ArrayBuffer& buffer);   // returns the tap id, -1 on failure
+    std::shared_ptr<PJSIPMediaTap> getMediaTap(int tap_id) { return media_taps.get(tap_id); }
+    bool destroyMediaTap(int tap_id);
+    int startRecording(int call_id, const std::string& path, const PJSIPRecordingOptions& options);
+    Napi::Value stopRecording(Napi::Env env, int recording_id) { return recordings.stop(env, recording_id); }
+    bool getRecordingStats(int recording_id, PJSIPRecordingStats& out) { return recordings.stats(recording_id, out); }
+    
+    // Call bridging - two calls' media linked without JS or the sound device
+    bool bridgeCalls(int call_a, int call_b, const PJSIPBridgeOptions& options);
+    bool unbridgeCalls(int call_id) { return bridges.unbridge((pjsua_call_id)call_id); }
+    bool getCallBridge(int call_id, PJSIPBridgeInfo& out) { return bridges.info((pjsua_call_id)call_id, out); }
+    PJSIPBridgeStats getBridgeStats() { return bridges.stats(); }
+    
+    // DNS - resolution cache in front of the nameservers given to initialize()
+    Napi::Value prewarmDns(Napi::Env env, const std::vector<std::string>& targets) { return dns.prewarm(env, targets); }
+    void prewarmDns(const std::vector<std::string>& targets) { dns.prewarm(targets); }
+    unsigned flushDnsCache() { return dns.flush(); }
+    PJSIPDnsStats getDnsStats() { return dns.stats(); }
+    
+    // Flows - connection-oriented transports shared by accounts
+    void getFlows(std::vector<PJSIPFlowInfo>& out) { flows.snapshot(out); }
+    PJSIPFlowStats getFlowStats() { return flows.stats(); }
+    
+    // SIP capture - account filters are given as account ids
+    bool startCapture(PJSIPCaptureOptions options, const std::vector<int>& account_ids);
+    PJSIPCaptureStats stopCapture() { return capture.stop(); }
+    PJSIPCaptureStats getCaptureStats() { return capture.stats(); }
+    
+    // Codecs - pjsua's codec manager and negotiated streams
+    bool getCodecs(std::vector<PJSIPCodecInfo>& out);
+    bool setCodecPriority(const std::string& id, unsigned priority);
+    bool setCodecParams(const std::string& id, const PJSIPCodecParams& params);
+    bool getCallCodec(int call_id, PJSIPCallCodec& out);
+    bool getCodecUsage(PJSIPCodecUsage& out);
     
     // Event handlers - Real PJSIP API
     void setOnRegistered(std::function<void(const std::string&)> callback);
@@ -91,17 +235,34 @@ public:
     void setOnUnregistered(std::function<void(const std::string&)> callback);
     void setOnIncomingCall(std::function<void(const std::string&)> callback);
     void setOnCallState(std::function<void(const std::string&)> callback);
+    PJSIPRegistrationScheduler& getRegistrationScheduler() { return registrations; }
+    PJSIPCallTable& getCallTable() { return calls; }
+    PJSIPAdmissionController& getAdmissionController() { return admission; }
+    PJSIPMediaStatsSampler& getMediaStatsSampler() { return media_stats; }
+    bool isInitialized() const { return is_initialized; }
+    
+    // Logging
+    bool setPjlibLogLevel(int level);
     
     // Utility functions
     std::string getVersion();
     std::string getLocalIP();
     int getBoundPort();
+    void getTransports(std::vector<PJSIPTransportInfo>& out) { transports.snapshot(out); }
+    void getMetricsGauges(PJSIPMetricsGauges& out);
     
     // PJSIP callback handlers (static)
+    static void pjsip_on_reg_started(pjsua_acc_id acc_id, pj_bool_t renew);
     static void pjsip_on_reg_state(pjsua_acc_id acc_id);
     static void pjsip_on_incoming_call(pjsua_acc_id acc_id, pjsua_call_id call_id, pjsip_rx_data *rdata);
     static void pjsip_on_call_state(pjsua_call_id call_id, pjsip_event *e);
     static void pjsip_on_call_media_state(pjsua_call_id call_id);
+    static void pjsip_on_call_sdp_created(pjsua_call_id call_id, pjmedia_sdp_session *sdp, pj_pool_t *pool,
+                                          const pjmedia_sdp_session *rem_sdp);
+    static pjmedia_transport* pjsip_on_create_media_transport(pjsua_call_id call_id, unsigned media_idx,
+                                                              pjmedia_transport *base_tp, unsigned flags);
+    static void pjsip_on_transport_state(pjsip_transport *tp, pjsip_transport_state state,
+                                         const pjsip_transport_state_info *info);
 };
 
 // N-API function declarations
@@ -109,15 +270,81 @@ Napi::Value Init(const Napi::CallbackInfo& info);
 Napi::Value RegisterAccount(const Napi::CallbackInfo& info);
 Napi::Value UnregisterAccount(const Napi::CallbackInfo& info);
 Napi::Value GetAccountInfo(const Napi::CallbackInfo& info);
+Napi::Value GetAccounts(const Napi::CallbackInfo& info);
+Napi::Value GetAccountPoolStats(const Napi::CallbackInfo& info);
 Napi::Value Shutdown(const Napi::CallbackInfo& info);
+Napi::Value GetCalls(const Napi::CallbackInfo& info);
+Napi::Value GetCall(const Napi::CallbackInfo& info);
+Napi::Value GetCallStats(const Napi::CallbackInfo& info);
+Napi::Value SetAdmissionPolicy(const Napi::CallbackInfo& info);
+Napi::Value GetAdmissionStats(const Napi::CallbackInfo& info);
+Napi::Value SetDraining(const Napi::CallbackInfo& info);
+Napi::Value HangupAllCalls(const Napi::CallbackInfo& info);
+Napi::Value UnregisterAccounts(const Napi::CallbackInfo& info);
+Napi::Value SnapshotAccounts(const Napi::CallbackInfo& info);
+Napi::Value SetLogOptions(const Napi::CallbackInfo& info);
+Napi::Value GetLogStats(const Napi::CallbackInfo& info);
+Napi::Value FlushLog(const Napi::CallbackInfo& info);
+Napi::Value AddAccountAsync(const Napi::CallbackInfo& info);
+Napi::Value RemoveAccountAsync(const Napi::CallbackInfo& info);
+Napi::Value RegisterAccountAsync(const Napi::CallbackInfo& info);
+Napi::Value UnregisterAccountAsync(const Napi::CallbackInfo& info);
+Napi::Value MakeCallAsync(const Napi::CallbackInfo& info);
+Napi::Value AnswerCallAsync(const Napi::CallbackInfo& info);
+Napi::Value HangupCallAsync(const Napi::CallbackInfo& info);
+Napi::Value ShutdownAsync(const Napi::CallbackInfo& info);
 Napi::Value AddAccount(const Napi::CallbackInfo& info);
+Napi::Value AddAccounts(const Napi::CallbackInfo& info);
 Napi::Value RemoveAccount(const Napi::CallbackInfo& info);
 Napi::Value MakeCall(const Napi::CallbackInfo& info);
 Napi::Value AnswerCall(const Napi::CallbackInfo& info);
 Napi::Value HangupCall(const Napi::CallbackInfo& info);
+Napi::Value SetCallSdp(const Napi::CallbackInfo& info);
+Napi::Value GetCallSdp(const Napi::CallbackInfo& info);
 Napi::Value GetVersion(const Napi::CallbackInfo& info);
 Napi::Value GetLocalIP(const Napi::CallbackInfo& info);
 Napi::Value GetBoundPort(const Napi::CallbackInfo& info);
+Napi::Value GetTransports(const Napi::CallbackInfo& info);
+Napi::Value SetEventCallback(const Napi::CallbackInfo& info);
+Napi::Value GetEventQueueStats(const Napi::CallbackInfo& info);
+Napi::Value GetMonotonicTime(const Napi::CallbackInfo& info);
+Napi::Value GetMetrics(const Napi::CallbackInfo& info);
+Napi::Value GetPrometheusMetrics(const Napi::CallbackInfo& info);
+Napi::Value ResetMetrics(const Napi::CallbackInfo& info);
+Napi::Value StartMediaStats(const Napi::CallbackInfo& info);
+Napi::Value StopMediaStats(const Napi::CallbackInfo& info);
+Napi::Value GetMediaStatsCounters(const Napi::CallbackInfo& info);
+Napi::Value GetCallConfSlot(const Napi::CallbackInfo& info);
+Napi::Value ConnectMedia(const Napi::CallbackInfo& info);
+Napi::Value DisconnectMedia(const Napi::CallbackInfo& info);
+Napi::Value CreatePlayer(const Napi::CallbackInfo& info);
+Napi::Value DestroyPlayer(const Napi::CallbackInfo& info);
+Napi::Value CreateRecorder(const Napi::CallbackInfo& info);
+Napi::Value DestroyRecorder(const Napi::CallbackInfo& info);
+Napi::Value CreateMediaTap(const Napi::CallbackInfo& info);
+Napi::Value DestroyMediaTap(const Napi::CallbackInfo& info);
+Napi::Value InjectTapAudio(const Napi::CallbackInfo& info);
+Napi::Value GetMediaTapStats(const Napi::CallbackInfo& info);
+Napi::Value StartRecording(const Napi::CallbackInfo& info);
+Napi::Value StopRecording(const Napi::CallbackInfo& info);
+Napi::Value GetRecordingStats(const Napi::CallbackInfo& info);
+Napi::Value BridgeCalls(const Napi::CallbackInfo& info);
+Napi::Value UnbridgeCalls(const Napi::CallbackInfo& info);
+Napi::Value GetCallBridge(const Napi::CallbackInfo& info);
+Napi::Value GetBridgeStats(const Napi::CallbackInfo& info);
+Napi::Value PrewarmDns(const Napi::CallbackInfo& info);
+Napi::Value FlushDnsCache(const Napi::CallbackInfo& info);
+Napi::Value GetDnsStats(const Napi::CallbackInfo& info);
+Napi::Value GetFlows(const Napi::CallbackInfo& info);
+Napi::Value GetFlowStats(const Napi::CallbackInfo& info);
+Napi::Value StartCapture(const Napi::CallbackInfo& info);
+Napi::Value StopCapture(const Napi::CallbackInfo& info);
+Napi::Value GetCaptureStats(const Napi::CallbackInfo& info);
+Napi::Value GetCodecs(const Napi::CallbackInfo& info);
+Napi::Value SetCodecPriority(const Napi::CallbackInfo& info);
+Napi::Value SetCodecParams(const Napi::CallbackInfo& info);
+Napi::Value GetCallCodec(const Napi::CallbackInfo& info);
+Napi::Value GetCodecUsage(const Napi::CallbackInfo& info);
 
 // Export bindings to Node.js
 Napi::Object InitPjsipWrapper(Napi::Env env, Napi::Object exports);
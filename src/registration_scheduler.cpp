@@ -0,0 +1,373 @@
+#include "registration_scheduler.h"
+#include "pjsip_wrapper.h"
+#include "pj_thread_util.h"
+#include "log_sink.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+// pjsua's default registration interval (PJSUA_REG_INTERVAL)
+static const unsigned DEFAULT_REG_TIMEOUT = 300;
+
+// A REGISTER without an answer by then is counted as failed: Timer F twice,
+// for an authentication round, plus slack. Covers accounts removed mid-batch
+// and transactions whose on_reg_state never comes.
+static const unsigned REGISTER_DEADLINE_S = 75;
+
+// PJSIPPacingOptions implementation
+PJSIPPacingOptions::PJSIPPacingOptions() : rate(50.0), burst(10), jitter(0.2), window(100),
+    refresh_spread(0.1) {
+}
+
+// PJSIPProvisionJob implementation
+PJSIPProvisionJob::PJSIPProvisionJob(Napi::Env env, PJSIPProvisionKind kind) : kind(kind),
+    deferred(Napi::Promise::Deferred::New(env)), has_progress_callback(false), env_id(0), cancelled(false),
+    added(0), registered(0), failed(0), sent(0) {
+}
+
+// PJSIPRegistrationScheduler implementation
+PJSIPRegistrationScheduler::PJSIPRegistrationScheduler(PJSIPWrapper* wrapper)
+    : wrapper(wrapper), awaiting(new std::atomic<uint8_t>[PJSUA_MAX_ACC]), in_flight(0), running(false) {
+    for (unsigned i = 0; i < PJSUA_MAX_ACC; i++) {
+        awaiting[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+PJSIPRegistrationScheduler::~PJSIPRegistrationScheduler() {
+    stop();
+}
+
+void PJSIPRegistrationScheduler::submit(std::shared_ptr<PJSIPProvisionJob> job) {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back(std::move(job));
+    if (!running) {
+        running = true;
+        worker = std::thread(&PJSIPRegistrationScheduler::run, this);
+    }
+    cv.notify_all();
+}
+
+void PJSIPRegistrationScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+    cv.notify_all();
+    worker.join();
+
+    // Anything not started yet is rejected
+    std::deque<std::shared_ptr<PJSIPProvisionJob>> abandoned;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        abandoned.swap(jobs);
+        in_flight = 0;
+    }
+    for (auto& job : abandoned) {
+        reportProgress(job, true, "PJSIP shut down before the accounts were provisioned");
+    }
+    for (unsigned i = 0; i < PJSUA_MAX_ACC; i++) {
+        awaiting[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void PJSIPRegistrationScheduler::cancel(unsigned env_id) {
+    std::deque<std::shared_ptr<PJSIPProvisionJob>> abandoned;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (auto it = jobs.begin(); it != jobs.end();) {
+            if ((*it)->env_id == env_id) {
+                abandoned.push_back(std::move(*it));
+                it = jobs.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (current && current->env_id == env_id) {
+            current->cancelled = true;
+            cv.notify_all();
+            cv.wait(lock, [this, env_id] { return !current || current->env_id != env_id; });
+        }
+    }
+
+    // Their callbacks are closed already, this only releases them
+    for (auto& job : abandoned) {
+        reportProgress(job, true, "Env torn down before the accounts were provisioned");
+    }
+}
+
+size_t PJSIPRegistrationScheduler::pendingJobs() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return jobs.size() + (current ? 1 : 0);
+}
+
+bool PJSIPRegistrationScheduler::onRegState(pjsua_acc_id acc_id, int status_code) {
+    if (!PJSIPAccountTable::isValidId(acc_id) || awaiting[acc_id].exchange(0) == 0) {
+        return false; // a refresh or a manual registerAccount()
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (in_flight > 0) {
+            in_flight--;
+        }
+        if (current) {
+            if (status_code == PJSIP_SC_OK) {
+                current->registered.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                current->failed.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+    cv.notify_all();
+    return true;
+}
+
+void PJSIPRegistrationScheduler::run() {
+    pjsipRegisterThread("pjsip-reg-sched");
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this] { return !running || !jobs.empty(); });
+            if (!running) {
+                break;
+            }
+            current = jobs.front();
+            jobs.pop_front();
+        }
+
+        runJob(current);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        current.reset();
+        cv.notify_all();
+    }
+}
+
+bool PJSIPRegistrationScheduler::waitForSlot(const std::shared_ptr<PJSIPProvisionJob>& job, std::deque<Sent>& sent,
+                                             std::unique_lock<std::mutex>& lock) {
+    unsigned window = job->pacing.window > 0 ? job->pacing.window : 1;
+    while (proceeding(job) && in_flight >= window) {
+        if (sent.empty()) {
+            cv.wait(lock);
+        } else {
+            cv.wait_until(lock, sent.front().deadline);
+        }
+        expireOverdue(job, sent);
+    }
+    return proceeding(job);
+}
+
+void PJSIPRegistrationScheduler::expireOverdue(const std::shared_ptr<PJSIPProvisionJob>& job, std::deque<Sent>& sent) {
+    Clock::time_point now = Clock::now();
+    while (!sent.empty()) {
+        const Sent& oldest = sent.front();
+        bool answered = awaiting[oldest.acc_id].load() == 0;
+        if (!answered && oldest.deadline > now) {
+            break;
+        }
+        pjsua_acc_id acc_id = oldest.acc_id;
+        sent.pop_front();
+
+        // The answer may still race us here, whoever clears the flag counts it
+        if (!answered && awaiting[acc_id].exchange(0) != 0) {
+            if (in_flight > 0) {
+                in_flight--;
+            }
+            job->failed.fetch_add(1, std::memory_order_relaxed);
+            PJW_LOG_DEBUG("⚠️ No answer to the REGISTER of account %d, counted as failed", acc_id);
+        }
+    }
+}
+
+void PJSIPRegistrationScheduler::runJob(const std::shared_ptr<PJSIPProvisionJob>& job) {
+    const PJSIPPacingOptions& pacing = job->pacing;
+    std::mt19937 rng(std::random_device{}());
+    std::uniform_real_distribution<double> unit(-1.0, 1.0);
+    Clock::time_point last_report = Clock::now();
+    const auto report_interval = std::chrono::milliseconds(250);
+
+    bool registering = job->kind == PJSIPProvisionKind::Register;
+
+    // Phase 1 - build every account without sending a REGISTER, spreading
+    // the refresh interval so the registrar does not see them all again at once.
+    // Unregistration batches start with their accounts in place.
+    if (registering) {
+        job->acc_ids.assign(job->configs.size(), PJSUA_INVALID_ID);
+    } else {
+        uint32_t valid = (uint32_t)std::count_if(job->acc_ids.begin(), job->acc_ids.end(),
+                                                 [](int acc_id) { return acc_id >= 0; });
+        job->added.store(valid, std::memory_order_relaxed);
+    }
+    for (size_t i = 0; registering && i < job->configs.size(); i++) {
+        PJSIPAccountConfig& config = job->configs[i];
+        config.register_on_add = false;
+        if (pacing.refresh_spread > 0) {
+            unsigned base = config.reg_timeout ? config.reg_timeout : DEFAULT_REG_TIMEOUT;
+            double spread = std::min(pacing.refresh_spread, 0.9);
+            config.reg_timeout = (unsigned)std::max(30.0, base * (1.0 + spread * unit(rng)));
+        }
+
+        int acc_id = wrapper->addAccount(config);
+        job->acc_ids[i] = acc_id;
+        if (acc_id >= 0) {
+            job->added.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            job->failed.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (Clock::now() - last_report >= report_interval) {
+            reportProgress(job, false, nullptr);
+            last_report = Clock::now();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!proceeding(job)) {
+            break;
+        }
+    }
+
+    // Phase 2 - (un)register through the token bucket and the in-flight window
+    double rate = pacing.rate > 0 ? pacing.rate : 1.0;
+    double burst = pacing.burst > 0 ? (double)pacing.burst : 1.0;
+    double tokens = burst;
+    Clock::time_point last_refill = Clock::now();
+    std::deque<Sent> sent;
+
+    for (size_t i = 0; i < job->acc_ids.size(); i++) {
+        pjsua_acc_id acc_id = job->acc_ids[i];
+        if (!PJSIPAccountTable::isValidId(acc_id)) {
+            continue;
+        }
+
+        Clock::time_point now = Clock::now();
+        tokens = std::min(burst, tokens + std::chrono::duration<double>(now - last_refill).count() * rate);
+        last_refill = now;
+        if (tokens < 1.0) {
+            double wait = (1.0 - tokens) / rate * (1.0 + pacing.jitter * unit(rng));
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait_for(lock, std::chrono::duration<double>(std::max(0.0, wait)), [this, &job] { return !proceeding(job); });
+            if (!proceeding(job)) {
+                break;
+            }
+            now = Clock::now();
+            tokens = std::min(burst, tokens + std::chrono::duration<double>(now - last_refill).count() * rate);
+            last_refill = now;
+        }
+        tokens -= 1.0;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (!waitForSlot(job, sent, lock)) {
+                break;
+            }
+            in_flight++;
+        }
+
+        awaiting[acc_id].store(1);
+        if (pjsua_acc_set_registration(acc_id, registering ? PJ_TRUE : PJ_FALSE) == PJ_SUCCESS) {
+            job->sent.fetch_add(1, std::memory_order_relaxed);
+            sent.push_back({ acc_id, Clock::now() + std::chrono::seconds(REGISTER_DEADLINE_S) });
+        } else if (awaiting[acc_id].exchange(0) != 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            in_flight--;
+            job->failed.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (Clock::now() - last_report >= report_interval) {
+            reportProgress(job, false, nullptr);
+            last_report = Clock::now();
+        }
+    }
+
+    // Wait for the last REGISTERs to complete
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (proceeding(job) && in_flight > 0) {
+            cv.wait_for(lock, report_interval);
+            expireOverdue(job, sent);
+            lock.unlock();
+            reportProgress(job, false, nullptr);
+            lock.lock();
+        }
+        if (running && job->cancelled) {
+            // Answers still due are not ours to count any more, nor the window slots they hold
+            for (const Sent& pending : sent) {
+                if (awaiting[pending.acc_id].exchange(0) != 0 && in_flight > 0) {
+                    in_flight--;
+                }
+            }
+            lock.unlock();
+            reportProgress(job, true, "Env torn down while accounts were registering");
+            return;
+        }
+        if (!running) {
+            lock.unlock();
+            reportProgress(job, true, "PJSIP shut down while accounts were registering");
+            return;
+        }
+    }
+
+    if (registering) {
+        PJW_LOG_INFO("✅ Provisioned %u/%zu accounts, %u registered", job->added.load(), job->configs.size(),
+                     job->registered.load());
+    } else {
+        PJW_LOG_INFO("✅ Unregistered %u/%zu accounts", job->registered.load(), job->acc_ids.size());
+    }
+    reportProgress(job, true, nullptr);
+}
+
+void PJSIPRegistrationScheduler::reportProgress(const std::shared_ptr<PJSIPProvisionJob>& job, bool done, const char* error) {
+    if (!done && !job->has_progress_callback) {
+        return;
+    }
+
+    PJSIPProvisionProgress progress;
+    progress.total = (uint32_t)job->total();
+    progress.added = job->added.load(std::memory_order_relaxed);
+    progress.registered = job->registered.load(std::memory_order_relaxed);
+    progress.failed = job->failed.load(std::memory_order_relaxed);
+    uint32_t completed = progress.registered + progress.failed;
+    uint32_t sent = job->sent.load(std::memory_order_relaxed) + (progress.total - progress.added);
+    progress.in_flight = sent > completed ? sent - completed : 0;
+
+    std::string error_text = error ? error : "";
+    std::shared_ptr<PJSIPProvisionJob> keep = job;
+    job->callback->call([keep, progress, done, error_text](Napi::Env env, Napi::Function callback) {
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("total", Napi::Number::New(env, progress.total));
+        if (keep->kind == PJSIPProvisionKind::Register) {
+            result.Set("added", Napi::Number::New(env, progress.added));
+            result.Set("registered", Napi::Number::New(env, progress.registered));
+        } else {
+            result.Set("unregistered", Napi::Number::New(env, progress.registered));
+        }
+        result.Set("failed", Napi::Number::New(env, progress.failed));
+        result.Set("inFlight", Napi::Number::New(env, progress.in_flight));
+
+        if (!done) {
+            callback.Call({ result });
+            return;
+        }
+
+        if (!error_text.empty()) {
+            keep->deferred.Reject(Napi::Error::New(env, error_text).Value());
+            return;
+        }
+
+        Napi::Array ids = Napi::Array::New(env, keep->acc_ids.size());
+        for (size_t i = 0; i < keep->acc_ids.size(); i++) {
+            ids.Set((uint32_t)i, Napi::Number::New(env, keep->acc_ids[i]));
+        }
+        result.Set("accountIds", ids);
+        keep->deferred.Resolve(result);
+    });
+
+    if (done) {
+        job->callback->release();
+    }
+}
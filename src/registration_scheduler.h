@@ -0,0 +1,120 @@
+#ifndef NODE_PJSIP_REGISTRATION_SCHEDULER_H
+#define NODE_PJSIP_REGISTRATION_SCHEDULER_H
+
+#include <napi.h>
+#include <pjsua-lib/pjsua.h>
+
+#include "account_table.h"
+#include "js_callback.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class PJSIPWrapper;
+
+// Pacing for bulk registration
+struct PJSIPPacingOptions {
+    double rate;            // REGISTERs per second (token bucket refill)
+    unsigned burst;         // token bucket size
+    double jitter;          // +/- fraction applied to every send gap
+    unsigned window;        // max REGISTERs in flight
+    double refresh_spread;  // +/- fraction applied to reg_timeout per account
+
+    PJSIPPacingOptions();
+};
+
+// What a batch does to its accounts
+enum class PJSIPProvisionKind {
+    Register,       // addAccounts() - add, then REGISTER
+    Unregister      // unregisterAccounts() - REGISTER with expires 0, accounts stay
+};
+
+// Progress of one addAccounts()/unregisterAccounts() batch
+struct PJSIPProvisionProgress {
+    uint32_t total;
+    uint32_t added;
+    uint32_t registered;        // unregistered for Unregister batches
+    uint32_t failed;
+    uint32_t in_flight;
+};
+
+// One addAccounts() or unregisterAccounts() call
+struct PJSIPProvisionJob {
+    PJSIPProvisionKind kind;
+    std::vector<PJSIPAccountConfig> configs;    // Register only
+    std::vector<int> acc_ids;                   // filled in by Register, given for Unregister
+    PJSIPPacingOptions pacing;
+    Napi::Promise::Deferred deferred;
+    std::shared_ptr<PJSIPJsCallback> callback;  // progress, also carries completion
+    bool has_progress_callback;
+    unsigned env_id;                            // env that submitted it
+    bool cancelled;                             // scheduler mutex, its env is gone
+
+    std::atomic<uint32_t> added;
+    std::atomic<uint32_t> registered;
+    std::atomic<uint32_t> failed;
+    std::atomic<uint32_t> sent;
+
+    explicit PJSIPProvisionJob(Napi::Env env, PJSIPProvisionKind kind = PJSIPProvisionKind::Register);
+
+    size_t total() const { return kind == PJSIPProvisionKind::Register ? configs.size() : acc_ids.size(); }
+};
+
+// Adds accounts without registering, then registers them through a token
+// bucket with jitter and a bounded in-flight window, on its own
+// pjlib-registered thread. Unregistration batches for draining go through
+// the same bucket and window. Completion of each REGISTER is fed back from
+// pjsip_on_reg_state through onRegState().
+class PJSIPRegistrationScheduler {
+public:
+    explicit PJSIPRegistrationScheduler(PJSIPWrapper* wrapper);
+    ~PJSIPRegistrationScheduler();
+
+    // JS thread
+    void submit(std::shared_ptr<PJSIPProvisionJob> job);
+    void stop();
+
+    // Env teardown - drops the env's queued jobs and stops its running one,
+    // returning once that one no longer adds accounts
+    void cancel(unsigned env_id);
+
+    // PJSIP threads - returns true when the REGISTER was one of ours
+    bool onRegState(pjsua_acc_id acc_id, int status_code);
+
+    size_t pendingJobs();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    // A REGISTER we sent, in send order
+    struct Sent {
+        pjsua_acc_id acc_id;
+        Clock::time_point deadline;
+    };
+
+    void run();
+    bool proceeding(const std::shared_ptr<PJSIPProvisionJob>& job) const { return running && !job->cancelled; }  // mutex held
+    void runJob(const std::shared_ptr<PJSIPProvisionJob>& job);
+    bool waitForSlot(const std::shared_ptr<PJSIPProvisionJob>& job, std::deque<Sent>& sent,
+                     std::unique_lock<std::mutex>& lock);
+    void expireOverdue(const std::shared_ptr<PJSIPProvisionJob>& job, std::deque<Sent>& sent);     // mutex held
+    void reportProgress(const std::shared_ptr<PJSIPProvisionJob>& job, bool done, const char* error);
+
+    PJSIPWrapper* wrapper;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::shared_ptr<PJSIPProvisionJob>> jobs;
+    std::shared_ptr<PJSIPProvisionJob> current;
+    std::unique_ptr<std::atomic<uint8_t>[]> awaiting;  // per acc_id, REGISTER sent by us
+    unsigned in_flight;
+    bool running;
+};
+
+#endif
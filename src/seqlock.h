@@ -0,0 +1,95 @@
+#ifndef NODE_PJSIP_SEQLOCK_H
+#define NODE_PJSIP_SEQLOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Sequence lock around a small trivially copyable value.
+// Readers never block writers and never take a lock: they retry when a
+// write overlapped their copy. Writers serialize on the sequence itself,
+// so PJSIP worker threads can update while JS reads.
+template <typename T>
+class PJSIPSeqLock {
+    static_assert(std::is_trivially_copyable<T>::value, "PJSIPSeqLock needs a trivially copyable type");
+
+public:
+    PJSIPSeqLock() : sequence(0) {
+        for (auto& word : words) {
+            word.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void store(const T& value) {
+        update([&value](T& current) { current = value; });
+    }
+
+    // Read-modify-write while holding the write side, so concurrent
+    // updates are applied one after the other and none is lost
+    template <typename Fn>
+    void update(Fn&& fn) {
+        uint32_t seq = lockWrite();
+
+        uint64_t buffer[WORD_COUNT] = {};
+        for (size_t i = 0; i < WORD_COUNT; i++) {
+            buffer[i] = words[i].load(std::memory_order_relaxed);
+        }
+        T value;
+        std::memcpy(&value, buffer, sizeof(T));
+        fn(value);
+        std::memcpy(buffer, &value, sizeof(T));
+
+        for (size_t i = 0; i < WORD_COUNT; i++) {
+            words[i].store(buffer[i], std::memory_order_relaxed);
+        }
+
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    T load() const {
+        uint64_t buffer[WORD_COUNT];
+        for (;;) {
+            uint32_t before = sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+            for (size_t i = 0; i < WORD_COUNT; i++) {
+                buffer[i] = words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == before) {
+                break;
+            }
+        }
+
+        T value;
+        std::memcpy(&value, buffer, sizeof(T));
+        return value;
+    }
+
+    // Even and bumped by two on every completed write
+    uint32_t version() const { return sequence.load(std::memory_order_acquire); }
+
+private:
+    // Take the write side by moving the sequence from even to odd
+    uint32_t lockWrite() {
+        uint32_t seq = sequence.load(std::memory_order_relaxed);
+        for (;;) {
+            if ((seq & 1) == 0 &&
+                sequence.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire)) {
+                break;
+            }
+            seq = sequence.load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        return seq;
+    }
+
+    static const size_t WORD_COUNT = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint64_t> words[WORD_COUNT];
+};
+
+#endif
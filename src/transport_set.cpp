@@ -0,0 +1,402 @@
+#include "transport_set.h"
+#include "log_sink.h"
+
+#include <pjsua-lib/pjsua_internal.h>
+
+#include <algorithm>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#endif
+
+// PJSIPTransportConfig implementation
+PJSIPTransportConfig::PJSIPTransportConfig() : type(PJSIP_TRANSPORT_UDP), port(5060), count(1), async_cnt(1),
+    rcvbuf(0), sndbuf(0), verify_server(false), verify_client(false) {
+}
+
+// Counting module, right before the transport layer like pjsua's message
+// logger: on receive it runs first, on send the message is already printed
+static pjsip_module stats_module;
+
+PJSIPTransportSet* PJSIPTransportSet::active = nullptr;
+
+// PJSIPTransportSet implementation
+PJSIPTransportSet::PJSIPTransportSet() : slot_count(0), next_listener(0) {
+}
+
+bool PJSIPTransportSet::start(const std::vector<PJSIPTransportConfig>& configs) {
+    clear();
+    active = this;
+
+    if (!registerModule()) {
+        return false;
+    }
+    return startAll(configs) && count() > 0;
+}
+
+void PJSIPTransportSet::clear() {
+    // Slots stay readable, late callbacks simply stop matching
+    slot_count.store(0, std::memory_order_release);
+    next_listener = 0;
+}
+
+bool PJSIPTransportSet::add(const std::vector<PJSIPTransportConfig>& configs,
+                            std::vector<pjsua_transport_id>& created) {
+    unsigned first_listener = next_listener;
+    bool ok = startAll(configs);
+
+    created.clear();
+    size_t n = count();
+    for (size_t i = 0; i < n; i++) {
+        if (slots[i].key.load(std::memory_order_acquire) != nullptr && slots[i].listener >= first_listener) {
+            created.push_back(slots[i].id);
+        }
+    }
+    if (!ok) {
+        close(created);
+        created.clear();
+    }
+    return ok;
+}
+
+void PJSIPTransportSet::close(const std::vector<pjsua_transport_id>& ids) {
+    size_t n = count();
+    for (pjsua_transport_id id : ids) {
+        for (size_t i = 0; i < n; i++) {
+            if (slots[i].id == id && slots[i].key.load(std::memory_order_acquire) != nullptr) {
+                slots[i].key.store(nullptr, std::memory_order_release);
+                pjsua_transport_close(id, PJ_FALSE);
+                break;
+            }
+        }
+    }
+}
+
+bool PJSIPTransportSet::startAll(const std::vector<PJSIPTransportConfig>& configs) {
+    for (const PJSIPTransportConfig& config : configs) {
+        unsigned listener = next_listener++;
+        bool ok = (config.type & ~PJSIP_TRANSPORT_IPV6) == PJSIP_TRANSPORT_UDP
+                      ? startUdp(config, listener)
+                      : startListener(config, listener);
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+pjsua_transport_id PJSIPTransportSet::primary() const {
+    return count() > 0 ? slots[0].id : PJSUA_INVALID_ID;
+}
+
+void PJSIPTransportSet::snapshot(std::vector<PJSIPTransportInfo>& out) const {
+    size_t n = count();
+    out.clear();
+    out.reserve(n);
+
+    for (size_t i = 0; i < n; i++) {
+        const Slot& slot = slots[i];
+        if (slot.key.load(std::memory_order_acquire) == nullptr) {
+            continue;
+        }
+        PJSIPTransportInfo info;
+        info.id = slot.id;
+        info.type = slot.type;
+        info.listener = slot.listener;
+        info.shard = slot.shard;
+        info.port = 0;
+
+        pjsua_transport_info transport_info;
+        if (pjsua_transport_get_info(slot.id, &transport_info) == PJ_SUCCESS) {
+            info.address.assign(transport_info.local_name.host.ptr, transport_info.local_name.host.slen);
+            info.port = transport_info.local_name.port;
+        }
+
+        info.stats.rx_packets = slot.rx_packets.load(std::memory_order_relaxed);
+        info.stats.rx_bytes = slot.rx_bytes.load(std::memory_order_relaxed);
+        info.stats.tx_packets = slot.tx_packets.load(std::memory_order_relaxed);
+        info.stats.tx_bytes = slot.tx_bytes.load(std::memory_order_relaxed);
+        out.push_back(std::move(info));
+    }
+}
+
+const char* PJSIPTransportSet::typeName(pjsip_transport_type_e type) {
+    switch ((int)type) {
+    case PJSIP_TRANSPORT_UDP: return "udp";
+    case PJSIP_TRANSPORT_TCP: return "tcp";
+    case PJSIP_TRANSPORT_TLS: return "tls";
+    case PJSIP_TRANSPORT_UDP6: return "udp6";
+    case PJSIP_TRANSPORT_TCP6: return "tcp6";
+    case PJSIP_TRANSPORT_TLS6: return "tls6";
+    default: return "unknown";
+    }
+}
+
+bool PJSIPTransportSet::parseType(const std::string& name, pjsip_transport_type_e& type) {
+    static const pjsip_transport_type_e types[] = {
+        PJSIP_TRANSPORT_UDP, PJSIP_TRANSPORT_TCP, PJSIP_TRANSPORT_TLS,
+        PJSIP_TRANSPORT_UDP6, PJSIP_TRANSPORT_TCP6, PJSIP_TRANSPORT_TLS6
+    };
+    for (pjsip_transport_type_e candidate : types) {
+        if (name == typeName(candidate)) {
+            type = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PJSIPTransportSet::startUdp(const PJSIPTransportConfig& config, unsigned listener) {
+    int af = (config.type & PJSIP_TRANSPORT_IPV6) ? pj_AF_INET6() : pj_AF_INET();
+    unsigned shards = std::max(1u, config.count);
+#ifndef SO_REUSEPORT
+    if (shards > 1) {
+        PJW_LOG_WARN("⚠️ SO_REUSEPORT is not available on this platform, opening one UDP socket on port %d",
+                     config.port);
+        shards = 1;
+    }
+#endif
+
+    pj_sockaddr bind_addr;
+    pj_str_t bind_host = pj_str((char*)config.bind_address.c_str());
+    pj_status_t status = pj_sockaddr_init(af, &bind_addr, config.bind_address.empty() ? nullptr : &bind_host,
+                                          (pj_uint16_t)config.port);
+    if (status != PJ_SUCCESS) {
+        PJW_LOG_ERROR("❌ Invalid UDP bind address '%s': %d", config.bind_address.c_str(), status);
+        return false;
+    }
+
+    // Published host, the same for every shard
+    std::string published = !config.public_address.empty() ? config.public_address : config.bind_address;
+    if (published.empty()) {
+        pj_sockaddr host_addr;
+        char host[PJ_INET6_ADDRSTRLEN];
+        if (pj_gethostip(af, &host_addr) != PJ_SUCCESS) {
+            PJW_LOG_ERROR("❌ Unable to determine the local %s address", typeName(config.type));
+            return false;
+        }
+        published = pj_sockaddr_print(&host_addr, host, sizeof(host), 0);
+    }
+
+    for (unsigned shard = 0; shard < shards; shard++) {
+        pj_sock_t sock = PJ_INVALID_SOCKET;
+        status = pj_sock_socket(af, pj_SOCK_DGRAM(), 0, &sock);
+        if (status != PJ_SUCCESS) {
+            PJW_LOG_ERROR("❌ Error creating UDP socket: %d", status);
+            return false;
+        }
+
+#ifdef SO_REUSEPORT
+        if (shards > 1) {
+            int on = 1;
+            status = pj_sock_setsockopt(sock, pj_SOL_SOCKET(), SO_REUSEPORT, &on, sizeof(on));
+            if (status != PJ_SUCCESS) {
+                PJW_LOG_ERROR("❌ Error enabling SO_REUSEPORT: %d", status);
+                pj_sock_close(sock);
+                return false;
+            }
+        }
+#endif
+        // Buffer sizes are a hint, the OS may clamp them
+        if (config.rcvbuf > 0) {
+            pj_sock_setsockopt(sock, pj_SOL_SOCKET(), pj_SO_RCVBUF(), &config.rcvbuf, sizeof(config.rcvbuf));
+        }
+        if (config.sndbuf > 0) {
+            pj_sock_setsockopt(sock, pj_SOL_SOCKET(), pj_SO_SNDBUF(), &config.sndbuf, sizeof(config.sndbuf));
+        }
+
+        status = pj_sock_bind(sock, &bind_addr, pj_sockaddr_get_len(&bind_addr));
+        if (status != PJ_SUCCESS) {
+            PJW_LOG_ERROR("❌ Error binding UDP port %d: %d", config.port, status);
+            pj_sock_close(sock);
+            return false;
+        }
+
+        // An ephemeral port is picked once and shared by the other shards
+        if (pj_sockaddr_get_port(&bind_addr) == 0) {
+            pj_sockaddr bound;
+            int bound_len = sizeof(bound);
+            if (pj_sock_getsockname(sock, &bound, &bound_len) == PJ_SUCCESS) {
+                pj_sockaddr_set_port(&bind_addr, pj_sockaddr_get_port(&bound));
+            }
+        }
+
+        pjsip_host_port name;
+        name.host = pj_str((char*)published.c_str());
+        name.port = pj_sockaddr_get_port(&bind_addr);
+
+        pjsip_transport* transport = nullptr;
+        status = pjsip_udp_transport_attach2(pjsua_get_pjsip_endpt(), config.type, sock, &name,
+                                             std::max(1u, config.async_cnt), &transport);
+        if (status != PJ_SUCCESS) {
+            PJW_LOG_ERROR("❌ Error creating UDP transport: %d", status);
+            pj_sock_close(sock);
+            return false;
+        }
+
+        pjsua_transport_id id = PJSUA_INVALID_ID;
+        status = pjsua_transport_register(transport, &id);
+        if (status != PJ_SUCCESS) {
+            PJW_LOG_ERROR("❌ Error registering UDP transport (PJSUA_MAX_TRANSPORTS is %d): %d",
+                          (int)PJSUA_MAX_TRANSPORTS, status);
+            pjsip_transport_shutdown(transport);
+            return false;
+        }
+
+        if (!publish(transport, id, config.type, listener, shard)) {
+            return false;
+        }
+    }
+
+    PJW_LOG_INFO("📡 %s listener on %s:%d (%u socket%s)", typeName(config.type), published.c_str(),
+                 (int)pj_sockaddr_get_port(&bind_addr), shards, shards > 1 ? "s" : "");
+    return true;
+}
+
+bool PJSIPTransportSet::startListener(const PJSIPTransportConfig& config, unsigned listener) {
+    pjsua_transport_config cfg;
+    pjsua_transport_config_default(&cfg);
+    cfg.port = (unsigned)config.port;
+    if (!config.bind_address.empty()) {
+        cfg.bound_addr = pj_str((char*)config.bind_address.c_str());
+    }
+    if (!config.public_address.empty()) {
+        cfg.public_addr = pj_str((char*)config.public_address.c_str());
+    }
+
+    // Applied to the listening socket and inherited by accepted connections
+    int rcvbuf = config.rcvbuf;
+    int sndbuf = config.sndbuf;
+    pj_sockopt_params sockopts;
+    sockopts.cnt = 0;
+    if (rcvbuf > 0) {
+        sockopts.options[sockopts.cnt].level = pj_SOL_SOCKET();
+        sockopts.options[sockopts.cnt].optname = pj_SO_RCVBUF();
+        sockopts.options[sockopts.cnt].optval = &rcvbuf;
+        sockopts.options[sockopts.cnt].optlen = sizeof(rcvbuf);
+        sockopts.cnt++;
+    }
+    if (sndbuf > 0) {
+        sockopts.options[sockopts.cnt].level = pj_SOL_SOCKET();
+        sockopts.options[sockopts.cnt].optname = pj_SO_SNDBUF();
+        sockopts.options[sockopts.cnt].optval = &sndbuf;
+        sockopts.options[sockopts.cnt].optlen = sizeof(sndbuf);
+        sockopts.cnt++;
+    }
+    cfg.sockopt_params = sockopts;
+
+    bool is_tls = (config.type & ~PJSIP_TRANSPORT_IPV6) == PJSIP_TRANSPORT_TLS;
+    if (is_tls) {
+        cfg.tls_setting.sockopt_params = sockopts;
+        cfg.tls_setting.cert_file = pj_str((char*)config.cert_file.c_str());
+        cfg.tls_setting.privkey_file = pj_str((char*)config.privkey_file.c_str());
+        cfg.tls_setting.ca_list_file = pj_str((char*)config.ca_list_file.c_str());
+        cfg.tls_setting.password = pj_str((char*)config.password.c_str());
+        cfg.tls_setting.verify_server = config.verify_server ? PJ_TRUE : PJ_FALSE;
+        cfg.tls_setting.verify_client = config.verify_client ? PJ_TRUE : PJ_FALSE;
+        cfg.tls_setting.require_client_cert = config.verify_client ? PJ_TRUE : PJ_FALSE;
+    }
+
+    pjsua_transport_id id = PJSUA_INVALID_ID;
+    pj_status_t status = pjsua_transport_create(config.type, &cfg, &id);
+    if (status != PJ_SUCCESS) {
+        PJW_LOG_ERROR("❌ Error creating %s transport on port %d: %d%s", typeName(config.type), config.port, status,
+                      is_tls ? " (is pjproject built with TLS support?)" : "");
+        return false;
+    }
+
+    if (!publish(pjsua_var.tpdata[id].data.factory, id, config.type, listener, 0)) {
+        return false;
+    }
+
+    PJW_LOG_INFO("📡 %s listener on port %d", typeName(config.type), config.port);
+    return true;
+}
+
+bool PJSIPTransportSet::publish(void* key, pjsua_transport_id id, pjsip_transport_type_e type, unsigned listener,
+                                unsigned shard) {
+    // A slot closed by a detached env first, then a fresh one
+    size_t high_water = slot_count.load(std::memory_order_relaxed);
+    size_t index = 0;
+    while (index < high_water && slots[index].key.load(std::memory_order_relaxed) != nullptr) {
+        index++;
+    }
+    if (index >= MAX_SLOTS) {
+        PJW_LOG_ERROR("❌ Too many SIP transports (max %d)", (int)MAX_SLOTS);
+        return false;
+    }
+
+    Slot& slot = slots[index];
+    slot.id = id;
+    slot.type = type;
+    slot.listener = listener;
+    slot.shard = shard;
+    slot.rx_packets.store(0, std::memory_order_relaxed);
+    slot.rx_bytes.store(0, std::memory_order_relaxed);
+    slot.tx_packets.store(0, std::memory_order_relaxed);
+    slot.tx_bytes.store(0, std::memory_order_relaxed);
+
+    // Visible to the module callbacks only once filled in
+    slot.key.store(key, std::memory_order_release);
+    if (index == high_water) {
+        slot_count.store(index + 1, std::memory_order_release);
+    }
+    return true;
+}
+
+PJSIPTransportSet::Slot* PJSIPTransportSet::find(const pjsip_transport* transport) {
+    if (!transport) {
+        return nullptr;
+    }
+    size_t n = count();
+    for (size_t i = 0; i < n; i++) {
+        void* key = slots[i].key.load(std::memory_order_acquire);
+        if (key != nullptr && (key == transport || (transport->factory && key == transport->factory))) {
+            return &slots[i];
+        }
+    }
+    return nullptr;
+}
+
+bool PJSIPTransportSet::registerModule() {
+    // pjsua_destroy unloads it with the endpoint and resets the id to -1
+    if (stats_module.name.slen > 0 && stats_module.id >= 0) {
+        return true;
+    }
+
+    pj_bzero(&stats_module, sizeof(stats_module));
+    stats_module.name = pj_str((char*)"mod-node-pjsip-transport-stats");
+    stats_module.id = -1;
+    stats_module.priority = PJSIP_MOD_PRIORITY_TRANSPORT_LAYER - 1;
+    stats_module.on_rx_request = &PJSIPTransportSet::onRxMessage;
+    stats_module.on_rx_response = &PJSIPTransportSet::onRxMessage;
+    stats_module.on_tx_request = &PJSIPTransportSet::onTxMessage;
+    stats_module.on_tx_response = &PJSIPTransportSet::onTxMessage;
+
+    pj_status_t status = pjsip_endpt_register_module(pjsua_get_pjsip_endpt(), &stats_module);
+    if (status != PJ_SUCCESS) {
+        PJW_LOG_ERROR("❌ Error registering transport stats module: %d", status);
+        return false;
+    }
+    return true;
+}
+
+pj_bool_t PJSIPTransportSet::onRxMessage(pjsip_rx_data* rdata) {
+    PJSIPTransportSet* set = active;
+    Slot* slot = set ? set->find(rdata->tp_info.transport) : nullptr;
+    if (slot) {
+        slot->rx_packets.fetch_add(1, std::memory_order_relaxed);
+        slot->rx_bytes.fetch_add((uint64_t)rdata->pkt_info.len, std::memory_order_relaxed);
+    }
+    return PJ_FALSE;
+}
+
+pj_status_t PJSIPTransportSet::onTxMessage(pjsip_tx_data* tdata) {
+    PJSIPTransportSet* set = active;
+    Slot* slot = set ? set->find(tdata->tp_info.transport) : nullptr;
+    if (slot) {
+        slot->tx_packets.fetch_add(1, std::memory_order_relaxed);
+        slot->tx_bytes.fetch_add((uint64_t)(tdata->buf.cur - tdata->buf.start), std::memory_order_relaxed);
+    }
+    return PJ_SUCCESS;
+}
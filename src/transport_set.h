@@ -0,0 +1,119 @@
+#ifndef NODE_PJSIP_TRANSPORT_SET_H
+#define NODE_PJSIP_TRANSPORT_SET_H
+
+#include <pjsua-lib/pjsua.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One entry of the init "transports" option
+struct PJSIPTransportConfig {
+    pjsip_transport_type_e type;    // UDP, TCP, TLS or the IPv6 variants
+    std::string bind_address;       // empty = any interface
+    std::string public_address;     // Via/Contact host, empty = bound or host address
+    int port;                       // 0 = ephemeral
+    unsigned count;                 // UDP only: sockets sharing the port through SO_REUSEPORT
+    unsigned async_cnt;             // UDP only: concurrent ioqueue reads per socket
+    int rcvbuf;                     // SO_RCVBUF bytes, 0 = OS default
+    int sndbuf;                     // SO_SNDBUF bytes, 0 = OS default
+
+    // TLS only
+    std::string cert_file;
+    std::string privkey_file;
+    std::string ca_list_file;
+    std::string password;
+    bool verify_server;
+    bool verify_client;
+
+    PJSIPTransportConfig();
+};
+
+struct PJSIPTransportStats {
+    uint64_t rx_packets;
+    uint64_t rx_bytes;
+    uint64_t tx_packets;
+    uint64_t tx_bytes;
+};
+
+struct PJSIPTransportInfo {
+    pjsua_transport_id id;
+    pjsip_transport_type_e type;
+    unsigned listener;              // index into the configured list
+    unsigned shard;                 // socket index within a UDP listener
+    std::string address;            // published host
+    int port;
+    PJSIPTransportStats stats;
+};
+
+// The SIP listener set created at initialize().
+//
+// UDP listeners are opened here rather than by pjsua_transport_create so that
+// several sockets can share one port (SO_REUSEPORT, the kernel spreads
+// datagrams across them and every SIP worker thread can service a different
+// socket) and so each socket gets its own receive depth and buffer sizes.
+// They are handed to pjsua with pjsua_transport_register. TCP and TLS
+// listeners go through pjsua_transport_create.
+//
+// A pjsip module just below the transport layer counts every SIP message
+// received or sent per listener. Connection-oriented transports are matched
+// through their listener factory, so all TCP/TLS connections of a listener
+// add up to its entry.
+class PJSIPTransportSet {
+public:
+    PJSIPTransportSet();
+
+    PJSIPTransportSet(const PJSIPTransportSet&) = delete;
+    PJSIPTransportSet& operator=(const PJSIPTransportSet&) = delete;
+
+    // Between pjsua_init() and pjsua_start()
+    bool start(const std::vector<PJSIPTransportConfig>& configs);
+    void clear();
+
+    // While running - listeners of an env attaching to the engine, closed
+    // again when it detaches. add() closes what it opened if one fails.
+    bool add(const std::vector<PJSIPTransportConfig>& configs, std::vector<pjsua_transport_id>& created);
+    void close(const std::vector<pjsua_transport_id>& ids);
+
+    pjsua_transport_id primary() const;
+    size_t count() const { return slot_count.load(std::memory_order_acquire); }
+    void snapshot(std::vector<PJSIPTransportInfo>& out) const;
+
+    static const char* typeName(pjsip_transport_type_e type);
+    static bool parseType(const std::string& name, pjsip_transport_type_e& type);
+
+private:
+    static const size_t MAX_SLOTS = PJSUA_MAX_TRANSPORTS;
+
+    struct alignas(64) Slot {
+        std::atomic<void*> key;     // pjsip_transport* (UDP) or pjsip_tpfactory* (TCP/TLS), null once closed
+        pjsua_transport_id id;
+        pjsip_transport_type_e type;
+        unsigned listener;
+        unsigned shard;
+        std::atomic<uint64_t> rx_packets;
+        std::atomic<uint64_t> rx_bytes;
+        std::atomic<uint64_t> tx_packets;
+        std::atomic<uint64_t> tx_bytes;
+    };
+
+    bool startAll(const std::vector<PJSIPTransportConfig>& configs);
+    bool startUdp(const PJSIPTransportConfig& config, unsigned listener);
+    bool startListener(const PJSIPTransportConfig& config, unsigned listener);
+    bool publish(void* key, pjsua_transport_id id, pjsip_transport_type_e type, unsigned listener, unsigned shard);
+    Slot* find(const pjsip_transport* transport);
+    bool registerModule();
+
+    static pj_bool_t onRxMessage(pjsip_rx_data* rdata);
+    static pj_status_t onTxMessage(pjsip_tx_data* tdata);
+
+    // pjsip module callbacks carry no user data
+    static PJSIPTransportSet* active;
+
+    Slot slots[MAX_SLOTS];
+    std::atomic<size_t> slot_count;     // high-water mark, closed slots are reused
+    unsigned next_listener;
+};
+
+#endif